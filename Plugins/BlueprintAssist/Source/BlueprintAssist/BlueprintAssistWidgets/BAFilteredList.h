@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "BlueprintAssistGlobals.h"
 #include "Widgets/Input/SSearchBox.h"
 #include "Widgets/Layout/SBorder.h"
 #include "Widgets/Layout/SSeparator.h"
@@ -69,7 +70,10 @@ public:
 
 		AllItems.Empty();
 
-		InArgs._InitListItems.Execute(AllItems);
+		{
+			BA_TRACE_SCOPE(BA_PopulateMenu);
+			InArgs._InitListItems.Execute(AllItems);
+		}
 
 		FilteredItems = AllItems;
 
@@ -160,6 +164,8 @@ public:
 
 	void OnFilterTextChanged(const FText& InFilterText)
 	{
+		BA_TRACE_SCOPE(BA_FilterMenu);
+
 		FilterText = InFilterText;
 		FString FilterString = InFilterText.ToString();
 
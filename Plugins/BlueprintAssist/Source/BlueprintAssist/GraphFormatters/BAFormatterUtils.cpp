@@ -1,52 +1,15 @@
 #include "BAFormatterUtils.h"
 
+#include "BlueprintAssistCommentHandler.h"
 #include "BlueprintAssistUtils.h"
+#include "EdGraphNode_Comment.h"
 
-bool FBAFormatterUtils::IsSameRow(const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* NodeA, UEdGraphNode* NodeB)
+void FBAFormatterUtils::StraightenRow(TSharedPtr<FBAGraphHandler> GraphHandler, FPinLinkIds& LinkIds, const FPinLinkSet& SameRowMapping, UEdGraphNode* Node, FCommentHandler* CommentHandler)
 {
-	TSet<FPinLink> VisitedLinks;
-	TQueue<UEdGraphNode*> PendingNodes;
-	PendingNodes.Enqueue(NodeA);
-	while (!PendingNodes.IsEmpty())
-	{
-		UEdGraphNode* Node = nullptr;
-		PendingNodes.Dequeue(Node);
-
-		// UE_LOG(LogTemp, Warning, TEXT("Checking node %s"), *FBAUtils::GetNodeName(Node));
-
-		if (Node == NodeB)
-		{
-			return true;
-		}
-
-		for (const FPinLink& PinLink : FBAUtils::GetPinLinks(Node))
-		{
-			if (VisitedLinks.Contains(PinLink))
-			{
-				continue;
-			}
-
-			VisitedLinks.Add(PinLink);
-			VisitedLinks.Add(PinLink.MakeOppositeLink());
-
-			if (!SameRowMapping.Contains(PinLink))
-			{
-				continue;
-			}
-
-			PendingNodes.Enqueue(PinLink.GetNode());
-		}
-	}
-
-	return false;
+	StraightenRowWithFilter(GraphHandler, LinkIds, SameRowMapping, Node, [](const FPinLink& Link) { return true; }, CommentHandler);
 }
 
-void FBAFormatterUtils::StraightenRow(TSharedPtr<FBAGraphHandler> GraphHandler, const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* Node)
-{
-	StraightenRowWithFilter(GraphHandler, SameRowMapping, Node, [](const FPinLink& Link) { return true; });
-}
-
-void FBAFormatterUtils::StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> GraphHandler, const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* Node, TFunctionRef<bool(const FPinLink&)> Pred)
+void FBAFormatterUtils::StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> GraphHandler, FPinLinkIds& LinkIds, const FPinLinkSet& SameRowMapping, UEdGraphNode* Node, TFunctionRef<bool(const FPinLink&)> Pred, FCommentHandler* CommentHandler)
 {
 	TQueue<FPinLink> PendingLinks;
 	for (const FPinLink& Link : FBAUtils::GetPinLinks(Node))
@@ -54,7 +17,7 @@ void FBAFormatterUtils::StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> Grap
 		PendingLinks.Enqueue(Link);
 	}
 
-	TSet<FPinLink> StraightenedLinks;
+	FPinLinkSet StraightenedLinks;
 	while (!PendingLinks.IsEmpty())
 	{
 		FPinLink Link;
@@ -65,22 +28,90 @@ void FBAFormatterUtils::StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> Grap
 			continue;
 		}
 
-		if (StraightenedLinks.Contains(Link))
+		const int32 LinkId = LinkIds.GetLinkId(Link);
+		if (StraightenedLinks.Contains(LinkId))
 		{
 			continue;
 		}
 
-		StraightenedLinks.Add(Link);
-		StraightenedLinks.Add(Link.MakeOppositeLink());
+		StraightenedLinks.Add(LinkId);
+		StraightenedLinks.Add(LinkIds.GetLinkId(Link.To, Link.From));
 
-		if (SameRowMapping.Contains(Link))
+		if (SameRowMapping.Contains(LinkId))
 		{
 			FBAUtils::StraightenPin(GraphHandler, Link);
 
+			if (CommentHandler)
+			{
+				CommentHandler->MarkNodeMoved(Link.GetToNode());
+			}
+
 			for (const FPinLink& NewLink : FBAUtils::GetPinLinks(Link.GetToNode()))
 			{
 				PendingLinks.Enqueue(NewLink);
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+void FBAFormatterUtils::ExpandCommentsNested(
+	TFormatterStack<FCommentExpandFrame>& Stack,
+	const FCommentHandler& CommentHandler,
+	TArray<UEdGraphNode*>&& RootNodeSet,
+	TFunctionRef<void(TArray<UEdGraphNode*>&)> SortNodeSet,
+	TFunctionRef<TArray<UEdGraphNode*>(UEdGraphNode_Comment*, const TArray<UEdGraphNode*>&)> GetCommentNodeSet,
+	TFunctionRef<void(FCommentExpandFrame&)> ExpandNodeSet)
+{
+	const auto InitFrame = [&](FCommentExpandFrame& Frame)
+	{
+		SortNodeSet(Frame.NodeSet);
+
+		Frame.Comments = FBAUtils::GetNodesOfClass<UEdGraphNode_Comment>(Frame.NodeSet);
+		Frame.Comments.StableSort([&](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
+		{
+			return CommentHandler.GetCommentDepth(&CommentA) < CommentHandler.GetCommentDepth(&CommentB);
+		});
+	};
+
+	FCommentExpandFrame& RootFrame = Stack.Push();
+	RootFrame.NodeSet = MoveTemp(RootNodeSet);
+	InitFrame(RootFrame);
+
+	while (Stack.Num() > 0)
+	{
+		FCommentExpandFrame& Frame = Stack.Top();
+
+		if (Frame.NextComment < Frame.Comments.Num())
+		{
+			UEdGraphNode_Comment* Comment = Frame.Comments[Frame.NextComment++];
+			if (Frame.HandledNodes.Contains(Comment))
+			{
+				continue;
+			}
+
+			Frame.PendingComment = Comment;
+
+			FCommentExpandFrame& CommentFrame = Stack.Push();
+			CommentFrame.NodeSet = GetCommentNodeSet(Comment, Frame.NodeSet);
+			InitFrame(CommentFrame);
+			continue;
+		}
+
+		// all nested comments are done, pass our nodes up to the comment containing them
+		if (Stack.Num() > 1)
+		{
+			FCommentExpandFrame& ParentFrame = Stack[Stack.Num() - 2];
+			ParentFrame.HandledNodes.Append(Frame.NodeSet);
+			ParentFrame.CommentContains.Add(ParentFrame.PendingComment, TSet<UEdGraphNode*>(Frame.NodeSet));
+		}
+
+		// Remove all handled nodes from subgraphs
+		const TSet<UEdGraphNode*>& HandledNodes = Frame.HandledNodes;
+		Frame.NodeSet.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
+		Frame.Comments.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
+
+		ExpandNodeSet(Frame);
+
+		Stack.Pop();
+	}
+}
@@ -2,9 +2,24 @@
 
 #include "GraphFormatterTypes.h"
 
+class FCommentHandler;
+
 struct FBAFormatterUtils
 {
-	static bool IsSameRow(const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* NodeA, UEdGraphNode* NodeB);
-	static void StraightenRow(TSharedPtr<FBAGraphHandler> GraphHandler, const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* Node);
-	static void StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> GraphHandler, const TMap<FPinLink, bool>& SameRowMapping, UEdGraphNode* Node, TFunctionRef<bool(const FPinLink&)> Pred);
+	/* Moved nodes are reported to the comment handler, if there is one */
+	static void StraightenRow(TSharedPtr<FBAGraphHandler> GraphHandler, FPinLinkIds& LinkIds, const FPinLinkSet& SameRowMapping, UEdGraphNode* Node, FCommentHandler* CommentHandler = nullptr);
+	static void StraightenRowWithFilter(TSharedPtr<FBAGraphHandler> GraphHandler, FPinLinkIds& LinkIds, const FPinLinkSet& SameRowMapping, UEdGraphNode* Node, TFunctionRef<bool(const FPinLink&)> Pred, FCommentHandler* CommentHandler = nullptr);
+
+	/**
+	 * Expand a node set and the node sets of its comments, innermost comments first.
+	 * SortNodeSet is applied to every node set before its comments are gathered,
+	 * ExpandNodeSet is called once the nested comments are done with the nodes they contain removed.
+	 */
+	static void ExpandCommentsNested(
+		TFormatterStack<FCommentExpandFrame>& Stack,
+		const FCommentHandler& CommentHandler,
+		TArray<UEdGraphNode*>&& RootNodeSet,
+		TFunctionRef<void(TArray<UEdGraphNode*>&)> SortNodeSet,
+		TFunctionRef<TArray<UEdGraphNode*>(UEdGraphNode_Comment*, const TArray<UEdGraphNode*>&)> GetCommentNodeSet,
+		TFunctionRef<void(FCommentExpandFrame&)> ExpandNodeSet);
 };
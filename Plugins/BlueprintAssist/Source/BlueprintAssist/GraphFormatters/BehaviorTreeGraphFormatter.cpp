@@ -2,10 +2,180 @@
 
 #include "BehaviorTreeGraphFormatter.h"
 
+#include "BlueprintAssistGlobals.h"
 #include "BlueprintAssistGraphHandler.h"
 #include "BlueprintAssistUtils.h"
 #include "Containers/Map.h"
 
+namespace
+{
+	/* Node data for the tidy tree layout (Buchheim, Juenger and Leipert's linear time version of Walker's algorithm) */
+	struct FBATidyTree
+	{
+		TArray<UEdGraphNode*> Nodes;
+		TArray<int32> Parents;
+		TArray<TArray<int32>> Children;
+
+		/* 1-based index of the node within its siblings */
+		TArray<int32> Numbers;
+
+		TArray<float> Widths;
+		TArray<float> Prelims;
+		TArray<float> Mods;
+		TArray<float> Shifts;
+		TArray<float> Changes;
+		TArray<int32> Threads;
+		TArray<int32> Ancestors;
+
+		float PaddingX = 0;
+
+		int32 Add(UEdGraphNode* Node, int32 Parent, float Width)
+		{
+			const int32 Index = Nodes.Add(Node);
+			Parents.Add(Parent);
+			Children.AddDefaulted();
+			Numbers.Add(Parent != INDEX_NONE ? Children[Parent].Add(Index) + 1 : 1);
+			Widths.Add(Width);
+			Prelims.Add(0);
+			Mods.Add(0);
+			Shifts.Add(0);
+			Changes.Add(0);
+			Threads.Add(INDEX_NONE);
+			Ancestors.Add(Index);
+			return Index;
+		}
+
+		int32 GetLeftSibling(int32 V) const
+		{
+			return Numbers[V] > 1 ? Children[Parents[V]][Numbers[V] - 2] : INDEX_NONE;
+		}
+
+		int32 GetLeftMostSibling(int32 V) const
+		{
+			return Parents[V] != INDEX_NONE ? Children[Parents[V]][0] : V;
+		}
+
+		int32 NextLeft(int32 V) const
+		{
+			return Children[V].Num() > 0 ? Children[V][0] : Threads[V];
+		}
+
+		int32 NextRight(int32 V) const
+		{
+			return Children[V].Num() > 0 ? Children[V].Last() : Threads[V];
+		}
+
+		/* Distance between the centers of two neighboring nodes on the same depth */
+		float GetDistance(int32 Left, int32 Right) const
+		{
+			return (Widths[Left] + Widths[Right]) * 0.5f + PaddingX;
+		}
+
+		void MoveSubtree(int32 WM, int32 WP, float Shift)
+		{
+			const float Subtrees = Numbers[WP] - Numbers[WM];
+			Changes[WP] -= Shift / Subtrees;
+			Shifts[WP] += Shift;
+			Changes[WM] += Shift / Subtrees;
+			Prelims[WP] += Shift;
+			Mods[WP] += Shift;
+		}
+
+		void ExecuteShifts(int32 V)
+		{
+			float Shift = 0;
+			float Change = 0;
+			for (int32 i = Children[V].Num() - 1; i >= 0; --i)
+			{
+				const int32 W = Children[V][i];
+				Prelims[W] += Shift;
+				Mods[W] += Shift;
+				Change += Changes[W];
+				Shift += Shifts[W] + Change;
+			}
+		}
+
+		/* Walk the right contour of the left siblings and the left contour of V, pushing V's subtree right where they get too close */
+		void Apportion(int32 V, int32& DefaultAncestor)
+		{
+			const int32 W = GetLeftSibling(V);
+			if (W == INDEX_NONE)
+			{
+				return;
+			}
+
+			int32 VIP = V;
+			int32 VOP = V;
+			int32 VIM = W;
+			int32 VOM = GetLeftMostSibling(VIP);
+			float SIP = Mods[VIP];
+			float SOP = Mods[VOP];
+			float SIM = Mods[VIM];
+			float SOM = Mods[VOM];
+
+			while (NextRight(VIM) != INDEX_NONE && NextLeft(VIP) != INDEX_NONE)
+			{
+				VIM = NextRight(VIM);
+				VIP = NextLeft(VIP);
+				VOM = NextLeft(VOM);
+				VOP = NextRight(VOP);
+				Ancestors[VOP] = V;
+
+				const float Shift = (Prelims[VIM] + SIM) - (Prelims[VIP] + SIP) + GetDistance(VIM, VIP);
+				if (Shift > 0)
+				{
+					const int32 Ancestor = Parents[Ancestors[VIM]] == Parents[V] ? Ancestors[VIM] : DefaultAncestor;
+					MoveSubtree(Ancestor, V, Shift);
+					SIP += Shift;
+					SOP += Shift;
+				}
+
+				SIM += Mods[VIM];
+				SIP += Mods[VIP];
+				SOM += Mods[VOM];
+				SOP += Mods[VOP];
+			}
+
+			if (NextRight(VIM) != INDEX_NONE && NextRight(VOP) == INDEX_NONE)
+			{
+				Threads[VOP] = NextRight(VIM);
+				Mods[VOP] += SIM - SOP;
+			}
+
+			if (NextLeft(VIP) != INDEX_NONE && NextLeft(VOM) == INDEX_NONE)
+			{
+				Threads[VOM] = NextLeft(VIP);
+				Mods[VOM] += SIP - SOM;
+				DefaultAncestor = V;
+			}
+		}
+
+		/* Called once all of V's children are placed */
+		void FinishNode(int32 V)
+		{
+			const int32 LeftSibling = GetLeftSibling(V);
+			if (Children[V].Num() == 0)
+			{
+				Prelims[V] = LeftSibling != INDEX_NONE ? Prelims[LeftSibling] + GetDistance(LeftSibling, V) : 0;
+				return;
+			}
+
+			ExecuteShifts(V);
+
+			const float Midpoint = (Prelims[Children[V][0]] + Prelims[Children[V].Last()]) * 0.5f;
+			if (LeftSibling != INDEX_NONE)
+			{
+				Prelims[V] = Prelims[LeftSibling] + GetDistance(LeftSibling, V);
+				Mods[V] = Prelims[V] - Midpoint;
+			}
+			else
+			{
+				Prelims[V] = Midpoint;
+			}
+		}
+	};
+}
+
 FBehaviorTreeGraphFormatter::FBehaviorTreeGraphFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler)
 	: GraphHandler(InGraphHandler)
 {
@@ -14,8 +184,9 @@ FBehaviorTreeGraphFormatter::FBehaviorTreeGraphFormatter(TSharedPtr<FBAGraphHand
 
 void FBehaviorTreeGraphFormatter::FormatNode(UEdGraphNode* InNode)
 {
+	BA_TRACE_SCOPE(BA_BehaviorTreeFormatNode);
+
 	RootNode = InNode;
-	RootNode->Modify();
 
 	while (true)
 	{
@@ -34,7 +205,7 @@ void FBehaviorTreeGraphFormatter::FormatNode(UEdGraphNode* InNode)
 	}
 
 	const float OldNodeX = RootNode->NodePosX;
-	FormatNodes(RootNode, FormattedNodes);
+	FormatTree();
 	const float DeltaX = RootNode->NodePosX - OldNodeX;
 
 	// make it look like the root node doesn't move
@@ -49,64 +220,120 @@ FBAFormatterSettings FBehaviorTreeGraphFormatter::GetFormatterSettings()
 	return FBAUtils::GetFormatterSettings(GraphHandler->GetFocusedEdGraph());
 }
 
-void FBehaviorTreeGraphFormatter::FormatNodes(UEdGraphNode* InNode, TSet<UEdGraphNode*>& VisitedNodes) const
+void FBehaviorTreeGraphFormatter::FormatTree()
 {
-	// TODO: Improve this algorithm as it can have overlapping nodes. With an x-padding of 100 it requires a very large BT though
-	TArray<UEdGraphPin*> LinkedOutPins = FBAUtils::GetLinkedPins(InNode, EGPD_Output);
+	BA_TRACE_SCOPE(BA_BehaviorTreeFormatTree);
 
-	FSlateRect InNodeBounds = FBAUtils::GetCachedNodeBounds(GraphHandler, InNode);
+	FBATidyTree Tree;
+	Tree.PaddingX = FormatterSettings.Padding.X;
 
-	float PreviousNodeX = InNode->NodePosX;
-	if (VisitedNodes.Num() > 0)
-	{
-		const FSlateRect VisitedNodeBounds = FBAUtils::GetCachedNodeArrayBounds(
-			GraphHandler,
-			VisitedNodes.Array());
+	TArray<FSlateRect> Bounds;
+	TArray<int32> Depths;
 
-		PreviousNodeX = FMath::Max(PreviousNodeX, VisitedNodeBounds.Right);
-	}
+	const auto AddNode = [&](UEdGraphNode* Node, int32 Parent)
+	{
+		const FSlateRect NodeBounds = FBAUtils::GetCachedNodeBounds(GraphHandler, Node);
+		Bounds.Add(NodeBounds);
+		Depths.Add(Parent != INDEX_NONE ? Depths[Parent] + 1 : 0);
+		FormattedNodes.Add(Node);
+		return Tree.Add(Node, Parent, NodeBounds.GetSize().X);
+	};
 
 	const auto& LeftMostSorter = [](UEdGraphPin& A, UEdGraphPin& B)
 	{
 		return A.GetOwningNode()->NodePosX < B.GetOwningNode()->NodePosX;
 	};
 
-	TArray<UEdGraphNode*> ChildNodes;
-	for (UEdGraphPin* Pin : LinkedOutPins)
+	// build the tree breadth first, parents always come before their children
+	AddNode(RootNode, INDEX_NONE);
+	for (int32 NodeIndex = 0; NodeIndex < Tree.Nodes.Num(); ++NodeIndex)
 	{
-		TArray<UEdGraphPin*> LinkedToPins = Pin->LinkedTo;
+		for (UEdGraphPin* Pin : FBAUtils::GetLinkedPins(Tree.Nodes[NodeIndex], EGPD_Output))
+		{
+			TArray<UEdGraphPin*> LinkedToPins = Pin->LinkedTo;
 
-		// must sort the pins by left most, since order in the behavior tree matters
-		LinkedToPins.Sort(LeftMostSorter);
+			// must sort the pins by left most, since order in the behavior tree matters
+			LinkedToPins.Sort(LeftMostSorter);
 
-		for (UEdGraphPin* LinkedPin : LinkedToPins)
-		{
-			UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+			for (UEdGraphPin* LinkedPin : LinkedToPins)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+				if (!FormattedNodes.Contains(LinkedNode))
+				{
+					AddNode(LinkedNode, NodeIndex);
+				}
+			}
+		}
+	}
+
+	// first walk: post order, each node is finished after its children and apportioned against its left siblings
+	TArray<int32> DefaultAncestors;
+	DefaultAncestors.Init(INDEX_NONE, Tree.Nodes.Num());
 
-			if (VisitedNodes.Contains(LinkedNode))
+	TArray<TPair<int32, int32>> Stack;
+	Stack.Push(TPair<int32, int32>(0, 0));
+	while (Stack.Num() > 0)
+	{
+		const int32 V = Stack.Last().Key;
+		const int32 NextChild = Stack.Last().Value;
+		if (NextChild < Tree.Children[V].Num())
+		{
+			if (NextChild == 0)
 			{
-				continue;
+				DefaultAncestors[V] = Tree.Children[V][0];
 			}
 
-			LinkedNode->Modify(false);
+			Stack.Last().Value += 1;
+			Stack.Push(TPair<int32, int32>(Tree.Children[V][NextChild], 0));
+			continue;
+		}
 
-			// vaguely position the child node
-			LinkedNode->NodePosX = PreviousNodeX + FormatterSettings.Padding.X;
-			LinkedNode->NodePosY = InNodeBounds.Bottom + FormatterSettings.Padding.Y;
+		Stack.Pop(false);
+		Tree.FinishNode(V);
 
-			FormatNodes(LinkedNode, VisitedNodes);
+		const int32 Parent = Tree.Parents[V];
+		if (Parent != INDEX_NONE)
+		{
+			Tree.Apportion(V, DefaultAncestors[Parent]);
+		}
+	}
 
-			ChildNodes.Add(LinkedNode);
+	// rows are as tall as their tallest node so nodes on different depths never overlap
+	TArray<float> RowY;
+	for (int32 NodeIndex = 0; NodeIndex < Tree.Nodes.Num(); ++NodeIndex)
+	{
+		if (Depths[NodeIndex] >= RowY.Num())
+		{
+			RowY.Add(0);
+		}
 
-			// center the root node to the children
-			const FSlateRect ChildrenBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, ChildNodes);
-			InNode->NodePosX = ChildrenBounds.GetCenter().X - InNodeBounds.GetSize().X / 2;
+		RowY[Depths[NodeIndex]] = FMath::Max(RowY[Depths[NodeIndex]], Bounds[NodeIndex].GetSize().Y);
+	}
 
-			InNodeBounds = FBAUtils::GetCachedNodeBounds(GraphHandler, InNode);
+	float NextRowY = Bounds[0].Top;
+	for (float& Row : RowY)
+	{
+		const float RowHeight = Row;
+		Row = NextRowY;
+		NextRowY += RowHeight + FormatterSettings.Padding.Y;
+	}
 
-			PreviousNodeX = FBAUtils::GetCachedNodeBounds(GraphHandler, LinkedNode).Right;
+	// second walk: breadth first order already has every parent before its children, so the mods can be summed in a single pass
+	TArray<float> ModSums;
+	ModSums.SetNumZeroed(Tree.Nodes.Num());
+	for (int32 NodeIndex = 0; NodeIndex < Tree.Nodes.Num(); ++NodeIndex)
+	{
+		const int32 Parent = Tree.Parents[NodeIndex];
+		if (Parent != INDEX_NONE)
+		{
+			ModSums[NodeIndex] = ModSums[Parent] + Tree.Mods[Parent];
 		}
-	}
 
-	VisitedNodes.Emplace(InNode);
+		const float CenterX = Tree.Prelims[NodeIndex] + ModSums[NodeIndex];
+
+		UEdGraphNode* Node = Tree.Nodes[NodeIndex];
+		const FSlateRect& NodeBounds = Bounds[NodeIndex];
+		Node->NodePosX = FMath::RoundToInt(CenterX - Tree.Widths[NodeIndex] * 0.5f);
+		Node->NodePosY = FMath::RoundToInt(RowY[Depths[NodeIndex]] + (Node->NodePosY - NodeBounds.Top));
+	}
 }
@@ -31,5 +31,6 @@ public:
 	virtual FBAFormatterSettings GetFormatterSettings() override;
 
 private:
-	void FormatNodes(UEdGraphNode* Node, TSet<UEdGraphNode*>& VisitedNodes) const;
+	/* Tidy tree layout in linear time, children keep their left to right order */
+	void FormatTree();
 };
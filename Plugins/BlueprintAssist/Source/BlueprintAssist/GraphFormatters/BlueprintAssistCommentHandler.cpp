@@ -6,6 +6,223 @@
 #include "BlueprintAssistUtils.h"
 #include "EdGraphNode_Comment.h"
 #include "FormatterInterface.h"
+#include "EdGraph/EdGraph.h"
+
+void FBACommentForest::Update(UEdGraph* Graph)
+{
+	if (!Graph)
+	{
+		Reset();
+		return;
+	}
+
+	TSet<UEdGraphNode_Comment*> GraphComments;
+	for (UEdGraphNode* Node : Graph->Nodes)
+	{
+		if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(Node))
+		{
+			GraphComments.Add(Comment);
+		}
+	}
+
+	// only rebuild the comments which were removed, added or now contain different nodes
+	TArray<UEdGraphNode_Comment*> ChangedComments;
+	for (const auto& Elem : Entries)
+	{
+		if (!GraphComments.Contains(Elem.Key) || !IsEntryUpToDate(Elem.Key, Elem.Value))
+		{
+			ChangedComments.Add(Elem.Key);
+		}
+	}
+
+	for (UEdGraphNode_Comment* Comment : GraphComments)
+	{
+		if (!Entries.Contains(Comment))
+		{
+			ChangedComments.Add(Comment);
+		}
+	}
+
+	if (ChangedComments.Num() == 0)
+	{
+		return;
+	}
+
+	++Version;
+
+	for (UEdGraphNode_Comment* Comment : ChangedComments)
+	{
+		RemoveEntry(Comment);
+
+		if (GraphComments.Contains(Comment))
+		{
+			AddEntry(Comment);
+		}
+	}
+
+	// depths and child comment nodes depend on the rest of the hierarchy
+	TMap<const UEdGraphNode_Comment*, int32> Depths;
+	TSet<UEdGraphNode_Comment*> Visiting;
+	SortedComments.Reset(Entries.Num());
+	for (auto& Elem : Entries)
+	{
+		Elem.Value.Depth = CalculateDepth(Elem.Key, Depths, Visiting);
+		Elem.Value.bHasChildCommentNodes = false;
+		Elem.Value.NodesUnderCommentAndChildComments.Reset();
+		SortedComments.Add(Elem.Key);
+	}
+
+	SortedComments.StableSort([&Depths](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
+	{
+		return Depths.FindRef(&CommentA) > Depths.FindRef(&CommentB);
+	});
+}
+
+void FBACommentForest::Reset()
+{
+	Entries.Reset();
+	ParentComments.Reset();
+	SortedComments.Reset();
+	++Version;
+}
+
+const TArray<UEdGraphNode*>& FBACommentForest::GetNodesUnderComment(UEdGraphNode_Comment* Comment) const
+{
+	static const TArray<UEdGraphNode*> Empty;
+	const FCommentEntry* Entry = Entries.Find(Comment);
+	return Entry ? Entry->NodesUnderComment : Empty;
+}
+
+const TArray<UEdGraphNode_Comment*>& FBACommentForest::GetParentComments(UEdGraphNode* Node) const
+{
+	static const TArray<UEdGraphNode_Comment*> Empty;
+	const TArray<UEdGraphNode_Comment*>* Found = ParentComments.Find(Node);
+	return Found ? *Found : Empty;
+}
+
+const TArray<UEdGraphNode*>& FBACommentForest::GetNodesUnderCommentAndChildComments(UEdGraphNode_Comment* Comment)
+{
+	static const TArray<UEdGraphNode*> Empty;
+	FCommentEntry* Entry = Entries.Find(Comment);
+	if (!Entry)
+	{
+		return Empty;
+	}
+
+	if (!Entry->bHasChildCommentNodes)
+	{
+		TSet<UEdGraphNode*> Nodes;
+		CollectNodesUnderCommentAndChildComments(Comment, Nodes);
+		Entry->NodesUnderCommentAndChildComments = Nodes.Array();
+		Entry->bHasChildCommentNodes = true;
+	}
+
+	return Entry->NodesUnderCommentAndChildComments;
+}
+
+int32 FBACommentForest::GetCommentDepth(UEdGraphNode_Comment* Comment) const
+{
+	const FCommentEntry* Entry = Entries.Find(Comment);
+	return Entry ? Entry->Depth : 0;
+}
+
+bool FBACommentForest::IsEntryUpToDate(UEdGraphNode_Comment* Comment, const FCommentEntry& Entry) const
+{
+	const auto& ObjUnderComment = Comment->GetNodesUnderComment();
+	if (ObjUnderComment.Num() != Entry.NumObjectsUnderComment)
+	{
+		return false;
+	}
+
+	for (UEdGraphNode* Node : Entry.NodesUnderComment)
+	{
+		if (!ObjUnderComment.Contains(Node))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FBACommentForest::AddEntry(UEdGraphNode_Comment* Comment)
+{
+	FCommentEntry& Entry = Entries.Add(Comment);
+	Entry.NumObjectsUnderComment = Comment->GetNodesUnderComment().Num();
+	Entry.NodesUnderComment = FBAUtils::GetNodesUnderComment(Comment);
+
+	for (UEdGraphNode* Node : Entry.NodesUnderComment)
+	{
+		ParentComments.FindOrAdd(Node).Add(Comment);
+	}
+}
+
+void FBACommentForest::RemoveEntry(UEdGraphNode_Comment* Comment)
+{
+	FCommentEntry Entry;
+	if (!Entries.RemoveAndCopyValue(Comment, Entry))
+	{
+		return;
+	}
+
+	for (UEdGraphNode* Node : Entry.NodesUnderComment)
+	{
+		if (TArray<UEdGraphNode_Comment*>* Parents = ParentComments.Find(Node))
+		{
+			Parents->Remove(Comment);
+			if (Parents->Num() == 0)
+			{
+				ParentComments.Remove(Node);
+			}
+		}
+	}
+}
+
+int32 FBACommentForest::CalculateDepth(UEdGraphNode_Comment* Comment, TMap<const UEdGraphNode_Comment*, int32>& Depths, TSet<UEdGraphNode_Comment*>& Visiting) const
+{
+	if (const int32* FoundDepth = Depths.Find(Comment))
+	{
+		return *FoundDepth;
+	}
+
+	// overlapping comments can contain each other
+	if (Visiting.Contains(Comment))
+	{
+		return 0;
+	}
+
+	Visiting.Add(Comment);
+
+	int32 MaxDepth = 0;
+	for (UEdGraphNode_Comment* ParentComment : GetParentComments(Comment))
+	{
+		MaxDepth = FMath::Max(MaxDepth, 1 + CalculateDepth(ParentComment, Depths, Visiting));
+	}
+
+	Visiting.Remove(Comment);
+	Depths.Add(Comment, MaxDepth);
+	return MaxDepth;
+}
+
+void FBACommentForest::CollectNodesUnderCommentAndChildComments(UEdGraphNode_Comment* Comment, TSet<UEdGraphNode*>& OutNodes) const
+{
+	for (UEdGraphNode* Node : GetNodesUnderComment(Comment))
+	{
+		if (UEdGraphNode_Comment* ChildComment = Cast<UEdGraphNode_Comment>(Node))
+		{
+			bool bAlreadyAdded = false;
+			OutNodes.Add(ChildComment, &bAlreadyAdded);
+			if (!bAlreadyAdded)
+			{
+				CollectNodesUnderCommentAndChildComments(ChildComment, OutNodes);
+			}
+		}
+		else
+		{
+			OutNodes.Add(Node);
+		}
+	}
+}
 
 FCommentHandler::FCommentHandler(TSharedPtr<FBAGraphHandler> InGraphHandler, TSharedPtr<FFormatterInterface> InFormatter)
 {
@@ -31,23 +248,20 @@ void FCommentHandler::Init(TSharedPtr<FBAGraphHandler> InGraphHandler, TSharedPt
 	// 	UE_LOG(LogTemp, Warning, TEXT("\t%s"), *FBAUtils::GetNodeName(FormattedNode));
 	// }
 
-	TArray<UEdGraphNode_Comment*> CommentNodes = FBAUtils::GetCommentNodesFromGraph(GraphHandler->GetFocusedEdGraph());
-
-	CommentNodes.Sort([&](const UEdGraphNode_Comment& NodeA, const UEdGraphNode_Comment& NodeB)
-	{
-		return GetCommentDepth(&NodeA) > GetCommentDepth(&NodeB);
-	});
+	// borrow the graph's comment hierarchy instead of collecting and sorting the comments each format
+	FBACommentForest& CommentForest = GraphHandler->GetCommentForest();
+	CommentForest.Update(GraphHandler->GetFocusedEdGraph());
 
-	for (UEdGraphNode_Comment* Comment : CommentNodes)
+	for (UEdGraphNode_Comment* Comment : CommentForest.GetSortedComments())
 	{
-		if (ShouldIgnoreComment(Comment))
+		if (ShouldIgnoreComment(Comment, FormattedNodes))
 		{
 			continue;
 		}
 
 		// UE_LOG(LogTemp, Warning, TEXT("Added Comment %s (%d)"), *FBAUtils::GetNodeName(Comment), GetCommentDepth(Comment));
 
-		TArray<UEdGraphNode*> NodesUnderComment = FBAUtils::GetNodesUnderComment(Comment);
+		const TArray<UEdGraphNode*>& NodesUnderComment = CommentForest.GetNodesUnderComment(Comment);
 
 		Comments.Add(Comment);
 
@@ -102,62 +316,253 @@ void FCommentHandler::Reset()
 	Comments.Reset();
 	ParentComments.Reset();
 	CommentNodesContains.Reset();
+	CommentDepths.Reset();
+	CachedCommentBounds.Reset();
+	CachedBoundsParents.Reset();
+	NodeAskingBounds.Reset();
+}
+
+SIZE_T FCommentHandler::GetAllocatedSize() const
+{
+	SIZE_T Size = Comments.GetAllocatedSize()
+		+ ParentComments.GetAllocatedSize()
+		+ CommentNodesContains.GetAllocatedSize()
+		+ CommentDepths.GetAllocatedSize()
+		+ CachedCommentBounds.GetAllocatedSize()
+		+ CachedBoundsParents.GetAllocatedSize()
+		+ NodeAskingBounds.GetAllocatedSize();
+
+	for (const auto& Elem : ParentComments)
+	{
+		Size += Elem.Value.GetAllocatedSize();
+	}
+
+	for (const auto& Elem : CommentNodesContains)
+	{
+		Size += Elem.Value.GetAllocatedSize();
+	}
+
+	for (const auto& Elem : CachedCommentBounds)
+	{
+		const FCachedCommentBounds& Entry = Elem.Value;
+		Size += Entry.NodesUnderComment.GetAllocatedSize()
+			+ Entry.CommentsUnderComment.GetAllocatedSize();
+	}
+
+	for (const auto& Elem : CachedBoundsParents)
+	{
+		Size += Elem.Value.GetAllocatedSize();
+	}
+
+	return Size;
 }
 
 FSlateRect FCommentHandler::GetCommentBounds(UEdGraphNode_Comment* CommentNode, UEdGraphNode* NodeAsking)
 {
-	auto ObjUnderComment = CommentNode->GetNodesUnderComment();
-	TArray<UEdGraphNode*> NodesUnderComment;
-	TArray<UEdGraphNode_Comment*> CommentNodesUnderComment;
+	// the node asking only changes the result if it is inside one of the comments
+	if (NodeAsking == nullptr || !ParentComments.Contains(NodeAsking))
+	{
+		return GetCachedCommentBounds(CommentNode);
+	}
+
+	const TPair<UEdGraphNode_Comment*, UEdGraphNode*> Key(CommentNode, NodeAsking);
+	if (const FSlateRect* Found = NodeAskingBounds.Find(Key))
+	{
+		return *Found;
+	}
+
+	const FSlateRect Bounds = CalculateCommentBounds(CommentNode, NodeAsking);
+	NodeAskingBounds.Add(Key, Bounds);
+	return Bounds;
+}
+
+FSlateRect FCommentHandler::GetContainedNodesBounds(UEdGraphNode_Comment* CommentNode)
+{
+	FCachedCommentBounds& Entry = FindOrAddCachedBounds(CommentNode);
+	RefreshContainedNodesBounds(Entry);
+	return Entry.ContainedNodesBounds;
+}
+
+void FCommentHandler::MarkNodeMoved(UEdGraphNode* Node)
+{
+	NodeAskingBounds.Reset();
+
+	const TArray<UEdGraphNode_Comment*>* Parents = CachedBoundsParents.Find(Node);
+	if (!Parents)
+	{
+		return;
+	}
+
+	const bool bIsComment = FBAUtils::IsCommentNode(Node);
+	for (UEdGraphNode_Comment* Parent : *Parents)
+	{
+		if (!bIsComment)
+		{
+			CachedCommentBounds[Parent].bContainedNodesDirty = true;
+		}
+
+		MarkBoundsDirty(Parent);
+	}
+}
+
+void FCommentHandler::MarkAllBoundsDirty()
+{
+	NodeAskingBounds.Reset();
+
+	for (auto& Elem : CachedCommentBounds)
+	{
+		Elem.Value.bContainedNodesDirty = true;
+		Elem.Value.bBoundsValid = false;
+	}
+}
+
+void FCommentHandler::MarkBoundsDirty(UEdGraphNode_Comment* CommentNode)
+{
+	// a comment is only resolved after the comments underneath it, so the ancestors of a dirty entry are already dirty
+	FCachedCommentBounds* Entry = CachedCommentBounds.Find(CommentNode);
+	if (!Entry || !Entry->bBoundsValid)
+	{
+		return;
+	}
+
+	Entry->bBoundsValid = false;
+
+	if (const TArray<UEdGraphNode_Comment*>* Parents = CachedBoundsParents.Find(CommentNode))
+	{
+		for (UEdGraphNode_Comment* Parent : *Parents)
+		{
+			MarkBoundsDirty(Parent);
+		}
+	}
+}
+
+FCommentHandler::FCachedCommentBounds& FCommentHandler::FindOrAddCachedBounds(UEdGraphNode_Comment* CommentNode)
+{
+	if (FCachedCommentBounds* Found = CachedCommentBounds.Find(CommentNode))
+	{
+		return *Found;
+	}
 
-	for (auto Obj : ObjUnderComment)
+	FCachedCommentBounds& Entry = CachedCommentBounds.Add(CommentNode);
+
+	Entry.bIsEmpty = true;
+	for (UObject* Obj : CommentNode->GetNodesUnderComment())
 	{
 		if (UEdGraphNode* EdNode = Cast<UEdGraphNode>(Obj))
 		{
-			if (auto Comment = Cast<UEdGraphNode_Comment>(EdNode))
+			Entry.bIsEmpty = false;
+
+			if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(EdNode))
 			{
-				CommentNodesUnderComment.Add(Comment);
+				if (Comment->GetNodesUnderComment().Num() > 0)
+				{
+					Entry.CommentsUnderComment.Add(Comment);
+					CachedBoundsParents.FindOrAdd(Comment).Add(CommentNode);
+				}
 			}
 			else
 			{
-				NodesUnderComment.Add(EdNode);
+				Entry.NodesUnderComment.Add(EdNode);
+				CachedBoundsParents.FindOrAdd(EdNode).Add(CommentNode);
 			}
 		}
 	}
 
-	auto ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, NodesUnderComment);
-	// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
-	for (UEdGraphNode_Comment* CommentUnderComment : CommentNodesUnderComment)
+	return Entry;
+}
+
+void FCommentHandler::RefreshContainedNodesBounds(FCachedCommentBounds& Entry)
+{
+	if (Entry.bContainedNodesDirty)
 	{
-		if (CommentUnderComment->GetNodesUnderComment().Num() == 0)
+		Entry.ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Entry.NodesUnderComment);
+		Entry.bContainedNodesDirty = false;
+	}
+}
+
+FSlateRect FCommentHandler::GetCachedCommentBounds(UEdGraphNode_Comment* CommentNode)
+{
+	{
+		FCachedCommentBounds& Entry = FindOrAddCachedBounds(CommentNode);
+		if (Entry.bIsEmpty)
 		{
-			continue;
+			return FSlateRect::FromPointAndExtent(FVector2D(CommentNode->NodePosX, CommentNode->NodePosY), FVector2D(CommentNode->NodeWidth, CommentNode->NodeHeight));
+		}
+
+		// overlapping comments can contain each other, use the last bounds when we loop back around
+		if (Entry.bBoundsValid || Entry.bResolving)
+		{
+			return Entry.Bounds;
 		}
 
+		Entry.bResolving = true;
+	}
+
+	// resolve the comments underneath first, the entry may move while the map grows
+	const TArray<UEdGraphNode_Comment*> CommentsUnderComment = CachedCommentBounds[CommentNode].CommentsUnderComment;
+	TArray<FSlateRect> ChildBounds;
+	ChildBounds.Reserve(CommentsUnderComment.Num());
+	for (UEdGraphNode_Comment* CommentUnderComment : CommentsUnderComment)
+	{
+		ChildBounds.Add(GetCachedCommentBounds(CommentUnderComment));
+	}
+
+	FCachedCommentBounds& Entry = CachedCommentBounds[CommentNode];
+	RefreshContainedNodesBounds(Entry);
+
+	FSlateRect Bounds = Entry.ContainedNodesBounds;
+	for (const FSlateRect& Child : ChildBounds)
+	{
+		Bounds = Bounds.Expand(Child);
+	}
+
+	Entry.Bounds = Bounds.ExtendBy(GetCommentPadding(CommentNode));
+	Entry.bBoundsValid = true;
+	Entry.bResolving = false;
+
+	return Entry.Bounds;
+}
+
+FSlateRect FCommentHandler::CalculateCommentBounds(UEdGraphNode_Comment* CommentNode, UEdGraphNode* NodeAsking)
+{
+	FCachedCommentBounds& Entry = FindOrAddCachedBounds(CommentNode);
+	if (Entry.bIsEmpty)
+	{
+		return FSlateRect::FromPointAndExtent(FVector2D(CommentNode->NodePosX, CommentNode->NodePosY), FVector2D(CommentNode->NodeWidth, CommentNode->NodeHeight));
+	}
+
+	RefreshContainedNodesBounds(Entry);
+
+	FSlateRect ContainedNodesBounds = Entry.ContainedNodesBounds;
+	const TArray<UEdGraphNode_Comment*> CommentsUnderComment = Entry.CommentsUnderComment;
+
+	// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
+	for (UEdGraphNode_Comment* CommentUnderComment : CommentsUnderComment)
+	{
 		if (DoesCommentContainNode(CommentUnderComment, NodeAsking))
 		{
 			continue;
 		}
 
+		// memoized per node asking until a node moves
 		ContainedNodesBounds = ContainedNodesBounds.Expand(GetCommentBounds(CommentUnderComment, NodeAsking));
 		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
 	}
 
+	return ContainedNodesBounds.ExtendBy(GetCommentPadding(CommentNode));
+}
+
+FMargin FCommentHandler::GetCommentPadding(UEdGraphNode_Comment* CommentNode) const
+{
 	const FVector2D Padding = GetDefault<UBASettings>()->CommentNodePadding;
 
 	const float TitlebarHeight = FBAUtils::GetCachedNodeBounds(GraphHandler, CommentNode, false).GetSize().Y;
 
-	const FMargin CommentPadding(
+	return FMargin(
 		Padding.X,
 		Padding.Y + TitlebarHeight,
 		Padding.X,
 		Padding.Y);
-
-	// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tContainedNodeBounds %s | Padding %s"), *ContainedNodesBounds.ToString(), *CommentPadding.GetDesiredSize().ToString());
-
-	ContainedNodesBounds = ContainedNodesBounds.ExtendBy(CommentPadding);
-
-	return ContainedNodesBounds;
 }
 
 bool FCommentHandler::DoesCommentContainNode(UEdGraphNode_Comment* Comment, UEdGraphNode* Node)
@@ -172,20 +577,32 @@ bool FCommentHandler::DoesCommentContainNode(UEdGraphNode_Comment* Comment, UEdG
 
 int FCommentHandler::GetCommentDepth(const UEdGraphNode_Comment* Comment) const
 {
+	// the parent comments don't change after init, so depths are only calculated once
+	if (const int32* FoundDepth = CommentDepths.Find(Comment))
+	{
+		return *FoundDepth;
+	}
+
 	int MaxDepth = 0;
 	for (const UEdGraphNode_Comment* ParentComment : GetParentComments(Comment))
 	{
 		MaxDepth = FMath::Max(MaxDepth, 1 + GetCommentDepth(ParentComment));
 	}
 
+	CommentDepths.Add(Comment, MaxDepth);
 	return MaxDepth;
 }
 
 bool FCommentHandler::ShouldIgnoreComment(UEdGraphNode_Comment* Comment)
+{
+	return ShouldIgnoreComment(Comment, Formatter->GetFormattedNodes());
+}
+
+bool FCommentHandler::ShouldIgnoreComment(UEdGraphNode_Comment* Comment, const TSet<UEdGraphNode*>& FormattedNodes)
 {
 	// UE_LOG(LogTemp, Warning, TEXT("Checking Comment %s"), *FBAUtils::GetNodeName(Comment));
 
-	TArray<UEdGraphNode*> NodesUnderComment = FBAUtils::GetNodesUnderCommentAndChildComments(Comment);
+	TArray<UEdGraphNode*> NodesUnderComment = GraphHandler->GetCommentForest().GetNodesUnderCommentAndChildComments(Comment);
 
 	// ignore containing comments
 	NodesUnderComment.RemoveAll(FBAUtils::IsCommentNode);
@@ -196,10 +613,8 @@ bool FCommentHandler::ShouldIgnoreComment(UEdGraphNode_Comment* Comment)
 		return true;
 	}
 
-	TSet<UEdGraphNode*> FormattedNodes = Formatter->GetFormattedNodes();
-
 	// ignore if the comment contains a node which isn't going to be formatted 
-	const bool bContainsNonFormattedNode = NodesUnderComment.ContainsByPredicate([FormattedNodes](UEdGraphNode* Node)
+	const bool bContainsNonFormattedNode = NodesUnderComment.ContainsByPredicate([&FormattedNodes](UEdGraphNode* Node)
 	{
 		return !FormattedNodes.Contains(Node);
 	});
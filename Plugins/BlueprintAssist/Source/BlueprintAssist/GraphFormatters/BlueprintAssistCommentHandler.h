@@ -5,6 +5,51 @@
 struct FFormatterInterface;
 class UEdGraphNode_Comment;
 class FBAGraphHandler;
+class UEdGraph;
+
+/* Comment hierarchy of a graph, kept by the graph handler and only rebuilt for comments which changed */
+struct BLUEPRINTASSIST_API FBACommentForest
+{
+	void Update(UEdGraph* Graph);
+
+	void Reset();
+
+	/* Comments sorted from the most nested to the outermost */
+	const TArray<UEdGraphNode_Comment*>& GetSortedComments() const { return SortedComments; }
+
+	const TArray<UEdGraphNode*>& GetNodesUnderComment(UEdGraphNode_Comment* Comment) const;
+
+	const TArray<UEdGraphNode_Comment*>& GetParentComments(UEdGraphNode* Node) const;
+
+	const TArray<UEdGraphNode*>& GetNodesUnderCommentAndChildComments(UEdGraphNode_Comment* Comment);
+
+	int32 GetCommentDepth(UEdGraphNode_Comment* Comment) const;
+
+	/* Incremented whenever an update changes the hierarchy */
+	uint32 GetVersion() const { return Version; }
+
+private:
+	struct FCommentEntry
+	{
+		TArray<UEdGraphNode*> NodesUnderComment;
+		int32 NumObjectsUnderComment = 0;
+		int32 Depth = 0;
+
+		TArray<UEdGraphNode*> NodesUnderCommentAndChildComments;
+		bool bHasChildCommentNodes = false;
+	};
+
+	TMap<UEdGraphNode_Comment*, FCommentEntry> Entries;
+	TMap<UEdGraphNode*, TArray<UEdGraphNode_Comment*>> ParentComments;
+	TArray<UEdGraphNode_Comment*> SortedComments;
+	uint32 Version = 0;
+
+	bool IsEntryUpToDate(UEdGraphNode_Comment* Comment, const FCommentEntry& Entry) const;
+	void AddEntry(UEdGraphNode_Comment* Comment);
+	void RemoveEntry(UEdGraphNode_Comment* Comment);
+	int32 CalculateDepth(UEdGraphNode_Comment* Comment, TMap<const UEdGraphNode_Comment*, int32>& Depths, TSet<UEdGraphNode_Comment*>& Visiting) const;
+	void CollectNodesUnderCommentAndChildComments(UEdGraphNode_Comment* Comment, TSet<UEdGraphNode*>& OutNodes) const;
+};
 
 struct BLUEPRINTASSIST_API FCommentHandler
 	: public TSharedFromThis<FCommentHandler>
@@ -26,13 +71,63 @@ struct BLUEPRINTASSIST_API FCommentHandler
 
 	void Reset();
 
+	SIZE_T GetAllocatedSize() const;
+
 	FSlateRect GetCommentBounds(UEdGraphNode_Comment* CommentNode, UEdGraphNode* NodeAsking = nullptr);
 
+	/* Bounds of the (non-comment) nodes under the comment, without any padding */
+	FSlateRect GetContainedNodesBounds(UEdGraphNode_Comment* CommentNode);
+
+	/* Dirty the cached bounds of the comments containing the node and of their ancestors */
+	void MarkNodeMoved(UEdGraphNode* Node);
+
+	/* Dirty every cached bounds, for passes which move nodes without reporting each one */
+	void MarkAllBoundsDirty();
+
 	bool DoesCommentContainNode(UEdGraphNode_Comment* Comment, UEdGraphNode* Node);
 
 	int GetCommentDepth(const UEdGraphNode_Comment* Comment) const;
 
 	bool ShouldIgnoreComment(UEdGraphNode_Comment* Comment);
 
+	bool ShouldIgnoreComment(UEdGraphNode_Comment* Comment, const TSet<UEdGraphNode*>& FormattedNodes);
+
 	static bool AreCommentsIntersecting(UEdGraphNode_Comment* CommentA, UEdGraphNode_Comment* CommentB);
+
+private:
+	mutable TMap<const UEdGraphNode_Comment*, int32> CommentDepths;
+
+	struct FCachedCommentBounds
+	{
+		TArray<UEdGraphNode*> NodesUnderComment;
+		TArray<UEdGraphNode_Comment*> CommentsUnderComment;
+		bool bIsEmpty = false;
+
+		FSlateRect ContainedNodesBounds;
+		FSlateRect Bounds;
+
+		/* Set when a node under the comment moved */
+		bool bContainedNodesDirty = true;
+
+		/* Cleared when a node under the comment or under any child comment moved */
+		bool bBoundsValid = false;
+
+		bool bResolving = false;
+	};
+
+	/* Comment bounds are aggregated bottom-up from the comments underneath and memoized until a contained node moves */
+	TMap<UEdGraphNode_Comment*, FCachedCommentBounds> CachedCommentBounds;
+
+	/* Cached comments each node or comment is under, walked up when a node moves */
+	TMap<UEdGraphNode*, TArray<UEdGraphNode_Comment*>> CachedBoundsParents;
+
+	/* Bounds for a node asking from inside the comment, cleared whenever a node moves */
+	TMap<TPair<UEdGraphNode_Comment*, UEdGraphNode*>, FSlateRect> NodeAskingBounds;
+
+	FCachedCommentBounds& FindOrAddCachedBounds(UEdGraphNode_Comment* CommentNode);
+	void MarkBoundsDirty(UEdGraphNode_Comment* CommentNode);
+	void RefreshContainedNodesBounds(FCachedCommentBounds& Entry);
+	FSlateRect GetCachedCommentBounds(UEdGraphNode_Comment* CommentNode);
+	FSlateRect CalculateCommentBounds(UEdGraphNode_Comment* CommentNode, UEdGraphNode* NodeAsking);
+	FMargin GetCommentPadding(UEdGraphNode_Comment* CommentNode) const;
 };
@@ -2,6 +2,7 @@
 
 #include "EdGraphFormatter.h"
 
+#include "BAFormatterUtils.h"
 #include "BlueprintAssistGlobals.h"
 #include "BlueprintAssistGraphHandler.h"
 #include "BlueprintAssistSettings.h"
@@ -15,6 +16,10 @@
 #include "Editor/BlueprintGraph/Classes/K2Node_Knot.h"
 #include "Kismet2/BlueprintEditorUtils.h"
 #include "KnotTrack/KnotTrackCreator.h"
+#include "Misc/ScopeExit.h"
+
+TRACE_DECLARE_INT_COUNTER(BA_FormattedNodes, TEXT("BlueprintAssist/FormattedNodes"));
+TRACE_DECLARE_INT_COUNTER(BA_FormattedLinks, TEXT("BlueprintAssist/FormattedLinks"));
 
 FNodeChangeInfo::FNodeChangeInfo(UEdGraphNode* InNode, UEdGraphNode* InNodeToKeepStill)
 	: Node(InNode)
@@ -71,11 +76,6 @@ bool FNodeChangeInfo::HasChanged(UEdGraphNode* NodeToKeepStill)
 	return false;
 }
 
-FString ChildBranch::ToString() const
-{
-	return FString::Printf(TEXT("%s | %s"), *FBAUtils::GetPinName(Pin), *FBAUtils::GetPinName(ParentPin));
-}
-
 FEdGraphFormatter::FEdGraphFormatter(
 	TSharedPtr<FBAGraphHandler> InGraphHandler,
 	FEdGraphFormatterParameters InFormatterParameters)
@@ -99,16 +99,22 @@ FEdGraphFormatter::FEdGraphFormatter(
 
 void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 {
+	BA_TRACE_SCOPE(BA_FormatNode);
+
 	if (!IsInitialNodeValid(InitialNode))
 	{
 		return;
 	}
 
-	KnotTrackCreator.Init(SharedThis(this), GraphHandler);
+	// resolve the settings once for the whole format, every pass below reads the snapshot
+	const UBASettings* BASettings = GetDefault<UBASettings>();
+	Settings = FBASettingsSnapshot(BASettings, BASettings->BlueprintFormatterSettings);
+
+	KnotTrackCreator.Init(SharedThis(this), GraphHandler, &Settings);
 
 	RootNode = InitialNode;
 
-	TArray<UEdGraphNode*> NewNodeTree = GetNodeTree(InitialNode);
+	TArray<UEdGraphNode*> NewNodeTree = GetNodeTree(GraphHandler, InitialNode, FormatterParameters.NodesToFormat);
 
 	NodeTree = NewNodeTree;
 
@@ -118,10 +124,8 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 		return !SelectedNodes.Contains(Node);
 	});
 
-	GraphHandler->GetFocusedEdGraph()->Modify();
-
 	// check if we can do simple relative formatting
-	if (GetMutableDefault<UBASettings>()->bEnableFasterFormatting && !IsFormattingRequired(NewNodeTree))
+	if (Settings.bEnableFasterFormatting && !IsFormattingRequired(NewNodeTree))
 	{
 		SimpleRelativeFormatting();
 		return;
@@ -130,12 +134,17 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	KnotTrackCreator.Reset();
 	CommentHandler.Reset();
 	NodeChangeInfos.Reset();
+	LastStructureHash = 0;
+	LastCommentBounds.Reset();
 	NodePool.Reset();
 	MainParameterFormatter.Reset();
 	ParameterFormatterMap.Reset();
 	FormatXInfoMap.Reset();
+	FormatXArena.Reset();
 	Path.Reset();
+	LinkIds.Reset();
 	SameRowMapping.Reset();
+	Rows.Reset();
 	NodesToExpand.Reset();
 	ParameterParentMap.Reset();
 	NodeHeightLevels.Reset();
@@ -148,6 +157,12 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 
 	RemoveKnotNodes();
 
+	// pooled knots which were removed but not reused are deleted however the format ends
+	ON_SCOPE_EXIT
+	{
+		KnotTrackCreator.DeleteUnusedKnots();
+	};
+
 	NodeToKeepStill = FormatterParameters.NodeToKeepStill ? FormatterParameters.NodeToKeepStill : RootNode;
 
 	if (FBAUtils::IsEventNode(RootNode) || FBAUtils::IsExtraRootNode(RootNode))
@@ -208,7 +223,7 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	//	}
 	//}
 
-	if (GetMutableDefault<UBASettings>()->bCustomDebug == 0)
+	if (Settings.CustomDebug == 0)
 	{
 		return;
 	}
@@ -218,13 +233,14 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 
 	CommentHandler.Init(GraphHandler, SharedThis(this));
 
-	if (GetMutableDefault<UBASettings>()->bCustomDebug == 3)
+	if (Settings.CustomDebug == 3)
 	{
 		return;
 	}
 
 	Path.Empty();
 	FormatXInfoMap.Empty();
+	FormatXArena.Reset();
 	FormatX(true);
 
 	// UE_LOG(LogTemp, Warning, TEXT("Same row mapping"));
@@ -243,17 +259,17 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	// 	}
 	// }
 
-	if (GetDefault<UBASettings>()->bExpandNodesAheadOfParameters)
+	if (Settings.bExpandNodesAheadOfParameters)
 	{
 		ExpandNodesAheadOfParameters();
 	}
 
-	if (GetDefault<UBASettings>()->bApplyCommentPadding)
+	if (Settings.bApplyCommentPadding)
 	{
 		ExpandCommentsX();
 	}
 
-	if (GetMutableDefault<UBASettings>()->bCustomDebug == 1)
+	if (Settings.CustomDebug == 1)
 	{
 		return;
 	}
@@ -261,17 +277,17 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	/** Format Y (Rows) */
 	FormatY();
 
-	if (GetDefault<UBASettings>()->bApplyCommentPadding)
+	if (Settings.bApplyCommentPadding)
 	{
 		ExpandCommentsY();
 	}
 
-	if (GetMutableDefault<UBASettings>()->bCustomDebug == 2)
+	if (Settings.CustomDebug == 2)
 	{
 		return;
 	}
 
-	if (GetMutableDefault<UBASettings>()->bExpandNodesByHeight)
+	if (Settings.bExpandNodesByHeight)
 	{
 		ExpandByHeight();
 	}
@@ -280,7 +296,7 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	// WrapNodes();
 
 	/** Format knot nodes */
-	if (GetMutableDefault<UBASettings>()->bCreateKnotNodes)
+	if (Settings.bCreateKnotNodes)
 	{
 		KnotTrackCreator.FormatKnotNodes();
 	}
@@ -288,7 +304,7 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	/** Formatting may move nodes, move all nodes back using the root as a baseline */
 	ResetRelativeToNodeToKeepStill(SavedLocation);
 
-	if (GetDefault<UBASettings>()->bSnapToGrid)
+	if (Settings.bSnapToGrid)
 	{
 		/** Snap all nodes to the grid (only on the x-axis) */
 		TSet<UEdGraphNode*> FormattedNodes = GetFormattedGraphNodes();
@@ -302,8 +318,18 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 
 	ModifyCommentNodes();
 
+	TRACE_COUNTER_SET(BA_FormattedNodes, NodePool.Num());
+	TRACE_COUNTER_SET(BA_FormattedLinks, LinkIds.Num());
+
+	// Free the per-pass format x info in one go
+	FormatXInfoMap.Empty();
+	NodesToExpand.Empty();
+	FormatXArena.Empty();
+
 	// Check if formatting is required checks the difference between the node trees, so we must set it here
-	NodeTree = GetNodeTree(InitialNode);
+	NodeTree = GetNodeTree(GraphHandler, InitialNode, FormatterParameters.NodesToFormat);
+	// the hash is only compared by faster formatting
+	LastStructureHash = Settings.bEnableFasterFormatting ? GetStructureHash(NodeTree) : 0;
 
 	//for (UEdGraphNode* Nodes : GetFormattedGraphNodes())
 	//{
@@ -311,7 +337,7 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 	//}
 	//
 
-	if (bAreAllNodesSelected)
+	if (bAreAllNodesSelected && GraphHandler->GetGraphPanel().IsValid())
 	{
 		auto& SelectionManager = GraphHandler->GetGraphPanel()->SelectionManager;
 		for (auto Node : KnotTrackCreator.GetCreatedKnotNodes())
@@ -323,11 +349,12 @@ void FEdGraphFormatter::FormatNode(UEdGraphNode* InitialNode)
 
 void FEdGraphFormatter::InitNodePool()
 {
+	BA_TRACE_SCOPE(BA_InitNodePool);
+
 	NodePool.Empty();
 	TArray<UEdGraphNode*> InputNodeStack;
 	TArray<UEdGraphNode*> OutputNodeStack;
 	OutputNodeStack.Push(RootNode);
-	RootNode->Modify();
 
 	while (InputNodeStack.Num() > 0 || OutputNodeStack.Num() > 0)
 	{
@@ -370,8 +397,6 @@ void FEdGraphFormatter::InitNodePool()
 						continue;
 					}
 
-					LinkedNode->Modify();
-
 					FBAUtils::StraightenPin(GraphHandler, Pin, LinkedPin);
 
 					if (Dir == EGPD_Output)
@@ -390,16 +415,16 @@ void FEdGraphFormatter::InitNodePool()
 
 void FEdGraphFormatter::ExpandPendingNodes(bool bUseParameter)
 {
-	for (TSharedPtr<FFormatXInfo> Info : NodesToExpand)
+	for (FFormatXInfo* Info : NodesToExpand)
 	{
-		if (!Info->Parent.IsValid())
+		if (Info->Parent == INDEX_NONE)
 		{
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("Expand X Invalid %s"), *FBAUtils::GetNodeName(Info->GetNode()));
 			return;
 		}
 
 		UEdGraphNode* Node = Info->GetNode();
-		UEdGraphNode* Parent = Info->Parent->GetNode();
+		UEdGraphNode* Parent = Info->GetParent()->GetNode();
 		TArray<UEdGraphNode*> InputChildren = Info->GetChildren(EGPD_Input);
 
 		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Expand X %s | %s"), *FBAUtils::GetNodeName(Info->GetNode()), *FBAUtils::GetNodeName(Parent));
@@ -441,6 +466,8 @@ void FEdGraphFormatter::ExpandPendingNodes(bool bUseParameter)
 
 void FEdGraphFormatter::SimpleRelativeFormatting()
 {
+	BA_TRACE_SCOPE(BA_SimpleRelativeFormatting);
+
 	for (UEdGraphNode* Node : GetFormattedNodes())
 	{
 		// check(NodeChangeInfos.Contains(Node))
@@ -462,17 +489,19 @@ void FEdGraphFormatter::SimpleRelativeFormatting()
 
 void FEdGraphFormatter::FormatX(const bool bUseParameter)
 {
+	BA_TRACE_SCOPE(BA_FormatX);
+
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("----- Format X -----"));
 
 	TSet<UEdGraphNode*> VisitedNodes;
 	TSet<UEdGraphNode*> PendingNodes;
 	PendingNodes.Add(RootNode);
-	TSet<FPinLink> VisitedLinks;
+	FPinLinkSet VisitedLinks;
 	const FPinLink RootNodeLink(nullptr, nullptr, RootNode);
-	TSharedPtr<FFormatXInfo> RootInfo = MakeShared<FFormatXInfo>(RootNodeLink, nullptr);
+	FFormatXInfo* RootInfo = FormatXArena.Add(FFormatXInfo(RootNodeLink, INDEX_NONE));
 
-	TArray<TSharedPtr<FFormatXInfo>> OutputStack;
-	TArray<TSharedPtr<FFormatXInfo>> InputStack;
+	TArray<FFormatXInfo*> OutputStack;
+	TArray<FFormatXInfo*> InputStack;
 	OutputStack.Push(RootInfo);
 	FormatXInfoMap.Add(RootNode, RootInfo);
 
@@ -483,10 +512,10 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 	while (OutputStack.Num() > 0 || InputStack.Num() > 0)
 	{
 		// try to get the current info from the pending input
-		TSharedPtr<FFormatXInfo> CurrentInfo = nullptr;
+		FFormatXInfo* CurrentInfo = nullptr;
 
-		TArray<TSharedPtr<FFormatXInfo>>& FirstStack = LastDirection == EGPD_Output ? OutputStack : InputStack;
-		TArray<TSharedPtr<FFormatXInfo>>& SecondStack = LastDirection == EGPD_Output ? InputStack : OutputStack;
+		TArray<FFormatXInfo*>& FirstStack = LastDirection == EGPD_Output ? OutputStack : InputStack;
+		TArray<FFormatXInfo*>& SecondStack = LastDirection == EGPD_Output ? InputStack : OutputStack;
 
 		if (FirstStack.Num() > 0)
 		{
@@ -509,7 +538,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 		{
 			if (CurrentNode != RootNode)
 			{
-				CurrentInfo->SetParent(CurrentInfo->Parent);
+				CurrentInfo->SetParent(CurrentInfo->GetParent());
 				CurrentNode->NodePosX = NewX;
 
 				if (bUseParameter)
@@ -525,7 +554,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 		}
 		else
 		{
-			TSharedPtr<FFormatXInfo> OldInfo = FormatXInfoMap[CurrentNode];
+			FFormatXInfo* OldInfo = FormatXInfoMap[CurrentNode];
 
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tInfo map contains %s | %s (%s) | Parent %s (%s) | %d"),
 			//        *FBAUtils::GetNodeName(CurrentInfo->Link.To->GetOwningNode()),
@@ -541,7 +570,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 			if (!bHasNoParent) // if we have a parent, check if there is a cycle
 			{
 				// bHasCycle = OldInfo->GetChildren(EGPD_Output).Contains(CurrentInfo->Parent->GetNode());
-				bHasCycle = OldInfo->GetChildren().Contains(CurrentInfo->Parent->GetNode());
+				bHasCycle = OldInfo->GetChildren().Contains(CurrentInfo->GetParent()->GetNode());
 
 				// if (bHasCycle)
 				// {
@@ -561,7 +590,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 
 			if (bHasNoParent || !bHasCycle)
 			{
-				if (OldInfo->Parent.IsValid())
+				if (OldInfo->Parent != INDEX_NONE)
 				{
 					bool bTakeNewParent = bHasNoParent;
 
@@ -592,7 +621,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 						// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTOOK PARENT"));
 
 						OldInfo->Link = CurrentInfo->Link;
-						OldInfo->SetParent(CurrentInfo->Parent);
+						OldInfo->SetParent(CurrentInfo->GetParent());
 
 						CurrentInfo = OldInfo;
 
@@ -602,8 +631,9 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 							RefreshParameters(CurrentNode);
 						}
 
-						for (TSharedPtr<FFormatXInfo> ChildInfo : CurrentInfo->Children)
+						for (int32 ChildIndex : CurrentInfo->Children)
 						{
+							FFormatXInfo* ChildInfo = FormatXArena.Get(ChildIndex);
 							if (ChildInfo->Link.GetDirection() == EGPD_Output)
 							{
 								OutputStack.Push(ChildInfo);
@@ -634,12 +664,13 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTrying to iterate link %s"), *PinLink.ToString());
 
-				if (VisitedLinks.Contains(PinLink))
+				const int32 LinkId = LinkIds.GetLinkId(PinLink);
+				if (VisitedLinks.Contains(LinkId))
 				{
 					continue;
 				}
 
-				VisitedLinks.Add(PinLink);
+				VisitedLinks.Add(LinkId);
 				if (!NodePool.Contains(LinkedNode))
 				{
 					continue;
@@ -652,7 +683,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tIterating pin link %s"), *PinLink.ToString());
 
-				TSharedPtr<FFormatXInfo> LinkedInfo = MakeShared<FFormatXInfo>(PinLink, CurrentInfo);
+				FFormatXInfo* LinkedInfo = FormatXArena.Add(FFormatXInfo(PinLink, CurrentInfo->Index));
 
 				if (ParentPin->Direction == EGPD_Output)
 				{
@@ -661,7 +692,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 				}
 				else
 				{
-					if (GetMutableDefault<UBASettings>()->FormattingStyle == EBANodeFormattingStyle::Expanded)
+					if (Settings.FormattingStyle == EBANodeFormattingStyle::Expanded)
 					{
 						const bool bHasCycle = PendingNodes.Contains(LinkedNode) || FBAUtils::GetExecTree(LinkedNode, EGPD_Input).Contains(CurrentInfo->GetNode());
 						//FBAUtils::GetExecTree(LinkedNode, EGPD_Input).Array().FilterByPredicate(OnlySelected).Contains(CurrentInfo->GetNode());
@@ -670,7 +701,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 						{
 							if (CurrentInfo->Link.GetDirection() == EGPD_Output)
 							{
-								if (!CurrentInfo->Parent.IsValid() || LinkedNode != CurrentInfo->Parent->GetNode())
+								if (CurrentInfo->Parent == INDEX_NONE || LinkedNode != CurrentInfo->GetParent()->GetNode())
 								{
 									NodesToExpand.Add(CurrentInfo);
 									// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\t\t\tExpanding node %s"), *FBAUtils::GetNodeName(LinkedNode));
@@ -688,7 +719,7 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 		}
 	}
 
-	if (GetMutableDefault<UBASettings>()->FormattingStyle == EBANodeFormattingStyle::Expanded)
+	if (Settings.FormattingStyle == EBANodeFormattingStyle::Expanded)
 	{
 		ExpandPendingNodes(bUseParameter);
 	}
@@ -696,10 +727,12 @@ void FEdGraphFormatter::FormatX(const bool bUseParameter)
 
 void FEdGraphFormatter::ExpandByHeight()
 {
+	BA_TRACE_SCOPE(BA_ExpandByHeight);
+
 	// expand nodes in the output direction for centered branches
 	for (UEdGraphNode* Node : NodePool)
 	{
-		TSharedPtr<FFormatXInfo> Info = FormatXInfoMap[Node];
+		FFormatXInfo* Info = FormatXInfoMap[Node];
 
 		const TArray<FPinLink> PinLinks = Info->GetChildrenAsLinks(EGPD_Output);
 
@@ -742,9 +775,11 @@ void FEdGraphFormatter::ExpandByHeight()
 
 void FEdGraphFormatter::ExpandNodesAheadOfParameters()
 {
+	BA_TRACE_SCOPE(BA_ExpandNodesAheadOfParameters);
+
 	for (UEdGraphNode* Node : NodePool)
 	{
-		TSharedPtr<FFormatXInfo> Info = FormatXInfoMap[Node];
+		FFormatXInfo* Info = FormatXInfoMap[Node];
 		const TArray<FPinLink> PinLinks = Info->GetChildrenAsLinks(EGPD_Output);
 
 		int32 LargestExpandX = 0;
@@ -787,19 +822,15 @@ void FEdGraphFormatter::ExpandNodesAheadOfParameters()
 	}
 }
 
-void FEdGraphFormatter::FormatY_Recursive(
-	UEdGraphNode* CurrentNode,
-	UEdGraphPin* CurrentPin,
-	UEdGraphPin* ParentPin,
-	TSet<UEdGraphNode*>& NodesToCollisionCheck,
-	TSet<FPinLink>& VisitedLinks,
-	const bool bSameRow,
-	TSet<UEdGraphNode*>& Children)
+void FEdGraphFormatter::FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck)
 {
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* ParentPin = Frame.ParentPin;
+
 	// const FString NodeNameA = CurrentNode == nullptr
 	// 	? FString("nullptr")
 	// 	: FBAUtils::GetNodeName(CurrentNode);
-	// const FString PinNameA = CurrentPin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(CurrentPin);
+	// const FString PinNameA = Frame.Pin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(Frame.Pin);
 	// const FString NodeNameB = ParentPin == nullptr
 	// 	? FString("nullptr")
 	// 	: FBAUtils::GetNodeName(ParentPin->GetOwningNode());
@@ -862,184 +893,213 @@ void FEdGraphFormatter::FormatY_Recursive(
 
 	NodesToCollisionCheck.Emplace(CurrentNode);
 
-	const EEdGraphPinDirection ParentDirection = ParentPin == nullptr ? EGPD_Output : ParentPin->Direction.GetValue();
-
-	bool bFirstPin = true;
+	Frame.MainPin = Frame.Pin;
+}
 
-	UEdGraphPin* MainPin = CurrentPin;
+FFormatYFrame* FEdGraphFormatter::FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck, FPinLinkSet& VisitedLinks)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* ParentPin = Frame.ParentPin;
 
-	bool bCenteredParent = false;
+	const EEdGraphPinDirection ParentDirection = ParentPin == nullptr ? EGPD_Output : ParentPin->Direction.GetValue();
 
-	TArray<EEdGraphPinDirection> Directions = { ParentDirection, UEdGraphPin::GetComplementaryDirection(ParentDirection) };
-	for (EEdGraphPinDirection CurrentDirection : Directions)
+	while (true)
 	{
-		TArray<UEdGraphPin*> Pins = FBAUtils::GetLinkedPins(CurrentNode, CurrentDirection)
-			.FilterByPredicate(IsExecOrDelegatePin)
-			.FilterByPredicate(FBAUtils::IsPinLinked);
-
-		UEdGraphPin* LastLinked = CurrentPin;
-		UEdGraphPin* LastProcessed = nullptr;
-
-		TArray<ChildBranch> ChildBranches;
-
-		int DeltaY = 0;
-		for (UEdGraphPin* MyPin : Pins)
+		if (Frame.PinIndex >= Frame.Pins.Num())
 		{
-			TArray<UEdGraphPin*> LinkedPins = MyPin->LinkedTo;
+			if (Frame.DirectionIndex != INDEX_NONE)
+			{
+				const EEdGraphPinDirection CurrentDirection = Frame.DirectionIndex == 0 ? ParentDirection : UEdGraphPin::GetComplementaryDirection(ParentDirection);
+				if (bCenterBranches && Frame.ChildBranches.Num() >= NumRequiredBranches && ParentDirection == EGPD_Output)
+				{
+					if (CurrentDirection != ParentDirection)
+					{
+						Frame.bCenteredParent = true;
+					}
+
+					CenterBranches(CurrentNode, Frame.ChildBranches, NodesToCollisionCheck);
+				}
+			}
 
-			for (int i = 0; i < LinkedPins.Num(); ++i)
+			Frame.DirectionIndex += 1;
+			if (Frame.DirectionIndex >= 2)
 			{
-				UEdGraphPin* OtherPin = LinkedPins[i];
-				UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
-				FPinLink Link(MyPin, OtherPin);
+				return nullptr;
+			}
 
-				bool bIsSameLink = Path.Contains(Link);
+			const EEdGraphPinDirection NextDirection = Frame.DirectionIndex == 0 ? ParentDirection : UEdGraphPin::GetComplementaryDirection(ParentDirection);
+			Frame.Pins = FBAUtils::GetLinkedPins(CurrentNode, NextDirection)
+				.FilterByPredicate(IsExecOrDelegatePin)
+				.FilterByPredicate(FBAUtils::IsPinLinked);
+
+			Frame.PinIndex = 0;
+			Frame.LinkIndex = INDEX_NONE;
+			Frame.LastLinked = Frame.Pin;
+			Frame.LastProcessed = nullptr;
+			Frame.ChildBranches.Reset();
+			Frame.DeltaY = 0;
+			continue;
+		}
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tIter Child %s"), *FBAUtils::GetNodeName(OtherNode));
-				//
-				// if (!bIsSameLink)
-				// {
-				// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tNot same link!"));
-				// }
+		UEdGraphPin* MyPin = Frame.Pins[Frame.PinIndex];
+		if (Frame.LinkIndex == INDEX_NONE)
+		{
+			Frame.LinkedPins = MyPin->LinkedTo;
+			Frame.LinkIndex = 0;
+		}
 
-				if (VisitedLinks.Contains(Link)
-					|| !NodePool.Contains(OtherNode)
-					|| FBAUtils::IsNodePure(OtherNode)
-					|| NodesToCollisionCheck.Contains(OtherNode)
-					|| !bIsSameLink)
-				{
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tSkipping child"));
-					continue;
-				}
-				VisitedLinks.Add(Link);
+		if (Frame.LinkIndex >= Frame.LinkedPins.Num())
+		{
+			Frame.LastLinked = MyPin;
+			Frame.DeltaY += 1;
+			Frame.PinIndex += 1;
+			Frame.LinkIndex = INDEX_NONE;
+			continue;
+		}
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTaking Child %s"), *FBAUtils::GetNodeName(OtherNode));
+		UEdGraphPin* OtherPin = Frame.LinkedPins[Frame.LinkIndex++];
+		UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
+		FPinLink Link(MyPin, OtherPin);
+		const int32 LinkId = LinkIds.GetLinkId(MyPin, OtherPin);
 
-				FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
+		bool bIsSameLink = Path.Contains(Link);
 
-				bool bChildIsSameRow = false;
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tIter Child %s"), *FBAUtils::GetNodeName(OtherNode));
+		//
+		// if (!bIsSameLink)
+		// {
+		// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tNot same link!"));
+		// }
 
-				if (bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction))
-				{
-					bChildIsSameRow = true;
-					bFirstPin = false;
-					// UE_LOG(LogBlueprintAssist, Error, TEXT("\t\tNode %s is same row as %s"),
-					//        *FBAUtils::GetNodeName(OtherNode),
-					//        *FBAUtils::GetNodeName(CurrentNode));
-				}
-				else
-				{
-					if (LastProcessed != nullptr)
-					{
-						//UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved node %s to %s"), *FBAUtils::GetNodeName(OtherNode), *FBAUtils::GetNodeName(LastPinOther->GetOwningNode()));
-						const int32 NewNodePosY = FMath::Max(OtherNode->NodePosY, LastProcessed->GetOwningNode()->NodePosY);
-						FBAUtils::SetNodePosY(GraphHandler, OtherNode, NewNodePosY);
-					}
-				}
+		if (VisitedLinks.Contains(LinkId)
+			|| !NodePool.Contains(OtherNode)
+			|| FBAUtils::IsNodePure(OtherNode)
+			|| NodesToCollisionCheck.Contains(OtherNode)
+			|| !bIsSameLink)
+		{
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tSkipping child"));
+			continue;
+		}
+		VisitedLinks.Add(LinkId);
 
-				if (!NodeHeightLevels.Contains(OtherNode))
-				{
-					int NewHeight = NodeHeightLevels[CurrentNode] + (bChildIsSameRow ? 0 : DeltaY);
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTaking Child %s"), *FBAUtils::GetNodeName(OtherNode));
 
-					NodeHeightLevels.Add(OtherNode, NewHeight);
+		FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
 
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("Set height for node %s to %d"), *FBAUtils::GetNodeName(OtherNode), NewHeight);
-				}
+		bool bChildIsSameRow = false;
 
-				RefreshParameters(OtherNode);
+		if (Frame.bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction))
+		{
+			bChildIsSameRow = true;
+			Frame.bFirstPin = false;
+			// UE_LOG(LogBlueprintAssist, Error, TEXT("\t\tNode %s is same row as %s"),
+			//        *FBAUtils::GetNodeName(OtherNode),
+			//        *FBAUtils::GetNodeName(CurrentNode));
+		}
+		else
+		{
+			if (Frame.LastProcessed != nullptr)
+			{
+				//UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved node %s to %s"), *FBAUtils::GetNodeName(OtherNode), *FBAUtils::GetNodeName(LastPinOther->GetOwningNode()));
+				const int32 NewNodePosY = FMath::Max(OtherNode->NodePosY, Frame.LastProcessed->GetOwningNode()->NodePosY);
+				FBAUtils::SetNodePosY(GraphHandler, OtherNode, NewNodePosY);
+			}
+		}
 
-				TSet<UEdGraphNode*> LocalChildren;
-				FormatY_Recursive(OtherNode, OtherPin, MyPin, NodesToCollisionCheck, VisitedLinks, bChildIsSameRow, LocalChildren);
-				Children.Append(LocalChildren);
+		if (!NodeHeightLevels.Contains(OtherNode))
+		{
+			int NewHeight = NodeHeightLevels[CurrentNode] + (bChildIsSameRow ? 0 : Frame.DeltaY);
 
-				if (FormatXInfoMap[CurrentNode]->GetImmediateChildren().Contains(OtherNode))
-				{
-					ChildBranches.Add(ChildBranch(OtherPin, MyPin, LocalChildren));
-				}
+			NodeHeightLevels.Add(OtherNode, NewHeight);
 
-				//UE_LOG(LogBlueprintAssist, Warning, TEXT("Local children for %s"), *FBAUtils::GetNodeName(CurrentNode));
-				//for (UEdGraphNode* Node : LocalChildren)
-				//{
-				//	UE_LOG(LogBlueprintAssist, Warning, TEXT("\tChild %s"), *FBAUtils::GetNodeName(Node));
-				//}
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("Set height for node %s to %d"), *FBAUtils::GetNodeName(OtherNode), NewHeight);
+		}
 
-				if (!bChildIsSameRow && LocalChildren.Num() > 0)
-				{
-					UEdGraphPin* PinToAvoid = LastLinked;
-					if (MainPin != nullptr)
-					{
-						PinToAvoid = MainPin;
-						MainPin = nullptr;
-					}
+		RefreshParameters(OtherNode);
 
-					if (PinToAvoid != nullptr && GetDefault<UBASettings>()->bCustomDebug != 27)
-					{
-						FSlateRect Bounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, LocalChildren.Array());
+		FFormatYFrame& ChildFrame = FormatYStack.Push();
+		ChildFrame.Node = OtherNode;
+		ChildFrame.Pin = OtherPin;
+		ChildFrame.ParentPin = MyPin;
+		ChildFrame.bSameRow = bChildIsSameRow;
+		return &ChildFrame;
+	}
+}
 
-						// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(OtherPin));
-						const float PinPos = GraphHandler->GetPinY(PinToAvoid) + VerticalPinSpacing;
-						const float Delta = PinPos - Bounds.Top;
+void FEdGraphFormatter::FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* MyPin = ChildFrame.ParentPin;
+	UEdGraphPin* OtherPin = ChildFrame.Pin;
+	UEdGraphNode* OtherNode = ChildFrame.Node;
+	const bool bChildIsSameRow = ChildFrame.bSameRow;
+	TSet<UEdGraphNode*>& LocalChildren = ChildFrame.Children;
 
-						if (Delta > 0)
-						{
-							for (UEdGraphNode* Child : LocalChildren)
-							{
-								Child->NodePosY += Delta;
-								RefreshParameters(Child);
-							}
-						}
-					}
-				}
+	Frame.Children.Append(LocalChildren);
 
-				LastProcessed = OtherPin;
-			}
+	if (FormatXInfoMap[CurrentNode]->GetImmediateChildren().Contains(OtherNode))
+	{
+		Frame.ChildBranches.Add(ChildBranch(OtherPin, MyPin, LocalChildren));
+	}
 
-			LastLinked = MyPin;
+	//UE_LOG(LogBlueprintAssist, Warning, TEXT("Local children for %s"), *FBAUtils::GetNodeName(CurrentNode));
+	//for (UEdGraphNode* Node : LocalChildren)
+	//{
+	//	UE_LOG(LogBlueprintAssist, Warning, TEXT("\tChild %s"), *FBAUtils::GetNodeName(Node));
+	//}
 
-			DeltaY += 1;
+	if (!bChildIsSameRow && LocalChildren.Num() > 0)
+	{
+		UEdGraphPin* PinToAvoid = Frame.LastLinked;
+		if (Frame.MainPin != nullptr)
+		{
+			PinToAvoid = Frame.MainPin;
+			Frame.MainPin = nullptr;
 		}
 
-		if (bCenterBranches && ChildBranches.Num() >= NumRequiredBranches && ParentDirection == EGPD_Output)
+		if (PinToAvoid != nullptr && Settings.CustomDebug != 27)
 		{
-			if (CurrentDirection != ParentDirection)
+			FSlateRect Bounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, LocalChildren.Array());
+
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(OtherPin));
+			const float PinPos = GraphHandler->GetPinY(PinToAvoid) + VerticalPinSpacing;
+			const float Delta = PinPos - Bounds.Top;
+
+			if (Delta > 0)
 			{
-				bCenteredParent = true;
+				for (UEdGraphNode* Child : LocalChildren)
+				{
+					Child->NodePosY += Delta;
+					RefreshParameters(Child);
+				}
 			}
-
-			CenterBranches(CurrentNode, ChildBranches, NodesToCollisionCheck);
 		}
 	}
 
-	Children.Add(CurrentNode);
+	Frame.LastProcessed = OtherPin;
+}
+
+void FEdGraphFormatter::FormatYExitNode(FFormatYFrame& Frame)
+{
+	Frame.Children.Add(Frame.Node);
 
-	if (bSameRow && ParentPin != nullptr && !bCenteredParent)
+	if (Frame.bSameRow && Frame.ParentPin != nullptr && !Frame.bCenteredParent)
 	{
 		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tStraightening pin from %s to %s"),
-		//        *FBAUtils::GetPinName(CurrentPin),
-		//        *FBAUtils::GetPinName(ParentPin));
+		//        *FBAUtils::GetPinName(Frame.Pin),
+		//        *FBAUtils::GetPinName(Frame.ParentPin));
 
-		FBAUtils::StraightenPin(GraphHandler, CurrentPin, ParentPin);
-		RefreshParameters(ParentPin->GetOwningNode());
+		FBAUtils::StraightenPin(GraphHandler, Frame.Pin, Frame.ParentPin);
+		RefreshParameters(Frame.ParentPin->GetOwningNode());
 	}
 }
 
-void FEdGraphFormatter::GetPinsOfSameHeight_Recursive(
-	UEdGraphNode* CurrentNode,
-	UEdGraphPin* CurrentPin,
-	UEdGraphPin* ParentPin,
-	TSet<UEdGraphNode*>& NodesToCollisionCheck,
-	TSet<FPinLink>& VisitedLinks)
+void FEdGraphFormatter::GetPinsOfSameHeight()
 {
-	NodesToCollisionCheck.Emplace(CurrentNode);
-
-	TArray<TArray<UEdGraphPin*>> OutputInput;
-
-	const EEdGraphPinDirection Direction = ParentPin == nullptr ? EGPD_Output : ParentPin->Direction.GetValue();
+	BA_TRACE_SCOPE(BA_GetPinsOfSameHeight);
 
-	OutputInput.Add(FBAUtils::GetLinkedPins(CurrentNode, Direction).FilterByPredicate(IsExecOrDelegatePin));
-	OutputInput.Add(FBAUtils::GetLinkedPins(CurrentNode, UEdGraphPin::GetComplementaryDirection(Direction)).FilterByPredicate(IsExecOrDelegatePin));
-
-	bool bFirstPin = true;
+	TSet<UEdGraphNode*> NodesToCollisionCheck;
+	FPinLinkSet VisitedLinks;
 
 	auto& GraphHandlerCapture = GraphHandler;
 
@@ -1047,34 +1107,44 @@ void FEdGraphFormatter::GetPinsOfSameHeight_Recursive(
 	{
 		struct FLocal
 		{
-			static void GetPins(UEdGraphPin* NextPin, TSet<UEdGraphNode*>& VisitedNodes, TArray<UEdGraphPin*>& OutPins, bool& bHasEventNode, int32& DepthToEventNode, int32 TempDepth)
+			static void GetPins(UEdGraphPin* StartPin, TSet<UEdGraphNode*>& VisitedNodes, TArray<UEdGraphPin*>& OutPins, bool& bHasEventNode, int32& DepthToEventNode)
 			{
-				if (FBAUtils::IsEventNode(NextPin->GetOwningNode()))
-				{
-					DepthToEventNode = TempDepth;
-					bHasEventNode = true;
-				}
+				// depth first, linked pins are pushed in reverse so they are visited in order
+				TArray<TPair<UEdGraphPin*, int32>> PendingPins;
+				PendingPins.Emplace(StartPin, 0);
 
-				if (VisitedNodes.Contains(NextPin->GetOwningNode()))
+				while (PendingPins.Num() > 0)
 				{
-					OutPins.Add(NextPin);
-					return;
-				}
+					const TPair<UEdGraphPin*, int32> Pending = PendingPins.Pop(false);
+					UEdGraphPin* NextPin = Pending.Key;
 
-				VisitedNodes.Add(NextPin->GetOwningNode());
+					if (FBAUtils::IsEventNode(NextPin->GetOwningNode()))
+					{
+						DepthToEventNode = Pending.Value;
+						bHasEventNode = true;
+					}
 
-				auto NextPins = FBAUtils::GetLinkedToPins(NextPin->GetOwningNode(), EGPD_Input);
+					if (VisitedNodes.Contains(NextPin->GetOwningNode()))
+					{
+						OutPins.Add(NextPin);
+						continue;
+					}
 
-				for (UEdGraphPin* Pin : NextPins)
-				{
-					GetPins(Pin, VisitedNodes, OutPins, bHasEventNode, DepthToEventNode, TempDepth + 1);
+					VisitedNodes.Add(NextPin->GetOwningNode());
+
+					auto NextPins = FBAUtils::GetLinkedToPins(NextPin->GetOwningNode(), EGPD_Input);
+
+					for (int32 PinIndex = NextPins.Num() - 1; PinIndex >= 0; --PinIndex)
+					{
+						PendingPins.Emplace(NextPins[PinIndex], Pending.Value + 1);
+					}
 				}
 			}
 
 			static UEdGraphPin* HighestPin(TSharedPtr<FBAGraphHandler> GraphHandler, UEdGraphPin* Pin, TSet<UEdGraphNode*>& VisitedNodes, bool& bHasEventNode, int32& DepthToEventNode)
 			{
 				TArray<UEdGraphPin*> OutPins;
-				GetPins(Pin, VisitedNodes, OutPins, bHasEventNode, DepthToEventNode, 0);
+				GetPins(Pin, VisitedNodes, OutPins, bHasEventNode, DepthToEventNode);
 
 				if (OutPins.Num() == 0)
 				{
@@ -1129,48 +1199,88 @@ void FEdGraphFormatter::GetPinsOfSameHeight_Recursive(
 		return PinPosA.Y < PinPosB.Y;
 	};
 
-	for (TArray<UEdGraphPin*>& Pins : OutputInput)
+	// walk the tree with an explicit stack, long execution chains would overflow the call stack
+	FFormatYFrame& RootFrame = FormatYStack.Push();
+	RootFrame.Node = RootNode;
+	NodesToCollisionCheck.Emplace(RootNode);
+
+	while (FormatYStack.Num() > 0)
 	{
-		for (UEdGraphPin* MyPin : Pins)
-		{
-			TArray<UEdGraphPin*> LinkedPins = MyPin->LinkedTo;
+		FFormatYFrame& Frame = FormatYStack.Top();
+		UEdGraphNode* CurrentNode = Frame.Node;
+		UEdGraphPin* ParentPin = Frame.ParentPin;
 
-			if (MyPin->Direction == EGPD_Input && GetMutableDefault<UBASettings>()->FormattingStyle == EBANodeFormattingStyle::Expanded)
+		if (Frame.PinIndex >= Frame.Pins.Num())
+		{
+			Frame.DirectionIndex += 1;
+			if (Frame.DirectionIndex >= 2)
 			{
-				LinkedPins.StableSort(LinkedToSorter);
+				FormatYStack.Pop();
+				continue;
 			}
 
-			for (int i = 0; i < LinkedPins.Num(); ++i)
+			const EEdGraphPinDirection Direction = ParentPin == nullptr ? EGPD_Output : ParentPin->Direction.GetValue();
+			const EEdGraphPinDirection NextDirection = Frame.DirectionIndex == 0 ? Direction : UEdGraphPin::GetComplementaryDirection(Direction);
+			Frame.Pins = FBAUtils::GetLinkedPins(CurrentNode, NextDirection).FilterByPredicate(IsExecOrDelegatePin);
+			Frame.PinIndex = 0;
+			Frame.LinkIndex = INDEX_NONE;
+			continue;
+		}
+
+		UEdGraphPin* MyPin = Frame.Pins[Frame.PinIndex];
+		if (Frame.LinkIndex == INDEX_NONE)
+		{
+			Frame.LinkedPins = MyPin->LinkedTo;
+
+			if (MyPin->Direction == EGPD_Input && Settings.FormattingStyle == EBANodeFormattingStyle::Expanded)
 			{
-				UEdGraphPin* OtherPin = LinkedPins[i];
-				UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
-				FPinLink Link(MyPin, OtherPin);
+				Frame.LinkedPins.StableSort(LinkedToSorter);
+			}
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("Try Iterating (%s) %s"), *FBAUtils::GetNodeName(CurrentNode), *Link.ToString());
+			Frame.LinkIndex = 0;
+		}
 
-				if (VisitedLinks.Contains(Link)
-					|| !NodePool.Contains(OtherNode)
-					|| FBAUtils::IsNodePure(OtherNode))
-				{
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tSkipping"));
-					continue;
-				}
-				VisitedLinks.Add(Link);
-				VisitedLinks.Add(Link.MakeOppositeLink());
+		if (Frame.LinkIndex >= Frame.LinkedPins.Num())
+		{
+			Frame.PinIndex += 1;
+			Frame.LinkIndex = INDEX_NONE;
+			continue;
+		}
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("Iterating %s"), *Link.ToString());
+		UEdGraphPin* OtherPin = Frame.LinkedPins[Frame.LinkIndex++];
+		UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
+		FPinLink Link(MyPin, OtherPin);
+		const int32 LinkId = LinkIds.GetLinkId(MyPin, OtherPin);
+		const int32 OppositeLinkId = LinkIds.GetLinkId(OtherPin, MyPin);
 
-				if (bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction) && !NodesToCollisionCheck.Contains(OtherNode))
-				{
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tSame row? %s"), *FBAUtils::GetPinName(ParentPin));
-					SameRowMapping.Add(Link, true);
-					SameRowMapping.Add(FPinLink(OtherPin, MyPin), true);
-					bFirstPin = false;
-				}
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Try Iterating (%s) %s"), *FBAUtils::GetNodeName(CurrentNode), *Link.ToString());
 
-				GetPinsOfSameHeight_Recursive(OtherNode, OtherPin, MyPin, NodesToCollisionCheck, VisitedLinks);
-			}
+		if (VisitedLinks.Contains(LinkId)
+			|| !NodePool.Contains(OtherNode)
+			|| FBAUtils::IsNodePure(OtherNode))
+		{
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tSkipping"));
+			continue;
 		}
+		VisitedLinks.Add(LinkId);
+		VisitedLinks.Add(OppositeLinkId);
+
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Iterating %s"), *Link.ToString());
+
+		if (Frame.bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction) && !NodesToCollisionCheck.Contains(OtherNode))
+		{
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tSame row? %s"), *FBAUtils::GetPinName(ParentPin));
+			SameRowMapping.Add(LinkId);
+			SameRowMapping.Add(OppositeLinkId);
+			Rows.JoinRows(CurrentNode, OtherNode);
+			Frame.bFirstPin = false;
+		}
+
+		FFormatYFrame& ChildFrame = FormatYStack.Push();
+		ChildFrame.Node = OtherNode;
+		ChildFrame.Pin = OtherPin;
+		ChildFrame.ParentPin = MyPin;
+		NodesToCollisionCheck.Emplace(OtherNode);
 	}
 }
 
@@ -1184,7 +1294,7 @@ UEdGraphNode* FEdGraphFormatter::GetHighestLevelParentNode(UEdGraphNode* Node)
 			return Node;
 		}
 
-		return GetHighestLevelParentNode(Info->Parent->GetNode());
+		return GetHighestLevelParentNode(Info->GetParent()->GetNode());
 	}
 
 	return nullptr;
@@ -1204,7 +1314,7 @@ void FEdGraphFormatter::WrapNodes()
 		UEdGraphNode* NextNode = PendingNodes.Pop();
 		if (NextNode->NodePosX - RootPos > 1000)
 		{
-			TSharedPtr<FFormatXInfo> Info = FormatXInfoMap[NextNode];
+			FFormatXInfo* Info = FormatXInfoMap[NextNode];
 			TArray<UEdGraphNode*> Children = Info->GetChildren(EGPD_Output);
 
 			float Offset = RootPos - NextNode->NodePosX;
@@ -1235,6 +1345,11 @@ void FEdGraphFormatter::WrapNodes()
 
 void FEdGraphFormatter::ExpandCommentsY()
 {
+	BA_TRACE_SCOPE(BA_ExpandCommentsY);
+
+	// the passes before this one don't report the nodes they move
+	CommentHandler.MarkAllBoundsDirty();
+
 	// UE_LOG(LogTemp, Error, TEXT("EXPAND COMMENTS Y"));
 	TArray<UEdGraphNode*> Contains = GetNodePool();
 	TArray<UEdGraphNode_Comment*> Comments = CommentHandler.GetComments().Array();
@@ -1255,60 +1370,37 @@ void FEdGraphFormatter::ExpandCommentsY()
 
 	Contains.Append(Comments);
 
-	TSet<UEdGraphNode*> Temp;
-	ExpandCommentsY_Recursive(Contains, Temp);
+	FBAFormatterUtils::ExpandCommentsNested(
+		CommentExpandStack,
+		CommentHandler,
+		MoveTemp(Contains),
+		[&](TArray<UEdGraphNode*>& NodeSet)
+		{
+			NodeSet.StableSort([&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
+			{
+				float TopA = GetNodeBounds(&NodeA, true).Top;
+				if (auto Comment = Cast<UEdGraphNode_Comment>(&NodeA))
+				{
+					TopA = CommentHandler.GetContainedNodesBounds(Comment).Top;
+				}
+
+				float TopB = GetNodeBounds(&NodeB, true).Top;
+				if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(&NodeB))
+				{
+					TopB = CommentHandler.GetContainedNodesBounds(Comment).Top;
+				}
+				return TopA < TopB;
+			});
+		},
+		[&](UEdGraphNode_Comment* Comment, const TArray<UEdGraphNode*>& NodeSet) { return GetCommentNodeSet(Comment, NodeSet); },
+		[&](FCommentExpandFrame& Frame) { ExpandCommentNodeSetY(Frame); });
 	// UE_LOG(LogTemp, Error, TEXT("END EXPAND COMMENTS Y"));
 }
 
-void FEdGraphFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes)
+void FEdGraphFormatter::ExpandCommentNodeSetY(FCommentExpandFrame& Frame)
 {
-	NodeSet.StableSort([&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
-	{
-		float TopA = GetNodeBounds(&NodeA, true).Top;
-		if (auto Comment = Cast<UEdGraphNode_Comment>(&NodeA))
-		{
-			auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
-			Nodes.RemoveAll(FBAUtils::IsCommentNode);
-			TopA = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
-		}
-
-		float TopB = GetNodeBounds(&NodeB, true).Top;
-		if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(&NodeB))
-		{
-			auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
-			Nodes.RemoveAll(FBAUtils::IsCommentNode);
-			TopB = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
-		}
-		return TopA < TopB;
-	});
-
-	TSet<UEdGraphNode*> HandledNodes;
-	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>> CommentContains;
-
-	TArray<UEdGraphNode_Comment*> Comments = FBAUtils::GetNodesOfClass<UEdGraphNode_Comment>(NodeSet);
-	Comments.StableSort([&](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
-	{
-		return CommentHandler.GetCommentDepth(&CommentA) < CommentHandler.GetCommentDepth(&CommentB);
-	});
-
-	for (UEdGraphNode_Comment* Comment : Comments)
-	{
-		if (HandledNodes.Contains(Comment))
-		{
-			continue;
-		}
-
-		TSet<UEdGraphNode*> LocalHandled;
-		ExpandCommentsY_Recursive(GetCommentNodeSet(Comment, NodeSet), LocalHandled);
-		HandledNodes.Append(LocalHandled);
-		CommentContains.Add(Comment, LocalHandled);
-	}
-
-	OutHandledNodes.Append(NodeSet);
-
-	// Remove all handled nodes from subgraphs
-	NodeSet.RemoveAll([&HandledNodes](UEdGraphNode* Node){ return HandledNodes.Contains(Node); });
-	Comments.RemoveAll([&HandledNodes](UEdGraphNode* Node){ return HandledNodes.Contains(Node); });
+	TArray<UEdGraphNode*>& NodeSet = Frame.NodeSet;
+	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>>& CommentContains = Frame.CommentContains;
 
 	// UE_LOG(LogTemp, Warning, TEXT("Format SubGraph"));
 	// for (UEdGraphNode* Node : NodeSet)
@@ -1362,6 +1454,7 @@ void FEdGraphFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 					for (UEdGraphNode* Node : CommentContains[CommentB])
 					{
 						Node->NodePosY += Delta;
+						CommentHandler.MarkNodeMoved(Node);
 						RefreshParameters(Node);
 					}
 
@@ -1378,6 +1471,7 @@ void FEdGraphFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 				else
 				{
 					NodeB->NodePosY += Delta;
+					CommentHandler.MarkNodeMoved(NodeB);
 					RefreshParameters(NodeB);
 					StraightenRowWithFilter(NodeB, [&](const FPinLink& Link) { return NodeSet.Contains(Link.GetNode()); });
 					// UE_LOG(LogTemp, Warning, TEXT("\t{%s} Colliding with NODE {%s}"), *FBAUtils::GetNodeName(NodeA), *FBAUtils::GetNodeName(NodeB));
@@ -1389,6 +1483,11 @@ void FEdGraphFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 
 void FEdGraphFormatter::ExpandCommentsX()
 {
+	BA_TRACE_SCOPE(BA_ExpandCommentsX);
+
+	// the passes before this one don't report the nodes they move
+	CommentHandler.MarkAllBoundsDirty();
+
 	// UE_LOG(LogTemp, Error, TEXT("EXPAND COMMENTS X"));
 	TArray<UEdGraphNode*> Contains = GetNodePool();
 
@@ -1412,49 +1511,31 @@ void FEdGraphFormatter::ExpandCommentsX()
 
 	Contains.Append(Comments);
 
-	TSet<UEdGraphNode*> Temp;
-	ExpandCommentsX_Recursive(Contains, Temp);
+	FBAFormatterUtils::ExpandCommentsNested(
+		CommentExpandStack,
+		CommentHandler,
+		MoveTemp(Contains),
+		[&](TArray<UEdGraphNode*>& NodeSet)
+		{
+			const auto LeftMost = [&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
+			{
+				const float LeftA = GetNodeBounds(&NodeA, true).Left;
+				const float LeftB = GetNodeBounds(&NodeB, true).Left;
+				return LeftA < LeftB;
+			};
+
+			NodeSet.StableSort(LeftMost);
+		},
+		[&](UEdGraphNode_Comment* Comment, const TArray<UEdGraphNode*>& NodeSet) { return GetCommentNodeSet(Comment, NodeSet); },
+		[&](FCommentExpandFrame& Frame) { ExpandCommentNodeSetX(Frame); });
 	// UE_LOG(LogTemp, Error, TEXT("END EXPAND COMMENTS X"));
 }
 
-void FEdGraphFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes)
+void FEdGraphFormatter::ExpandCommentNodeSetX(FCommentExpandFrame& Frame)
 {
-	const auto LeftMost = [&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
-	{
-		const float LeftA = GetNodeBounds(&NodeA, true).Left;
-		const float LeftB = GetNodeBounds(&NodeB, true).Left;
-		return LeftA < LeftB;
-	};
-
-	NodeSet.StableSort(LeftMost);
-
-	TSet<UEdGraphNode*> HandledNodes;
-	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>> CommentContains;
-
-	TArray<UEdGraphNode_Comment*> Comments = FBAUtils::GetNodesOfClass<UEdGraphNode_Comment>(NodeSet);
-	Comments.StableSort([&](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
-	{
-		return CommentHandler.GetCommentDepth(&CommentA) < CommentHandler.GetCommentDepth(&CommentB);
-	});
-
-	for (UEdGraphNode_Comment* Comment : Comments)
-	{
-		if (HandledNodes.Contains(Comment))
-		{
-			continue;
-		}
-
-		TSet<UEdGraphNode*> LocalHandled;
-		ExpandCommentsX_Recursive(GetCommentNodeSet(Comment, NodeSet), LocalHandled);
-		HandledNodes.Append(LocalHandled);
-		CommentContains.Add(Comment, LocalHandled);
-	}
-
-	OutHandledNodes.Append(NodeSet);
-
-	// Remove all handled nodes from subgraphs
-	NodeSet.RemoveAll([&HandledNodes](UEdGraphNode* Node){ return HandledNodes.Contains(Node); });
-	Comments.RemoveAll([&HandledNodes](UEdGraphNode* Node){ return HandledNodes.Contains(Node); });
+	TArray<UEdGraphNode*>& NodeSet = Frame.NodeSet;
+	TArray<UEdGraphNode_Comment*>& Comments = Frame.Comments;
+	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>>& CommentContains = Frame.CommentContains;
 
 	// UE_LOG(LogTemp, Warning, TEXT("Format SubGraph"));
 	// for (UEdGraphNode* Node : NodeSet)
@@ -1465,26 +1546,32 @@ void FEdGraphFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 	for (UEdGraphNode* NodeA : NodeSet)
 	{
 		// collide only with our children
-		TSet<TSharedPtr<FFormatXInfo>> Children;
+		TSet<FFormatXInfo*> Children;
 		if (UEdGraphNode_Comment* CommentA = Cast<UEdGraphNode_Comment>(NodeA))
 		{
 			for (UEdGraphNode* Node : CommentContains[CommentA])
 			{
-				if (TSharedPtr<FFormatXInfo> FormatXInfo = GetFormatXInfo(Node))
+				if (FFormatXInfo* FormatXInfo = GetFormatXInfo(Node))
 				{
-					Children.Append(FormatXInfo->Children);
+					for (int32 ChildIndex : FormatXInfo->Children)
+					{
+						Children.Add(FormatXArena.Get(ChildIndex));
+					}
 				}
 			}
 		}
 		else
 		{
-			if (TSharedPtr<FFormatXInfo> FormatXInfo = GetFormatXInfo(NodeA))
+			if (FFormatXInfo* FormatXInfo = GetFormatXInfo(NodeA))
 			{
-				Children.Append(FormatXInfo->Children);
+				for (int32 ChildIndex : FormatXInfo->Children)
+				{
+					Children.Add(FormatXArena.Get(ChildIndex));
+				}
 			}
 		}
 
-		for (TSharedPtr<FFormatXInfo> Info : Children)
+		for (FFormatXInfo* Info : Children)
 		{
 			auto NodeB = Info->GetNode();
 
@@ -1579,6 +1666,7 @@ void FEdGraphFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 					for (auto Child : AllChildren)
 					{
 						Child->NodePosX += Delta;
+						CommentHandler.MarkNodeMoved(Child);
 						RefreshParameters(Child);
 						// UE_LOG(LogTemp, Warning, TEXT("\tMove child %s"), *FBAUtils::GetNodeName(Child));
 					}
@@ -1596,10 +1684,12 @@ void FEdGraphFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 					// UE_LOG(LogTemp, Warning, TEXT("COMMENT {%s} Colliding with Node {%s}"), *FBAUtils::GetNodeName(NodeA), *FBAUtils::GetNodeName(NodeB));
 
 					NodeB->NodePosX += Delta;
+					CommentHandler.MarkNodeMoved(NodeB);
 					RefreshParameters(NodeB);
 					for (auto Child : FormatXInfoMap[NodeB]->GetChildren())
 					{
 						Child->NodePosX += Delta;
+						CommentHandler.MarkNodeMoved(Child);
 						RefreshParameters(Child);
 						// UE_LOG(LogTemp, Warning, TEXT("\tMove child %s"), *FBAUtils::GetNodeName(Child));
 					}
@@ -1622,7 +1712,7 @@ void FEdGraphFormatter::StraightenRowWithFilter(UEdGraphNode* Node, TFunctionRef
 		PendingLinks.Enqueue(Link);
 	}
 
-	TSet<FPinLink> StraightenedLinks;
+	FPinLinkSet StraightenedLinks;
 	while (!PendingLinks.IsEmpty())
 	{
 		FPinLink Link;
@@ -1633,17 +1723,19 @@ void FEdGraphFormatter::StraightenRowWithFilter(UEdGraphNode* Node, TFunctionRef
 			continue;
 		}
 
-		if (StraightenedLinks.Contains(Link))
+		const int32 LinkId = LinkIds.GetLinkId(Link);
+		if (StraightenedLinks.Contains(LinkId))
 		{
 			continue;
 		}
 
-		StraightenedLinks.Add(Link);
-		StraightenedLinks.Add(Link.MakeOppositeLink());
+		StraightenedLinks.Add(LinkId);
+		StraightenedLinks.Add(LinkIds.GetLinkId(Link.To, Link.From));
 
-		if (IsSameRow(Link))
+		if (SameRowMapping.Contains(LinkId))
 		{
 			FBAUtils::StraightenPin(GraphHandler, Link);
+			CommentHandler.MarkNodeMoved(Link.GetToNode());
 			RefreshParameters(Link.GetToNode());
 
 			for (const FPinLink& NewLink : FBAUtils::GetPinLinks(Link.GetToNode()))
@@ -1656,85 +1748,12 @@ void FEdGraphFormatter::StraightenRowWithFilter(UEdGraphNode* Node, TFunctionRef
 
 bool FEdGraphFormatter::IsSameRow(const FPinLink& PinLink)
 {
-	if (bool* FoundSameRow = SameRowMapping.Find(PinLink))
-	{
-		return *FoundSameRow;
-	}
-
-	return false;
-}
-
-bool FEdGraphFormatter::IsSameRow(UEdGraphNode* NodeA, UEdGraphNode* NodeB)
-{
-	TSet<FPinLink> VisitedLinks;
-	TQueue<UEdGraphNode*> PendingNodes;
-	PendingNodes.Enqueue(NodeA);
-
-	while (!PendingNodes.IsEmpty())
-	{
-		UEdGraphNode* Node = nullptr;
-		PendingNodes.Dequeue(Node);
-
-		if (Node == NodeB)
-		{
-			return true;
-		}
-
-		for (const FPinLink& PinLink : FBAUtils::GetPinLinks(Node))
-		{
-			if (VisitedLinks.Contains(PinLink))
-			{
-				continue;
-			}
-
-			VisitedLinks.Add(PinLink);
-			VisitedLinks.Add(PinLink.MakeOppositeLink());
-
-			if (!IsSameRow(PinLink))
-			{
-				continue;
-			}
-
-			PendingNodes.Enqueue(PinLink.GetNode());
-		}
-	}
-
-	return false;
+	return SameRowMapping.Contains(LinkIds.GetLinkId(PinLink));
 }
 
 TArray<UEdGraphNode*> FEdGraphFormatter::GetNodesInRow(UEdGraphNode* Node)
 {
-	TArray<UEdGraphNode*> NodesInRow;
-	NodesInRow.Add(Node);
-	TSet<FPinLink> VisitedLinks;
-	TQueue<UEdGraphNode*> PendingNodes;
-	PendingNodes.Enqueue(Node);
-	while (!PendingNodes.IsEmpty())
-	{
-		UEdGraphNode* NextNode = nullptr;
-		PendingNodes.Dequeue(NextNode);
-
-		for (const FPinLink& PinLink : FBAUtils::GetPinLinks(NextNode))
-		{
-			if (VisitedLinks.Contains(PinLink))
-			{
-				continue;
-			}
-
-			VisitedLinks.Add(PinLink);
-			VisitedLinks.Add(PinLink.MakeOppositeLink());
-
-			if (!IsSameRow(PinLink))
-			{
-				continue;
-			}
-
-			NodesInRow.Add(PinLink.GetNode());
-			PendingNodes.Enqueue(PinLink.GetNode());
-		}
-	}
-
-	return NodesInRow;
+	return Rows.GetNodesInRow(Node);
 }
 
 bool FEdGraphFormatter::AreCommentsIntersecting(UEdGraphNode_Comment* CommentA, UEdGraphNode_Comment* CommentB)
@@ -1779,7 +1798,7 @@ TSharedPtr<FEdGraphParameterFormatter> FEdGraphFormatter::GetParameterParent(UEd
 	return nullptr;
 }
 
-TSharedPtr<FFormatXInfo> FEdGraphFormatter::GetFormatXInfo(UEdGraphNode* Node)
+FFormatXInfo* FEdGraphFormatter::GetFormatXInfo(UEdGraphNode* Node)
 {
 	return FormatXInfoMap.FindRef(Node);
 }
@@ -1945,27 +1964,26 @@ void FEdGraphFormatter::RemoveKnotNodes()
 
 bool FEdGraphFormatter::IsExecOrDelegatePin(UEdGraphPin* Pin)
 {
-	const bool bUseDelegatePins = GetMutableDefault<UBASettings>()->bTreatDelegatesAsExecutionPins && FBAUtils::IsDelegatePin(Pin) && FBAUtils::IsNodeImpure(Pin->GetOwningNode());
+	const bool bUseDelegatePins = GetDefault<UBASettings>()->bTreatDelegatesAsExecutionPins && FBAUtils::IsDelegatePin(Pin) && FBAUtils::IsNodeImpure(Pin->GetOwningNode());
 	return FBAUtils::IsExecPin(Pin) || bUseDelegatePins;
 }
 
 void FEdGraphFormatter::ModifyCommentNodes()
 {
+	BA_TRACE_SCOPE(BA_ModifyCommentNodes);
+
+	LastCommentBounds.Reset();
+
+	CommentHandler.MarkAllBoundsDirty();
+
 	for (UEdGraphNode_Comment* Comment : CommentHandler.GetComments())
 	{
-		Comment->Modify();
-
 		// set bounds
-		Comment->SetBounds(GetCommentBounds(Comment));
-	}
-}
+		const FSlateRect Bounds = GetCommentBounds(Comment);
+		Comment->SetBounds(Bounds);
 
-void FEdGraphFormatter::GetPinsOfSameHeight()
-{
-	TSet<UEdGraphNode*> NodesToCollisionCheck;
-	TSet<FPinLink> VisitedLinks;
-	TSet<UEdGraphNode*> TempChildren;
-	GetPinsOfSameHeight_Recursive(RootNode, nullptr, nullptr, NodesToCollisionCheck, VisitedLinks);
+		LastCommentBounds.Emplace(Comment, Bounds.OffsetBy(-FVector2D(NodeToKeepStill->NodePosX, NodeToKeepStill->NodePosY)));
+	}
 }
 
 FSlateRect FEdGraphFormatter::GetCommentNodeBounds(UEdGraphNode_Comment* CommentNode, const FSlateRect& InBounds, FMargin& PostPadding)
@@ -1993,8 +2011,7 @@ FSlateRect FEdGraphFormatter::GetCommentNodeBounds(UEdGraphNode_Comment* Comment
 	const auto ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, NodesUnderComment);
 	auto OutBounds = InBounds;
 
-	const auto BASettings = GetDefault<UBASettings>();
-	const FVector2D Padding = BASettings->CommentNodePadding;
+	const FVector2D Padding = Settings.CommentNodePadding;
 	float TitlebarHeight = 0.f;
 
 	TSharedPtr<SGraphNodeComment> GraphNodeComment = StaticCastSharedPtr<SGraphNodeComment>(FBAUtils::GetGraphNode(GraphHandler->GetGraphPanel(), CommentNode));
@@ -2048,68 +2065,7 @@ FSlateRect FEdGraphFormatter::GetCommentNodeBounds(UEdGraphNode_Comment* Comment
 
 FSlateRect FEdGraphFormatter::GetCommentBounds(UEdGraphNode_Comment* CommentNode, UEdGraphNode* NodeAsking)
 {
-	auto ObjUnderComment = CommentNode->GetNodesUnderComment();
-	TArray<UEdGraphNode*> NodesUnderComment;
-	TArray<UEdGraphNode_Comment*> CommentNodesUnderComment;
-
-	for (UObject* Obj : ObjUnderComment)
-	{
-		if (UEdGraphNode* EdNode = Cast<UEdGraphNode>(Obj))
-		{
-			if (auto Comment = Cast<UEdGraphNode_Comment>(EdNode))
-			{
-				CommentNodesUnderComment.Add(Comment);
-			}
-			else
-			{
-				NodesUnderComment.Add(EdNode);
-			}
-		}
-	}
-
-	// for (auto Node : NodesUnderComment)
-	// {
-	// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tNodeUnderComment %s | %s"), *FBAUtils::GetNodeName(Node), *FBAUtils::GetCachedNodeBounds(GraphHandler, Node).ToString());
-	// }
-
-	if (NodesUnderComment.Num() == 0 && CommentNodesUnderComment.Num() == 0)
-	{
-		return FSlateRect::FromPointAndExtent(FVector2D(CommentNode->NodePosX, CommentNode->NodePosY), FVector2D(CommentNode->NodeWidth, CommentNode->NodeHeight));
-	}
-
-	auto ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, NodesUnderComment);
-	// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
-	for (UEdGraphNode_Comment* CommentUnderComment : CommentNodesUnderComment)
-	{
-		if (CommentUnderComment->GetNodesUnderComment().Num() == 0)
-		{
-			continue;
-		}
-
-		if (CommentHandler.DoesCommentContainNode(CommentUnderComment, NodeAsking))
-		{
-			continue;
-		}
-
-		ContainedNodesBounds = ContainedNodesBounds.Expand(GetCommentBounds(CommentUnderComment, NodeAsking));
-		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
-	}
-
-	const FVector2D Padding = GetDefault<UBASettings>()->CommentNodePadding;
-
-	const float TitlebarHeight = FBAUtils::GetCachedNodeBounds(GraphHandler, CommentNode, false).GetSize().Y;
-
-	const FMargin CommentPadding(
-		Padding.X,
-		Padding.Y + TitlebarHeight,
-		Padding.X,
-		Padding.Y);
-
-	// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tContainedNodeBounds %s | Padding %s"), *ContainedNodesBounds.ToString(), *CommentPadding.GetDesiredSize().ToString());
-
-	ContainedNodesBounds = ContainedNodesBounds.ExtendBy(CommentPadding);
-
-	return ContainedNodesBounds;
+	return CommentHandler.GetCommentBounds(CommentNode, NodeAsking);
 }
 
 FSlateRect FEdGraphFormatter::GetCommentNodeSetBounds(UEdGraphNode_Comment* CommentNode, TArray<UEdGraphNode*> NodeSet, UEdGraphNode* NodeAsking)
@@ -2171,7 +2127,7 @@ FSlateRect FEdGraphFormatter::GetCommentNodeSetBounds(UEdGraphNode_Comment* Comm
 		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t ContainedNodesBounds %s"), *ContainedNodesBounds.ToString());
 	}
 
-	const FVector2D Padding = GetDefault<UBASettings>()->CommentNodePadding;
+	const FVector2D Padding = Settings.CommentNodePadding;
 
 	const float TitlebarHeight = FBAUtils::GetCachedNodeBounds(GraphHandler, CommentNode, false).GetSize().Y;
 
@@ -2202,22 +2158,7 @@ void FEdGraphFormatter::ApplyCommentPadding(FSlateRect& Bounds, UEdGraphNode* No
 		float Offset = 0;
 		for (auto Comment : CommentHandler.ParentComments[Node])
 		{
-			auto ObjUnderComment = Comment->GetNodesUnderComment();
-			TArray<UEdGraphNode*> NodesUnderComment;
-			for (auto Obj : ObjUnderComment)
-			{
-				if (UEdGraphNode* EdNode = Cast<UEdGraphNode>(Obj))
-				{
-					if (FBAUtils::IsCommentNode(EdNode))
-					{
-						continue;
-					}
-
-					NodesUnderComment.Add(EdNode);
-				}
-			}
-
-			const auto ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, NodesUnderComment);
+			const auto ContainedNodesBounds = CommentHandler.GetContainedNodesBounds(Comment);
 			if (ContainedNodesBounds.Left == NodeBounds.Left)
 			{
 				Offset += 30;
@@ -2230,22 +2171,7 @@ void FEdGraphFormatter::ApplyCommentPadding(FSlateRect& Bounds, UEdGraphNode* No
 		float Offset = 0;
 		for (auto Comment : CommentHandler.ParentComments[Node])
 		{
-			auto ObjUnderComment = Comment->GetNodesUnderComment();
-			TArray<UEdGraphNode*> NodesUnderComment;
-			for (auto Obj : ObjUnderComment)
-			{
-				if (UEdGraphNode* EdNode = Cast<UEdGraphNode>(Obj))
-				{
-					if (FBAUtils::IsCommentNode(EdNode))
-					{
-						continue;
-					}
-
-					NodesUnderComment.Add(EdNode);
-				}
-			}
-
-			const auto ContainedNodesBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, NodesUnderComment);
+			const auto ContainedNodesBounds = CommentHandler.GetContainedNodesBounds(Comment);
 			if (ContainedNodesBounds.Right == NodeBounds.Right)
 			{
 				Offset += 30;
@@ -2257,6 +2183,8 @@ void FEdGraphFormatter::ApplyCommentPadding(FSlateRect& Bounds, UEdGraphNode* No
 
 void FEdGraphFormatter::FormatParameterNodes()
 {
+	BA_TRACE_SCOPE(BA_FormatParameterNodes);
+
 	TArray<UEdGraphNode*> IgnoredNodes;
 
 	TArray<UEdGraphNode*> NodePoolCopy = NodePool;
@@ -2312,7 +2240,7 @@ void FEdGraphFormatter::FormatParameterNodes()
 	}
 
 	// Expand parameters by height
-	if (GetDefault<UBASettings>()->bExpandParametersByHeight)
+	if (Settings.bExpandParametersByHeight)
 	{
 		for (UEdGraphNode* MainNode : NodePoolCopy)
 		{
@@ -2357,6 +2285,11 @@ void FEdGraphFormatter::RefreshParameters(UEdGraphNode* Node)
 
 	TSharedPtr<FEdGraphParameterFormatter> Formatter = GetParameterFormatter(Node);
 	Formatter->FormatNode(Node);
+
+	for (UEdGraphNode* ParameterNode : Formatter->GetFormattedNodes())
+	{
+		CommentHandler.MarkNodeMoved(ParameterNode);
+	}
 }
 
 bool FEdGraphFormatter::IsFormattingRequired(const TArray<UEdGraphNode*>& NewNodeTree)
@@ -2373,90 +2306,104 @@ bool FEdGraphFormatter::IsFormattingRequired(const TArray<UEdGraphNode*>& NewNod
 		return true;
 	}
 
-	// Check if the number of nodes has changed
-	if (NodeTree.Num() != NewNodeTree.Num())
-	{
-		//UE_LOG(LogBlueprintAssist, Warning, TEXT("Num nodes changed %d to %d"), NewNodeTree.Num(), NodeTree.Num());
-		return true;
-	}
+	// The structure hash covers the node set, links, relative positions and comment membership
+	const uint32 NewStructureHash = GetStructureHash(NewNodeTree);
+
+	//UE_LOG(LogBlueprintAssist, Warning, TEXT("Structure hash %u | Last %u"), NewStructureHash, LastStructureHash);
+
+	return NewStructureHash != LastStructureHash;
+}
 
-	// Check if the node tree has changed
-	for (UEdGraphNode* Node : NewNodeTree)
+uint32 FEdGraphFormatter::CalculateStructureHash(TSharedPtr<FBAGraphHandler> GraphHandler, const TArray<UEdGraphNode*>& InNodeTree, UEdGraphNode* NodeToKeepStill)
+{
+	if (!NodeToKeepStill)
 	{
-		if (!NodeTree.Contains(Node))
-		{
-			//UE_LOG(LogBlueprintAssist, Warning, TEXT("Node tree changed for node %s"), *FBAUtils::GetNodeName(Node));
-			return true;
-		}
+		return 0;
 	}
 
-	// Check if any formatted nodes from last time have changed position or links
-	for (UEdGraphNode* Node : GetFormattedNodes())
+	FBACommentForest& CommentForest = GraphHandler->GetCommentForest();
+	CommentForest.Update(GraphHandler->GetFocusedEdGraph());
+
+	return HashCombine(CalculatePositionHash(InNodeTree, NodeToKeepStill), CalculateLinkHash(CommentForest, InNodeTree));
+}
+
+uint32 FEdGraphFormatter::CalculatePositionHash(const TArray<UEdGraphNode*>& InNodeTree, UEdGraphNode* NodeToKeepStill)
+{
+	// each part of the structure is summed so the hash does not depend on the order we visit nodes, pins or comments
+	uint32 Hash = GetTypeHash(InNodeTree.Num());
+
+	for (UEdGraphNode* Node : InNodeTree)
 	{
-		// Check if node has changed
-		if (NodeChangeInfos.Contains(Node))
-		{
-			FNodeChangeInfo ChangeInfo = NodeChangeInfos[Node];
-			if (ChangeInfo.HasChanged(NodeToKeepStill))
-			{
-				//UE_LOG(LogBlueprintAssist, Warning, TEXT("Node links or position has changed"));
-				return true;
-			}
-		}
+		const FIntPoint RelativePos(Node->NodePosX - NodeToKeepStill->NodePosX, Node->NodePosY - NodeToKeepStill->NodePosY);
+		Hash += HashCombine(GetTypeHash(Node->NodeGuid), GetTypeHash(RelativePos));
 	}
 
-	TArray<UEdGraphNode_Comment*> CachedComments;
-	CommentHandler.CommentNodesContains.GetKeys(CachedComments);
+	return Hash;
+}
+
+uint32 FEdGraphFormatter::CalculateLinkHash(const FBACommentForest& CommentForest, const TArray<UEdGraphNode*>& InNodeTree)
+{
+	uint32 Hash = 0;
 
-	// Check if any comment nodes have been deleted
-	const auto& NodeTreeCapture = NodeTree;
-	TArray<UEdGraphNode_Comment*> CommentNodes = FBAUtils::GetCommentNodesFromGraph(GraphHandler->GetFocusedEdGraph());
-	for (auto Comment : CommentNodes)
+	for (UEdGraphNode* Node : InNodeTree)
 	{
-		TArray<UEdGraphNode*> Contained = FBAUtils::GetNodesUnderComment(Comment);
-		UEdGraphNode** RelativeNodePtr = Contained.FindByPredicate([&NodeTreeCapture](UEdGraphNode* Node)
-		{
-			return NodeTreeCapture.Contains(Node);
-		});
+		const uint32 NodeHash = GetTypeHash(Node->NodeGuid);
 
-		if (RelativeNodePtr != nullptr)
+		for (UEdGraphPin* Pin : Node->Pins)
 		{
-			if (!CachedComments.Contains(Comment))
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
 			{
-				return true;
+				Hash += HashCombine(GetTypeHash(Pin->PinId), GetTypeHash(LinkedPin->PinId));
 			}
 		}
-	}
 
-	// Check contained comment nodes
-	for (UEdGraphNode_Comment* Comment : CachedComments)
-	{
-		if (!CommentNodes.Contains(Comment))
+		// comment membership, looked up per node instead of scanning every comment in the graph
+		for (UEdGraphNode_Comment* Comment : CommentForest.GetParentComments(Node))
 		{
-			return true;
+			Hash += HashCombine(GetTypeHash(Comment->NodeGuid), NodeHash);
 		}
+	}
 
-		TArray<UEdGraphNode*> CachedContained = CommentHandler.GetNodesUnderComments(Comment);
-		TArray<UEdGraphNode*> CurrentContained = FBAUtils::GetNodesUnderComment(Comment);
-		if (CachedContained.Num() != CurrentContained.Num())
-		{
-			return true;
-		}
+	return Hash;
+}
 
-		for (auto Contained : CachedContained)
-		{
-			if (!CurrentContained.Contains(Contained))
-			{
-				return true;
-			}
-		}
+uint32 FEdGraphFormatter::GetStructureHash(const TArray<UEdGraphNode*>& InNodeTree)
+{
+	if (!NodeToKeepStill)
+	{
+		return 0;
 	}
 
-	return false;
+	const uint32 LinkVersion = GraphHandler->GetNodeTreeIndex().GetLinkVersion();
+
+	FBACommentForest& CommentForest = GraphHandler->GetCommentForest();
+	CommentForest.Update(GraphHandler->GetFocusedEdGraph());
+
+	uint32 NodeSet = 0;
+	for (UEdGraphNode* Node : InNodeTree)
+	{
+		NodeSet += PointerHash(Node);
+	}
+
+	if (!bHasCachedLinkHash
+		|| CachedLinkHashLinkVersion != LinkVersion
+		|| CachedLinkHashCommentVersion != CommentForest.GetVersion()
+		|| CachedLinkHashNodeSet != NodeSet)
+	{
+		CachedLinkHash = CalculateLinkHash(CommentForest, InNodeTree);
+		CachedLinkHashLinkVersion = LinkVersion;
+		CachedLinkHashCommentVersion = CommentForest.GetVersion();
+		CachedLinkHashNodeSet = NodeSet;
+		bHasCachedLinkHash = true;
+	}
+
+	return HashCombine(CalculatePositionHash(InNodeTree, NodeToKeepStill), CachedLinkHash);
 }
 
 void FEdGraphFormatter::SaveFormattingEndInfo()
 {
+	BA_TRACE_SCOPE(BA_SaveFormattingEndInfo);
+
 	// Save the position so we can move relative to this the next time we format
 	LastFormattedX = NodeToKeepStill->NodePosX;
 	LastFormattedY = NodeToKeepStill->NodePosY;
@@ -2475,13 +2422,11 @@ void FEdGraphFormatter::SaveFormattingEndInfo()
 	}
 }
 
-TArray<UEdGraphNode*> FEdGraphFormatter::GetNodeTree(UEdGraphNode* InitialNode) const
+TArray<UEdGraphNode*> FEdGraphFormatter::GetNodeTree(TSharedPtr<FBAGraphHandler> GraphHandler, UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat)
 {
-	const auto& GraphHandlerCapture = GraphHandler;
-	const auto& FormatterParametersCapture = FormatterParameters;
-	const auto Filter = [&GraphHandlerCapture, &FormatterParametersCapture](const FPinLink& Link)
+	const auto Filter = [&GraphHandler, &NodesToFormat](const FPinLink& Link)
 	{
-		return GraphHandlerCapture->FilterDelegatePin(Link, FormatterParametersCapture.NodesToFormat);
+		return GraphHandler->FilterDelegatePin(Link, NodesToFormat);
 	};
 	return FBAUtils::GetNodeTreeWithFilter(InitialNode, Filter).Array();
 }
@@ -2550,9 +2495,83 @@ TSharedPtr<FEdGraphParameterFormatter> FEdGraphFormatter::GetParameterFormatter(
 	return ParameterFormatterMap[Node];
 }
 
+SIZE_T FEdGraphFormatter::GetAllocatedSize() const
+{
+	SIZE_T Size = NodePool.GetAllocatedSize()
+		+ NodeTree.GetAllocatedSize()
+		+ ParameterFormatterMap.GetAllocatedSize()
+		+ LastNodePositions.GetAllocatedSize()
+		+ NodeChangeInfos.GetAllocatedSize()
+		+ LastCommentBounds.GetAllocatedSize()
+		+ FormatXArena.GetAllocatedSize()
+		+ FormatXInfoMap.GetAllocatedSize()
+		+ Path.GetAllocatedSize()
+		+ LinkIds.GetAllocatedSize()
+		+ SameRowMapping.GetAllocatedSize()
+		+ Rows.GetAllocatedSize()
+		+ ParameterParentMap.GetAllocatedSize()
+		+ NodesToExpand.GetAllocatedSize()
+		+ NodeHeightLevels.GetAllocatedSize()
+		+ CommentHandler.GetAllocatedSize();
+
+	for (const auto& Elem : ParameterFormatterMap)
+	{
+		Size += sizeof(FEdGraphParameterFormatter) + Elem.Value->GetAllocatedSize();
+	}
+
+	if (MainParameterFormatter.IsValid())
+	{
+		Size += sizeof(FEdGraphParameterFormatter) + MainParameterFormatter->GetAllocatedSize();
+	}
+
+	for (const auto& Elem : NodeChangeInfos)
+	{
+		Size += Elem.Value.Links.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+FEdGraphFormatterResumeState FEdGraphFormatter::MakeResumeState()
+{
+	FEdGraphFormatterResumeState ResumeState;
+
+	// selective formatting filters the node tree, which the resume state doesn't keep
+	if (FormatterParameters.NodesToFormat.Num() > 0)
+	{
+		return ResumeState;
+	}
+
+	ResumeState.RootNode = RootNode;
+	ResumeState.NodeToKeepStill = NodeToKeepStill;
+	ResumeState.StructureHash = LastStructureHash;
+	for (UEdGraphNode* Node : GetFormattedNodes())
+	{
+		ResumeState.FormattedNodes.Add(Node);
+	}
+
+	ResumeState.CommentBounds = LastCommentBounds;
+	return ResumeState;
+}
+
+void FEdGraphFormatter::ReleaseFormattingData()
+{
+	// the parameter formatters are the only owners of their shared pointer back to this formatter
+	ParameterFormatterMap.Empty();
+	MainParameterFormatter.Reset();
+	ParameterParentMap.Empty();
+
+	KnotTrackCreator.Reset();
+	KnotTrackCreator.Init(nullptr, nullptr, nullptr);
+
+	CommentHandler.Reset();
+	CommentHandler.Formatter.Reset();
+	CommentHandler.GraphHandler.Reset();
+}
+
 FBAFormatterSettings FEdGraphFormatter::GetFormatterSettings()
 {
-	if (FBAFormatterSettings* FormatterSettings = FBAUtils::FindFormatterSettings(GraphHandler->GetFocusedEdGraph()))
+	if (const FBAFormatterSettings* FormatterSettings = GraphHandler->GetFormatterSettings())
 	{
 		return *FormatterSettings;
 	}
@@ -2580,14 +2599,39 @@ TSet<UEdGraphNode*> FEdGraphFormatter::GetFormattedNodes()
 
 void FEdGraphFormatter::FormatY()
 {
+	BA_TRACE_SCOPE(BA_FormatY);
+
 	NodeHeightLevels.Add(RootNode, 0);
 
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("-------Format Y-------- NO COMMENTS"));
 
 	TSet<UEdGraphNode*> NodesToCollisionCheck;
-	TSet<FPinLink> VisitedLinks;
-	TSet<UEdGraphNode*> TempChildren;
-	FormatY_Recursive(RootNode, nullptr, nullptr, NodesToCollisionCheck, VisitedLinks, true, TempChildren);
+	FPinLinkSet VisitedLinks;
+
+	// walk the tree with an explicit stack, long execution chains would overflow the call stack
+	FFormatYFrame& RootFrame = FormatYStack.Push();
+	RootFrame.Node = RootNode;
+	RootFrame.bSameRow = true;
+	FormatYEnterNode(RootFrame, NodesToCollisionCheck);
+
+	while (FormatYStack.Num() > 0)
+	{
+		FFormatYFrame& Frame = FormatYStack.Top();
+		if (FFormatYFrame* ChildFrame = FormatYNextChild(Frame, NodesToCollisionCheck, VisitedLinks))
+		{
+			FormatYEnterNode(*ChildFrame, NodesToCollisionCheck);
+			continue;
+		}
+
+		FormatYExitNode(Frame);
+
+		if (FormatYStack.Num() > 1)
+		{
+			FormatYChildFinished(FormatYStack[FormatYStack.Num() - 2], Frame);
+		}
+
+		FormatYStack.Pop();
+	}
 
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("-------Format Y-------- COMMENTS"));
 }
@@ -2683,3 +2727,100 @@ bool FEdGraphFormatter::NodeCollisionBetweenLocation(FVector2D Start, FVector2D
 	return false;
 }
 
+
+/* Only gives the comment handler the formatted nodes of a resumed formatter */
+class FBAFormattedNodeSet final
+	: public FFormatterInterface
+{
+public:
+	FBAFormattedNodeSet(UEdGraphNode* InRootNode, const TSet<UEdGraphNode*>& InFormattedNodes)
+		: RootNode(InRootNode)
+		, FormattedNodes(InFormattedNodes) { }
+
+	virtual void FormatNode(UEdGraphNode* Node) override { }
+
+	virtual TSet<UEdGraphNode*> GetFormattedNodes() override { return FormattedNodes; }
+
+	virtual UEdGraphNode* GetRootNode() override { return RootNode; }
+
+private:
+	UEdGraphNode* RootNode;
+	TSet<UEdGraphNode*> FormattedNodes;
+};
+
+FEdGraphResumedFormatter::FEdGraphResumedFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler, const FEdGraphFormatterResumeState& InResumeState)
+	: GraphHandler(InGraphHandler)
+	, ResumeState(InResumeState) { }
+
+bool FEdGraphResumedFormatter::CanResume()
+{
+	if (!ResumeState.IsValid())
+	{
+		return false;
+	}
+
+	// only compare pointers until we know the nodes are still in the tree
+	const TArray<UEdGraphNode*> NewNodeTree = FEdGraphFormatter::GetNodeTree(GraphHandler, ResumeState.RootNode.Get(), TArray<UEdGraphNode*>());
+	if (!NewNodeTree.Contains(ResumeState.NodeToKeepStill.Get()))
+	{
+		return false;
+	}
+
+	if (FEdGraphFormatter::CalculateStructureHash(GraphHandler, NewNodeTree, ResumeState.NodeToKeepStill.Get()) != ResumeState.StructureHash)
+	{
+		return false;
+	}
+
+	const TSet<UEdGraphNode*> NewNodeTreeSet(NewNodeTree);
+	FormattedNodes.Reset();
+	for (const TWeakObjectPtr<UEdGraphNode>& Node : ResumeState.FormattedNodes)
+	{
+		if (Node.IsValid() && NewNodeTreeSet.Contains(Node.Get()))
+		{
+			FormattedNodes.Add(Node);
+		}
+	}
+
+	return true;
+}
+
+void FEdGraphResumedFormatter::FormatNode(UEdGraphNode* Node)
+{
+	BA_TRACE_SCOPE(BA_ResumedFormatNode);
+
+	UEdGraphNode* NodeToKeepStill = ResumeState.NodeToKeepStill.Get();
+	if (!NodeToKeepStill)
+	{
+		return;
+	}
+
+	const FVector2D KeepStillPos(NodeToKeepStill->NodePosX, NodeToKeepStill->NodePosY);
+	for (const auto& Elem : ResumeState.CommentBounds)
+	{
+		if (UEdGraphNode_Comment* Comment = Elem.Key.Get())
+		{
+			Comment->SetBounds(Elem.Value.OffsetBy(KeepStillPos));
+		}
+	}
+}
+
+FCommentHandler* FEdGraphResumedFormatter::GetCommentHandler()
+{
+	if (!CommentHandlerFormatter.IsValid())
+	{
+		CommentHandlerFormatter = MakeShared<FBAFormattedNodeSet>(ResumeState.RootNode.Get(), FormattedNodes);
+		CommentHandler.Init(GraphHandler, CommentHandlerFormatter);
+	}
+
+	return &CommentHandler;
+}
+
+FBAFormatterSettings FEdGraphResumedFormatter::GetFormatterSettings()
+{
+	if (const FBAFormatterSettings* FormatterSettings = GraphHandler->GetFormatterSettings())
+	{
+		return *FormatterSettings;
+	}
+
+	return GetMutableDefault<UBASettings>()->BlueprintFormatterSettings;
+}
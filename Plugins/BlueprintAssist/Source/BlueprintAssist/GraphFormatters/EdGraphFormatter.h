@@ -37,23 +37,20 @@ struct FNodeChangeInfo
 	bool HasChanged(UEdGraphNode* NodeToKeepStill);
 };
 
-struct ChildBranch
+/* What the faster formatting path needs from a formatter, kept by the graph handler after the formatter is evicted (the nodes may be deleted meanwhile) */
+struct FEdGraphFormatterResumeState
 {
-	UEdGraphPin* Pin;
-	UEdGraphPin* ParentPin;
-	TSet<UEdGraphNode*> BranchNodes;
+	TWeakObjectPtr<UEdGraphNode> RootNode;
+	TWeakObjectPtr<UEdGraphNode> NodeToKeepStill;
+	uint32 StructureHash = 0;
+	TArray<TWeakObjectPtr<UEdGraphNode>> FormattedNodes;
 
-	ChildBranch(UEdGraphPin* InPin, UEdGraphPin* InParentPin, TSet<UEdGraphNode*>& InBranchNodes)
-		: Pin(InPin)
-		, ParentPin(InParentPin)
-		, BranchNodes(InBranchNodes) { }
+	/* Comment bounds relative to the node to keep still */
+	TArray<TPair<TWeakObjectPtr<UEdGraphNode_Comment>, FSlateRect>> CommentBounds;
 
-	bool operator==(const ChildBranch& Other) const
-	{
-		return FPinLink(Pin, ParentPin) == FPinLink(Other.Pin, Other.ParentPin);
-	}
+	bool IsValid() const { return RootNode.IsValid() && NodeToKeepStill.IsValid() && StructureHash != 0; }
 
-	FString ToString() const;
+	SIZE_T GetAllocatedSize() const { return FormattedNodes.GetAllocatedSize() + CommentBounds.GetAllocatedSize(); }
 };
 
 class FEdGraphFormatter final
@@ -66,6 +63,9 @@ class FEdGraphFormatter final
 	FKnotTrackCreator KnotTrackCreator;
 	FCommentHandler CommentHandler;
 
+	/* Resolved at the start of each format so the passes don't query the settings object per node */
+	FBASettingsSnapshot Settings;
+
 public:
 	FEdGraphFormatter(
 		TSharedPtr<FBAGraphHandler> InGraphHandler,
@@ -89,10 +89,31 @@ public:
 
 	const FEdGraphFormatterParameters& GetFormatterParameters() const { return FormatterParameters; }
 
+	const FBASettingsSnapshot& GetSettings() const { return Settings; }
+
 	TSharedPtr<FEdGraphParameterFormatter> GetParameterFormatter(UEdGraphNode* Node);
 
 	virtual FBAFormatterSettings GetFormatterSettings() override;
 
+	/* Heap memory held by the formatter, its parameter formatters and comment handler */
+	SIZE_T GetAllocatedSize() const;
+
+	FEdGraphFormatterResumeState MakeResumeState();
+
+	/* Breaks the shared pointer cycles through the parameter formatters, knot track creator and comment handler so the formatter can be freed */
+	void ReleaseFormattingData();
+
+	static TArray<UEdGraphNode*> GetNodeTree(TSharedPtr<FBAGraphHandler> GraphHandler, UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat);
+
+	/* Covers the node set, links, positions relative to the node to keep still and comment membership */
+	static uint32 CalculateStructureHash(TSharedPtr<FBAGraphHandler> GraphHandler, const TArray<UEdGraphNode*>& InNodeTree, UEdGraphNode* NodeToKeepStill);
+
+	/* The node set and positions relative to the node to keep still */
+	static uint32 CalculatePositionHash(const TArray<UEdGraphNode*>& InNodeTree, UEdGraphNode* NodeToKeepStill);
+
+	/* The links and comment membership of the nodes, the comment forest must be up to date */
+	static uint32 CalculateLinkHash(const FBACommentForest& CommentForest, const TArray<UEdGraphNode*>& InNodeTree);
+
 private:
 	FVector2D PinPadding;
 	FVector2D NodePadding;
@@ -114,20 +135,44 @@ private:
 
 	TMap<UEdGraphNode*, FNodeChangeInfo> NodeChangeInfos;
 
-	TMap<UEdGraphNode*, TSharedPtr<FFormatXInfo>> FormatXInfoMap;
+	uint32 LastStructureHash = 0;
+
+	/* The link hash is only recalculated when the links, the comments or the node set changed since it was cached */
+	uint32 CachedLinkHash = 0;
+	uint32 CachedLinkHashLinkVersion = 0;
+	uint32 CachedLinkHashCommentVersion = 0;
+	uint32 CachedLinkHashNodeSet = 0;
+	bool bHasCachedLinkHash = false;
+
+	uint32 GetStructureHash(const TArray<UEdGraphNode*>& InNodeTree);
+
+	/* Comment bounds relative to NodeToKeepStill after the last format */
+	TArray<TPair<TWeakObjectPtr<UEdGraphNode_Comment>, FSlateRect>> LastCommentBounds;
+
+	TFormatterArena<FFormatXInfo> FormatXArena;
+
+	TMap<UEdGraphNode*, FFormatXInfo*> FormatXInfoMap;
 
 	TArray<FPinLink> Path;
 
 	TSharedPtr<FEdGraphParameterFormatter> MainParameterFormatter;
 
-	TMap<FPinLink, bool> SameRowMapping;
+	FPinLinkIds LinkIds;
+
+	FPinLinkSet SameRowMapping;
+
+	FNodeRowSets Rows;
 
 	TMap<UEdGraphNode*, TSharedPtr<FEdGraphParameterFormatter>> ParameterParentMap;
 
-	TArray<TSharedPtr<FFormatXInfo>> NodesToExpand;
+	TArray<FFormatXInfo*> NodesToExpand;
 
 	TMap<UEdGraphNode*, int> NodeHeightLevels;
 
+	/* Scratch stacks reused by every format, see FormatY, GetPinsOfSameHeight and ExpandComments */
+	TFormatterStack<FFormatYFrame> FormatYStack;
+	TFormatterStack<FCommentExpandFrame> CommentExpandStack;
+
 	void ExpandPendingNodes(bool bUseParameter);
 
 	void SimpleRelativeFormatting();
@@ -136,8 +181,6 @@ private:
 
 	void SaveFormattingEndInfo();
 
-	TArray<UEdGraphNode*> GetNodeTree(UEdGraphNode* InitialNode) const;
-
 	bool IsInitialNodeValid(UEdGraphNode* Node) const;
 
 	void InitNodePool();
@@ -148,17 +191,17 @@ private:
 
 	void FormatX(bool bUseParameter);
 
-	void FormatY_Recursive(
-		UEdGraphNode* CurrentNode,
-		UEdGraphPin* CurrentPin,
-		UEdGraphPin* ParentPin,
-		TSet<UEdGraphNode*>& NodesToCollisionCheck,
-		TSet<FPinLink>& VisitedLinks,
-		bool bSameRow,
-		TSet<UEdGraphNode*>& Children);
-
 	void FormatY();
 
+	void FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck);
+
+	/* Push the next child of the frame onto FormatYStack, returns null once all children are formatted */
+	FFormatYFrame* FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck, FPinLinkSet& VisitedLinks);
+
+	void FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame);
+
+	void FormatYExitNode(FFormatYFrame& Frame);
+
 	void CenterBranches(UEdGraphNode* CurrentNode, TArray<ChildBranch>& ChildBranches, TSet<UEdGraphNode*>& NodesToCollisionCheck);
 
 	bool AnyCollisionBetweenPins(UEdGraphPin* Pin, UEdGraphPin* OtherPin);
@@ -176,28 +219,21 @@ private:
 	void ModifyCommentNodes();
 
 	void GetPinsOfSameHeight();
-	void GetPinsOfSameHeight_Recursive(
-		UEdGraphNode* CurrentNode,
-		UEdGraphPin* CurrentPin,
-		UEdGraphPin* ParentPin,
-		TSet<UEdGraphNode*>& NodesToCollisionCheck,
-		TSet<FPinLink>& VisitedLinks);
 
 	UEdGraphNode* GetHighestLevelParentNode(UEdGraphNode* Node);
 
 	void WrapNodes();
 
 	void ExpandCommentsY();
-	void ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes);
+	void ExpandCommentNodeSetY(FCommentExpandFrame& Frame);
 
 	void ExpandCommentsX();
-	void ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes);
+	void ExpandCommentNodeSetX(FCommentExpandFrame& Frame);
 
 	void StraightenRow(UEdGraphNode* Node);
 	void StraightenRowWithFilter(UEdGraphNode* Node, TFunctionRef<bool(const FPinLink&)> Pred);
 
 	bool IsSameRow(const FPinLink& PinLink);
-	bool IsSameRow(UEdGraphNode* NodeA, UEdGraphNode* NodeB);
 
 	TArray<UEdGraphNode*> GetNodesInRow(UEdGraphNode* Node);
 
@@ -205,7 +241,7 @@ private:
 
 	TSharedPtr<FEdGraphParameterFormatter> GetParameterParent(UEdGraphNode* Node);
 
-	TSharedPtr<FFormatXInfo> GetFormatXInfo(UEdGraphNode* Node);
+	FFormatXInfo* GetFormatXInfo(UEdGraphNode* Node);
 
 	TArray<UEdGraphNode*> GetCommentNodeSet(UEdGraphNode_Comment* Comment, const TArray<UEdGraphNode*>& NodeSet);
 
@@ -228,3 +264,38 @@ protected:
 	friend struct FNodeInfo;
 	friend struct FKnotNodeTrack;
 };
+
+/**
+ * Stands in for an evicted FEdGraphFormatter while its node tree is unchanged.
+ * Every node is still where it was formatted, so FormatNode only restores the comment bounds.
+ */
+class FEdGraphResumedFormatter final
+	: public FFormatterInterface
+{
+public:
+	FEdGraphResumedFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler, const FEdGraphFormatterResumeState& InResumeState);
+
+	virtual ~FEdGraphResumedFormatter() override { }
+
+	/* Whether the node tree still matches the resume state */
+	bool CanResume();
+
+	virtual void FormatNode(UEdGraphNode* Node) override;
+
+	virtual TSet<UEdGraphNode*> GetFormattedNodes() override { return FormattedNodes; }
+
+	virtual UEdGraphNode* GetRootNode() override { return ResumeState.RootNode.Get(); }
+
+	virtual FCommentHandler* GetCommentHandler() override;
+
+	virtual FBAFormatterSettings GetFormatterSettings() override;
+
+private:
+	TSharedPtr<FBAGraphHandler> GraphHandler;
+	FEdGraphFormatterResumeState ResumeState;
+	TSet<UEdGraphNode*> FormattedNodes;
+
+	/* Initialized on first use with a separate formatter for the formatted nodes, so it doesn't own a pointer back to us */
+	FCommentHandler CommentHandler;
+	TSharedPtr<FFormatterInterface> CommentHandlerFormatter;
+};
@@ -42,6 +42,8 @@ FEdGraphParameterFormatter::FEdGraphParameterFormatter(
 
 void FEdGraphParameterFormatter::FormatNode(UEdGraphNode* InNode)
 {
+	BA_TRACE_SCOPE(BA_ParameterFormatNode);
+
 	if (!FBAUtils::IsGraphNode(RootNode))
 	{
 		return;
@@ -68,39 +70,57 @@ void FEdGraphParameterFormatter::FormatNode(UEdGraphNode* InNode)
 	AllFormattedNodes = { RootNode };
 
 	NodeOffsets.Reset();
+	LinkIds.Reset();
 
 	bFormatWithHelixing = DoesHelixingApply();
 
-	FormatX();
-
-	TSet<UEdGraphNode*> SameRowVisited;
-	SameRowMapping.Reset();
-	ProcessSameRowMapping(RootNode, nullptr, nullptr, SameRowVisited);
+	const TArray<UEdGraphNode*> ClusterNodes = GetClusterNodes();
+	TArray<uint32> Signature;
+	MakeClusterSignature(ClusterNodes, Signature);
+	const uint32 SignatureHash = FCrc::MemCrc32(Signature.GetData(), Signature.Num() * Signature.GetTypeSize());
 
-	FormatX();
+	const FIntPoint RootPos(RootNode->NodePosX, RootNode->NodePosY);
 
-	// move the output nodes so they don't overlap with the helixed input nodes
-	if (bFormatWithHelixing && FormattedInputNodes.Num() > 0)
+	// the same parameter structure has been formatted before, reuse that layout
+	if (!ApplyCachedLayout(ClusterNodes, Signature, SignatureHash, RootPos))
 	{
-		const float InputNodesRight = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, FormattedInputNodes.Array()).Right;
-		const FSlateRect RootNodeBounds = FBAUtils::GetCachedNodeBounds(GraphHandler, RootNode);
-		const float Delta = InputNodesRight - RootNodeBounds.Right;
-		if (Delta > 0)
+		FormatX();
+
+		// without helixing FormatX only depends on the root position and the cluster, so a second pass gives the same result.
+		// with helixing the second pass places the nodes which were only found to be helixed input nodes during the first pass
+		if (bFormatWithHelixing)
 		{
-			for (UEdGraphNode* Node : FormattedOutputNodes)
+			FormatX();
+		}
+
+		// move the output nodes so they don't overlap with the helixed input nodes
+		if (bFormatWithHelixing && FormattedInputNodes.Num() > 0)
+		{
+			float InputNodesRight = -FLT_MAX;
+			for (UEdGraphNode* Node : FormattedInputNodes)
+			{
+				InputNodesRight = FMath::Max(InputNodesRight, FBAUtils::GetCachedNodeBounds(GraphHandler, Node).Right);
+			}
+
+			const FSlateRect RootNodeBounds = FBAUtils::GetCachedNodeBounds(GraphHandler, RootNode);
+			const float Delta = InputNodesRight - RootNodeBounds.Right;
+			if (Delta > 0)
 			{
-				Node->NodePosX += Delta;
+				for (UEdGraphNode* Node : FormattedOutputNodes)
+				{
+					Node->NodePosX += Delta;
+				}
 			}
 		}
-	}
 
-	TSet<UEdGraphNode*> TempVisited;
-	TSet<UEdGraphNode*> TempChildren;
-	FormatY(RootNode, nullptr, nullptr, TempVisited, false, TempChildren);
+		FormatY();
 
-	if (GetDefault<UBASettings>()->bExpandParametersByHeight && FBAUtils::IsNodePure(RootNode))
-	{
-		ExpandByHeight();
+		if (GraphFormatter->GetSettings().bExpandParametersByHeight && FBAUtils::IsNodePure(RootNode))
+		{
+			ExpandByHeight();
+		}
+
+		SaveLayoutToCache(ClusterNodes, Signature, SignatureHash, RootPos);
 	}
 
 	// move the nodes relative to the chosen node to keep still
@@ -121,7 +141,7 @@ void FEdGraphParameterFormatter::FormatNode(UEdGraphNode* InNode)
 
 bool FEdGraphParameterFormatter::DoesHelixingApply()
 {
-	EBAParameterFormattingStyle FormattingStyleToUse = GetDefault<UBASettings>()->ParameterStyle;
+	EBAParameterFormattingStyle FormattingStyleToUse = GraphFormatter->GetSettings().ParameterStyle;
 	if (GraphFormatter->GetFormatterParameters().OverrideFormattingStyle.IsValid())
 	{
 		FormattingStyleToUse = *GraphFormatter->GetFormatterParameters().OverrideFormattingStyle.Get();
@@ -202,7 +222,8 @@ bool FEdGraphParameterFormatter::DoesHelixingApply()
 	}
 
 	// check if any single node is extremely tall
-	if (GetDefault<UBASettings>()->bLimitHelixingHeight)
+	const FBASettingsSnapshot& Settings = GraphFormatter->GetSettings();
+	if (Settings.bLimitHelixingHeight)
 	{
 		float TotalHeight = 0;
 		for (UEdGraphNode* Node : GatheredInputNodes)
@@ -210,7 +231,7 @@ bool FEdGraphParameterFormatter::DoesHelixingApply()
 			if (Node != RootNode)
 			{
 				const float NodeHeight = FBAUtils::GetCachedNodeBounds(GraphHandler, Node).GetSize().Y;
-				if (NodeHeight > GetDefault<UBASettings>()->SingleNodeMaxHeight)
+				if (NodeHeight > Settings.SingleNodeMaxHeight)
 				{
 					return false;
 				}
@@ -220,7 +241,7 @@ bool FEdGraphParameterFormatter::DoesHelixingApply()
 		}
 
 		// helixing should not apply if the height of the stack is too large
-		if (TotalHeight > GetDefault<UBASettings>()->HelixingHeightMax)
+		if (TotalHeight > Settings.HelixingHeightMax)
 		{
 			return false;
 		}
@@ -229,85 +250,22 @@ bool FEdGraphParameterFormatter::DoesHelixingApply()
 	return true;
 }
 
-void FEdGraphParameterFormatter::ProcessSameRowMapping(UEdGraphNode* CurrentNode,
-														UEdGraphPin* CurrentPin,
-														UEdGraphPin* ParentPin,
-														TSet<UEdGraphNode*>& VisitedNodes)
-{
-	if (VisitedNodes.Contains(CurrentNode))
-	{
-		return;
-	}
-
-	const TArray<UEdGraphNode*> Children = NodeInfoMap[CurrentNode]->GetChildNodes();
-
-	VisitedNodes.Add(CurrentNode);
-
-	bool bFirstPin = true;
-
-	for (EEdGraphPinDirection Direction : { EGPD_Input, EGPD_Output })
-	{
-		for (UEdGraphPin* MyPin : FBAUtils::GetPinsByDirection(CurrentNode, Direction))
-		{
-			if (FBAUtils::IsExecPin(MyPin))
-			{
-				continue;
-			}
-
-			TArray<UEdGraphPin*> LinkedTo = MyPin->LinkedTo;
-
-			for (UEdGraphPin* OtherPin : LinkedTo)
-			{
-				UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
-
-				if (!GraphHandler->FilterSelectiveFormatting(OtherNode, GraphFormatter->GetFormatterParameters().NodesToFormat))
-				{
-					continue;
-				}
-
-				if (!Children.Contains(OtherNode))
-				{
-					continue;
-				}
-
-				if (VisitedNodes.Contains(OtherNode))
-				{
-					continue;
-				}
-
-				const bool bApplyHelixing = bFormatWithHelixing && FormattedInputNodes.Contains(OtherNode);
-
-				const bool bSameDirectionAsParent = ParentPin == nullptr || MyPin->Direction == ParentPin->Direction;
-
-				if (bFirstPin && bSameDirectionAsParent && !bApplyHelixing && CurrentNode != RootNode)
-				{
-					SameRowMapping.Add(FPinLink(MyPin, OtherPin), true);
-					SameRowMapping.Add(FPinLink(OtherPin, MyPin), true);
-					bFirstPin = false;
-				}
-
-				TSet<UEdGraphNode*> LocalChildren;
-				ProcessSameRowMapping(OtherNode, OtherPin, MyPin, VisitedNodes);
-			}
-		}
-	}
-}
-
 void FEdGraphParameterFormatter::FormatX()
 {
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("FORMATTING X for %s"), *FBAUtils::GetNodeName(RootNode));
 
 	TArray<TEnumAsByte<EEdGraphPinDirection>> InOut = { EGPD_Output, EGPD_Input };
 
-	TSet<FPinLink> VisitedLinks;
+	FPinLinkSet VisitedLinks;
 
 	TArray<UEdGraphNode*> TempOutput;
 
 	NodeInfoMap.Reset();
+	NodeInfoArena.Reset();
 
 	for (EEdGraphPinDirection InitialDirection : InOut)
 	{
-		VisitedLinks.Empty();
+		VisitedLinks.Reset();
 
 		TQueue<FPinLink> OutputQueue;
 		TQueue<FPinLink> InputQueue;
@@ -353,7 +311,7 @@ void FEdGraphParameterFormatter::FormatX()
 
 			UEdGraphNode* ParentNode = ParentPin != nullptr ? ParentPin->GetOwningNode() : nullptr;
 
-			TSharedPtr<FNodeInfo> ParentInfo;
+			FNodeInfo* ParentInfo = nullptr;
 			if (ParentPin != nullptr)
 			{
 				ParentInfo = NodeInfoMap[ParentPin->GetOwningNode()];
@@ -379,7 +337,7 @@ void FEdGraphParameterFormatter::FormatX()
 			{
 				if (ParentPin != nullptr && MyPin != nullptr)
 				{
-					TSharedPtr<FNodeInfo> CurrentInfo = NodeInfoMap[CurrentNode];
+					FNodeInfo* CurrentInfo = NodeInfoMap[CurrentNode];
 
 					if (ParentNode != CurrentInfo->GetParentNode())
 					{
@@ -422,8 +380,6 @@ void FEdGraphParameterFormatter::FormatX()
 			}
 			else
 			{
-				CurrentNode->Modify();
-
 				if (CurrentNode != RootNode)
 				{
 					if (InitialDirection == EGPD_Input && CurrentPinLink.GetDirection() == EGPD_Input && (FormattedInputNodes.Contains(ParentNode) || ParentNode == RootNode))
@@ -458,7 +414,7 @@ void FEdGraphParameterFormatter::FormatX()
 					AllFormattedNodes.Add(RootNode);
 				}
 
-				TSharedPtr<FNodeInfo> NewNodeInfo = MakeShareable(new FNodeInfo(CurrentNode, MyPin, ParentInfo, ParentPin, InitialDirection));
+				FNodeInfo* NewNodeInfo = NodeInfoArena.Add(FNodeInfo(CurrentNode, MyPin, ParentInfo, ParentPin, InitialDirection));
 				NewNodeInfo->SetParent(ParentInfo, MyPin);
 				NodeInfoMap.Add(CurrentNode, NewNodeInfo);
 
@@ -473,7 +429,7 @@ void FEdGraphParameterFormatter::FormatX()
 				//}
 			}
 
-			TSharedPtr<FNodeInfo> CurrentInfo = NodeInfoMap[CurrentNode];
+			FNodeInfo* CurrentInfo = NodeInfoMap[CurrentNode];
 
 			// if the current node is the root node, use the initial direction when getting linked nodes
 			const bool bCurrentNodeIsRootAndImpure = CurrentNode == RootNode && FBAUtils::IsNodeImpure(CurrentNode);
@@ -506,15 +462,16 @@ void FEdGraphParameterFormatter::FormatX()
 					}
 
 					FPinLink CurrentLink = FPinLink(Pin, LinkedPin);
-					if (VisitedLinks.Contains(CurrentLink))
+					const int32 CurrentLinkId = LinkIds.GetLinkId(Pin, LinkedPin);
+					if (VisitedLinks.Contains(CurrentLinkId))
 					{
 						continue;
 					}
-					VisitedLinks.Add(CurrentLink);
+					VisitedLinks.Add(CurrentLinkId);
 
 					if (NodeInfoMap.Contains(LinkedNode))
 					{
-						TSharedPtr<FNodeInfo> LinkedInfo = NodeInfoMap[LinkedNode];
+						FNodeInfo* LinkedInfo = NodeInfoMap[LinkedNode];
 						if (CurrentInfo->DetectCycle(LinkedInfo))
 						{
 							continue;
@@ -546,26 +503,46 @@ void FEdGraphParameterFormatter::FormatX()
 	}
 }
 
-void FEdGraphParameterFormatter::FormatY(
-	UEdGraphNode* CurrentNode,
-	UEdGraphPin* CurrentPin,
-	UEdGraphPin* ParentPin,
-	TSet<UEdGraphNode*>& VisitedNodes,
-	const bool bSameRow,
-	TSet<UEdGraphNode*>& OutChildren)
+void FEdGraphParameterFormatter::FormatY()
 {
-	//UE_LOG(LogBlueprintAssist, Warning, TEXT("ParameterFormatter: FormatY %s | Pin %s | Parent %s"), 
-	//	*FBAUtils::GetNodeName(CurrentNode),
-	//	*FBAUtils::GetPinName(CurrentPin),
-	//	*FBAUtils::GetPinName(ParentPin)
-	//);
+	TSet<UEdGraphNode*> VisitedNodes;
+
+	// walk the tree with an explicit stack, long parameter chains would overflow the call stack
+	FFormatYFrame& RootFrame = FormatYStack.Push();
+	RootFrame.Node = RootNode;
+	FormatYEnterNode(RootFrame, VisitedNodes);
 
-	if (VisitedNodes.Contains(CurrentNode))
+	while (FormatYStack.Num() > 0)
 	{
-		return;
+		FFormatYFrame& Frame = FormatYStack.Top();
+		if (FFormatYFrame* ChildFrame = FormatYNextChild(Frame, VisitedNodes))
+		{
+			FormatYEnterNode(*ChildFrame, VisitedNodes);
+			continue;
+		}
+
+		FormatYExitNode(Frame);
+
+		if (FormatYStack.Num() > 1)
+		{
+			FormatYChildFinished(FormatYStack[FormatYStack.Num() - 2], Frame);
+		}
+
+		FormatYStack.Pop();
 	}
+}
+
+void FEdGraphParameterFormatter::FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& VisitedNodes)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+
+	//UE_LOG(LogBlueprintAssist, Warning, TEXT("ParameterFormatter: FormatY %s | Pin %s | Parent %s"), 
+	//	*FBAUtils::GetNodeName(CurrentNode),
+	//	*FBAUtils::GetPinName(Frame.Pin),
+	//	*FBAUtils::GetPinName(Frame.ParentPin)
+	//);
 
-	const TArray<UEdGraphNode*> Children = NodeInfoMap[CurrentNode]->GetChildNodes();
+	Frame.ChildNodes = NodeInfoMap[CurrentNode]->GetChildNodes();
 
 	// solve collisions against visited nodes
 	for (int i = 0; i < 100; ++i)
@@ -622,118 +599,158 @@ void FEdGraphParameterFormatter::FormatY(
 	}
 
 	VisitedNodes.Add(CurrentNode);
+}
 
-	bool bFirstPin = true;
+FFormatYFrame* FEdGraphParameterFormatter::FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& VisitedNodes)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* ParentPin = Frame.ParentPin;
 
-	bool bCenteredParent = false;
+	while (true)
+	{
+		if (Frame.PinIndex >= Frame.Pins.Num())
+		{
+			const bool bInputDirection = Frame.DirectionIndex == 0;
+			if (bInputDirection && bCenterBranches && Frame.ChildBranches.Num() >= NumRequiredBranches && FBAUtils::IsNodePure(CurrentNode))
+			{
+				// check if there are any child nodes to the right of us
+				bool bChildrenTooBig = false;
+				for (const ChildBranch& Branch : Frame.ChildBranches)
+				{
+					for (UEdGraphNode* Child : Branch.BranchNodes)
+					{
+						if (CurrentNode->NodePosX < FBAUtils::GetCachedNodeBounds(GraphHandler, Child).Right)
+						{
+							bChildrenTooBig = true;
+							break;
+						}
+					}
+				}
 
-	const EEdGraphPinDirection ParentDirection = ParentPin == nullptr ? EGPD_Output : ParentPin->Direction.GetValue();
+				if (!bChildrenTooBig)
+				{
+					CenterBranches(CurrentNode, Frame.ChildBranches, VisitedNodes);
+				}
+			}
 
-	for (EEdGraphPinDirection Direction : { EGPD_Input, EGPD_Output })
-	{
-		UEdGraphPin* LastLinked = nullptr;
+			Frame.DirectionIndex += 1;
+			if (Frame.DirectionIndex >= 2)
+			{
+				return nullptr;
+			}
 
-		TArray<ChildBranch> ChildBranches;
+			Frame.Pins = FBAUtils::GetPinsByDirection(CurrentNode, Frame.DirectionIndex == 0 ? EGPD_Input : EGPD_Output);
+			Frame.PinIndex = 0;
+			Frame.LinkIndex = INDEX_NONE;
+			Frame.LastLinked = nullptr;
+			Frame.ChildBranches.Reset();
+			continue;
+		}
 
-		for (UEdGraphPin* MyPin : FBAUtils::GetPinsByDirection(CurrentNode, Direction))
+		UEdGraphPin* MyPin = Frame.Pins[Frame.PinIndex];
+		if (Frame.LinkIndex == INDEX_NONE)
 		{
 			if (FBAUtils::IsExecPin(MyPin))
 			{
-				LastLinked = MyPin;
+				Frame.LastLinked = MyPin;
+				Frame.PinIndex += 1;
 				continue;
 			}
 
-			TArray<UEdGraphPin*> LinkedTo = MyPin->LinkedTo;
+			Frame.LinkedPins = MyPin->LinkedTo;
+			Frame.LinkIndex = 0;
+		}
 
-			for (UEdGraphPin* OtherPin : LinkedTo)
+		if (Frame.LinkIndex >= Frame.LinkedPins.Num())
+		{
+			if (Frame.LinkedPins.Num() > 0)
 			{
-				UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
+				Frame.LastLinked = MyPin;
+			}
 
-				if (IgnoredNodes.Contains(OtherNode) ||
-					!GraphHandler->FilterSelectiveFormatting(OtherNode, GraphFormatter->GetFormatterParameters().NodesToFormat) ||
-					!Children.Contains(OtherNode) ||
-					VisitedNodes.Contains(OtherNode))
-				{
-					continue;
-				}
+			Frame.PinIndex += 1;
+			Frame.LinkIndex = INDEX_NONE;
+			continue;
+		}
 
-				// if we applied helixing, then do not format any input nodes
-				const bool bApplyHelixing = bFormatWithHelixing && FormattedInputNodes.Contains(OtherNode);
-				if (bApplyHelixing)
-				{
-					OtherNode->NodePosY = FBAUtils::GetCachedNodeBounds(GraphHandler, MyPin->GetOwningNode()).Bottom + Padding.Y;
-				}
-				else
-				{
-					FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
-				}
+		UEdGraphPin* OtherPin = Frame.LinkedPins[Frame.LinkIndex++];
+		UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
 
-				const bool bSameDirectionAsParent = ParentPin == nullptr || MyPin->Direction == ParentPin->Direction;
+		if (IgnoredNodes.Contains(OtherNode) ||
+			!GraphHandler->FilterSelectiveFormatting(OtherNode, GraphFormatter->GetFormatterParameters().NodesToFormat) ||
+			!Frame.ChildNodes.Contains(OtherNode) ||
+			VisitedNodes.Contains(OtherNode))
+		{
+			continue;
+		}
 
-				bool bChildIsSameRow = false;
+		// if we applied helixing, then do not format any input nodes
+		const bool bApplyHelixing = bFormatWithHelixing && FormattedInputNodes.Contains(OtherNode);
+		if (bApplyHelixing)
+		{
+			OtherNode->NodePosY = FBAUtils::GetCachedNodeBounds(GraphHandler, MyPin->GetOwningNode()).Bottom + Padding.Y;
+		}
+		else
+		{
+			FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
+		}
 
-				if (bFirstPin && bSameDirectionAsParent && !bApplyHelixing && CurrentNode != RootNode)
-				{
-					bChildIsSameRow = true;
-					bFirstPin = false;
-				}
+		const bool bSameDirectionAsParent = ParentPin == nullptr || MyPin->Direction == ParentPin->Direction;
 
-				TSet<UEdGraphNode*> LocalChildren;
-				FormatY(OtherNode, OtherPin, MyPin, VisitedNodes, bChildIsSameRow, LocalChildren);
-				OutChildren.Append(LocalChildren);
+		bool bChildIsSameRow = false;
 
-				ChildBranches.Add(ChildBranch(OtherPin, MyPin, LocalChildren));
+		if (Frame.bFirstPin && bSameDirectionAsParent && !bApplyHelixing && CurrentNode != RootNode)
+		{
+			bChildIsSameRow = true;
+			Frame.bFirstPin = false;
+		}
 
-				// TODO: Fix issue with this. Output nodes should not be moved here, they should be processed later - see BABadCases
-				if (!(bFormatWithHelixing && Direction == EGPD_Input) && LocalChildren.Num() > 0 && LastLinked != nullptr)
-				{
-					UEdGraphPin* PinToAvoid = LastLinked;
-					const FSlateRect Bounds = GraphFormatter->GetNodeArrayBounds(LocalChildren.Array(), false);
+		FFormatYFrame& ChildFrame = FormatYStack.Push();
+		ChildFrame.Node = OtherNode;
+		ChildFrame.Pin = OtherPin;
+		ChildFrame.ParentPin = MyPin;
+		ChildFrame.bSameRow = bChildIsSameRow;
+		return &ChildFrame;
+	}
+}
 
-					//UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(OtherPin));
+void FEdGraphParameterFormatter::FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame)
+{
+	const EEdGraphPinDirection Direction = Frame.DirectionIndex == 0 ? EGPD_Input : EGPD_Output;
+	TSet<UEdGraphNode*>& LocalChildren = ChildFrame.Children;
 
-					const float PinPos = GraphHandler->GetPinY(PinToAvoid) + GetDefault<UBASettings>()->ParameterVerticalPinSpacing;
-					const float Delta = PinPos - Bounds.Top;
-					if (Delta > 0)
-					{
-						for (UEdGraphNode* Child : LocalChildren)
-						{
-							// UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved child %s by %f (Pin %f (%s) | %f)"), *FBAUtils::GetNodeName(Child), Delta, PinPos, *FBAUtils::GetPinName(PinToAvoid), Bounds.Top);
-							Child->NodePosY += Delta;
-						}
-					}
-				}
-			}
+	Frame.Children.Append(LocalChildren);
 
-			if (LinkedTo.Num() > 0)
-			{
-				LastLinked = MyPin;
-			}
-		}
+	Frame.ChildBranches.Add(ChildBranch(ChildFrame.Pin, ChildFrame.ParentPin, LocalChildren));
 
-		// check if there are any child nodes to the right of us
-		TArray<UEdGraphNode*> AllChildren;
-		for (auto Branch : ChildBranches)
-		{
-			AllChildren.Append(Branch.BranchNodes.Array());
-		}
-		FSlateRect ChildBounds = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, AllChildren);
-		const bool bChildrenTooBig = CurrentNode->NodePosX < ChildBounds.Right;
+	// TODO: Fix issue with this. Output nodes should not be moved here, they should be processed later - see BABadCases
+	if (!(bFormatWithHelixing && Direction == EGPD_Input) && LocalChildren.Num() > 0 && Frame.LastLinked != nullptr)
+	{
+		UEdGraphPin* PinToAvoid = Frame.LastLinked;
+		const FSlateRect Bounds = GraphFormatter->GetNodeArrayBounds(LocalChildren.Array(), false);
+
+		//UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(ChildFrame.Pin));
 
-		if (bCenterBranches && Direction == EGPD_Input && ChildBranches.Num() >= NumRequiredBranches && !bChildrenTooBig)
+		const float PinPos = GraphHandler->GetPinY(PinToAvoid) + GraphFormatter->GetSettings().ParameterVerticalPinSpacing;
+		const float Delta = PinPos - Bounds.Top;
+		if (Delta > 0)
 		{
-			if (FBAUtils::IsNodePure(CurrentNode))
+			for (UEdGraphNode* Child : LocalChildren)
 			{
-				CenterBranches(CurrentNode, ChildBranches, VisitedNodes);
+				// UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved child %s by %f (Pin %f (%s) | %f)"), *FBAUtils::GetNodeName(Child), Delta, PinPos, *FBAUtils::GetPinName(PinToAvoid), Bounds.Top);
+				Child->NodePosY += Delta;
 			}
 		}
 	}
+}
 
-	OutChildren.Add(CurrentNode);
+void FEdGraphParameterFormatter::FormatYExitNode(FFormatYFrame& Frame)
+{
+	Frame.Children.Add(Frame.Node);
 
-	if (bSameRow && ParentPin)
+	if (Frame.bSameRow && Frame.ParentPin)
 	{
-		FBAUtils::StraightenPin(GraphHandler, CurrentPin, ParentPin);
+		FBAUtils::StraightenPin(GraphHandler, Frame.Pin, Frame.ParentPin);
 	}
 }
 
@@ -835,13 +852,26 @@ TSet<UEdGraphNode*> FEdGraphParameterFormatter::GetFormattedNodes()
 	return AllFormattedNodes;
 }
 
+SIZE_T FEdGraphParameterFormatter::GetAllocatedSize() const
+{
+	return IgnoredNodes.GetAllocatedSize()
+		+ FormattedInputNodes.GetAllocatedSize()
+		+ FormattedOutputNodes.GetAllocatedSize()
+		+ AllFormattedNodes.GetAllocatedSize()
+		+ NodeInfoArena.GetAllocatedSize()
+		+ NodeInfoMap.GetAllocatedSize()
+		+ LinkIds.GetAllocatedSize()
+		+ NodeOffsets.GetAllocatedSize()
+		+ LastLayout.GetAllocatedSize();
+}
+
 void FEdGraphParameterFormatter::DebugPrintFormatted()
 {
 	UE_LOG(LogBlueprintAssist, Warning, TEXT("Node Info Map: "));
 	for (auto& Elem : NodeInfoMap)
 	{
 		UEdGraphNode* Node = Elem.Key;
-		TSharedPtr<FNodeInfo> Info = Elem.Value;
+		FNodeInfo* Info = Elem.Value;
 
 		UE_LOG(LogBlueprintAssist, Warning, TEXT("\tNode %s | Parent %s"), *FBAUtils::GetNodeName(Node), *FBAUtils::GetNodeName(Info->GetParentNode()));
 
@@ -1033,3 +1063,196 @@ void FEdGraphParameterFormatter::CenterBranches(UEdGraphNode* CurrentNode, const
 		}
 	}
 }
+
+TArray<UEdGraphNode*> FEdGraphParameterFormatter::GetClusterNodes() const
+{
+	const auto AllowedPins = [](UEdGraphPin* Pin)
+	{
+		return FBAUtils::IsParameterPin(Pin) || FBAUtils::IsDelegatePin(Pin);
+	};
+
+	// uses the same rules as FormatX, nodes are visited in pin order so the cluster order is stable
+	TArray<UEdGraphNode*> ClusterNodes = { RootNode };
+	TSet<UEdGraphNode*> VisitedNodes = { RootNode };
+
+	for (int i = 0; i < ClusterNodes.Num(); ++i)
+	{
+		for (UEdGraphPin* Pin : ClusterNodes[i]->Pins)
+		{
+			if (!AllowedPins(Pin))
+			{
+				continue;
+			}
+
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin->GetOwningNodeUnchecked();
+
+				if (VisitedNodes.Contains(LinkedNode) || IgnoredNodes.Contains(LinkedNode))
+				{
+					continue;
+				}
+
+				if (FBAUtils::IsNodeImpure(LinkedNode) || FBAUtils::IsKnotNode(LinkedNode))
+				{
+					continue;
+				}
+
+				if (!GraphHandler->FilterSelectiveFormatting(LinkedNode, GraphFormatter->GetFormatterParameters().NodesToFormat))
+				{
+					continue;
+				}
+
+				VisitedNodes.Add(LinkedNode);
+				ClusterNodes.Add(LinkedNode);
+			}
+		}
+	}
+
+	return ClusterNodes;
+}
+
+void FEdGraphParameterFormatter::MakeClusterSignature(const TArray<UEdGraphNode*>& ClusterNodes, TArray<uint32>& OutSignature) const
+{
+	const FBASettingsSnapshot& BASettings = GraphFormatter->GetSettings();
+
+	// settings which change the layout
+	OutSignature.Add(bFormatWithHelixing);
+	OutSignature.Add(bCenterBranches);
+	OutSignature.Add(static_cast<uint32>(NumRequiredBranches));
+	OutSignature.Add(GetTypeHash(Padding));
+	OutSignature.Add(GetTypeHash(BASettings.ParameterVerticalPinSpacing));
+	OutSignature.Add(BASettings.bExpandParametersByHeight);
+
+	TMap<UEdGraphNode*, int32> ClusterIndices;
+	for (int i = 0; i < ClusterNodes.Num(); ++i)
+	{
+		ClusterIndices.Add(ClusterNodes[i], i);
+	}
+
+	for (UEdGraphNode* Node : ClusterNodes)
+	{
+		OutSignature.Add(GetTypeHash(Node->GetClass()->GetFName()));
+		OutSignature.Add(GetTypeHash(FBAUtils::GetCachedNodeBounds(GraphHandler, Node).GetSize()));
+		OutSignature.Add(static_cast<uint32>(Node->Pins.Num()));
+
+		for (UEdGraphPin* Pin : Node->Pins)
+		{
+			OutSignature.Add(HashCombine(GetTypeHash(Pin->PinType.PinCategory), static_cast<uint32>(Pin->Direction.GetValue())));
+			OutSignature.Add(GetTypeHash(GraphHandler->GetPinY(Pin) - Node->NodePosY));
+			OutSignature.Add(static_cast<uint32>(Pin->LinkedTo.Num()));
+
+			// links to nodes outside of the cluster only matter for the pin spacing
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin->GetOwningNodeUnchecked();
+				if (const int32* LinkedIndex = ClusterIndices.Find(LinkedNode))
+				{
+					OutSignature.Add(static_cast<uint32>(*LinkedIndex));
+					OutSignature.Add(static_cast<uint32>(LinkedNode->Pins.IndexOfByKey(LinkedPin)));
+				}
+				else
+				{
+					OutSignature.Add(static_cast<uint32>(INDEX_NONE));
+				}
+			}
+		}
+	}
+}
+
+bool FEdGraphParameterFormatter::ApplyCachedLayout(const TArray<UEdGraphNode*>& ClusterNodes, const TArray<uint32>& Signature, uint32 SignatureHash, const FIntPoint& RootPos)
+{
+	if (!GraphFormatter->GetSettings().bCacheParameterLayouts || ClusterNodes.Num() <= 1)
+	{
+		return false;
+	}
+
+	// the graph formatter formats each cluster twice, the second pass usually finds the same cluster
+	const FParameterLayout* Layout = &LastLayout;
+	if (LastLayoutHash != SignatureHash || LastLayout.Signature != Signature)
+	{
+		Layout = GraphHandler->GetParameterLayoutCache().Find(SignatureHash);
+	}
+
+	if (Layout == nullptr || Layout->Signature != Signature || Layout->NodeOffsets.Num() != ClusterNodes.Num())
+	{
+		return false;
+	}
+
+	for (int i = 0; i < ClusterNodes.Num(); ++i)
+	{
+		UEdGraphNode* Node = ClusterNodes[i];
+		Node->NodePosX = RootPos.X + Layout->NodeOffsets[i].X;
+		Node->NodePosY = RootPos.Y + Layout->NodeOffsets[i].Y;
+	}
+
+	AllFormattedNodes.Append(ClusterNodes);
+
+	for (int32 Index : Layout->FormattedInputIndices)
+	{
+		FormattedInputNodes.Add(ClusterNodes[Index]);
+	}
+
+	for (int32 Index : Layout->FormattedOutputIndices)
+	{
+		FormattedOutputNodes.Add(ClusterNodes[Index]);
+	}
+
+	if (Layout != &LastLayout)
+	{
+		LastLayout = *Layout;
+		LastLayoutHash = SignatureHash;
+	}
+
+	return true;
+}
+
+void FEdGraphParameterFormatter::SaveLayoutToCache(const TArray<UEdGraphNode*>& ClusterNodes, const TArray<uint32>& Signature, uint32 SignatureHash, const FIntPoint& RootPos)
+{
+	if (!GraphFormatter->GetSettings().bCacheParameterLayouts || ClusterNodes.Num() <= 1)
+	{
+		return;
+	}
+
+	// only cache the layout if FormatX formatted exactly the cluster nodes
+	if (AllFormattedNodes.Num() != ClusterNodes.Num())
+	{
+		return;
+	}
+
+	FParameterLayout Layout;
+	Layout.Signature = Signature;
+
+	for (int i = 0; i < ClusterNodes.Num(); ++i)
+	{
+		UEdGraphNode* Node = ClusterNodes[i];
+		if (!AllFormattedNodes.Contains(Node))
+		{
+			return;
+		}
+
+		Layout.NodeOffsets.Add(FIntPoint(Node->NodePosX - RootPos.X, Node->NodePosY - RootPos.Y));
+
+		if (FormattedInputNodes.Contains(Node))
+		{
+			Layout.FormattedInputIndices.Add(i);
+		}
+
+		if (FormattedOutputNodes.Contains(Node))
+		{
+			Layout.FormattedOutputIndices.Add(i);
+		}
+	}
+
+	TMap<uint32, FParameterLayout>& LayoutCache = GraphHandler->GetParameterLayoutCache();
+
+	// the cache is only a shortcut, clear it instead of growing forever
+	if (LayoutCache.Num() >= 512)
+	{
+		LayoutCache.Reset();
+	}
+
+	LastLayout = Layout;
+	LastLayoutHash = SignatureHash;
+	LayoutCache.Add(SignatureHash, MoveTemp(Layout));
+}
@@ -9,7 +9,6 @@
 #include "GraphFormatterTypes.h"
 #include "EdGraph/EdGraphNode.h"
 
-struct ChildBranch;
 class FEdGraphFormatter;
 class FBAGraphHandler;
 struct FNodeEdge;
@@ -62,10 +61,13 @@ public:
 
 	bool IsUsingHelixing() const { return bFormatWithHelixing; }
 
+	SIZE_T GetAllocatedSize() const;
+
 private:
 	bool bFormatWithHelixing;
 
-	TMap<UEdGraphNode*, TSharedPtr<FNodeInfo>> NodeInfoMap;
+	TFormatterArena<FNodeInfo> NodeInfoArena;
+	TMap<UEdGraphNode*, FNodeInfo*> NodeInfoMap;
 
 	bool DoesHelixingApply();
 
@@ -73,24 +75,28 @@ private:
 
 	FVector2D Padding;
 
-	TMap<FPinLink, bool> SameRowMapping;
+	FPinLinkIds LinkIds;
 
 	TMap<UEdGraphNode*, FVector2D> NodeOffsets;
 
-	void ProcessSameRowMapping(UEdGraphNode* CurrentNode,
-								UEdGraphPin* CurrentPin,
-								UEdGraphPin* ParentPin,
-								TSet<UEdGraphNode*>& VisitedNodes);
+	/* Layout of the last format, checked before the graph handler's layout cache */
+	FParameterLayout LastLayout;
+	uint32 LastLayoutHash = 0;
+
+	TFormatterStack<FFormatYFrame> FormatYStack;
 
 	void FormatX();
 
-	void FormatY(
-		UEdGraphNode* CurrentNode,
-		UEdGraphPin* CurrentPin,
-		UEdGraphPin* ParentPin,
-		TSet<UEdGraphNode*>& VisitedNodes,
-		bool bSameRow,
-		TSet<UEdGraphNode*>& Children);
+	void FormatY();
+
+	void FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& VisitedNodes);
+
+	/* Push the next child of the frame onto FormatYStack, returns null once all children are formatted */
+	FFormatYFrame* FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& VisitedNodes);
+
+	void FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame);
+
+	void FormatYExitNode(FFormatYFrame& Frame);
 
 	void CenterBranches(UEdGraphNode* CurrentNode, const TArray<ChildBranch>& ChildBranches, const TSet<UEdGraphNode*>& NodesToCollisionCheck);
 
@@ -104,4 +110,12 @@ private:
 	void DebugPrintFormatted();
 
 	void SimpleRelativeFormatting();
+
+	TArray<UEdGraphNode*> GetClusterNodes() const;
+
+	void MakeClusterSignature(const TArray<UEdGraphNode*>& ClusterNodes, TArray<uint32>& OutSignature) const;
+
+	bool ApplyCachedLayout(const TArray<UEdGraphNode*>& ClusterNodes, const TArray<uint32>& Signature, uint32 SignatureHash, const FIntPoint& RootPos);
+
+	void SaveLayoutToCache(const TArray<UEdGraphNode*>& ClusterNodes, const TArray<uint32>& Signature, uint32 SignatureHash, const FIntPoint& RootPos);
 };
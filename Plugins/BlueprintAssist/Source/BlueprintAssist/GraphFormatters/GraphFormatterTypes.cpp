@@ -11,32 +11,67 @@
 #include "Editor/BlueprintGraph/Classes/K2Node_Knot.h"
 #include "Runtime/SlateCore/Public/Layout/SlateRect.h"
 
+FBASettingsSnapshot::FBASettingsSnapshot(const UBASettings* BASettings, const FBAFormatterSettings& InFormatterSettings)
+	: FormatterSettings(InFormatterSettings)
+	, FormattingStyle(BASettings->FormattingStyle)
+	, ParameterStyle(BASettings->ParameterStyle)
+	, ExecutionWiringStyle(BASettings->ExecutionWiringStyle)
+	, ParameterWiringStyle(BASettings->ParameterWiringStyle)
+	, BlueprintParameterPadding(BASettings->BlueprintParameterPadding)
+	, CommentNodePadding(BASettings->CommentNodePadding)
+	, FormatAllPadding(BASettings->FormatAllPadding)
+	, BlueprintKnotTrackSpacing(BASettings->BlueprintKnotTrackSpacing)
+	, VerticalPinSpacing(BASettings->VerticalPinSpacing)
+	, ParameterVerticalPinSpacing(BASettings->ParameterVerticalPinSpacing)
+	, KnotNodeDistanceThreshold(BASettings->KnotNodeDistanceThreshold)
+	, HelixingHeightMax(BASettings->HelixingHeightMax)
+	, SingleNodeMaxHeight(BASettings->SingleNodeMaxHeight)
+	, NumRequiredBranchesForParameters(BASettings->NumRequiredBranchesForParameters)
+	, CustomDebug(BASettings->bCustomDebug)
+	, bEnableFasterFormatting(BASettings->bEnableFasterFormatting)
+	, bApplyCommentPadding(BASettings->bApplyCommentPadding)
+	, bExpandNodesAheadOfParameters(BASettings->bExpandNodesAheadOfParameters)
+	, bExpandNodesByHeight(BASettings->bExpandNodesByHeight)
+	, bExpandParametersByHeight(BASettings->bExpandParametersByHeight)
+	, bCreateKnotNodes(BASettings->bCreateKnotNodes)
+	, bSnapToGrid(BASettings->bSnapToGrid)
+	, bTreatDelegatesAsExecutionPins(BASettings->bTreatDelegatesAsExecutionPins)
+	, bCenterBranchesForParameters(BASettings->bCenterBranchesForParameters)
+	, bLimitHelixingHeight(BASettings->bLimitHelixingHeight)
+	, bCacheParameterLayouts(BASettings->bCacheParameterLayouts)
+	, bAddKnotNodesToComments(BASettings->bAddKnotNodesToComments)
+	, bUseKnotNodePool(BASettings->bUseKnotNodePool) { }
+
+FString ChildBranch::ToString() const
+{
+	return FString::Printf(TEXT("%s | %s"), *FBAUtils::GetPinName(Pin), *FBAUtils::GetPinName(ParentPin));
+}
+
 FNodeInfo::FNodeInfo(
 	UEdGraphNode* InNode,
 	UEdGraphPin* InPin,
-	TSharedPtr<FNodeInfo> InParent,
+	FNodeInfo* InParent,
 	UEdGraphPin* InParentPin,
 	const EEdGraphPinDirection InDirection)
 	: Node(InNode)
 	, Pin(InPin)
-	, Direction(InDirection)
-	, Children(TArray<TSharedPtr<FNodeInfo>>()) {}
+	, Direction(InDirection) {}
 
-void FNodeInfo::SetParent(TSharedPtr<FNodeInfo> NewParent, UEdGraphPin* MyPin)
+void FNodeInfo::SetParent(FNodeInfo* NewParent, UEdGraphPin* MyPin)
 {
 	Pin = MyPin;
 
-	if (Parent.IsValid())
+	if (FNodeInfo* OldParent = GetParent())
 	{
-		Parent->Children.Remove(SharedThis(this));
+		OldParent->Children.Remove(Index);
 	}
 
-	if (NewParent.IsValid() && NewParent != Parent)
+	if (NewParent && NewParent->Index != Parent)
 	{
-		NewParent->Children.Add(SharedThis(this));
+		NewParent->Children.Add(Index);
 	}
 
-	Parent = NewParent;
+	Parent = NewParent ? NewParent->Index : INDEX_NONE;
 }
 
 int32 FNodeInfo::GetChildX(
@@ -57,17 +92,17 @@ int32 FNodeInfo::GetChildX(
 	return FMath::RoundToInt(NewNodePos);
 }
 
-bool FNodeInfo::DetectCycle(TSharedPtr<FNodeInfo> OtherInfo)
+bool FNodeInfo::DetectCycle(FNodeInfo* OtherInfo)
 {
-	TArray<TSharedPtr<FNodeInfo>> PendingInfos;
-	PendingInfos.Add(OtherInfo);
+	TArray<int32> PendingInfos;
+	PendingInfos.Add(OtherInfo->Index);
 
 	while (PendingInfos.Num() > 0)
 	{
-		TSharedPtr<FNodeInfo> NextInfo = PendingInfos.Pop();
-		for (TSharedPtr<FNodeInfo> Child : NextInfo->Children)
+		FNodeInfo* NextInfo = GetInfo(PendingInfos.Pop());
+		for (int32 Child : NextInfo->Children)
 		{
-			if (Child == SharedThis(this))
+			if (Child == Index)
 			{
 				return true;
 			}
@@ -80,13 +115,14 @@ bool FNodeInfo::DetectCycle(TSharedPtr<FNodeInfo> OtherInfo)
 }
 
 void FNodeInfo::MoveChildren(
-	TSharedPtr<FNodeInfo> Info,
+	FNodeInfo* Info,
 	TSharedPtr<FBAGraphHandler> GraphHandler,
 	const FVector2D& Padding,
 	TSet<UEdGraphNode*>& TempVisited) const
 {
-	for (TSharedPtr<FNodeInfo> Child : Info->Children)
+	for (int32 ChildIndex : Info->Children)
 	{
+		FNodeInfo* Child = GetInfo(ChildIndex);
 		if (TempVisited.Contains(Child->Node))
 		{
 			continue;
@@ -101,7 +137,7 @@ void FNodeInfo::MoveChildren(
 
 FString FNodeInfo::ToString() const
 {
-	UEdGraphNode* ParentNode = Parent.IsValid() ? Parent->Node : nullptr;
+	UEdGraphNode* ParentNode = GetParentNode();
 
 	return FString::Printf(
 		TEXT("NodeInfo <%s> | Par <%s>"),
@@ -110,12 +146,12 @@ FString FNodeInfo::ToString() const
 	);
 }
 
-TArray<UEdGraphNode*> FNodeInfo::GetChildNodes()
+TArray<UEdGraphNode*> FNodeInfo::GetChildNodes() const
 {
 	TArray<UEdGraphNode*> ChildNodes;
-	for (TSharedPtr<FNodeInfo> Info : Children)
+	for (int32 ChildIndex : Children)
 	{
-		ChildNodes.Emplace(Info->Node);
+		ChildNodes.Emplace(GetInfo(ChildIndex)->Node);
 	}
 
 	return ChildNodes;
@@ -177,7 +213,135 @@ FString FPinLink::ToString() const
 	);
 }
 
-FFormatXInfo::FFormatXInfo(const FPinLink& InLink, TSharedPtr<FFormatXInfo> InParent)
+int32 FPinLinkIds::GetPinId(UEdGraphPin* Pin)
+{
+	if (const int32* FoundId = PinIds.Find(Pin))
+	{
+		return *FoundId;
+	}
+
+	return PinIds.Add(Pin, PinIds.Num());
+}
+
+int32 FPinLinkIds::GetLinkId(UEdGraphPin* From, UEdGraphPin* To)
+{
+	const uint64 Key = (static_cast<uint64>(GetPinId(From)) << 32) | static_cast<uint32>(GetPinId(To));
+
+	if (const int32* FoundId = LinkIds.Find(Key))
+	{
+		return *FoundId;
+	}
+
+	return LinkIds.Add(Key, LinkIds.Num());
+}
+
+void FPinLinkIds::Reset()
+{
+	PinIds.Reset();
+	LinkIds.Reset();
+}
+
+int32 FNodeRowSets::GetNodeId(UEdGraphNode* Node)
+{
+	if (const int32* FoundId = NodeIds.Find(Node))
+	{
+		return *FoundId;
+	}
+
+	const int32 NewId = Nodes.Add(Node);
+	Parents.Add(NewId);
+	Sizes.Add(1);
+	return NodeIds.Add(Node, NewId);
+}
+
+int32 FNodeRowSets::FindRoot(int32 NodeId)
+{
+	// path halving
+	while (Parents[NodeId] != NodeId)
+	{
+		Parents[NodeId] = Parents[Parents[NodeId]];
+		NodeId = Parents[NodeId];
+	}
+
+	return NodeId;
+}
+
+void FNodeRowSets::JoinRows(UEdGraphNode* NodeA, UEdGraphNode* NodeB)
+{
+	int32 RootA = FindRoot(GetNodeId(NodeA));
+	int32 RootB = FindRoot(GetNodeId(NodeB));
+	if (RootA == RootB)
+	{
+		return;
+	}
+
+	if (Sizes[RootA] < Sizes[RootB])
+	{
+		Swap(RootA, RootB);
+	}
+
+	Parents[RootB] = RootA;
+	Sizes[RootA] += Sizes[RootB];
+	RowMembers.Reset();
+}
+
+bool FNodeRowSets::IsSameRow(UEdGraphNode* NodeA, UEdGraphNode* NodeB)
+{
+	if (NodeA == NodeB)
+	{
+		return true;
+	}
+
+	const int32* IdA = NodeIds.Find(NodeA);
+	const int32* IdB = NodeIds.Find(NodeB);
+	if (!IdA || !IdB)
+	{
+		return false;
+	}
+
+	return FindRoot(*IdA) == FindRoot(*IdB);
+}
+
+TArray<UEdGraphNode*> FNodeRowSets::GetNodesInRow(UEdGraphNode* Node)
+{
+	const int32* NodeId = NodeIds.Find(Node);
+	if (!NodeId)
+	{
+		return { Node };
+	}
+
+	if (RowMembers.Num() == 0)
+	{
+		for (int32 i = 0; i < Nodes.Num(); ++i)
+		{
+			RowMembers.FindOrAdd(FindRoot(i)).Add(Nodes[i]);
+		}
+	}
+
+	return RowMembers.FindChecked(FindRoot(*NodeId));
+}
+
+void FNodeRowSets::Reset()
+{
+	NodeIds.Reset();
+	Nodes.Reset();
+	Parents.Reset();
+	Sizes.Reset();
+	RowMembers.Reset();
+}
+
+SIZE_T FNodeRowSets::GetAllocatedSize() const
+{
+	SIZE_T Size = NodeIds.GetAllocatedSize() + Nodes.GetAllocatedSize() + Parents.GetAllocatedSize() + Sizes.GetAllocatedSize() + RowMembers.GetAllocatedSize();
+	for (const auto& Elem : RowMembers)
+	{
+		Size += Elem.Value.GetAllocatedSize();
+	}
+
+	return Size;
+}
+
+FFormatXInfo::FFormatXInfo(const FPinLink& InLink, int32 InParent)
 	: Link(InLink)
 	, Parent(InParent) {}
 
@@ -186,14 +350,14 @@ UEdGraphNode* FFormatXInfo::GetNode() const
 	return Link.GetNode();
 }
 
-void FFormatXInfo::SetParent(TSharedPtr<FFormatXInfo> NewParent)
+void FFormatXInfo::SetParent(FFormatXInfo* NewParent)
 {
-	if (Parent.IsValid())
+	if (FFormatXInfo* OldParent = GetParent())
 	{
-		Parent->Children.Remove(SharedThis(this));
+		OldParent->Children.Remove(Index);
 	}
 
-	if (NewParent.IsValid())
+	if (NewParent)
 	{
 		//const FString OldParent
 		//	= Parent != nullptr
@@ -207,25 +371,34 @@ void FFormatXInfo::SetParent(TSharedPtr<FFormatXInfo> NewParent)
 		//	*FBlueprintAssistUtils::GetNodeName(NewParent->GetNode()),
 		//	*OldParent);
 
-		NewParent->Children.Add(SharedThis(this));
+		NewParent->Children.Add(Index);
 	}
 
-	Parent = NewParent;
+	Parent = NewParent ? NewParent->Index : INDEX_NONE;
 }
 
 TArray<UEdGraphNode*> FFormatXInfo::GetChildren(EEdGraphPinDirection Direction, bool bInitialDirectionOnly) const
 {
 	TArray<UEdGraphNode*> OutChildren;
 
-	const auto& FilterByDirection = [Direction](TSharedPtr<FFormatXInfo> Info)
+	const auto& FilterByDirection = [Direction](FFormatXInfo* Info)
 	{
 		return Info->Link.GetDirection() == Direction || Direction == EGPD_MAX;
 	};
-	TArray<TSharedPtr<FFormatXInfo>> PendingInfo = Children.FilterByPredicate(FilterByDirection);
+
+	TArray<FFormatXInfo*> PendingInfo;
+	for (int32 ChildIndex : Children)
+	{
+		FFormatXInfo* ChildInfo = GetInfo(ChildIndex);
+		if (FilterByDirection(ChildInfo))
+		{
+			PendingInfo.Add(ChildInfo);
+		}
+	}
 
 	while (PendingInfo.Num() > 0)
 	{
-		TSharedPtr<FFormatXInfo> CurrentInfo = PendingInfo.Pop();
+		FFormatXInfo* CurrentInfo = PendingInfo.Pop();
 		if (OutChildren.Contains(CurrentInfo->GetNode()))
 		{
 			break;
@@ -233,9 +406,13 @@ TArray<UEdGraphNode*> FFormatXInfo::GetChildren(EEdGraphPinDirection Direction,
 
 		OutChildren.Push(CurrentInfo->GetNode());
 
-		for (TSharedPtr<FFormatXInfo> Info : bInitialDirectionOnly ? CurrentInfo->Children : CurrentInfo->Children.FilterByPredicate(FilterByDirection))
+		for (int32 ChildIndex : CurrentInfo->Children)
 		{
-			PendingInfo.Push(Info);
+			FFormatXInfo* ChildInfo = GetInfo(ChildIndex);
+			if (bInitialDirectionOnly || FilterByDirection(ChildInfo))
+			{
+				PendingInfo.Push(ChildInfo);
+			}
 		}
 	}
 
@@ -245,9 +422,9 @@ TArray<UEdGraphNode*> FFormatXInfo::GetChildren(EEdGraphPinDirection Direction,
 TArray<UEdGraphNode*> FFormatXInfo::GetImmediateChildren() const
 {
 	TArray<UEdGraphNode*> OutChildren;
-	for (TSharedPtr<FFormatXInfo> Child : Children)
+	for (int32 ChildIndex : Children)
 	{
-		OutChildren.Add(Child->GetNode());
+		OutChildren.Add(GetInfo(ChildIndex)->GetNode());
 	}
 	return OutChildren;
 }
@@ -255,8 +432,9 @@ TArray<UEdGraphNode*> FFormatXInfo::GetImmediateChildren() const
 TArray<FPinLink> FFormatXInfo::GetChildrenAsLinks(EEdGraphPinDirection Direction) const
 {
 	TArray<FPinLink> OutLinks;
-	for (TSharedPtr<FFormatXInfo> Child : Children)
+	for (int32 ChildIndex : Children)
 	{
+		FFormatXInfo* Child = GetInfo(ChildIndex);
 		if (Child->Link.GetDirection() == Direction)
 		{
 			OutLinks.Add(Child->Link);
@@ -265,20 +443,20 @@ TArray<FPinLink> FFormatXInfo::GetChildrenAsLinks(EEdGraphPinDirection Direction
 	return OutLinks;
 }
 
-TSharedPtr<FFormatXInfo> FFormatXInfo::GetRootParent()
+FFormatXInfo* FFormatXInfo::GetRootParent()
 {
-	TSet<TSharedPtr<FFormatXInfo>> Visited;
-	TSharedPtr<FFormatXInfo> Next = SharedThis(this);
-	while (Next->Parent.IsValid())
+	TSet<int32> Visited;
+	FFormatXInfo* Next = this;
+	while (Next->Parent != INDEX_NONE)
 	{
-		if (Visited.Contains(Next))
+		if (Visited.Contains(Next->Index))
 		{
 			return nullptr;
 		}
-		Visited.Add(Next);
+		Visited.Add(Next->Index);
 
-		Next = Next->Parent;
+		Next = Next->GetParent();
 	}
 
 	return Next;
-}
\ No newline at end of file
+}
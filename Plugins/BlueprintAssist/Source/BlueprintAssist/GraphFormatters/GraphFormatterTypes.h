@@ -36,26 +36,313 @@ struct FEdGraphFormatterParameters
 	}
 };
 
+/**
+ * Resolved copy of the settings read while formatting, built once per operation and passed by reference
+ * so the passes don't go through GetDefault<UBASettings>() for every node
+ */
+struct FBASettingsSnapshot
+{
+	/* Formatter settings of the graph being formatted */
+	FBAFormatterSettings FormatterSettings;
+
+	EBANodeFormattingStyle FormattingStyle = EBANodeFormattingStyle::Expanded;
+	EBAParameterFormattingStyle ParameterStyle = EBAParameterFormattingStyle::Helixing;
+	EBAWiringStyle ExecutionWiringStyle = EBAWiringStyle::AlwaysMerge;
+	EBAWiringStyle ParameterWiringStyle = EBAWiringStyle::AlwaysMerge;
+
+	FVector2D BlueprintParameterPadding = FVector2D::ZeroVector;
+	FVector2D CommentNodePadding = FVector2D::ZeroVector;
+	FVector2D FormatAllPadding = FVector2D::ZeroVector;
+
+	float BlueprintKnotTrackSpacing = 0;
+	float VerticalPinSpacing = 0;
+	float ParameterVerticalPinSpacing = 0;
+	float KnotNodeDistanceThreshold = 0;
+	float HelixingHeightMax = 0;
+	float SingleNodeMaxHeight = 0;
+
+	int32 NumRequiredBranchesForParameters = 0;
+	int32 CustomDebug = 0;
+
+	bool bEnableFasterFormatting = false;
+	bool bApplyCommentPadding = false;
+	bool bExpandNodesAheadOfParameters = false;
+	bool bExpandNodesByHeight = false;
+	bool bExpandParametersByHeight = false;
+	bool bCreateKnotNodes = false;
+	bool bSnapToGrid = false;
+	bool bTreatDelegatesAsExecutionPins = false;
+	bool bCenterBranchesForParameters = false;
+	bool bLimitHelixingHeight = false;
+	bool bCacheParameterLayouts = false;
+	bool bAddKnotNodesToComments = false;
+	bool bUseKnotNodePool = true;
+
+	FBASettingsSnapshot() = default;
+
+	FBASettingsSnapshot(const UBASettings* BASettings, const FBAFormatterSettings& InFormatterSettings);
+};
+
+struct FParameterLayout
+{
+	/* Structure of the parameter cluster this layout was calculated for */
+	TArray<uint32> Signature;
+
+	/* Node positions relative to the root node (before formatting), in cluster order */
+	TArray<FIntPoint> NodeOffsets;
+
+	TArray<int32> FormattedInputIndices;
+	TArray<int32> FormattedOutputIndices;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Signature.GetAllocatedSize() + NodeOffsets.GetAllocatedSize() + FormattedInputIndices.GetAllocatedSize() + FormattedOutputIndices.GetAllocatedSize();
+	}
+};
+
+/* Position and size of a node, used to find which nodes were changed by formatting */
+struct FNodeLayoutState
+{
+	int32 NodePosX = 0;
+	int32 NodePosY = 0;
+	int32 NodeWidth = 0;
+	int32 NodeHeight = 0;
+
+	FNodeLayoutState() = default;
+
+	explicit FNodeLayoutState(const UEdGraphNode* Node)
+		: NodePosX(Node->NodePosX)
+		, NodePosY(Node->NodePosY)
+		, NodeWidth(Node->NodeWidth)
+		, NodeHeight(Node->NodeHeight) { }
+
+	void ApplyTo(UEdGraphNode* Node) const
+	{
+		Node->NodePosX = NodePosX;
+		Node->NodePosY = NodePosY;
+		Node->NodeWidth = NodeWidth;
+		Node->NodeHeight = NodeHeight;
+	}
+
+	bool operator==(const FNodeLayoutState& Other) const
+	{
+		return NodePosX == Other.NodePosX && NodePosY == Other.NodePosY && NodeWidth == Other.NodeWidth && NodeHeight == Other.NodeHeight;
+	}
+
+	bool operator!=(const FNodeLayoutState& Other) const { return !(*this == Other); }
+};
+
+/* Links of every pin on a node, used to find which nodes were relinked by formatting */
+struct FNodeLinkState
+{
+	TArray<TArray<UEdGraphPin*>> PinLinks;
+
+	FNodeLinkState() = default;
+
+	explicit FNodeLinkState(const UEdGraphNode* Node)
+	{
+		PinLinks.Reserve(Node->Pins.Num());
+		for (const UEdGraphPin* Pin : Node->Pins)
+		{
+			PinLinks.Add(Pin->LinkedTo);
+		}
+	}
+
+	/* Only writes the links of the node's own pins, the linked pins are left as they are */
+	void ApplyTo(UEdGraphNode* Node) const
+	{
+		if (Node->Pins.Num() != PinLinks.Num())
+		{
+			return;
+		}
+
+		for (int32 i = 0; i < PinLinks.Num(); ++i)
+		{
+			Node->Pins[i]->LinkedTo = PinLinks[i];
+		}
+	}
+
+	/* The order of the links is ignored, relinking a pin appends to its links */
+	bool HasSameLinks(const UEdGraphNode* Node) const
+	{
+		if (Node->Pins.Num() != PinLinks.Num())
+		{
+			return false;
+		}
+
+		for (int32 i = 0; i < PinLinks.Num(); ++i)
+		{
+			const TArray<UEdGraphPin*>& LinkedTo = Node->Pins[i]->LinkedTo;
+			if (LinkedTo.Num() != PinLinks[i].Num())
+			{
+				return false;
+			}
+
+			for (UEdGraphPin* LinkedPin : LinkedTo)
+			{
+				if (!PinLinks[i].Contains(LinkedPin))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+};
+
+/**
+ * Linear storage for the per-pass node infos of a formatter.
+ * Infos link to each other by index and are all freed together with Reset or Empty.
+ */
+template <typename InfoType>
+class TFormatterArena
+{
+public:
+	TFormatterArena() = default;
+
+	// infos keep a pointer back to their arena
+	TFormatterArena(const TFormatterArena&) = delete;
+	TFormatterArena& operator=(const TFormatterArena&) = delete;
+
+	InfoType* Add(InfoType&& Info)
+	{
+		if (NumUsedChunks == 0 || Chunks[NumUsedChunks - 1].Num() == ChunkSize)
+		{
+			if (NumUsedChunks == Chunks.Num())
+			{
+				// chunks never grow past their reserved size, so pointers to infos stay valid
+				Chunks.AddDefaulted_GetRef().Reserve(ChunkSize);
+			}
+
+			++NumUsedChunks;
+		}
+
+		Info.Index = NumInfos++;
+		Info.Arena = this;
+
+		TArray<InfoType>& Chunk = Chunks[NumUsedChunks - 1];
+		return &Chunk[Chunk.Add(MoveTemp(Info))];
+	}
+
+	InfoType* Get(int32 Index)
+	{
+		return Index == INDEX_NONE ? nullptr : &Chunks[Index / ChunkSize][Index % ChunkSize];
+	}
+
+	int32 Num() const { return NumInfos; }
+
+	/* Remove all infos but keep the memory for the next pass */
+	void Reset()
+	{
+		for (int i = 0; i < NumUsedChunks; ++i)
+		{
+			Chunks[i].Reset();
+		}
+
+		NumUsedChunks = 0;
+		NumInfos = 0;
+	}
+
+	/* Remove all infos and free the memory */
+	void Empty()
+	{
+		Chunks.Empty();
+		NumUsedChunks = 0;
+		NumInfos = 0;
+	}
+
+	/* Includes the memory kept by Reset for the next pass */
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T Size = Chunks.GetAllocatedSize();
+		for (const TArray<InfoType>& Chunk : Chunks)
+		{
+			Size += Chunk.GetAllocatedSize();
+		}
+
+		return Size;
+	}
+
+private:
+	static constexpr int32 ChunkSize = 256;
+
+	TArray<TArray<InfoType>> Chunks;
+	int32 NumUsedChunks = 0;
+	int32 NumInfos = 0;
+};
+
+/**
+ * Explicit stack for the formatter passes which walk a node tree depth first.
+ * Popped frames are kept so their containers are reused by the next push,
+ * and each frame is allocated separately so references to it stay valid while pushing.
+ */
+template <typename FrameType>
+class TFormatterStack
+{
+public:
+	TFormatterStack() = default;
+
+	TFormatterStack(const TFormatterStack&) = delete;
+	TFormatterStack& operator=(const TFormatterStack&) = delete;
+
+	FrameType& Push()
+	{
+		if (NumFrames == Frames.Num())
+		{
+			Frames.Add(MakeUnique<FrameType>());
+		}
+
+		FrameType& Frame = *Frames[NumFrames++];
+		Frame.Reset();
+		return Frame;
+	}
+
+	void Pop()
+	{
+		check(NumFrames > 0);
+		--NumFrames;
+	}
+
+	FrameType& Top() { return *Frames[NumFrames - 1]; }
+
+	FrameType& operator[](int32 Index) { return *Frames[Index]; }
+
+	int32 Num() const { return NumFrames; }
+
+	/* Free the memory of all frames */
+	void Empty()
+	{
+		Frames.Empty();
+		NumFrames = 0;
+	}
+
+private:
+	TArray<TUniquePtr<FrameType>> Frames;
+	int32 NumFrames = 0;
+};
 
 struct BLUEPRINTASSIST_API FNodeInfo
-	: public TSharedFromThis<FNodeInfo>
 {
 	UEdGraphNode* Node = nullptr;
 	UEdGraphPin* Pin = nullptr;
-	TSharedPtr<FNodeInfo> Parent = nullptr;
+	int32 Parent = INDEX_NONE;
 	EEdGraphPinDirection Direction = EGPD_MAX;
-	TArray<TSharedPtr<FNodeInfo>> Children;
+	TArray<int32, TInlineAllocator<4>> Children;
+
+	int32 Index = INDEX_NONE;
+	TFormatterArena<FNodeInfo>* Arena = nullptr;
 
 	FNodeInfo(
 		UEdGraphNode* InNode,
 		UEdGraphPin* InPin,
-		TSharedPtr<FNodeInfo> InParent,
+		FNodeInfo* InParent,
 		UEdGraphPin* InParentPin,
 		EEdGraphPinDirection InDirection);
 
 	FNodeInfo() { }
 
-	void SetParent(TSharedPtr<FNodeInfo> NewParent, UEdGraphPin* MyPin);
+	void SetParent(FNodeInfo* NewParent, UEdGraphPin* MyPin);
 
 	int32 GetChildX(
 		UEdGraphNode* Child,
@@ -63,20 +350,21 @@ struct BLUEPRINTASSIST_API FNodeInfo
 		const FVector2D& Padding,
 		EEdGraphPinDirection ChildDirection) const;
 
-	bool DetectCycle(TSharedPtr<FNodeInfo> OtherInfo);
+	bool DetectCycle(FNodeInfo* OtherInfo);
 
 	void MoveChildren(
-		TSharedPtr<FNodeInfo> Info,
+		FNodeInfo* Info,
 		TSharedPtr<FBAGraphHandler> GraphHandler,
 		const FVector2D& Padding,
 		TSet<UEdGraphNode*>& TempVisited) const;
 
-	TSharedPtr<FNodeInfo> GetParent() const { return Parent; }
-	UEdGraphNode* GetParentNode() const { return !Parent.IsValid() ? nullptr : Parent->Node; }
+	FNodeInfo* GetInfo(int32 InfoIndex) const { return Arena->Get(InfoIndex); }
+	FNodeInfo* GetParent() const { return GetInfo(Parent); }
+	UEdGraphNode* GetParentNode() const { return Parent == INDEX_NONE ? nullptr : GetParent()->Node; }
 
 	FString ToString() const;
 
-	TArray<UEdGraphNode*> GetChildNodes();
+	TArray<UEdGraphNode*> GetChildNodes() const;
 };
 
 struct BLUEPRINTASSIST_API FPinLink
@@ -158,24 +446,197 @@ struct BLUEPRINTASSIST_API FPinLink
 	FPinLink MakeOppositeLink() const { return FPinLink(To, From); }
 };
 
+struct ChildBranch
+{
+	UEdGraphPin* Pin;
+	UEdGraphPin* ParentPin;
+	TSet<UEdGraphNode*> BranchNodes;
+
+	ChildBranch(UEdGraphPin* InPin, UEdGraphPin* InParentPin, TSet<UEdGraphNode*>& InBranchNodes)
+		: Pin(InPin)
+		, ParentPin(InParentPin)
+		, BranchNodes(InBranchNodes) { }
+
+	bool operator==(const ChildBranch& Other) const
+	{
+		return FPinLink(Pin, ParentPin) == FPinLink(Other.Pin, Other.ParentPin);
+	}
+
+	FString ToString() const;
+};
+
+/* Dense per-pass ids for pin links, used instead of FPinLink as the key of hot sets and maps */
+struct BLUEPRINTASSIST_API FPinLinkIds
+{
+	int32 GetPinId(UEdGraphPin* Pin);
+
+	int32 GetLinkId(UEdGraphPin* From, UEdGraphPin* To);
+	int32 GetLinkId(const FPinLink& Link) { return GetLinkId(Link.From, Link.To); }
+
+	int32 Num() const { return LinkIds.Num(); }
+
+	void Reset();
+
+	SIZE_T GetAllocatedSize() const { return PinIds.GetAllocatedSize() + LinkIds.GetAllocatedSize(); }
+
+private:
+	TMap<UEdGraphPin*, int32> PinIds;
+	TMap<uint64, int32> LinkIds;
+};
+
+/* Flat bitset over link ids from FPinLinkIds */
+struct BLUEPRINTASSIST_API FPinLinkSet
+{
+	bool Contains(int32 LinkId) const
+	{
+		return LinkId < Bits.Num() && Bits[LinkId];
+	}
+
+	void Add(int32 LinkId)
+	{
+		if (LinkId >= Bits.Num())
+		{
+			Bits.Add(false, LinkId + 1 - Bits.Num());
+		}
+
+		Bits[LinkId] = true;
+	}
+
+	void Reset() { Bits.Reset(); }
+
+	SIZE_T GetAllocatedSize() const { return Bits.GetAllocatedSize(); }
+
+private:
+	TBitArray<> Bits;
+};
+
+/* Disjoint sets of nodes which are joined by same row links */
+struct BLUEPRINTASSIST_API FNodeRowSets
+{
+	void JoinRows(UEdGraphNode* NodeA, UEdGraphNode* NodeB);
+
+	bool IsSameRow(UEdGraphNode* NodeA, UEdGraphNode* NodeB);
+
+	TArray<UEdGraphNode*> GetNodesInRow(UEdGraphNode* Node);
+
+	void Reset();
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	int32 GetNodeId(UEdGraphNode* Node);
+	int32 FindRoot(int32 NodeId);
+
+	TMap<UEdGraphNode*, int32> NodeIds;
+	TArray<UEdGraphNode*> Nodes;
+	TArray<int32> Parents;
+	TArray<int32> Sizes;
+
+	/* Row members for each root, built on demand and cleared whenever rows are joined */
+	TMap<int32, TArray<UEdGraphNode*>> RowMembers;
+};
+
 struct BLUEPRINTASSIST_API FFormatXInfo
-	: public TSharedFromThis<FFormatXInfo>
 {
 	FPinLink Link;
-	TSharedPtr<FFormatXInfo> Parent;
-	TArray<TSharedPtr<FFormatXInfo>> Children;
+	int32 Parent = INDEX_NONE;
+	TArray<int32, TInlineAllocator<4>> Children;
+
+	int32 Index = INDEX_NONE;
+	TFormatterArena<FFormatXInfo>* Arena = nullptr;
 
-	FFormatXInfo(const FPinLink& InLink, TSharedPtr<FFormatXInfo> InParent);
+	FFormatXInfo(const FPinLink& InLink, int32 InParent);
 
 	UEdGraphNode* GetNode() const;
 
+	FFormatXInfo* GetInfo(int32 InfoIndex) const { return Arena->Get(InfoIndex); }
+	FFormatXInfo* GetParent() const { return GetInfo(Parent); }
+
 	TArray<UEdGraphNode*> GetChildren(EEdGraphPinDirection Direction = EGPD_MAX, bool bInitialDirectionOnly = true) const;
 
 	TArray<UEdGraphNode*> GetImmediateChildren() const;
 
 	TArray<FPinLink> GetChildrenAsLinks(EEdGraphPinDirection Direction = EGPD_MAX) const;
 
-	void SetParent(TSharedPtr<FFormatXInfo> NewParent);
+	void SetParent(FFormatXInfo* NewParent);
+
+	FFormatXInfo* GetRootParent();
+};
+
+/* Locals of one node while walking the FormatY tree with a TFormatterStack */
+struct FFormatYFrame
+{
+	UEdGraphNode* Node = nullptr;
+	UEdGraphPin* Pin = nullptr;
+	UEdGraphPin* ParentPin = nullptr;
+	bool bSameRow = false;
+
+	/* Nodes formatted below this node, the node itself is added when the frame is finished */
+	TSet<UEdGraphNode*> Children;
+
+	bool bFirstPin = true;
+	bool bCenteredParent = false;
+	UEdGraphPin* MainPin = nullptr;
+
+	/* Index into the directions walked by the pass, INDEX_NONE until the first direction is started */
+	int32 DirectionIndex = INDEX_NONE;
+	TArray<UEdGraphPin*> Pins;
+	int32 PinIndex = 0;
+
+	/* Copy of the links of Pins[PinIndex], LinkIndex is INDEX_NONE until the pin is started */
+	TArray<UEdGraphPin*> LinkedPins;
+	int32 LinkIndex = INDEX_NONE;
 
-	TSharedPtr<FFormatXInfo> GetRootParent();
-};
\ No newline at end of file
+	UEdGraphPin* LastLinked = nullptr;
+	UEdGraphPin* LastProcessed = nullptr;
+	int32 DeltaY = 0;
+
+	TArray<UEdGraphNode*> ChildNodes;
+	TArray<ChildBranch> ChildBranches;
+
+	void Reset()
+	{
+		Node = nullptr;
+		Pin = nullptr;
+		ParentPin = nullptr;
+		bSameRow = false;
+		Children.Reset();
+		bFirstPin = true;
+		bCenteredParent = false;
+		MainPin = nullptr;
+		DirectionIndex = INDEX_NONE;
+		Pins.Reset();
+		PinIndex = 0;
+		LinkedPins.Reset();
+		LinkIndex = INDEX_NONE;
+		LastLinked = nullptr;
+		LastProcessed = nullptr;
+		DeltaY = 0;
+		ChildNodes.Reset();
+		ChildBranches.Reset();
+	}
+};
+
+/* Node set of one comment level for ExpandCommentsX / ExpandCommentsY, nested comments are handled first */
+struct FCommentExpandFrame
+{
+	TArray<UEdGraphNode*> NodeSet;
+	TArray<UEdGraphNode_Comment*> Comments;
+	int32 NextComment = 0;
+
+	/* Comment whose node set is being expanded by the frame above this one */
+	UEdGraphNode_Comment* PendingComment = nullptr;
+
+	TSet<UEdGraphNode*> HandledNodes;
+	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>> CommentContains;
+
+	void Reset()
+	{
+		NodeSet.Reset();
+		Comments.Reset();
+		NextComment = 0;
+		PendingComment = nullptr;
+		HandledNodes.Reset();
+		CommentContains.Reset();
+	}
+};
@@ -79,11 +79,13 @@ FKnotNodeTrack::FKnotNodeTrack(
 	UEdGraphPin* InParentPin,
 	TArray<UEdGraphPin*> InLinkedTo,
 	float InTrackY,
-	bool bInIsLoopingTrack)
+	bool bInIsLoopingTrack,
+	float InTrackSpacing)
 	: GraphHandler(InGraphHandler)
 	, ParentPin(InParentPin)
 	, LinkedTo(InLinkedTo)
 	, TrackHeight(InTrackY)
+	, TrackSpacing(InTrackSpacing)
 	, PinToAlignTo(nullptr)
 	, PinAlignedX(0)
 	, bIsLoopingTrack(bInIsLoopingTrack)
@@ -110,7 +112,6 @@ UEdGraphPin* FKnotNodeTrack::GetPinToAlignTo() const
 
 FSlateRect FKnotNodeTrack::GetTrackBounds() const
 {
-	const float TrackSpacing = GetDefault<UBASettings>()->BlueprintKnotTrackSpacing;
 	const float LocalTrackY = GetTrackHeight();
 	const float LastPinX = FBAUtils::GetPinPos(GraphHandler, GetLastPin()).X;
 	const float TrackXLeft = FMath::Min(ParentPinPos.X, LastPinX) + 5;
@@ -134,7 +135,6 @@ TArray<FGraphPinHandle> FKnotNodeTrack::GetLinkedToSafe()
 
 void FKnotNodeTrack::SetTrackHeight(TSharedPtr<FFormatterInterface> Formatter)
 {
-	const float TrackSpacing = GetDefault<UBASettings>()->BlueprintKnotTrackSpacing;
 	const TArray<UEdGraphNode*>& AllNodes = Formatter->GetFormattedNodes().Array();
 
 	UEdGraphPin* LastPin = GetLastPin();
@@ -252,8 +252,6 @@ bool FKnotNodeTrack::HasPinToAlignTo() const
 
 bool FKnotNodeTrack::TryAlignTrack(TSharedPtr<FFormatterInterface> Formatter, float TrackStart, float TrackEnd, float TestHeight)
 {
-	const float TrackSpacing = GetMutableDefault<UBASettings>()->BlueprintKnotTrackSpacing;
-
 	UEdGraphPin* MyPin = ParentPin;
 	UEdGraphPin* LastPin = GetLastPin();
 
@@ -291,4 +289,153 @@ FString FKnotNodeTrack::ToString()
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void FBAKnotNodePool::RegisterKnot(UK2Node_Knot* Knot, const FGraphPinHandle& PinHandle)
+{
+	if (Knot)
+	{
+		KnotPins.Add(Knot, PinHandle);
+	}
+}
+
+void FBAKnotNodePool::ReleaseKnot(UK2Node_Knot* Knot, const TSet<FGraphPinHandle>& PreviousLinks)
+{
+	if (!Knot)
+	{
+		return;
+	}
+
+	FFreeKnot FreeKnot { Knot, PreviousLinks };
+	if (const FGraphPinHandle* PinHandle = KnotPins.Find(Knot))
+	{
+		FreeKnots.FindOrAdd(*PinHandle).Add(MoveTemp(FreeKnot));
+	}
+	else
+	{
+		UnknownFreeKnots.Add(MoveTemp(FreeKnot));
+	}
+}
+
+UK2Node_Knot* FBAKnotNodePool::AcquireKnot(const FGraphPinHandle& PinHandle, const FVector2D& Position, const TSet<FGraphPinHandle>& DesiredLinks)
+{
+	// prefer a knot which was made for the same pin, if it had the same links it doesn't change at all
+	if (TArray<FFreeKnot>* KnotsForPin = FreeKnots.Find(PinHandle))
+	{
+		if (UK2Node_Knot* Knot = PopKnot(*KnotsForPin, Position, &DesiredLinks))
+		{
+			return Knot;
+		}
+
+		if (UK2Node_Knot* Knot = PopKnot(*KnotsForPin, Position, nullptr))
+		{
+			return Knot;
+		}
+	}
+
+	if (UK2Node_Knot* Knot = PopKnot(UnknownFreeKnots, Position, nullptr))
+	{
+		return Knot;
+	}
+
+	for (auto& Elem : FreeKnots)
+	{
+		if (UK2Node_Knot* Knot = PopKnot(Elem.Value, Position, nullptr))
+		{
+			return Knot;
+		}
+	}
+
+	return nullptr;
+}
+
+TArray<UK2Node_Knot*> FBAKnotNodePool::TakeUnusedKnots()
+{
+	TArray<UK2Node_Knot*> UnusedKnots;
+
+	const auto TakeIfUnused = [this, &UnusedKnots](TArray<FFreeKnot>& Knots)
+	{
+		for (FFreeKnot& FreeKnot : Knots)
+		{
+			if (IsKnotUsable(FreeKnot.Knot) && FBAUtils::GetLinkedNodes(FreeKnot.Knot.Get()).Num() == 0)
+			{
+				KnotPins.Remove(FreeKnot.Knot);
+				UnusedKnots.Add(FreeKnot.Knot.Get());
+			}
+		}
+
+		Knots.Reset();
+	};
+
+	for (auto& Elem : FreeKnots)
+	{
+		TakeIfUnused(Elem.Value);
+	}
+
+	TakeIfUnused(UnknownFreeKnots);
+
+	FreeKnots.Reset();
+
+	// forget knots which were deleted outside of the formatter
+	for (auto It = KnotPins.CreateIterator(); It; ++It)
+	{
+		if (!IsKnotUsable(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	return UnusedKnots;
+}
+
+void FBAKnotNodePool::Reset()
+{
+	KnotPins.Reset();
+	FreeKnots.Reset();
+	UnknownFreeKnots.Reset();
+}
+
+bool FBAKnotNodePool::IsKnotUsable(const TWeakObjectPtr<UK2Node_Knot>& Knot)
+{
+	return Knot.IsValid() && !FBAUtils::IsNodeDeleted(Knot.Get());
+}
+
+UK2Node_Knot* FBAKnotNodePool::PopKnot(TArray<FFreeKnot>& Knots, const FVector2D& Position, const TSet<FGraphPinHandle>* DesiredLinks)
+{
+	int32 BestIndex = INDEX_NONE;
+	float BestDistance = MAX_flt;
+	for (int32 i = Knots.Num() - 1; i >= 0; --i)
+	{
+		if (!IsKnotUsable(Knots[i].Knot))
+		{
+			Knots.RemoveAtSwap(i);
+			continue;
+		}
+
+		if (DesiredLinks && !(Knots[i].PreviousLinks.Num() == DesiredLinks->Num() && Knots[i].PreviousLinks.Includes(*DesiredLinks)))
+		{
+			continue;
+		}
+
+		const UK2Node_Knot* Knot = Knots[i].Knot.Get();
+		const float Distance = FVector2D::DistSquared(FVector2D(Knot->NodePosX, Knot->NodePosY), Position);
+		if (Distance < BestDistance)
+		{
+			BestDistance = Distance;
+			BestIndex = i;
+		}
+	}
+
+	if (BestIndex == INDEX_NONE)
+	{
+		return nullptr;
+	}
+
+	UK2Node_Knot* Knot = Knots[BestIndex].Knot.Get();
+	Knots.RemoveAtSwap(BestIndex);
+	return Knot;
+}
@@ -59,6 +59,7 @@ struct BLUEPRINTASSIST_API FKnotNodeTrack
 
 private:
 	float TrackHeight;
+	float TrackSpacing;
 
 public:
 	float GetTrackHeight() const;
@@ -77,7 +78,8 @@ public:
 		UEdGraphPin* InParentPin,
 		TArray<UEdGraphPin*> InLinkedTo,
 		float InTrackY,
-		bool bInIsLoopingTrack);
+		bool bInIsLoopingTrack,
+		float InTrackSpacing);
 
 	UEdGraphPin* GetParentPin() const;
 
@@ -123,4 +125,37 @@ struct BLUEPRINTASSIST_API FGroupedTracks
 			bLooping |= Track->bIsLoopingTrack;
 		}
 	}
-};
\ No newline at end of file
+};
+
+/* Knot nodes kept on the graph handler between formats. Each knot stays registered to the pin it was created for,
+ * removed knots are freed with the pins they were linked to so the next format can give a knot back the same links,
+ * only creating or deleting the difference. */
+struct BLUEPRINTASSIST_API FBAKnotNodePool
+{
+	void RegisterKnot(UK2Node_Knot* Knot, const FGraphPinHandle& PinHandle);
+
+	void ReleaseKnot(UK2Node_Knot* Knot, const TSet<FGraphPinHandle>& PreviousLinks);
+
+	/* Prefers a knot which was linked to exactly the desired pins, then the nearest knot made for the pin */
+	UK2Node_Knot* AcquireKnot(const FGraphPinHandle& PinHandle, const FVector2D& Position, const TSet<FGraphPinHandle>& DesiredLinks);
+
+	/* Released knots which were not acquired again and have no links, the pool forgets them */
+	TArray<UK2Node_Knot*> TakeUnusedKnots();
+
+	void Reset();
+
+private:
+	struct FFreeKnot
+	{
+		TWeakObjectPtr<UK2Node_Knot> Knot;
+		TSet<FGraphPinHandle> PreviousLinks;
+	};
+
+	TMap<TWeakObjectPtr<UK2Node_Knot>, FGraphPinHandle> KnotPins;
+	TMap<FGraphPinHandle, TArray<FFreeKnot>> FreeKnots;
+	TArray<FFreeKnot> UnknownFreeKnots;
+
+	static bool IsKnotUsable(const TWeakObjectPtr<UK2Node_Knot>& Knot);
+
+	static UK2Node_Knot* PopKnot(TArray<FFreeKnot>& Knots, const FVector2D& Position, const TSet<FGraphPinHandle>* DesiredLinks);
+};
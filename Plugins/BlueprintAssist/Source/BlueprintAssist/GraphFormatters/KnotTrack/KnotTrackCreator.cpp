@@ -9,21 +9,30 @@
 #include "K2Node_Knot.h"
 #include "BlueprintAssist/GraphFormatters/BlueprintAssistCommentHandler.h"
 #include "BlueprintAssist/GraphFormatters/FormatterInterface.h"
+#include "BlueprintAssist/GraphFormatters/GraphFormatterTypes.h"
 #include "Kismet2/BlueprintEditorUtils.h"
 
-void FKnotTrackCreator::Init(TSharedPtr<FFormatterInterface> InFormatter, TSharedPtr<FBAGraphHandler> InGraphHandler)
+TRACE_DECLARE_INT_COUNTER(BA_KnotTracks, TEXT("BlueprintAssist/KnotTracks"));
+TRACE_DECLARE_INT_COUNTER(BA_KnotNodes, TEXT("BlueprintAssist/KnotNodes"));
+
+void FKnotTrackCreator::Init(TSharedPtr<FFormatterInterface> InFormatter, TSharedPtr<FBAGraphHandler> InGraphHandler, const FBASettingsSnapshot* InSettings)
 {
 	Formatter = InFormatter;
 	GraphHandler = InGraphHandler;
+	Settings = InSettings;
 
-	const UBASettings* BASettings = GetDefault<UBASettings>();
-	NodePadding = BASettings->BlueprintFormatterSettings.Padding;
-	PinPadding = BASettings->BlueprintParameterPadding;
-	TrackSpacing = BASettings->BlueprintKnotTrackSpacing;
+	if (Settings)
+	{
+		NodePadding = Settings->FormatterSettings.Padding;
+		PinPadding = Settings->BlueprintParameterPadding;
+		TrackSpacing = Settings->BlueprintKnotTrackSpacing;
+	}
 }
 
 void FKnotTrackCreator::FormatKnotNodes()
 {
+	BA_TRACE_SCOPE(BA_FormatKnotNodes);
+
 	//UE_LOG(LogBlueprintAssist, Warning, TEXT("### Format Knot Nodes"));
 
 	MakeKnotTrack();
@@ -36,7 +45,10 @@ void FKnotTrackCreator::FormatKnotNodes()
 
 	CreateKnotTracks();
 
-	if (GetDefault<UBASettings>()->bAddKnotNodesToComments)
+	TRACE_COUNTER_SET(BA_KnotTracks, KnotTracks.Num());
+	TRACE_COUNTER_SET(BA_KnotNodes, KnotNodesSet.Num());
+
+	if (Settings->bAddKnotNodesToComments)
 	{
 		AddKnotNodesToComments();
 	}
@@ -44,6 +56,8 @@ void FKnotTrackCreator::FormatKnotNodes()
 
 void FKnotTrackCreator::CreateKnotTracks()
 {
+	BA_TRACE_SCOPE(BA_CreateKnotTracks);
+
 	// we sort tracks by
 	// 1. exec pin track over parameter track 
 	// 2. top-most-track-height 
@@ -139,9 +153,12 @@ void FKnotTrackCreator::CreateKnotTracks()
 				if (bCreatePinAlignedKnot && NumCreations == 1) // move the parent knot to the aligned x position
 				{
 					// UE_LOG(LogBlueprintAssist, Warning, TEXT("Create pin aligned!"));
+					// the connection modifies both pins, so they must be modified with their recorded links first
+					GraphHandler->ModifyRecordedNode(ParentKnot);
 					for (const FGraphPinHandle& PinHandle : Creation->PinHandlesToConnectTo)
 					{
 						UEdGraphPin* Pin = FBAUtils::GetPinFromGraph(PinHandle, GraphHandler->GetFocusedEdGraph());
+						GraphHandler->ModifyRecordedNode(Pin->GetOwningNode());
 
 						UEdGraphPin* ParentPin = Pin->Direction == EGPD_Input
 							? ParentKnot->GetOutputPin()
@@ -168,173 +185,297 @@ void FKnotTrackCreator::CreateKnotTracks()
 	}
 
 	FBlueprintEditorUtils::MarkBlueprintAsModified(GraphHandler->GetBlueprint());
-
-	// Cleanup knot node pool
-	for (auto KnotNode : KnotNodePool)
-	{
-		if (FBAUtils::GetLinkedNodes(KnotNode).Num() == 0)
-		{
-			FBAUtils::DeleteNode(KnotNode);
-		}
-	}
-	KnotNodePool.Empty();
 }
 
 void FKnotTrackCreator::ExpandKnotTracks()
 {
+	BA_TRACE_SCOPE(BA_ExpandKnotTracks);
+
 	// UE_LOG(LogBlueprintAssist, Error, TEXT("### Expanding Knot Tracks"));
 	// for (auto Elem : KnotTracks)
 	// {
 	// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("KnotTrack %s"), *FBAUtils::GetPinName(Elem->GetParentPin()));
 	// }
 
+	// sort keys are computed once per track, reading the track bounds and pin y on every comparison was slow with many tracks
+	struct FTrackSortKey
+	{
+		TSharedPtr<FKnotNodeTrack> Track;
+		bool bIsExecPin;
+		bool bIsLoopingTrack;
+		float TrackHeight;
+		float Width;
+		float LastPinY;
+	};
+
+	TSharedPtr<FBAGraphHandler> GraphHandlerCapture = GraphHandler;
+	const auto SortTracks = [GraphHandlerCapture](TArray<TSharedPtr<FKnotNodeTrack>>& Tracks, TFunctionRef<bool(const FTrackSortKey&, const FTrackSortKey&)> Sorter)
+	{
+		TArray<FTrackSortKey> Keys;
+		Keys.Reserve(Tracks.Num());
+		for (const TSharedPtr<FKnotNodeTrack>& Track : Tracks)
+		{
+			FTrackSortKey& Key = Keys.AddDefaulted_GetRef();
+			Key.Track = Track;
+			Key.bIsExecPin = FBAUtils::IsExecPin(Track->GetLastPin());
+			Key.bIsLoopingTrack = Track->bIsLoopingTrack;
+			Key.TrackHeight = Track->GetTrackHeight();
+			Key.Width = Track->GetTrackBounds().GetSize().X;
+			Key.LastPinY = GraphHandlerCapture->GetPinY(Track->GetLastPin());
+		}
+
+		Keys.StableSort(Sorter);
+
+		for (int i = 0; i < Keys.Num(); ++i)
+		{
+			Tracks[i] = Keys[i].Track;
+		}
+	};
+
 	// sort tracks by:
 	// 1. exec over parameter
 	// 2. Highest track Y
 	// 3. Smallest track width
 	// 4. Parent pin height
-	TSharedPtr<FBAGraphHandler> GraphHandlerCapture = GraphHandler;
-	const auto& ExpandTrackSorter = [GraphHandlerCapture](const TSharedPtr<FKnotNodeTrack>& TrackA, const TSharedPtr<FKnotNodeTrack>& TrackB)
+	const auto& ExpandTrackSorter = [](const FTrackSortKey& KeyA, const FTrackSortKey& KeyB)
 	{
-		const bool bIsExecPinA = FBAUtils::IsExecPin(TrackA->GetLastPin());
-		const bool bIsExecPinB = FBAUtils::IsExecPin(TrackB->GetLastPin());
-		if (bIsExecPinA != bIsExecPinB)
+		if (KeyA.bIsExecPin != KeyB.bIsExecPin)
 		{
-			return bIsExecPinA > bIsExecPinB;
+			return KeyA.bIsExecPin > KeyB.bIsExecPin;
 		}
 
-		if (bIsExecPinA && TrackA->bIsLoopingTrack != TrackB->bIsLoopingTrack)
+		if (KeyA.bIsExecPin && KeyA.bIsLoopingTrack != KeyB.bIsLoopingTrack)
 		{
-			return TrackA->bIsLoopingTrack < TrackB->bIsLoopingTrack;
+			return KeyA.bIsLoopingTrack < KeyB.bIsLoopingTrack;
 		}
 
-		if (TrackA->GetTrackHeight() != TrackB->GetTrackHeight())
+		if (KeyA.TrackHeight != KeyB.TrackHeight)
 		{
-			return TrackA->bIsLoopingTrack
-				? TrackA->GetTrackHeight() > TrackB->GetTrackHeight()
-				: TrackA->GetTrackHeight() < TrackB->GetTrackHeight();
+			return KeyA.bIsLoopingTrack
+				? KeyA.TrackHeight > KeyB.TrackHeight
+				: KeyA.TrackHeight < KeyB.TrackHeight;
 		}
 
-		const float WidthA = TrackA->GetTrackBounds().GetSize().X;
-		const float WidthB = TrackB->GetTrackBounds().GetSize().X;
-		if (WidthA != WidthB)
+		if (KeyA.Width != KeyB.Width)
 		{
-			return TrackA->bIsLoopingTrack
-				? WidthA > WidthB
-				: WidthA < WidthB;
+			return KeyA.bIsLoopingTrack
+				? KeyA.Width > KeyB.Width
+				: KeyA.Width < KeyB.Width;
 		}
 
-		return GraphHandlerCapture->GetPinY(TrackA->GetLastPin()) < GraphHandlerCapture->GetPinY(TrackB->GetLastPin());
+		return KeyA.LastPinY < KeyB.LastPinY;
 	};
 
-	const auto& OverlappingTrackSorter = [GraphHandlerCapture](const TSharedPtr<FKnotNodeTrack>& TrackA, const TSharedPtr<FKnotNodeTrack>& TrackB)
+	const auto& OverlappingTrackSorter = [](const FTrackSortKey& KeyA, const FTrackSortKey& KeyB)
 	{
-		if (TrackA->bIsLoopingTrack != TrackB->bIsLoopingTrack)
+		if (KeyA.bIsLoopingTrack != KeyB.bIsLoopingTrack)
 		{
-			return TrackA->bIsLoopingTrack < TrackB->bIsLoopingTrack;
+			return KeyA.bIsLoopingTrack < KeyB.bIsLoopingTrack;
 		}
 
-		const bool bIsExecPinA = FBAUtils::IsExecPin(TrackA->GetLastPin());
-		const bool bIsExecPinB = FBAUtils::IsExecPin(TrackB->GetLastPin());
-		if (bIsExecPinA != bIsExecPinB)
+		if (KeyA.bIsExecPin != KeyB.bIsExecPin)
 		{
-			return bIsExecPinA > bIsExecPinB;
+			return KeyA.bIsExecPin > KeyB.bIsExecPin;
 		}
 
-		const float WidthA = TrackA->GetTrackBounds().GetSize().X;
-		const float WidthB = TrackB->GetTrackBounds().GetSize().X;
-		if (WidthA != WidthB)
+		if (KeyA.Width != KeyB.Width)
 		{
-			return TrackA->bIsLoopingTrack
-				? WidthA > WidthB
-				: WidthA < WidthB;
+			return KeyA.bIsLoopingTrack
+				? KeyA.Width > KeyB.Width
+				: KeyA.Width < KeyB.Width;
 		}
 
-		return GraphHandlerCapture->GetPinY(TrackA->GetLastPin()) < GraphHandlerCapture->GetPinY(TrackB->GetLastPin());
+		return KeyA.LastPinY < KeyB.LastPinY;
 	};
 
 	TArray<TSharedPtr<FKnotNodeTrack>> SortedTracks = KnotTracks;
-	SortedTracks.StableSort(ExpandTrackSorter);
+	SortTracks(SortedTracks, ExpandTrackSorter);
+
+	const int32 NumTracks = SortedTracks.Num();
+
+	// nodes only move vertically while expanding, so the x span of each track stays the same.
+	// the track y is cached and refreshed whenever a track height is updated or nodes are moved.
+	TArray<float> TrackLeft;
+	TArray<float> TrackRight;
+	TArray<float> TrackY;
+	TArray<bool> TrackHasPinToAlignTo;
+	TrackLeft.SetNumUninitialized(NumTracks);
+	TrackRight.SetNumUninitialized(NumTracks);
+	TrackY.SetNumUninitialized(NumTracks);
+	TrackHasPinToAlignTo.SetNumUninitialized(NumTracks);
+
+	TMap<FKnotNodeTrack*, int32> TrackIndices;
+	for (int i = 0; i < NumTracks; ++i)
+	{
+		const FSlateRect TrackBounds = SortedTracks[i]->GetTrackBounds();
+		TrackLeft[i] = TrackBounds.Left;
+		TrackRight[i] = TrackBounds.Right;
+		TrackY[i] = SortedTracks[i]->GetTrackHeight();
+		TrackHasPinToAlignTo[i] = SortedTracks[i]->HasPinToAlignTo();
+		TrackIndices.Add(SortedTracks[i].Get(), i);
+	}
 
-	TArray<TSharedPtr<FKnotNodeTrack>> PendingTracks = SortedTracks;
+	const float HalfTrackThickness = (TrackSpacing - 1) * 0.5f;
+	const auto GetCachedTrackBounds = [&](int32 Index)
+	{
+		return FSlateRect(TrackLeft[Index], TrackY[Index] - HalfTrackThickness, TrackRight[Index], TrackY[Index] + HalfTrackThickness);
+	};
+
+	// the tracks are bucketed by their y and rebucketed whenever their y changes,
+	// so finding the tracks overlapping a track block only tests the tracks in the buckets the block covers
+	const float BucketSize = FMath::Max(TrackSpacing, 1.0f);
+	const auto GetBucket = [BucketSize](float Y) { return FMath::FloorToInt(Y / BucketSize); };
+
+	TMap<int32, TArray<int32>> TracksByBucket;
+	TArray<int32> TrackBuckets;
+	TrackBuckets.SetNumUninitialized(NumTracks);
+	for (int32 i = 0; i < NumTracks; ++i)
+	{
+		TrackBuckets[i] = GetBucket(TrackY[i]);
+		TracksByBucket.FindOrAdd(TrackBuckets[i]).Add(i);
+	}
+
+	const auto SetTrackY = [&](int32 Index, float NewTrackY)
+	{
+		TrackY[Index] = NewTrackY;
+
+		const int32 NewBucket = GetBucket(NewTrackY);
+		if (NewBucket != TrackBuckets[Index])
+		{
+			TracksByBucket.FindChecked(TrackBuckets[Index]).RemoveSingleSwap(Index, false);
+			TracksByBucket.FindOrAdd(NewBucket).Add(Index);
+			TrackBuckets[Index] = NewBucket;
+		}
+	};
+
+	const auto ClearPinToAlignTo = [&](int32 Index)
+	{
+		if (TrackHasPinToAlignTo[Index])
+		{
+			SortedTracks[Index]->PinToAlignTo = nullptr;
+			TrackHasPinToAlignTo[Index] = false;
+			SetTrackY(Index, SortedTracks[Index]->GetTrackHeight());
+		}
+	};
+
+	const auto UpdateTrackHeight = [&](int32 Index, float NewTrackY)
+	{
+		SortedTracks[Index]->UpdateTrackHeight(NewTrackY);
+		SetTrackY(Index, SortedTracks[Index]->GetTrackHeight());
+	};
+
+	const TSet<UEdGraphNode*> FormattedNodes = Formatter->GetFormattedNodes();
 
 	// for (auto Track : SortedTracks)
 	// {
 	// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("Expanding tracks %s"), *Track->ToString());
 	// }
 
-	TSet<TSharedPtr<FKnotNodeTrack>> PlacedTracks;
-	while (PendingTracks.Num() > 0)
-	{
-		TSharedPtr<FKnotNodeTrack> CurrentTrack = PendingTracks[0];
-		PlacedTracks.Add(CurrentTrack);
-
-		const float TrackY = CurrentTrack->GetTrackHeight();
+	// pending tracks are the sorted tracks which haven't been placed yet
+	TBitArray<> PlacedTracks(false, NumTracks);
+	TArray<int32> PlacedTrackList;
+	TSet<UEdGraphNode*> PlacedTrackNodes;
 
-		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Process pending Track %s (%s)"), *FBAUtils::GetPinName(CurrentTrack->ParentPin), *FBAUtils::GetNodeName(CurrentTrack->ParentPin->GetOwningNode()));
+	const auto PlaceTrack = [&](int32 Index)
+	{
+		if (!PlacedTracks[Index])
+		{
+			PlacedTracks[Index] = true;
+			PlacedTrackList.Add(Index);
+			PlacedTrackNodes.Add(SortedTracks[Index]->ParentPin->GetOwningNode());
+			PlacedTrackNodes.Add(SortedTracks[Index]->GetLastPin()->GetOwningNode());
+		}
+	};
 
-		// check against all other tracks, and find ones which overlap with the current track
-		TArray<TSharedPtr<FKnotNodeTrack>> OverlappingTracks;
-		OverlappingTracks.Add(CurrentTrack);
+	const auto FindOverlappingTracks = [&](const FSlateRect& Bounds, const TBitArray<>& IgnoredTracks, TArray<int32>& OutTracks)
+	{
+		OutTracks.Reset();
 
-		float CurrentLowestTrackHeight = CurrentTrack->GetTrackHeight();
-		FSlateRect OverlappingBounds = CurrentTrack->GetTrackBounds();
-		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Current Track bounds %s"), *CurrentTrack->GetTrackBounds().ToString());
-		bool bFoundCollision = true;
-		do
+		// a track overlaps the bounds when its y is within half a track thickness of them
+		const int32 LastBucket = GetBucket(Bounds.Bottom + HalfTrackThickness);
+		for (int32 Bucket = GetBucket(Bounds.Top - HalfTrackThickness); Bucket <= LastBucket; ++Bucket)
 		{
-			bFoundCollision = false;
-			for (TSharedPtr<FKnotNodeTrack> Track : SortedTracks)
+			if (const TArray<int32>* BucketTracks = TracksByBucket.Find(Bucket))
 			{
-				if (OverlappingTracks.Contains(Track))
+				for (int32 TrackIndex : *BucketTracks)
 				{
-					continue;
+					if (!IgnoredTracks[TrackIndex] && FSlateRect::DoRectanglesIntersect(Bounds, GetCachedTrackBounds(TrackIndex)))
+					{
+						OutTracks.Add(TrackIndex);
+					}
 				}
+			}
+		}
 
-				FSlateRect TrackBounds = Track->GetTrackBounds();
+		// add them in the sorted order
+		OutTracks.Sort();
+	};
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tOverlapping Bounds %s | %s"), *OverlappingBounds.ToString(), *TrackBounds.ToString());
-				if (FSlateRect::DoRectanglesIntersect(OverlappingBounds, TrackBounds))
-				{
-					OverlappingTracks.Add(Track);
-					PlacedTracks.Add(Track);
-					bFoundCollision = true;
+	TBitArray<> TracksInBlock(false, NumTracks);
+	TArray<int32> FoundTracks;
+
+	for (int32 PendingIndex = 0; PendingIndex < NumTracks; ++PendingIndex)
+	{
+		if (PlacedTracks[PendingIndex])
+		{
+			continue;
+		}
 
-					OverlappingBounds.Top = FMath::Min(Track->GetTrackHeight(), OverlappingBounds.Top);
-					OverlappingBounds.Left = FMath::Min(TrackBounds.Left, OverlappingBounds.Left);
-					OverlappingBounds.Right = FMath::Max(TrackBounds.Right, OverlappingBounds.Right);
-					OverlappingBounds.Bottom = OverlappingBounds.Top + (OverlappingTracks.Num() * TrackSpacing);
+		const int32 CurrentIndex = PendingIndex;
 
-					if (CurrentTrack->HasPinToAlignTo())
-					{
-						CurrentTrack->PinToAlignTo = nullptr;
-					}
+		// the block grows with every track stacked into it, so keep looking for tracks overlapping the grown block until there are none
+		TArray<int32> OverlappingTracks = { CurrentIndex };
+		TracksInBlock[CurrentIndex] = true;
 
-					if (Track->HasPinToAlignTo())
-					{
-						// UE_LOG(LogBlueprintAssist, Warning, TEXT("Removed pin to align to for %s"), *Track->ToString());
-						Track->PinToAlignTo = nullptr;
-					}
+		// the block the overlapping tracks are stacked into
+		FSlateRect OverlappingBounds = GetCachedTrackBounds(CurrentIndex);
+		FindOverlappingTracks(OverlappingBounds, TracksInBlock, FoundTracks);
+		while (FoundTracks.Num() > 0)
+		{
+			for (int32 TrackIndex : FoundTracks)
+			{
+				TracksInBlock[TrackIndex] = true;
+				OverlappingTracks.Add(TrackIndex);
 
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tTrack %s colliding %s"), *FBAUtils::GetPinName(Track->ParentPin), *FBAUtils::GetPinName(CurrentTrack->ParentPin));
-				}
+				OverlappingBounds.Top = FMath::Min(TrackY[TrackIndex], OverlappingBounds.Top);
+				OverlappingBounds.Left = FMath::Min(TrackLeft[TrackIndex], OverlappingBounds.Left);
+				OverlappingBounds.Right = FMath::Max(TrackRight[TrackIndex], OverlappingBounds.Right);
 			}
+
+			OverlappingBounds.Bottom = OverlappingBounds.Top + (OverlappingTracks.Num() * TrackSpacing);
+			FindOverlappingTracks(OverlappingBounds, TracksInBlock, FoundTracks);
 		}
-		while (bFoundCollision);
+
+		for (int32 TrackIndex : OverlappingTracks)
+		{
+			PlaceTrack(TrackIndex);
+			TracksInBlock[TrackIndex] = false;
+		}
+
+		const float CurrentTrackY = TrackY[CurrentIndex];
+
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Process pending Track %s (%s)"), *FBAUtils::GetPinName(SortedTracks[CurrentIndex]->ParentPin), *FBAUtils::GetNodeName(SortedTracks[CurrentIndex]->ParentPin->GetOwningNode()));
 
 		if (OverlappingTracks.Num() == 1)
 		{
-			PendingTracks.Remove(CurrentTrack);
 			continue;
 		}
 
+		const float CurrentLowestTrackHeight = TrackY[CurrentIndex];
+
+		for (int32 TrackIndex : OverlappingTracks)
+		{
+			ClearPinToAlignTo(TrackIndex);
+		}
+
 		bool bOverlappingLoopingTrack = false;
 		TArray<TSharedPtr<FKnotNodeTrack>> ExecTracks;
 
 		// Group overlapping tracks by node (expect for exec tracks)
 		TArray<FGroupedTracks> OverlappingGroupedTracks;
-		for (TSharedPtr<FKnotNodeTrack> Track : OverlappingTracks)
+		for (int32 TrackIndex : OverlappingTracks)
 		{
+			TSharedPtr<FKnotNodeTrack> Track = SortedTracks[TrackIndex];
 			if (FBAUtils::IsExecPin(Track->ParentPin) && !Track->bIsLoopingTrack)
 			{
 				ExecTracks.Add(Track);
@@ -365,12 +506,12 @@ void FKnotTrackCreator::ExpandKnotTracks()
 			}
 		}
 
-		ExecTracks.StableSort(OverlappingTrackSorter);
+		SortTracks(ExecTracks, OverlappingTrackSorter);
 
 		for (auto& Group : OverlappingGroupedTracks)
 		{
 			Group.Init();
-			Group.Tracks.StableSort(OverlappingTrackSorter);
+			SortTracks(Group.Tracks, OverlappingTrackSorter);
 		}
 
 		const auto& GroupSorter = [](const FGroupedTracks& GroupA, const FGroupedTracks& GroupB)
@@ -388,7 +529,7 @@ void FKnotTrackCreator::ExpandKnotTracks()
 		for (auto Track : ExecTracks)
 		{
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tTrack %s"), *Track->ToString());
-			Track->UpdateTrackHeight(CurrentLowestTrackHeight + (TrackCount * TrackSpacing));
+			UpdateTrackHeight(TrackIndices[Track.Get()], CurrentLowestTrackHeight + (TrackCount * TrackSpacing));
 			TrackCount += 1;
 		}
 
@@ -398,56 +539,41 @@ void FKnotTrackCreator::ExpandKnotTracks()
 			for (TSharedPtr<FKnotNodeTrack> Track : Group.Tracks)
 			{
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tTrack %s"), *Track->ToString());
-				Track->UpdateTrackHeight(CurrentLowestTrackHeight + (TrackCount * TrackSpacing));
+				UpdateTrackHeight(TrackIndices[Track.Get()], CurrentLowestTrackHeight + (TrackCount * TrackSpacing));
 				TrackCount += 1;
 			}
 		}
 
-		for (TSharedPtr<FKnotNodeTrack> Track : PlacedTracks)
-		{
-			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tPlaced track %s"), *Track->ToString());
-			PendingTracks.Remove(Track);
-		}
-
-		TSet<UEdGraphNode*> TrackNodes = CurrentTrack->GetNodes(GraphHandler->GetFocusedEdGraph());
-
 		FSlateRect ExpandedBounds = OverlappingBounds;
 		const float Padding = bOverlappingLoopingTrack ? TrackSpacing * 2 : TrackSpacing;
 		ExpandedBounds.Bottom += Padding;
 
+		// nodes belonging to any placed track are skipped, gathered once here instead of per node
+		TSet<UEdGraphNode*> SkippedNodes = PlacedTrackNodes;
+		for (int32 PlacedIndex : PlacedTrackList)
+		{
+			if (TrackHasPinToAlignTo[PlacedIndex])
+			{
+				if (auto AlignedPin = SortedTracks[PlacedIndex]->GetPinToAlignTo())
+				{
+					SkippedNodes.Add(AlignedPin->GetOwningNode());
+				}
+			}
+		}
+
 		// find the top of the tallest node the track block is colliding with
 		bool bAnyCollision = false;
 		float CollisionTop = MAX_flt;
 
 		// collide against nodes
-		for (UEdGraphNode* Node : Formatter->GetFormattedNodes())
+		for (UEdGraphNode* Node : FormattedNodes)
 		{
 			// if (Node == CurrentTrack->LinkedTo[0]->GetOwningNode() || Node == CurrentTrack->GetLastPin()->GetOwningNode())
 			// 	continue;
 
-			bool bSkipNode = false;
-			for (TSharedPtr<FKnotNodeTrack> Track : PlacedTracks)
-			{
-				if (Node == Track->ParentPin->GetOwningNode() || Node == Track->GetLastPin()->GetOwningNode())
-				{
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("Skipping node %s"), *FBAUtils::GetNodeName(Node));
-					bSkipNode = true;
-					break;
-				}
-
-				if (auto AlignedPin = Track->GetPinToAlignTo())
-				{
-					if (Node == AlignedPin->GetOwningNode())
-					{
-						// UE_LOG(LogBlueprintAssist, Warning, TEXT("Skipping node aligned %s"), *FBAUtils::GetNodeName(Node));
-						bSkipNode = true;
-						break;
-					}
-				}
-			}
-
-			if (bSkipNode)
+			if (SkippedNodes.Contains(Node))
 			{
+				// UE_LOG(LogBlueprintAssist, Warning, TEXT("Skipping node %s"), *FBAUtils::GetNodeName(Node));
 				continue;
 			}
 
@@ -467,7 +593,7 @@ void FKnotTrackCreator::ExpandKnotTracks()
 			continue;
 		}
 
-		if (GetDefault<UBASettings>()->bCustomDebug == 200)
+		if (Settings->CustomDebug == 200)
 		{
 			continue;
 		}
@@ -477,11 +603,11 @@ void FKnotTrackCreator::ExpandKnotTracks()
 
 		// move all nodes below the track block
 		TSet<UEdGraphNode*> MovedNodes;
-		for (UEdGraphNode* Node : Formatter->GetFormattedNodes())
+		for (UEdGraphNode* Node : FormattedNodes)
 		{
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tChecking Node for collision %s | My %d | Track %f"), *FBAUtils::GetNodeName(Node), Node->NodePosY, TrackY);
 
-			if (Node->NodePosY > TrackY)
+			if (Node->NodePosY > CurrentTrackY)
 			{
 				Node->NodePosY += Delta;
 				MovedNodes.Add(Node);
@@ -490,26 +616,38 @@ void FKnotTrackCreator::ExpandKnotTracks()
 		}
 
 		// Update other tracks since their nodes may have moved
-		for (TSharedPtr<FKnotNodeTrack> Track : SortedTracks)
+		for (int32 TrackIndex = 0; TrackIndex < NumTracks; ++TrackIndex)
 		{
+			TSharedPtr<FKnotNodeTrack> Track = SortedTracks[TrackIndex];
+
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("CHECKING track %s"), *Track->ToString());
-			if (PlacedTracks.Contains(Track))
+			if (PlacedTracks[TrackIndex])
 			{
+				// aligned tracks follow their pin
+				if (TrackHasPinToAlignTo[TrackIndex])
+				{
+					SetTrackY(TrackIndex, Track->GetTrackHeight());
+				}
+
 				continue;
 			}
 
-			if (Track->HasPinToAlignTo()) // if we are aligned to a pin, update our track y when a node moves
+			if (TrackHasPinToAlignTo[TrackIndex]) // if we are aligned to a pin, update our track y when a node moves
 			{
 				if (MovedNodes.Contains(Track->GetLastPin()->GetOwningNode()) || MovedNodes.Contains(Track->ParentPin->GetOwningNode()))
 				{
 					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tMoved Aligned Track for node delta %s"), *FBAUtils::GetNodeName(Track->GetLastPin()->GetOwningNode()));
-					Track->UpdateTrackHeight(Track->GetTrackHeight() + Delta);
+					UpdateTrackHeight(TrackIndex, Track->GetTrackHeight() + Delta);
+				}
+				else
+				{
+					SetTrackY(TrackIndex, Track->GetTrackHeight());
 				}
 			}
-			else if (Track->GetTrackHeight() > TrackY)
+			else if (TrackY[TrackIndex] > CurrentTrackY)
 			{
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tMoved BELOW Track for node delta %s"), *FBAUtils::GetNodeName(Track->GetLastPin()->GetOwningNode()));
-				Track->UpdateTrackHeight(Track->GetTrackHeight() + Delta);
+				UpdateTrackHeight(TrackIndex, TrackY[TrackIndex] + Delta);
 			}
 		}
 	}
@@ -558,6 +696,18 @@ void FKnotTrackCreator::RemoveKnotNodes(const TArray<UEdGraphNode*>& NodeTree)
 		/** Delete all connections for each knot node */
 		if (UK2Node_Knot* KnotNode = Cast<UK2Node_Knot>(Node))
 		{
+			// the knot is relinked after the layout, the nodes are only modified if they end up with different links
+			TSet<FGraphPinHandle> PreviousLinks;
+			GraphHandler->RecordNodeLinks(KnotNode);
+			for (UEdGraphPin* Pin : KnotNode->Pins)
+			{
+				for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+				{
+					PreviousLinks.Add(FGraphPinHandle(LinkedPin));
+					GraphHandler->RecordNodeLinks(LinkedPin->GetOwningNode());
+				}
+			}
+
 			FBAUtils::DisconnectKnotNode(KnotNode);
 
 			for (auto Comment : CommentNodes)
@@ -568,18 +718,34 @@ void FKnotTrackCreator::RemoveKnotNodes(const TArray<UEdGraphNode*>& NodeTree)
 				}
 			}
 
-			if (GetDefault<UBASettings>()->bUseKnotNodePool)
+			if (Settings->bUseKnotNodePool)
 			{
-				KnotNodePool.Add(KnotNode);
+				GraphHandler->GetKnotNodePool().ReleaseKnot(KnotNode, PreviousLinks);
 			}
 			else
 			{
+				GraphHandler->ModifyRecordedNode(KnotNode);
 				FBAUtils::DeleteNode(KnotNode);
 			}
 		}
 	}
 }
 
+void FKnotTrackCreator::DeleteUnusedKnots()
+{
+	if (!Settings || !Settings->bUseKnotNodePool)
+	{
+		return;
+	}
+
+	for (UK2Node_Knot* KnotNode : GraphHandler->GetKnotNodePool().TakeUnusedKnots())
+	{
+		// modify the knot with its recorded links so undo restores them
+		GraphHandler->ModifyRecordedNode(KnotNode);
+		FBAUtils::DeleteNode(KnotNode);
+	}
+}
+
 UK2Node_Knot* FKnotTrackCreator::CreateKnotNode(FKnotNodeCreation* Creation, const FVector2D& Position, UEdGraphPin* ParentPin)
 {
 	if (!Creation)
@@ -587,19 +753,51 @@ UK2Node_Knot* FKnotTrackCreator::CreateKnotNode(FKnotNodeCreation* Creation, con
 		return nullptr;
 	}
 
+	const bool bUseKnotNodePool = Settings->bUseKnotNodePool;
+
+	auto Graph = GraphHandler->GetFocusedEdGraph();
+
 	UK2Node_Knot* OptionalNodeToReuse = nullptr;
-	if (GetDefault<UBASettings>()->bUseKnotNodePool && KnotNodePool.Num() > 0)
+	if (bUseKnotNodePool)
 	{
-		OptionalNodeToReuse = KnotNodePool.Pop();
+		TSet<FGraphPinHandle> DesiredLinks(Creation->PinHandlesToConnectTo);
+		DesiredLinks.Add(Creation->PinToConnectToHandle);
+		if (ParentPin)
+		{
+			DesiredLinks.Add(FGraphPinHandle(ParentPin));
+		}
+
+		OptionalNodeToReuse = GraphHandler->GetKnotNodePool().AcquireKnot(Creation->PinToConnectToHandle, Position, DesiredLinks);
 	}
-	else
+
+	// if (!OptionalNodeToReuse)
+	// {
+	// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("Failed to find?"));
+	// }
+
+	// record the nodes whose links are about to change, they have already been moved by the layout
+	if (ParentPin)
 	{
-		// UE_LOG(LogBlueprintAssist, Warning, TEXT("Failed to find?"));
+		GraphHandler->RecordNodeLinks(ParentPin->GetOwningNode());
 	}
 
-	auto Graph = GraphHandler->GetFocusedEdGraph();
+	for (const FGraphPinHandle& PinHandle : Creation->PinHandlesToConnectTo)
+	{
+		if (UEdGraphPin* Pin = FBAUtils::GetPinFromGraph(PinHandle, Graph))
+		{
+			GraphHandler->RecordNodeLinks(Pin->GetOwningNode());
+		}
+	}
+
+	GraphHandler->RecordNodeLinks(OptionalNodeToReuse);
+
 	UK2Node_Knot* CreatedNode = Creation->CreateKnotNode(Position, ParentPin, OptionalNodeToReuse, Graph);
 
+	if (bUseKnotNodePool)
+	{
+		GraphHandler->GetKnotNodePool().RegisterKnot(CreatedNode, Creation->PinToConnectToHandle);
+	}
+
 	UEdGraphPin* MainPinToConnectTo = FBAUtils::GetPinFromGraph(Creation->PinToConnectToHandle, Graph);
 
 	KnotNodeOwners.Add(CreatedNode, MainPinToConnectTo->GetOwningNode());
@@ -762,9 +960,34 @@ void FKnotTrackCreator::Reset()
 
 void FKnotTrackCreator::MakeKnotTrack()
 {
+	BA_TRACE_SCOPE(BA_MakeKnotTrack);
+
 	const TSet<UEdGraphNode*> FormattedNodes = Formatter->GetFormattedNodes();
 
-	const auto& NotFormatted = [FormattedNodes](UEdGraphPin* Pin)
+	// the wiring style is fixed for the whole pass, so pick the kernel once instead of per pin
+	if (Settings->ExecutionWiringStyle == EBAWiringStyle::AlwaysMerge)
+	{
+		MakeKnotTracksForPins<true>(FormattedNodes, true);
+	}
+	else
+	{
+		MakeKnotTracksForPins<false>(FormattedNodes, true);
+	}
+
+	if (Settings->ParameterWiringStyle == EBAWiringStyle::AlwaysMerge)
+	{
+		MakeKnotTracksForPins<true>(FormattedNodes, false);
+	}
+	else
+	{
+		MakeKnotTracksForPins<false>(FormattedNodes, false);
+	}
+}
+
+template <bool bMergeLinkedPins>
+void FKnotTrackCreator::MakeKnotTracksForPins(const TSet<UEdGraphNode*>& FormattedNodes, bool bExecPins)
+{
+	const auto& NotFormatted = [&FormattedNodes](UEdGraphPin* Pin)
 	{
 		return !FormattedNodes.Contains(Pin->GetOwningNode());
 	};
@@ -772,9 +995,10 @@ void FKnotTrackCreator::MakeKnotTrack()
 	// iterate across the pins of all nodes and determine if they require a knot track
 	for (UEdGraphNode* MyNode : FormattedNodes)
 	{
-		// make tracks for input exec pins
+		// make tracks for input exec pins or output parameter pins
 		TArray<TSharedPtr<FKnotNodeTrack>> PreviousTracks;
-		for (UEdGraphPin* MyPin : FBAUtils::GetExecPins(MyNode, EGPD_Input))
+		const TArray<UEdGraphPin*> Pins = bExecPins ? FBAUtils::GetExecPins(MyNode, EGPD_Input) : FBAUtils::GetParameterPins(MyNode, EGPD_Output);
+		for (UEdGraphPin* MyPin : Pins)
 		{
 			TArray<UEdGraphPin*> LinkedTo = MyPin->LinkedTo;
 			LinkedTo.RemoveAll(NotFormatted);
@@ -783,42 +1007,29 @@ void FKnotTrackCreator::MakeKnotTrack()
 				continue;
 			}
 
-			if (GetDefault<UBASettings>()->ExecutionWiringStyle == EBAWiringStyle::AlwaysMerge)
-			{
-				MakeKnotTracksForLinkedExecPins(MyPin, LinkedTo, PreviousTracks);
-			}
-			else
+			if (bMergeLinkedPins)
 			{
-				for (UEdGraphPin* Pin : LinkedTo)
+				if (bExecPins)
 				{
-					MakeKnotTracksForLinkedExecPins(MyPin, { Pin }, PreviousTracks);
+					MakeKnotTracksForLinkedExecPins(MyPin, LinkedTo, PreviousTracks);
+				}
+				else
+				{
+					MakeKnotTracksForParameterPins(MyPin, LinkedTo, PreviousTracks);
 				}
-			}
-		}
-	}
-
-	for (UEdGraphNode* MyNode : FormattedNodes)
-	{
-		// make tracks for output parameter pins
-		TArray<TSharedPtr<FKnotNodeTrack>> PreviousTracks;
-		for (UEdGraphPin* MyPin : FBAUtils::GetParameterPins(MyNode, EGPD_Output))
-		{
-			TArray<UEdGraphPin*> LinkedTo = MyPin->LinkedTo;
-			LinkedTo.RemoveAll(NotFormatted);
-			if (LinkedTo.Num() == 0)
-			{
-				continue;
-			}
-
-			if (GetDefault<UBASettings>()->ParameterWiringStyle == EBAWiringStyle::AlwaysMerge)
-			{
-				MakeKnotTracksForParameterPins(MyPin, LinkedTo, PreviousTracks);
 			}
 			else
 			{
 				for (UEdGraphPin* Pin : LinkedTo)
 				{
-					MakeKnotTracksForParameterPins(MyPin, { Pin }, PreviousTracks);
+					if (bExecPins)
+					{
+						MakeKnotTracksForLinkedExecPins(MyPin, { Pin }, PreviousTracks);
+					}
+					else
+					{
+						MakeKnotTracksForParameterPins(MyPin, { Pin }, PreviousTracks);
+					}
 				}
 			}
 		}
@@ -856,7 +1067,7 @@ TSharedPtr<FKnotNodeTrack> FKnotTrackCreator::MakeKnotTracksForLinkedExecPins(UE
 		const float AboveNodeWithPadding = FMath::Min(OtherNodeTop, MyNodeTop) - TrackSpacing * 2;
 
 		TArray<UEdGraphPin*> TrackPins = { OtherPin };
-		TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, TrackPins, AboveNodeWithPadding, true);
+		TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, TrackPins, AboveNodeWithPadding, true, TrackSpacing);
 		KnotTracks.Add(KnotTrack);
 
 		const FVector2D OtherPinPos = FBAUtils::GetPinPos(GraphHandler, OtherPin);
@@ -920,7 +1131,7 @@ TSharedPtr<FKnotNodeTrack> FKnotTrackCreator::MakeKnotTracksForLinkedExecPins(UE
 	const float Dist = FMath::Abs(ParentPinPos.X - LastPinPos.X);
 
 	// skip the pin distance check if we are expanding by height
-	const bool bPinReallyFar = Dist > GetDefault<UBASettings>()->KnotNodeDistanceThreshold && !GetDefault<UBASettings>()->bExpandNodesByHeight;
+	const bool bPinReallyFar = Dist > Settings->KnotNodeDistanceThreshold && !Settings->bExpandNodesByHeight;
 
 	const bool bPinNeedsTrack = DoesPinNeedTrack(ParentPin, LinkedPins);
 
@@ -941,7 +1152,7 @@ TSharedPtr<FKnotNodeTrack> FKnotTrackCreator::MakeKnotTracksForLinkedExecPins(UE
 		return nullptr;
 	}
 
-	TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, LinkedPins, ParentPinPos.Y, false);
+	TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, LinkedPins, ParentPinPos.Y, false, TrackSpacing);
 	KnotTracks.Add(KnotTrack);
 
 	TryAlignTrackToEndPins(KnotTrack, Formatter->GetFormattedNodes().Array());
@@ -1017,7 +1228,7 @@ TSharedPtr<FKnotNodeTrack> FKnotTrackCreator::MakeKnotTracksForParameterPins(UEd
 
 	const float Dist = FMath::Abs(ParentPinPos.X - LastPinPos.X);
 
-	const bool bLastPinFarAway = Dist > GetDefault<UBASettings>()->KnotNodeDistanceThreshold && !GetDefault<UBASettings>()->bExpandNodesByHeight;
+	const bool bLastPinFarAway = Dist > Settings->KnotNodeDistanceThreshold && !Settings->bExpandNodesByHeight;
 
 	const bool bPinNeedsTrack = DoesPinNeedTrack(ParentPin, LinkedPins);
 
@@ -1039,7 +1250,7 @@ TSharedPtr<FKnotNodeTrack> FKnotTrackCreator::MakeKnotTracksForParameterPins(UEd
 	}
 
 	// init the knot track
-	TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, LinkedPins, ParentPinPos.Y, false);
+	TSharedPtr<FKnotNodeTrack> KnotTrack = MakeShared<FKnotNodeTrack>(Formatter, GraphHandler, ParentPin, LinkedPins, ParentPinPos.Y, false, TrackSpacing);
 	KnotTracks.Add(KnotTrack);
 
 	// check if the track height can simply be set to one of it's pin's height
@@ -1093,7 +1304,7 @@ void FKnotTrackCreator::MergeNearbyKnotTracks()
 
 	TArray<TSharedPtr<FKnotNodeTrack>> PendingTracks = KnotTracks;
 
-	if (GetDefault<UBASettings>()->ExecutionWiringStyle != EBAWiringStyle::MergeWhenNear)
+	if (Settings->ExecutionWiringStyle != EBAWiringStyle::MergeWhenNear)
 	{
 		PendingTracks.RemoveAll([](TSharedPtr<FKnotNodeTrack> Track)
 		{
@@ -1101,7 +1312,7 @@ void FKnotTrackCreator::MergeNearbyKnotTracks()
 		});
 	}
 
-	if (GetDefault<UBASettings>()->ParameterWiringStyle != EBAWiringStyle::MergeWhenNear)
+	if (Settings->ParameterWiringStyle != EBAWiringStyle::MergeWhenNear)
 	{
 		PendingTracks.RemoveAll([](TSharedPtr<FKnotNodeTrack> Track)
 		{
@@ -1169,6 +1380,9 @@ void FKnotTrackCreator::AddKnotNodesToComments()
 		return;
 	}
 
+	// the knot tracks moved nodes since the bounds were cached
+	CommentHandler->MarkAllBoundsDirty();
+
 	for (TSharedPtr<FKnotNodeTrack> Track : KnotTracks)
 	{
 		TArray<UEdGraphNode*> TrackNodes = Track->GetNodes(GraphHandler->GetFocusedEdGraph()).Array();
@@ -1204,6 +1418,7 @@ void FKnotTrackCreator::AddKnotNodesToComments()
 					{
 						if (!NodesUnderComment.Contains(Creation->CreatedKnot))
 						{
+							GraphHandler->ModifyRecordedNode(Comment);
 							Comment->AddNodeUnderComment(Creation->CreatedKnot);
 						}
 					}
@@ -6,6 +6,7 @@
 
 #include "KnotTrack.h"
 
+struct FBASettingsSnapshot;
 struct FCommentHandler;
 struct FPinLink;
 
@@ -15,8 +16,8 @@ class FKnotTrackCreator final
 	TSharedPtr<FBAGraphHandler> GraphHandler;
 	TSet<UEdGraphNode*> KnotNodesSet;
 	TArray<TSharedPtr<FKnotNodeTrack>> KnotTracks;
-	TArray<UK2Node_Knot*> KnotNodePool;
 	TMap<UK2Node_Knot*, UEdGraphNode*> KnotNodeOwners;
+	const FBASettingsSnapshot* Settings = nullptr;
 
 	FVector2D PinPadding;
 	FVector2D NodePadding;
@@ -24,16 +25,22 @@ class FKnotTrackCreator final
 
 public:
 	FKnotTrackCreator() = default;
-	void Init(TSharedPtr<FFormatterInterface> InFormatter, TSharedPtr<FBAGraphHandler> InGraphHandler);
+	void Init(TSharedPtr<FFormatterInterface> InFormatter, TSharedPtr<FBAGraphHandler> InGraphHandler, const FBASettingsSnapshot* InSettings);
 
 	void FormatKnotNodes();
 	void RemoveKnotNodes(const TArray<UEdGraphNode*>& NodeTree);
+
+	/* Deletes the knots removed by RemoveKnotNodes which were not reused, must run before the format returns */
+	void DeleteUnusedKnots();
 	const TSet<UEdGraphNode*>& GetCreatedKnotNodes() { return KnotNodesSet; }
 	void Reset();
 
 private:
 	void MakeKnotTrack();
 
+	template <bool bMergeLinkedPins>
+	void MakeKnotTracksForPins(const TSet<UEdGraphNode*>& FormattedNodes, bool bExecPins);
+
 	TSharedPtr<FKnotNodeTrack> MakeKnotTracksForLinkedExecPins(UEdGraphPin* ParentPin, TArray<UEdGraphPin*> LinkedPins, TArray<TSharedPtr<FKnotNodeTrack>>& PreviousTracks);
 
 	TSharedPtr<FKnotNodeTrack> MakeKnotTracksForParameterPins(UEdGraphPin* ParentPin, TArray<UEdGraphPin*> LinkedPins, TArray<TSharedPtr<FKnotNodeTrack>>& PreviousTracks);
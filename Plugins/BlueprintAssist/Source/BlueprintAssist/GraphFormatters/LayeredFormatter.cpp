@@ -0,0 +1,763 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "LayeredFormatter.h"
+
+#include "BlueprintAssistGlobals.h"
+#include "BlueprintAssistGraphHandler.h"
+#include "BlueprintAssistUtils.h"
+
+namespace
+{
+	struct FLayeredLink
+	{
+		int32 From;
+		int32 To;
+		float FromOffset;
+		float ToOffset;
+	};
+}
+
+FLayeredFormatter::FLayeredFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler)
+	: GraphHandler(InGraphHandler)
+	, RootNode(nullptr)
+{
+	FormatterSettings = GetFormatterSettings();
+}
+
+void FLayeredFormatter::FormatNode(UEdGraphNode* InNode)
+{
+	BA_TRACE_SCOPE(BA_LayeredFormatNode);
+
+	RootNode = InNode;
+	FormattedNodes.Reset();
+
+	if (RootNode == nullptr)
+	{
+		return;
+	}
+
+	FormatterSettings = GetFormatterSettings();
+
+	const FIntPoint SavedRootPos(RootNode->NodePosX, RootNode->NodePosY);
+
+	BuildLayers();
+
+	ReduceCrossings();
+
+	AssignY();
+
+	AssignX();
+
+	// make it look like the root node doesn't move
+	const FIntPoint Delta = SavedRootPos - FIntPoint(RootNode->NodePosX, RootNode->NodePosY);
+	for (UEdGraphNode* Node : FormattedNodes)
+	{
+		Node->NodePosX += Delta.X;
+		Node->NodePosY += Delta.Y;
+	}
+
+	Nodes.Empty();
+	Segments.Empty();
+	Layers.Empty();
+	LeftSegments.Empty();
+	RightSegments.Empty();
+}
+
+FBAFormatterSettings FLayeredFormatter::GetFormatterSettings()
+{
+	return FBAUtils::GetFormatterSettings(GraphHandler->GetFocusedEdGraph());
+}
+
+void FLayeredFormatter::BuildLayers()
+{
+	BA_TRACE_SCOPE(BA_LayeredBuildLayers);
+
+	Nodes.Reset();
+	Segments.Reset();
+	Layers.Reset();
+
+	// collect every node connected to the root
+	TMap<UEdGraphNode*, int32> NodeIndices;
+	TArray<UEdGraphNode*> GraphNodes;
+	NodeIndices.Add(RootNode, 0);
+	GraphNodes.Add(RootNode);
+
+	for (int32 i = 0; i < GraphNodes.Num(); ++i)
+	{
+		for (UEdGraphPin* Pin : GraphNodes[i]->Pins)
+		{
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin ? LinkedPin->GetOwningNodeUnchecked() : nullptr;
+				if (LinkedNode && !FBAUtils::IsCommentNode(LinkedNode) && !NodeIndices.Contains(LinkedNode))
+				{
+					NodeIndices.Add(LinkedNode, GraphNodes.Num());
+					GraphNodes.Add(LinkedNode);
+				}
+			}
+		}
+	}
+
+	const int32 NumGraphNodes = GraphNodes.Num();
+	Nodes.Reserve(NumGraphNodes);
+	for (UEdGraphNode* Node : GraphNodes)
+	{
+		const FSlateRect Bounds = FBAUtils::GetCachedNodeBounds(GraphHandler, Node);
+
+		FBALayeredNode& LayeredNode = Nodes.AddDefaulted_GetRef();
+		LayeredNode.Node = Node;
+		LayeredNode.Width = Bounds.GetSize().X;
+		LayeredNode.Height = Bounds.GetSize().Y;
+		LayeredNode.TopInset = Node->NodePosY - Bounds.Top;
+		LayeredNode.InitialY = Bounds.Top;
+
+		FormattedNodes.Add(Node);
+	}
+
+	const auto GetPinOffset = [this](int32 NodeIndex, UEdGraphPin* Pin)
+	{
+		return GraphHandler->GetPinY(Pin) - Nodes[NodeIndex].InitialY;
+	};
+
+	// links always go from output to input
+	TArray<FLayeredLink> Links;
+	TArray<TArray<int32>> OutLinks;
+	OutLinks.SetNum(NumGraphNodes);
+	for (int32 NodeIndex = 0; NodeIndex < NumGraphNodes; ++NodeIndex)
+	{
+		for (UEdGraphPin* Pin : GraphNodes[NodeIndex]->Pins)
+		{
+			if (Pin->Direction != EGPD_Output)
+			{
+				continue;
+			}
+
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				const int32* LinkedIndex = LinkedPin ? NodeIndices.Find(LinkedPin->GetOwningNodeUnchecked()) : nullptr;
+				if (LinkedIndex == nullptr || *LinkedIndex == NodeIndex)
+				{
+					continue;
+				}
+
+				OutLinks[NodeIndex].Add(Links.Num());
+				Links.Add({ NodeIndex, *LinkedIndex, GetPinOffset(NodeIndex, Pin), GetPinOffset(*LinkedIndex, LinkedPin) });
+			}
+		}
+	}
+
+	// break cycles by reversing the back links of a depth first search from the root
+	TBitArray<> ReversedLinks(false, Links.Num());
+	{
+		TArray<uint8> VisitState;
+		VisitState.Init(0, NumGraphNodes);
+		TArray<TPair<int32, int32>> Stack;
+
+		for (int32 StartIndex = 0; StartIndex < NumGraphNodes; ++StartIndex)
+		{
+			if (VisitState[StartIndex] != 0)
+			{
+				continue;
+			}
+
+			VisitState[StartIndex] = 1;
+			Stack.Push(TPair<int32, int32>(StartIndex, 0));
+
+			while (Stack.Num() > 0)
+			{
+				const int32 NodeIndex = Stack.Last().Key;
+				const int32 NextLink = Stack.Last().Value;
+				if (NextLink >= OutLinks[NodeIndex].Num())
+				{
+					VisitState[NodeIndex] = 2;
+					Stack.Pop(false);
+					continue;
+				}
+
+				Stack.Last().Value += 1;
+
+				const int32 LinkIndex = OutLinks[NodeIndex][NextLink];
+				const int32 To = Links[LinkIndex].To;
+				if (VisitState[To] == 1)
+				{
+					ReversedLinks[LinkIndex] = true;
+				}
+				else if (VisitState[To] == 0)
+				{
+					VisitState[To] = 1;
+					Stack.Push(TPair<int32, int32>(To, 0));
+				}
+			}
+		}
+	}
+
+	// longest path layering, anchored to the sinks when the formatter expands towards the inputs
+	const bool bAnchorToSinks = FormatterSettings.FormatterDirection == EGPD_Input;
+
+	TArray<TArray<int32>> Successors;
+	TArray<int32> InDegree;
+	Successors.SetNum(NumGraphNodes);
+	InDegree.Init(0, NumGraphNodes);
+	for (int32 LinkIndex = 0; LinkIndex < Links.Num(); ++LinkIndex)
+	{
+		int32 From = Links[LinkIndex].From;
+		int32 To = Links[LinkIndex].To;
+		if (ReversedLinks[LinkIndex] != bAnchorToSinks)
+		{
+			Swap(From, To);
+		}
+
+		Successors[From].Add(To);
+		InDegree[To] += 1;
+	}
+
+	TArray<int32> TopologicalOrder;
+	TopologicalOrder.Reserve(NumGraphNodes);
+	for (int32 NodeIndex = 0; NodeIndex < NumGraphNodes; ++NodeIndex)
+	{
+		if (InDegree[NodeIndex] == 0)
+		{
+			TopologicalOrder.Add(NodeIndex);
+		}
+	}
+
+	for (int32 i = 0; i < TopologicalOrder.Num(); ++i)
+	{
+		for (int32 Successor : Successors[TopologicalOrder[i]])
+		{
+			InDegree[Successor] -= 1;
+			if (InDegree[Successor] == 0)
+			{
+				TopologicalOrder.Add(Successor);
+			}
+		}
+	}
+
+	if (!ensure(TopologicalOrder.Num() == NumGraphNodes))
+	{
+		return;
+	}
+
+	for (int32 NodeIndex : TopologicalOrder)
+	{
+		for (int32 Successor : Successors[NodeIndex])
+		{
+			Nodes[Successor].Layer = FMath::Max(Nodes[Successor].Layer, Nodes[NodeIndex].Layer + 1);
+		}
+	}
+
+	// pull nodes next to their closest successor so inputs sit beside the node they feed
+	for (int32 i = TopologicalOrder.Num() - 1; i >= 0; --i)
+	{
+		FBALayeredNode& LayeredNode = Nodes[TopologicalOrder[i]];
+		if (Successors[TopologicalOrder[i]].Num() > 0)
+		{
+			int32 MinLayer = MAX_int32;
+			for (int32 Successor : Successors[TopologicalOrder[i]])
+			{
+				MinLayer = FMath::Min(MinLayer, Nodes[Successor].Layer);
+			}
+
+			LayeredNode.Layer = MinLayer - 1;
+		}
+	}
+
+	int32 MaxLayer = 0;
+	for (const FBALayeredNode& LayeredNode : Nodes)
+	{
+		MaxLayer = FMath::Max(MaxLayer, LayeredNode.Layer);
+	}
+
+	if (bAnchorToSinks)
+	{
+		for (FBALayeredNode& LayeredNode : Nodes)
+		{
+			LayeredNode.Layer = MaxLayer - LayeredNode.Layer;
+		}
+	}
+
+	// split links spanning several layers with dummy nodes
+	for (const FLayeredLink& Link : Links)
+	{
+		int32 Left = Link.From;
+		int32 Right = Link.To;
+		float LeftOffset = Link.FromOffset;
+		float RightOffset = Link.ToOffset;
+		if (Nodes[Left].Layer > Nodes[Right].Layer)
+		{
+			Swap(Left, Right);
+			Swap(LeftOffset, RightOffset);
+		}
+
+		const int32 LeftLayer = Nodes[Left].Layer;
+		const int32 RightLayer = Nodes[Right].Layer;
+		const float LeftY = Nodes[Left].InitialY + LeftOffset;
+		const float RightY = Nodes[Right].InitialY + RightOffset;
+
+		int32 Previous = Left;
+		float PreviousOffset = LeftOffset;
+		for (int32 Layer = LeftLayer + 1; Layer < RightLayer; ++Layer)
+		{
+			const int32 DummyIndex = Nodes.Num();
+			FBALayeredNode& Dummy = Nodes.AddDefaulted_GetRef();
+			Dummy.Layer = Layer;
+			Dummy.InitialY = FMath::Lerp(LeftY, RightY, static_cast<float>(Layer - LeftLayer) / (RightLayer - LeftLayer));
+
+			Segments.Add({ Previous, DummyIndex, PreviousOffset, 0 });
+			Previous = DummyIndex;
+			PreviousOffset = 0;
+		}
+
+		Segments.Add({ Previous, Right, PreviousOffset, RightOffset });
+	}
+
+	LeftSegments.Reset();
+	RightSegments.Reset();
+	LeftSegments.SetNum(Nodes.Num());
+	RightSegments.SetNum(Nodes.Num());
+	for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); ++SegmentIndex)
+	{
+		RightSegments[Segments[SegmentIndex].Left].Add(SegmentIndex);
+		LeftSegments[Segments[SegmentIndex].Right].Add(SegmentIndex);
+	}
+
+	// start from the current vertical order of the nodes
+	Layers.SetNum(MaxLayer + 1);
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+	{
+		Layers[Nodes[NodeIndex].Layer].Add(NodeIndex);
+	}
+
+	for (TArray<int32>& Layer : Layers)
+	{
+		Layer.StableSort([this](int32 A, int32 B) { return Nodes[A].InitialY < Nodes[B].InitialY; });
+		for (int32 Order = 0; Order < Layer.Num(); ++Order)
+		{
+			Nodes[Layer[Order]].Order = Order;
+		}
+	}
+}
+
+void FLayeredFormatter::ReduceCrossings()
+{
+	BA_TRACE_SCOPE(BA_LayeredReduceCrossings);
+
+	int64 BestCrossings = CountCrossings();
+	TArray<TArray<int32>> BestLayers = Layers;
+
+	TArray<float> Barycenters;
+	Barycenters.SetNumZeroed(Nodes.Num());
+
+	const int32 MaxSweeps = GetDefault<UBASettings>()->LayeredFormatterMaxSweeps;
+	for (int32 Sweep = 0; Sweep < MaxSweeps && BestCrossings > 0; ++Sweep)
+	{
+		// alternate between ordering by the previous layer and ordering by the next layer
+		const bool bLeftToRight = Sweep % 2 == 0;
+
+		for (int32 i = 1; i < Layers.Num(); ++i)
+		{
+			TArray<int32>& Layer = Layers[bLeftToRight ? i : Layers.Num() - 1 - i];
+
+			for (int32 NodeIndex : Layer)
+			{
+				const TArray<int32>& NodeSegments = bLeftToRight ? LeftSegments[NodeIndex] : RightSegments[NodeIndex];
+				if (NodeSegments.Num() == 0)
+				{
+					Barycenters[NodeIndex] = Nodes[NodeIndex].Order + 0.5f;
+					continue;
+				}
+
+				// use the pin position so links into the same node are ordered as well
+				float Sum = 0;
+				for (int32 SegmentIndex : NodeSegments)
+				{
+					const FBALayeredSegment& Segment = Segments[SegmentIndex];
+					const FBALayeredNode& Neighbor = Nodes[bLeftToRight ? Segment.Left : Segment.Right];
+					const float Offset = bLeftToRight ? Segment.LeftOffset : Segment.RightOffset;
+					Sum += Neighbor.Order + (Neighbor.Height > 0 ? FMath::Clamp(Offset / Neighbor.Height, 0.f, 0.99f) : 0.5f);
+				}
+
+				Barycenters[NodeIndex] = Sum / NodeSegments.Num();
+			}
+
+			Layer.StableSort([&Barycenters](int32 A, int32 B) { return Barycenters[A] < Barycenters[B]; });
+			for (int32 Order = 0; Order < Layer.Num(); ++Order)
+			{
+				Nodes[Layer[Order]].Order = Order;
+			}
+		}
+
+		const int64 Crossings = CountCrossings();
+		if (Crossings < BestCrossings)
+		{
+			BestCrossings = Crossings;
+			BestLayers = Layers;
+		}
+	}
+
+	Layers = MoveTemp(BestLayers);
+	for (const TArray<int32>& Layer : Layers)
+	{
+		for (int32 Order = 0; Order < Layer.Num(); ++Order)
+		{
+			Nodes[Layer[Order]].Order = Order;
+		}
+	}
+}
+
+int64 FLayeredFormatter::CountCrossings() const
+{
+	int64 Crossings = 0;
+
+	TArray<TPair<int32, int32>> SegmentOrders;
+	TArray<int32> Tree;
+
+	for (int32 LayerIndex = 0; LayerIndex + 1 < Layers.Num(); ++LayerIndex)
+	{
+		SegmentOrders.Reset();
+		for (int32 NodeIndex : Layers[LayerIndex])
+		{
+			for (int32 SegmentIndex : RightSegments[NodeIndex])
+			{
+				SegmentOrders.Add(TPair<int32, int32>(Nodes[NodeIndex].Order, Nodes[Segments[SegmentIndex].Right].Order));
+			}
+		}
+
+		SegmentOrders.Sort([](const TPair<int32, int32>& A, const TPair<int32, int32>& B)
+		{
+			return A.Key != B.Key ? A.Key < B.Key : A.Value < B.Value;
+		});
+
+		// count the inversions of the right orders with a fenwick tree
+		const int32 NumRight = Layers[LayerIndex + 1].Num();
+		Tree.Reset();
+		Tree.SetNumZeroed(NumRight + 1);
+
+		for (int32 NumInserted = 0; NumInserted < SegmentOrders.Num(); ++NumInserted)
+		{
+			const int32 RightOrder = SegmentOrders[NumInserted].Value;
+
+			int32 NumNotAbove = 0;
+			for (int32 i = RightOrder + 1; i > 0; i -= i & -i)
+			{
+				NumNotAbove += Tree[i];
+			}
+
+			Crossings += NumInserted - NumNotAbove;
+
+			for (int32 i = RightOrder + 1; i <= NumRight; i += i & -i)
+			{
+				Tree[i] += 1;
+			}
+		}
+	}
+
+	return Crossings;
+}
+
+void FLayeredFormatter::AssignY()
+{
+	BA_TRACE_SCOPE(BA_LayeredAssignY);
+
+	const int32 NumNodes = Nodes.Num();
+	const float Padding = FormatterSettings.Padding.Y;
+
+	// mark segments crossing an inner segment (dummy to dummy) so long links are kept straight
+	TBitArray<> MarkedSegments(false, Segments.Num());
+	for (int32 LayerIndex = 0; LayerIndex + 1 < Layers.Num(); ++LayerIndex)
+	{
+		const TArray<int32>& NextLayer = Layers[LayerIndex + 1];
+
+		int32 K0 = 0;
+		int32 ScanIndex = 0;
+		for (int32 L1 = 0; L1 < NextLayer.Num(); ++L1)
+		{
+			const int32 NodeIndex = NextLayer[L1];
+			const bool bInnerSegment = Nodes[NodeIndex].IsDummy() && Nodes[Segments[LeftSegments[NodeIndex][0]].Left].IsDummy();
+			if (L1 != NextLayer.Num() - 1 && !bInnerSegment)
+			{
+				continue;
+			}
+
+			const int32 K1 = bInnerSegment ? Nodes[Segments[LeftSegments[NodeIndex][0]].Left].Order : Layers[LayerIndex].Num() - 1;
+			for (; ScanIndex <= L1; ++ScanIndex)
+			{
+				for (int32 SegmentIndex : LeftSegments[NextLayer[ScanIndex]])
+				{
+					const int32 K = Nodes[Segments[SegmentIndex].Left].Order;
+					if (K < K0 || K > K1)
+					{
+						MarkedSegments[SegmentIndex] = true;
+					}
+				}
+			}
+
+			K0 = K1;
+		}
+	}
+
+	// Brandes-Koepf: align and compact the layers in all four directions, then balance the layouts
+	TArray<float> Layouts[4];
+	bool bValidLayouts[4] = { false, false, false, false };
+
+	TArray<int32> Roots;
+	TArray<int32> Aligns;
+	TArray<float> Offsets;
+	TArray<float> BlockY;
+	TArray<int32> BlockInDegree;
+	TArray<TArray<TPair<int32, float>>> BlockLinks;
+	TArray<int32> BlockQueue;
+
+	for (int32 Direction = 0; Direction < 4; ++Direction)
+	{
+		const bool bFromRight = (Direction & 1) != 0;
+		const bool bFromBottom = (Direction & 2) != 0;
+
+		const auto GetPos = [this, bFromBottom](int32 NodeIndex)
+		{
+			const FBALayeredNode& LayeredNode = Nodes[NodeIndex];
+			return bFromBottom ? Layers[LayeredNode.Layer].Num() - 1 - LayeredNode.Order : LayeredNode.Order;
+		};
+
+		const auto GetOffset = [this, bFromBottom](int32 NodeIndex, float Offset)
+		{
+			return bFromBottom ? Nodes[NodeIndex].Height - Offset : Offset;
+		};
+
+		const auto GetNeighbor = [this, bFromRight](int32 SegmentIndex)
+		{
+			return bFromRight ? Segments[SegmentIndex].Right : Segments[SegmentIndex].Left;
+		};
+
+		Roots.SetNumUninitialized(NumNodes);
+		Aligns.SetNumUninitialized(NumNodes);
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+		{
+			Roots[NodeIndex] = NodeIndex;
+			Aligns[NodeIndex] = NodeIndex;
+		}
+
+		Offsets.Reset();
+		Offsets.SetNumZeroed(NumNodes);
+
+		// align each node with the median of its neighbors in the previous layer
+		for (int32 i = 1; i < Layers.Num(); ++i)
+		{
+			const TArray<int32>& Layer = Layers[bFromRight ? Layers.Num() - 1 - i : i];
+
+			int32 R = INDEX_NONE;
+			for (int32 j = 0; j < Layer.Num(); ++j)
+			{
+				const int32 V = Layer[bFromBottom ? Layer.Num() - 1 - j : j];
+
+				TArray<int32, TInlineAllocator<8>> NeighborSegments(bFromRight ? RightSegments[V] : LeftSegments[V]);
+				if (NeighborSegments.Num() == 0)
+				{
+					continue;
+				}
+
+				NeighborSegments.Sort([&](int32 A, int32 B)
+				{
+					const int32 PosA = GetPos(GetNeighbor(A));
+					const int32 PosB = GetPos(GetNeighbor(B));
+					if (PosA != PosB)
+					{
+						return PosA < PosB;
+					}
+
+					const FBALayeredSegment& SegmentA = Segments[A];
+					const FBALayeredSegment& SegmentB = Segments[B];
+					return GetOffset(GetNeighbor(A), bFromRight ? SegmentA.RightOffset : SegmentA.LeftOffset)
+						< GetOffset(GetNeighbor(B), bFromRight ? SegmentB.RightOffset : SegmentB.LeftOffset);
+				});
+
+				const int32 NumNeighbors = NeighborSegments.Num();
+				for (int32 M = (NumNeighbors - 1) / 2; M <= NumNeighbors / 2 && Aligns[V] == V; ++M)
+				{
+					const int32 SegmentIndex = NeighborSegments[M];
+					const int32 U = GetNeighbor(SegmentIndex);
+					if (MarkedSegments[SegmentIndex] || R >= GetPos(U))
+					{
+						continue;
+					}
+
+					Aligns[U] = V;
+					Roots[V] = Roots[U];
+					Aligns[V] = Roots[V];
+					R = GetPos(U);
+
+					// line up the pins of the link rather than the top of the nodes
+					const FBALayeredSegment& Segment = Segments[SegmentIndex];
+					const float UOffset = GetOffset(U, bFromRight ? Segment.RightOffset : Segment.LeftOffset);
+					const float VOffset = GetOffset(V, bFromRight ? Segment.LeftOffset : Segment.RightOffset);
+					Offsets[V] = Offsets[U] + UOffset - VOffset;
+				}
+			}
+		}
+
+		// compact the blocks with a longest path over the separation constraints between neighboring blocks
+		BlockLinks.SetNum(NumNodes);
+		for (TArray<TPair<int32, float>>& Links : BlockLinks)
+		{
+			Links.Reset();
+		}
+
+		BlockInDegree.Reset();
+		BlockInDegree.SetNumZeroed(NumNodes);
+
+		for (const TArray<int32>& Layer : Layers)
+		{
+			for (int32 j = 1; j < Layer.Num(); ++j)
+			{
+				const int32 U = Layer[bFromBottom ? Layer.Num() - j : j - 1];
+				const int32 W = Layer[bFromBottom ? Layer.Num() - 1 - j : j];
+
+				const float Spacing = Nodes[U].IsDummy() || Nodes[W].IsDummy() ? Padding * 0.5f : Padding;
+				BlockLinks[Roots[U]].Add(TPair<int32, float>(Roots[W], Offsets[U] + Nodes[U].Height + Spacing - Offsets[W]));
+				BlockInDegree[Roots[W]] += 1;
+			}
+		}
+
+		BlockY.Reset();
+		BlockY.SetNumZeroed(NumNodes);
+		BlockQueue.Reset();
+
+		int32 NumBlocks = 0;
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+		{
+			if (Roots[NodeIndex] == NodeIndex)
+			{
+				NumBlocks += 1;
+				if (BlockInDegree[NodeIndex] == 0)
+				{
+					BlockQueue.Add(NodeIndex);
+				}
+			}
+		}
+
+		for (int32 i = 0; i < BlockQueue.Num(); ++i)
+		{
+			const int32 Block = BlockQueue[i];
+			for (const TPair<int32, float>& Link : BlockLinks[Block])
+			{
+				BlockY[Link.Key] = FMath::Max(BlockY[Link.Key], BlockY[Block] + Link.Value);
+				BlockInDegree[Link.Key] -= 1;
+				if (BlockInDegree[Link.Key] == 0)
+				{
+					BlockQueue.Add(Link.Key);
+				}
+			}
+		}
+
+		bValidLayouts[Direction] = BlockQueue.Num() == NumBlocks;
+		if (!bValidLayouts[Direction])
+		{
+			UE_LOG(LogBlueprintAssist, Warning, TEXT("LayeredFormatter: Failed to compact layout %d"), Direction);
+			continue;
+		}
+
+		TArray<float>& Layout = Layouts[Direction];
+		Layout.SetNumUninitialized(NumNodes);
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+		{
+			const float Top = BlockY[Roots[NodeIndex]] + Offsets[NodeIndex];
+			Layout[NodeIndex] = bFromBottom ? -Top - Nodes[NodeIndex].Height : Top;
+		}
+	}
+
+	// align every layout to the one with the smallest height
+	float MinY[4];
+	float MaxY[4];
+	int32 Smallest = INDEX_NONE;
+	for (int32 Direction = 0; Direction < 4; ++Direction)
+	{
+		if (!bValidLayouts[Direction])
+		{
+			continue;
+		}
+
+		MinY[Direction] = MAX_flt;
+		MaxY[Direction] = -MAX_flt;
+		for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+		{
+			MinY[Direction] = FMath::Min(MinY[Direction], Layouts[Direction][NodeIndex]);
+			MaxY[Direction] = FMath::Max(MaxY[Direction], Layouts[Direction][NodeIndex] + Nodes[NodeIndex].Height);
+		}
+
+		if (Smallest == INDEX_NONE || MaxY[Direction] - MinY[Direction] < MaxY[Smallest] - MinY[Smallest])
+		{
+			Smallest = Direction;
+		}
+	}
+
+	if (Smallest == INDEX_NONE)
+	{
+		// stack each layer by its order
+		for (const TArray<int32>& Layer : Layers)
+		{
+			float NextY = 0;
+			for (int32 NodeIndex : Layer)
+			{
+				if (UEdGraphNode* Node = Nodes[NodeIndex].Node)
+				{
+					Node->NodePosY = FMath::RoundToInt(NextY + Nodes[NodeIndex].TopInset);
+					NextY += Nodes[NodeIndex].Height + Padding;
+				}
+			}
+		}
+
+		return;
+	}
+
+	float Shifts[4] = { 0, 0, 0, 0 };
+	for (int32 Direction = 0; Direction < 4; ++Direction)
+	{
+		if (bValidLayouts[Direction])
+		{
+			Shifts[Direction] = (Direction & 2) != 0 ? MaxY[Smallest] - MaxY[Direction] : MinY[Smallest] - MinY[Direction];
+		}
+	}
+
+	// the average median of the layouts keeps the order and spacing of each layer
+	TArray<float, TInlineAllocator<4>> Values;
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+	{
+		UEdGraphNode* Node = Nodes[NodeIndex].Node;
+		if (Node == nullptr)
+		{
+			continue;
+		}
+
+		Values.Reset();
+		for (int32 Direction = 0; Direction < 4; ++Direction)
+		{
+			if (bValidLayouts[Direction])
+			{
+				Values.Add(Layouts[Direction][NodeIndex] + Shifts[Direction]);
+			}
+		}
+
+		Values.Sort();
+		const float Y = (Values[(Values.Num() - 1) / 2] + Values[Values.Num() / 2]) * 0.5f;
+		Node->NodePosY = FMath::RoundToInt(Y + Nodes[NodeIndex].TopInset);
+	}
+}
+
+void FLayeredFormatter::AssignX()
+{
+	float LayerX = 0;
+	for (const TArray<int32>& Layer : Layers)
+	{
+		float LayerWidth = 0;
+		for (int32 NodeIndex : Layer)
+		{
+			if (UEdGraphNode* Node = Nodes[NodeIndex].Node)
+			{
+				Node->NodePosX = FMath::RoundToInt(LayerX);
+				LayerWidth = FMath::Max(LayerWidth, Nodes[NodeIndex].Width);
+			}
+		}
+
+		LayerX += LayerWidth + FormatterSettings.Padding.X;
+	}
+}
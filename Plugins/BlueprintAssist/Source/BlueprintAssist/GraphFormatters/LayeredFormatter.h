@@ -0,0 +1,83 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "BlueprintAssistSettings.h"
+#include "FormatterInterface.h"
+
+class FBAGraphHandler;
+
+/* A node in the layered graph, Node is null for the dummy nodes which long links are split into */
+struct FBALayeredNode
+{
+	UEdGraphNode* Node = nullptr;
+	int32 Layer = 0;
+	int32 Order = 0;
+	float Width = 0;
+	float Height = 0;
+
+	/* Distance from the top of the bounds (including the comment bubble) to NodePosY */
+	float TopInset = 0;
+
+	/* Top of the bounds before formatting (the link's y for dummy nodes), used for the initial order of each layer */
+	float InitialY = 0;
+
+	bool IsDummy() const { return Node == nullptr; }
+};
+
+/* A link between two adjacent layers, the offsets are the pin positions relative to the top of each node */
+struct FBALayeredSegment
+{
+	int32 Left = INDEX_NONE;
+	int32 Right = INDEX_NONE;
+	float LeftOffset = 0;
+	float RightOffset = 0;
+};
+
+/**
+ * Sugiyama style formatter for large non-blueprint graphs (materials, niagara).
+ * Nodes are layered by longest path, ordered within each layer by barycenter sweeps
+ * and given y positions with Brandes-Koepf coordinate assignment.
+ */
+class BLUEPRINTASSIST_API FLayeredFormatter final
+	: public FFormatterInterface
+{
+public:
+	TSharedPtr<FBAGraphHandler> GraphHandler;
+	FBAFormatterSettings FormatterSettings;
+
+	TSet<UEdGraphNode*> FormattedNodes;
+	virtual TSet<UEdGraphNode*> GetFormattedNodes() override { return FormattedNodes; }
+
+	UEdGraphNode* RootNode;
+	virtual UEdGraphNode* GetRootNode() override { return RootNode; }
+
+	FLayeredFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler);
+
+	virtual ~FLayeredFormatter() override { }
+
+	virtual void FormatNode(UEdGraphNode* Node) override;
+
+	virtual FBAFormatterSettings GetFormatterSettings() override;
+
+private:
+	TArray<FBALayeredNode> Nodes;
+	TArray<FBALayeredSegment> Segments;
+	TArray<TArray<int32>> Layers;
+
+	/* Segment indices per node, linking to the previous and next layer */
+	TArray<TArray<int32>> LeftSegments;
+	TArray<TArray<int32>> RightSegments;
+
+	void BuildLayers();
+
+	void ReduceCrossings();
+
+	int64 CountCrossings() const;
+
+	void AssignY();
+
+	void AssignX();
+};
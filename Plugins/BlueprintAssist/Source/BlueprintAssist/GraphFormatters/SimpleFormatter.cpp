@@ -3,6 +3,7 @@
 #include "SimpleFormatter.h"
 
 #include "BAFormatterUtils.h"
+#include "BlueprintAssistGlobals.h"
 #include "BlueprintAssistUtils.h"
 #include "EdGraphNode_Comment.h"
 #include "Containers/Queue.h"
@@ -16,6 +17,8 @@ FSimpleFormatter::FSimpleFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler)
 
 void FSimpleFormatter::FormatNode(UEdGraphNode* Node)
 {
+	BA_TRACE_SCOPE(BA_SimpleFormatNode);
+
 	RootNode = Node;
 
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("Root node %s"), *FBAUtils::GetNodeName(RootNode));
@@ -25,26 +28,37 @@ void FSimpleFormatter::FormatNode(UEdGraphNode* Node)
 	int32 SavedNodePosX = RootNode->NodePosX;
 	int32 SavedNodePosY = RootNode->NodePosY;
 
-	FormatX();
+	if (FormatterSettings.bFastMode)
+	{
+		FormatFast();
+	}
+	else
+	{
+		LinkIds.Reset();
+		SameRowMapping.Reset();
+		Rows.Reset();
 
-	CommentHandler.Init(GraphHandler, SharedThis(this));
+		FormatX();
 
-	FormatY();
+		CommentHandler.Init(GraphHandler, SharedThis(this));
 
-	// UE_LOG(LogTemp, Warning, TEXT("Same row mapping"));
-	// for (auto Kvp : SameRowMapping)
-	// {
-	// 	UE_LOG(LogTemp, Warning, TEXT("\t%s"), *Kvp.Key.ToString());
-	// }
+		FormatY();
 
-	if (GetDefault<UBASettings>()->bApplyCommentPadding)
-	{
-		ExpandCommentsX();
-	}
+		// UE_LOG(LogTemp, Warning, TEXT("Same row mapping"));
+		// for (auto Kvp : SameRowMapping)
+		// {
+		// 	UE_LOG(LogTemp, Warning, TEXT("\t%s"), *Kvp.Key.ToString());
+		// }
 
-	if (GetDefault<UBASettings>()->bApplyCommentPadding)
-	{
-		ExpandCommentsY();
+		if (GetDefault<UBASettings>()->bApplyCommentPadding)
+		{
+			ExpandCommentsX();
+		}
+
+		if (GetDefault<UBASettings>()->bApplyCommentPadding)
+		{
+			ExpandCommentsY();
+		}
 	}
 
 	// reset root node position
@@ -56,6 +70,13 @@ void FSimpleFormatter::FormatNode(UEdGraphNode* Node)
 		FormattedNode->NodePosX += DeltaX;
 		FormattedNode->NodePosY += DeltaY;
 	}
+
+	// Free the per-pass format x info in one go
+	FormatXInfoMap.Empty();
+	NodesToExpand.Empty();
+	FormatXArena.Empty();
+	FastNodes.Empty();
+	FastOrder.Empty();
 }
 
 void FSimpleFormatter::FormatX()
@@ -63,12 +84,12 @@ void FSimpleFormatter::FormatX()
 	TSet<UEdGraphNode*> VisitedNodes;
 	TSet<UEdGraphNode*> PendingNodes;
 	PendingNodes.Add(RootNode);
-	TSet<FPinLink> VisitedLinks;
+	FPinLinkSet VisitedLinks;
 	const FPinLink RootNodeLink(nullptr, nullptr, RootNode);
-	TSharedPtr<FFormatXInfo> RootInfo = MakeShareable(new FFormatXInfo(RootNodeLink, nullptr));
+	FFormatXInfo* RootInfo = FormatXArena.Add(FFormatXInfo(RootNodeLink, INDEX_NONE));
 
-	TArray<TSharedPtr<FFormatXInfo>> OutputStack;
-	TArray<TSharedPtr<FFormatXInfo>> InputStack;
+	TArray<FFormatXInfo*> OutputStack;
+	TArray<FFormatXInfo*> InputStack;
 	OutputStack.Push(RootInfo);
 	FormatXInfoMap.Add(RootNode, RootInfo);
 
@@ -79,10 +100,10 @@ void FSimpleFormatter::FormatX()
 	while (OutputStack.Num() > 0 || InputStack.Num() > 0)
 	{
 		// try to get the current info from the pending input
-		TSharedPtr<FFormatXInfo> CurrentInfo = nullptr;
+		FFormatXInfo* CurrentInfo = nullptr;
 
-		TArray<TSharedPtr<FFormatXInfo>>& FirstStack = LastDirection == EGPD_Output ? OutputStack : InputStack;
-		TArray<TSharedPtr<FFormatXInfo>>& SecondStack = LastDirection == EGPD_Output ? InputStack : OutputStack;
+		TArray<FFormatXInfo*>& FirstStack = LastDirection == EGPD_Output ? OutputStack : InputStack;
+		TArray<FFormatXInfo*>& SecondStack = LastDirection == EGPD_Output ? InputStack : OutputStack;
 
 		if (FirstStack.Num() > 0)
 		{
@@ -107,7 +128,7 @@ void FSimpleFormatter::FormatX()
 		{
 			if (CurrentNode != RootNode)
 			{
-				CurrentInfo->SetParent(CurrentInfo->Parent);
+				CurrentInfo->SetParent(CurrentInfo->GetParent());
 				CurrentNode->NodePosX = NewX;
 
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tInitial Set node pos x %d %s"), NewX, *FBAUtils::GetNodeName(CurrentNode));
@@ -118,7 +139,7 @@ void FSimpleFormatter::FormatX()
 		}
 		else
 		{
-			TSharedPtr<FFormatXInfo> OldInfo = FormatXInfoMap[CurrentNode];
+			FFormatXInfo* OldInfo = FormatXInfoMap[CurrentNode];
 
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tInfo map contains %s | %s (%s) | Parent %s (%s) | %d"),
 			//        *FBAUtils::GetNodeName(CurrentInfo->Link.To->GetOwningNode()),
@@ -134,7 +155,7 @@ void FSimpleFormatter::FormatX()
 			if (!bHasNoParent) // if we have a parent, check if there is a cycle
 			{
 				// bHasCycle = OldInfo->GetChildren(EGPD_Output).Contains(CurrentInfo->Parent->GetNode());
-				bHasCycle = OldInfo->GetChildren().Contains(CurrentInfo->Parent->GetNode());
+				bHasCycle = OldInfo->GetChildren().Contains(CurrentInfo->GetParent()->GetNode());
 
 				// if (bHasCycle)
 				// {
@@ -154,7 +175,7 @@ void FSimpleFormatter::FormatX()
 
 			if (bHasNoParent || !bHasCycle)
 			{
-				if (OldInfo->Parent.IsValid())
+				if (OldInfo->Parent != INDEX_NONE)
 				{
 					bool bTakeNewParent = bHasNoParent;
 
@@ -185,14 +206,15 @@ void FSimpleFormatter::FormatX()
 						// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTOOK PARENT"));
 
 						OldInfo->Link = CurrentInfo->Link;
-						OldInfo->SetParent(CurrentInfo->Parent);
+						OldInfo->SetParent(CurrentInfo->GetParent());
 
 						CurrentInfo = OldInfo;
 
 						CurrentNode->NodePosX = NewX;
 
-						for (TSharedPtr<FFormatXInfo> ChildInfo : CurrentInfo->Children)
+						for (int32 ChildIndex : CurrentInfo->Children)
 						{
+							FFormatXInfo* ChildInfo = FormatXArena.Get(ChildIndex);
 							if (ChildInfo->Link.GetDirection() == EGPD_Output)
 							{
 								OutputStack.Push(ChildInfo);
@@ -226,16 +248,17 @@ void FSimpleFormatter::FormatX()
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("Iterating node %s"), *FBAUtils::GetNodeName(LinkedNode));
 
 				const FPinLink PinLink(ParentPin, LinkedPin, LinkedNode);
-				if (VisitedLinks.Contains(PinLink))
+				const int32 LinkId = LinkIds.GetLinkId(PinLink);
+				if (VisitedLinks.Contains(LinkId))
 				{
 					continue;
 				}
 
-				VisitedLinks.Add(PinLink);
+				VisitedLinks.Add(LinkId);
 
 				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tIterating pin link %s"), *PinLink.ToString());
 
-				TSharedPtr<FFormatXInfo> LinkedInfo = MakeShareable(new FFormatXInfo(PinLink, CurrentInfo));
+				FFormatXInfo* LinkedInfo = FormatXArena.Add(FFormatXInfo(PinLink, CurrentInfo->Index));
 
 				if (ParentPin->Direction == FormatterSettings.FormatterDirection)
 				{
@@ -254,7 +277,7 @@ void FSimpleFormatter::FormatX()
 
 							if (!bHasCycle)
 							{
-								if (!CurrentInfo->Parent.IsValid() || LinkedNode != CurrentInfo->Parent->GetNode())
+								if (CurrentInfo->Parent == INDEX_NONE || LinkedNode != CurrentInfo->GetParent()->GetNode())
 								{
 									NodesToExpand.Add(CurrentInfo);
 									// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\t\t\tExpanding node %s"), *FBAUtils::GetNodeName(LinkedNode));
@@ -332,16 +355,16 @@ FBAFormatterSettings FSimpleFormatter::GetFormatterSettings()
 
 void FSimpleFormatter::ExpandPendingNodes()
 {
-	for (TSharedPtr<FFormatXInfo> Info : NodesToExpand)
+	for (FFormatXInfo* Info : NodesToExpand)
 	{
-		if (!Info->Parent.IsValid())
+		if (Info->Parent == INDEX_NONE)
 		{
 			// UE_LOG(LogBlueprintAssist, Warning, TEXT("Expand X Invalid %s"), *FBAUtils::GetNodeName(Info->GetNode()));
 			return;
 		}
 
 		UEdGraphNode* Node = Info->GetNode();
-		UEdGraphNode* Parent = Info->Parent->GetNode();
+		UEdGraphNode* Parent = Info->GetParent()->GetNode();
 
 		auto OppositeDirection = UEdGraphPin::GetComplementaryDirection(FormatterSettings.FormatterDirection);
 		TArray<UEdGraphNode*> Children = Info->GetChildren(OppositeDirection);
@@ -384,28 +407,46 @@ void FSimpleFormatter::FormatY()
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("Format y?!?!?"));
 
 	TSet<UEdGraphNode*> NodesToCollisionCheck;
-	TSet<FPinLink> VisitedLinks;
-	TSet<UEdGraphNode*> TempChildren;
-	FormatY_Recursive(RootNode, nullptr, nullptr, NodesToCollisionCheck, VisitedLinks, true, TempChildren);
+	FPinLinkSet VisitedLinks;
+
+	// walk the tree with an explicit stack, long execution chains would overflow the call stack
+	FFormatYFrame& RootFrame = FormatYStack.Push();
+	RootFrame.Node = RootNode;
+	RootFrame.bSameRow = true;
+	FormatYEnterNode(RootFrame, NodesToCollisionCheck);
+
+	while (FormatYStack.Num() > 0)
+	{
+		FFormatYFrame& Frame = FormatYStack.Top();
+		if (FFormatYFrame* ChildFrame = FormatYNextChild(Frame, NodesToCollisionCheck, VisitedLinks))
+		{
+			FormatYEnterNode(*ChildFrame, NodesToCollisionCheck);
+			continue;
+		}
+
+		FormatYExitNode(Frame);
+
+		if (FormatYStack.Num() > 1)
+		{
+			FormatYChildFinished(FormatYStack[FormatYStack.Num() - 2], Frame);
+		}
+
+		FormatYStack.Pop();
+	}
 }
 
-void FSimpleFormatter::FormatY_Recursive(
-	UEdGraphNode* CurrentNode,
-	UEdGraphPin* CurrentPin,
-	UEdGraphPin* ParentPin,
-	TSet<UEdGraphNode*>& NodesToCollisionCheck,
-	TSet<FPinLink>& VisitedLinks,
-	bool bSameRow,
-	TSet<UEdGraphNode*>& Children)
+void FSimpleFormatter::FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck)
 {
+	UEdGraphNode* CurrentNode = Frame.Node;
+
 	// 	const FString NodeNameA = CurrentNode == nullptr
 	// 	? FString("nullptr")
 	// 	: FBAUtils::GetNodeName(CurrentNode);
-	// const FString PinNameA = CurrentPin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(CurrentPin);
-	// const FString NodeNameB = ParentPin == nullptr
+	// const FString PinNameA = Frame.Pin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(Frame.Pin);
+	// const FString NodeNameB = Frame.ParentPin == nullptr
 	// 	? FString("nullptr")
-	// 	: FBAUtils::GetNodeName(ParentPin->GetOwningNode());
-	// const FString PinNameB = ParentPin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(ParentPin);
+	// 	: FBAUtils::GetNodeName(Frame.ParentPin->GetOwningNode());
+	// const FString PinNameB = Frame.ParentPin == nullptr ? FString("nullptr") : FBAUtils::GetPinName(Frame.ParentPin);
 	//
 	// UE_LOG(LogBlueprintAssist, Warning, TEXT("FormatY Next : %s | %s || %s | %s"),
 	//        *NodeNameA, *PinNameA,
@@ -473,135 +514,168 @@ void FSimpleFormatter::FormatY_Recursive(
 
 	NodesToCollisionCheck.Emplace(CurrentNode);
 
-	TArray<TArray<UEdGraphPin*>> OutputInput;
+	Frame.MainPin = Frame.Pin;
+}
 
-	const EEdGraphPinDirection Direction = ParentPin == nullptr ? EGPD_Input : ParentPin->Direction.GetValue();
+FFormatYFrame* FSimpleFormatter::FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck, FPinLinkSet& VisitedLinks)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* ParentPin = Frame.ParentPin;
 
-	// UE_LOG(LogBlueprintAssist, Warning, TEXT("Pin Direction: %d"), Direction);
+	const EEdGraphPinDirection Direction = ParentPin == nullptr ? EGPD_Input : ParentPin->Direction.GetValue();
 
-	OutputInput.Add(FBAUtils::GetLinkedPins(CurrentNode, Direction));
-	OutputInput.Add(FBAUtils::GetLinkedPins(CurrentNode, UEdGraphPin::GetComplementaryDirection(Direction)));
+	while (true)
+	{
+		if (Frame.PinIndex >= Frame.Pins.Num())
+		{
+			Frame.DirectionIndex += 1;
+			if (Frame.DirectionIndex >= 2)
+			{
+				return nullptr;
+			}
 
-	bool bFirstPin = true;
+			const EEdGraphPinDirection NextDirection = Frame.DirectionIndex == 0 ? Direction : UEdGraphPin::GetComplementaryDirection(Direction);
+			Frame.Pins = FBAUtils::GetLinkedPins(CurrentNode, NextDirection);
+			Frame.PinIndex = 0;
+			Frame.LinkIndex = INDEX_NONE;
+			Frame.LastLinked = Frame.Pin;
+			Frame.LastProcessed = nullptr;
+			Frame.DeltaY = 0;
+			continue;
+		}
 
-	UEdGraphPin* MainPin = CurrentPin;
+		UEdGraphPin* MyPin = Frame.Pins[Frame.PinIndex];
+		if (Frame.LinkIndex == INDEX_NONE)
+		{
+			Frame.LinkedPins = MyPin->LinkedTo;
+			Frame.LinkIndex = 0;
+		}
 
-	auto& GraphHandlerCapture = GraphHandler;
+		if (Frame.LinkIndex >= Frame.LinkedPins.Num())
+		{
+			Frame.LastLinked = MyPin;
+			Frame.DeltaY += 1;
+			Frame.PinIndex += 1;
+			Frame.LinkIndex = INDEX_NONE;
+			continue;
+		}
 
-	for (TArray<UEdGraphPin*>& Pins : OutputInput)
-	{
-		UEdGraphPin* LastLinked = CurrentPin;
-		UEdGraphPin* LastProcessed = nullptr;
+		UEdGraphPin* OtherPin = Frame.LinkedPins[Frame.LinkIndex++];
+		UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
+		FPinLink Link(MyPin, OtherPin);
+		const int32 LinkId = LinkIds.GetLinkId(MyPin, OtherPin);
 
-		int DeltaY = 0;
-		for (UEdGraphPin* MyPin : Pins)
-		{
-			TArray<UEdGraphPin*> LinkedPins = MyPin->LinkedTo;
+		bool bIsSameLink = Path.Contains(Link);
 
-			for (int i = 0; i < LinkedPins.Num(); ++i)
-			{
-				UEdGraphPin* OtherPin = LinkedPins[i];
-				UEdGraphNode* OtherNode = OtherPin->GetOwningNode();
-				FPinLink Link(MyPin, OtherPin);
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tIter Child %s"), *FBAUtils::GetNodeName(OtherNode));
+		//
+		// if (!bIsSameLink)
+		// {
+		// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tNot same link!"));
+		// }
 
-				bool bIsSameLink = Path.Contains(Link);
+		if (VisitedLinks.Contains(LinkId)
+			// || !NodePool.Contains(OtherNode)
+			|| NodesToCollisionCheck.Contains(OtherNode)
+			|| !bIsSameLink)
+		{
+			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tSkipping child"));
+			continue;
+		}
+		VisitedLinks.Add(LinkId);
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\tIter Child %s"), *FBAUtils::GetNodeName(OtherNode));
-				//
-				// if (!bIsSameLink)
-				// {
-				// 	UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tNot same link!"));
-				// }
+		// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTaking Child %s"), *FBAUtils::GetNodeName(OtherNode));
 
-				if (VisitedLinks.Contains(Link)
-					// || !NodePool.Contains(OtherNode)
-					|| NodesToCollisionCheck.Contains(OtherNode)
-					|| !bIsSameLink)
-				{
-					// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tSkipping child"));
-					continue;
-				}
-				VisitedLinks.Add(Link);
+		FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
 
-				// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\tTaking Child %s"), *FBAUtils::GetNodeName(OtherNode));
+		bool bChildIsSameRow = false;
 
-				FBAUtils::StraightenPin(GraphHandler, MyPin, OtherPin);
+		if (Frame.bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction))
+		{
+			bChildIsSameRow = true;
+			Frame.bFirstPin = false;
+			// UE_LOG(LogBlueprintAssist, Error, TEXT("\t\tNode %s is same row as %s"),
+			//        *FBAUtils::GetNodeName(OtherNode),
+			//        *FBAUtils::GetNodeName(CurrentNode));
+		}
+		else
+		{
+			if (Frame.LastProcessed != nullptr)
+			{
+				//UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved node %s to %s"), *FBAUtils::GetNodeName(OtherNode), *FBAUtils::GetNodeName(LastPinOther->GetOwningNode()));
+				const int32 NewNodePosY = FMath::Max(OtherNode->NodePosY, Frame.LastProcessed->GetOwningNode()->NodePosY);
+				FBAUtils::SetNodePosY(GraphHandler, OtherNode, NewNodePosY);
+			}
+		}
 
-				bool bChildIsSameRow = false;
+		FFormatYFrame& ChildFrame = FormatYStack.Push();
+		ChildFrame.Node = OtherNode;
+		ChildFrame.Pin = OtherPin;
+		ChildFrame.ParentPin = MyPin;
+		ChildFrame.bSameRow = bChildIsSameRow;
+		return &ChildFrame;
+	}
+}
 
-				if (bFirstPin && (ParentPin == nullptr || MyPin->Direction == ParentPin->Direction))
-				{
-					bChildIsSameRow = true;
-					bFirstPin = false;
-					// UE_LOG(LogBlueprintAssist, Error, TEXT("\t\tNode %s is same row as %s"),
-					//        *FBAUtils::GetNodeName(OtherNode),
-					//        *FBAUtils::GetNodeName(CurrentNode));
-				}
-				else
-				{
-					if (LastProcessed != nullptr)
-					{
-						//UE_LOG(LogBlueprintAssist, Warning, TEXT("Moved node %s to %s"), *FBAUtils::GetNodeName(OtherNode), *FBAUtils::GetNodeName(LastPinOther->GetOwningNode()));
-						const int32 NewNodePosY = FMath::Max(OtherNode->NodePosY, LastProcessed->GetOwningNode()->NodePosY);
-						FBAUtils::SetNodePosY(GraphHandler, OtherNode, NewNodePosY);
-					}
-				}
+void FSimpleFormatter::FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame)
+{
+	const bool bChildIsSameRow = ChildFrame.bSameRow;
+	TSet<UEdGraphNode*>& LocalChildren = ChildFrame.Children;
 
-				TSet<UEdGraphNode*> LocalChildren;
-				FormatY_Recursive(OtherNode, OtherPin, MyPin, NodesToCollisionCheck, VisitedLinks, bChildIsSameRow, LocalChildren);
-				Children.Append(LocalChildren);
+	Frame.Children.Append(LocalChildren);
 
-				//UE_LOG(LogBlueprintAssist, Warning, TEXT("Local children for %s"), *FBAUtils::GetNodeName(CurrentNode));
-				//for (UEdGraphNode* Node : LocalChildren)
-				//{
-				//	UE_LOG(LogBlueprintAssist, Warning, TEXT("\tChild %s"), *FBAUtils::GetNodeName(Node));
-				//}
+	//UE_LOG(LogBlueprintAssist, Warning, TEXT("Local children for %s"), *FBAUtils::GetNodeName(Frame.Node));
+	//for (UEdGraphNode* Node : LocalChildren)
+	//{
+	//	UE_LOG(LogBlueprintAssist, Warning, TEXT("\tChild %s"), *FBAUtils::GetNodeName(Node));
+	//}
 
-				if (!bChildIsSameRow && LocalChildren.Num() > 0)
-				{
-					UEdGraphPin* PinToAvoid = LastLinked;
-					if (MainPin != nullptr)
-					{
-						PinToAvoid = MainPin;
-						MainPin = nullptr;
-					}
+	if (!bChildIsSameRow && LocalChildren.Num() > 0)
+	{
+		UEdGraphPin* PinToAvoid = Frame.LastLinked;
+		if (Frame.MainPin != nullptr)
+		{
+			PinToAvoid = Frame.MainPin;
+			Frame.MainPin = nullptr;
+		}
 
-					if (PinToAvoid != nullptr && GetDefault<UBASettings>()->bCustomDebug != 27)
-					{
-						FSlateRect Bounds = GetNodeArrayBounds(LocalChildren.Array());
+		if (PinToAvoid != nullptr && GetDefault<UBASettings>()->bCustomDebug != 27)
+		{
+			FSlateRect Bounds = GetNodeArrayBounds(LocalChildren.Array());
 
-						//UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(OtherPin));
-						const float PinPos = GraphHandler->GetPinY(PinToAvoid) + TrackSpacing;
-						const float Delta = PinPos - Bounds.Top;
+			//UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tPin to avoid %s (%s)"), *FBAUtils::GetPinName(PinToAvoid), *FBAUtils::GetPinName(ChildFrame.Pin));
+			const float PinPos = GraphHandler->GetPinY(PinToAvoid) + TrackSpacing;
+			const float Delta = PinPos - Bounds.Top;
 
-						if (Delta > 0)
-						{
-							for (UEdGraphNode* Child : LocalChildren)
-							{
-								Child->NodePosY += Delta;
-							}
-						}
-					}
+			if (Delta > 0)
+			{
+				for (UEdGraphNode* Child : LocalChildren)
+				{
+					Child->NodePosY += Delta;
 				}
-
-				LastProcessed = OtherPin;
 			}
-
-			LastLinked = MyPin;
-
-			DeltaY += 1;
 		}
 	}
 
-	Children.Add(CurrentNode);
+	Frame.LastProcessed = ChildFrame.Pin;
+}
+
+void FSimpleFormatter::FormatYExitNode(FFormatYFrame& Frame)
+{
+	UEdGraphNode* CurrentNode = Frame.Node;
+	UEdGraphPin* CurrentPin = Frame.Pin;
+	UEdGraphPin* ParentPin = Frame.ParentPin;
 
-	if (bSameRow && ParentPin != nullptr)
+	Frame.Children.Add(CurrentNode);
+
+	if (Frame.bSameRow && ParentPin != nullptr)
 	{
 		//UE_LOG(LogBlueprintAssist, Warning, TEXT("\t\t\tStraightening pin from %s to %s"),
 		//       *FBAUtils::GetPinName(CurrentPin),
 		//       *FBAUtils::GetPinName(ParentPin));
-		SameRowMapping.Add(FPinLink(CurrentPin, ParentPin));
-		SameRowMapping.Add(FPinLink(ParentPin, CurrentPin));
+		SameRowMapping.Add(LinkIds.GetLinkId(CurrentPin, ParentPin));
+		SameRowMapping.Add(LinkIds.GetLinkId(ParentPin, CurrentPin));
+		Rows.JoinRows(CurrentNode, ParentPin->GetOwningNode());
 		FBAUtils::StraightenPin(GraphHandler, CurrentPin, ParentPin);
 	}
 }
@@ -614,6 +688,8 @@ TSet<UEdGraphNode*> FSimpleFormatter::GetFormattedNodes()
 void FSimpleFormatter::ExpandCommentsX()
 {
 	// UE_LOG(LogTemp, Warning, TEXT("EXPAND COMMENTS X Comments"));
+	CommentHandler.MarkAllBoundsDirty();
+
 	TArray<UEdGraphNode*> Contains = GetFormattedNodes().Array();
 
 	TArray<UEdGraphNode_Comment*> Comments = CommentHandler.GetComments().Array();
@@ -639,50 +715,32 @@ void FSimpleFormatter::ExpandCommentsX()
 
 	// UE_LOG(LogTemp, Warning, TEXT("EXPAND COMMENTS X Comments %d"), Comments.Num());
 
-	TSet<UEdGraphNode*> Temp;
-	ExpandCommentsX_Recursive(Contains, Temp);
+	FBAFormatterUtils::ExpandCommentsNested(
+		CommentExpandStack,
+		CommentHandler,
+		MoveTemp(Contains),
+		[&](TArray<UEdGraphNode*>& NodeSet)
+		{
+			const auto LeftMost = [&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
+			{
+				const float LeftA = GetNodeBounds(&NodeA).Left;
+				const float LeftB = GetNodeBounds(&NodeB).Left;
+				return FormatterSettings.FormatterDirection == EGPD_Output
+					? LeftA < LeftB
+					: LeftA > LeftB;
+			};
+
+			NodeSet.StableSort(LeftMost);
+		},
+		[&](UEdGraphNode_Comment* Comment, const TArray<UEdGraphNode*>& NodeSet) { return CommentHandler.GetNodesUnderComments(Comment); },
+		[&](FCommentExpandFrame& Frame) { ExpandCommentNodeSetX(Frame); });
 }
 
-void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes)
+void FSimpleFormatter::ExpandCommentNodeSetX(FCommentExpandFrame& Frame)
 {
-	const auto LeftMost = [&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
-	{
-		const float LeftA = GetNodeBounds(&NodeA).Left;
-		const float LeftB = GetNodeBounds(&NodeB).Left;
-		return FormatterSettings.FormatterDirection == EGPD_Output
-			? LeftA < LeftB
-			: LeftA > LeftB;
-	};
-
-	NodeSet.StableSort(LeftMost);
-
-	TSet<UEdGraphNode*> HandledNodes;
-	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>> CommentContains;
-
-	TArray<UEdGraphNode_Comment*> Comments = FBAUtils::GetNodesOfClass<UEdGraphNode_Comment>(NodeSet);
-	Comments.StableSort([&](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
-	{
-		return CommentHandler.GetCommentDepth(&CommentA) < CommentHandler.GetCommentDepth(&CommentB);
-	});
-
-	for (UEdGraphNode_Comment* Comment : Comments)
-	{
-		if (HandledNodes.Contains(Comment))
-		{
-			continue;
-		}
-
-		TSet<UEdGraphNode*> LocalHandled;
-		ExpandCommentsX_Recursive(CommentHandler.GetNodesUnderComments(Comment), LocalHandled);
-		HandledNodes.Append(LocalHandled);
-		CommentContains.Add(Comment, LocalHandled);
-	}
-
-	OutHandledNodes.Append(NodeSet);
-
-	// Remove all handled nodes from subgraphs
-	NodeSet.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
-	Comments.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
+	TArray<UEdGraphNode*>& NodeSet = Frame.NodeSet;
+	TArray<UEdGraphNode_Comment*>& Comments = Frame.Comments;
+	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>>& CommentContains = Frame.CommentContains;
 
 	// UE_LOG(LogTemp, Warning, TEXT("Format SubGraph"));
 	// for (UEdGraphNode* Node : NodeSet)
@@ -693,22 +751,28 @@ void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 	for (UEdGraphNode* NodeA : NodeSet)
 	{
 		// collide only with our children
-		TSet<TSharedPtr<FFormatXInfo>> Children;
+		TSet<FFormatXInfo*> Children;
 		if (UEdGraphNode_Comment* CommentA = Cast<UEdGraphNode_Comment>(NodeA))
 		{
 			for (UEdGraphNode* Node : CommentContains[CommentA])
 			{
-				if (TSharedPtr<FFormatXInfo> FormatXInfo = FormatXInfoMap.FindRef(Node))
+				if (FFormatXInfo* FormatXInfo = FormatXInfoMap.FindRef(Node))
 				{
-					Children.Append(FormatXInfo->Children);
+					for (int32 ChildIndex : FormatXInfo->Children)
+					{
+						Children.Add(FormatXArena.Get(ChildIndex));
+					}
 				}
 			}
 		}
 		else
 		{
-			if (TSharedPtr<FFormatXInfo> FormatXInfo = FormatXInfoMap.FindRef(NodeA))
+			if (FFormatXInfo* FormatXInfo = FormatXInfoMap.FindRef(NodeA))
 			{
-				Children.Append(FormatXInfo->Children);
+				for (int32 ChildIndex : FormatXInfo->Children)
+				{
+					Children.Add(FormatXArena.Get(ChildIndex));
+				}
 			}
 		}
 
@@ -718,13 +782,13 @@ void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 		// 	UE_LOG(LogTemp, Warning, TEXT("\t%s"), *FBAUtils::GetNodeName(Info->GetNode()));
 		// }
 
-		for (TSharedPtr<FFormatXInfo> Info : Children)
+		for (FFormatXInfo* Info : Children)
 		{
 			UEdGraphNode* NodeB = Info->GetNode();
 
 			// UE_LOG(LogTemp, Warning, TEXT("TRY {%s} Checking {%s}"), *FBAUtils::GetNodeName(NodeA), *FBAUtils::GetNodeName(NodeB));
 
-			if (!SameRowMapping.Contains(Info->Link))
+			if (!SameRowMapping.Contains(LinkIds.GetLinkId(Info->Link)))
 			{
 				// UE_LOG(LogTemp, Warning, TEXT("\tNOt same row skipping"));
 				continue;
@@ -813,6 +877,7 @@ void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 					for (auto Child : AllChildren)
 					{
 						Child->NodePosX += Delta;
+						CommentHandler.MarkNodeMoved(Child);
 						// UE_LOG(LogTemp, Warning, TEXT("\tMove child %s"), *FBAUtils::GetNodeName(Child));
 					}
 
@@ -829,9 +894,11 @@ void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 					// UE_LOG(LogTemp, Warning, TEXT("COMMENT {%s} Colliding with Node {%s}"), *FBAUtils::GetNodeName(NodeA), *FBAUtils::GetNodeName(NodeB));
 
 					NodeB->NodePosX += Delta;
+					CommentHandler.MarkNodeMoved(NodeB);
 					for (auto Child : FormatXInfoMap[NodeB]->GetChildren())
 					{
 						Child->NodePosX += Delta;
+						CommentHandler.MarkNodeMoved(Child);
 						// UE_LOG(LogTemp, Warning, TEXT("\tMove child %s"), *FBAUtils::GetNodeName(Child));
 					}
 				}
@@ -843,6 +910,8 @@ void FSimpleFormatter::ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet,
 void FSimpleFormatter::ExpandCommentsY()
 {
 	// UE_LOG(LogTemp, Error, TEXT("EXPAND COMMENTS Y"));
+	CommentHandler.MarkAllBoundsDirty();
+
 	TArray<UEdGraphNode*> Contains = GetFormattedNodes().Array();
 	TArray<UEdGraphNode_Comment*> Comments = CommentHandler.GetComments().Array();
 	Comments.RemoveAll([&Contains](UEdGraphNode_Comment* Comment)
@@ -862,69 +931,41 @@ void FSimpleFormatter::ExpandCommentsY()
 
 	Contains.Append(Comments);
 
-	TSet<UEdGraphNode*> Temp;
-	ExpandCommentsY_Recursive(Contains, Temp);
+	FBAFormatterUtils::ExpandCommentsNested(
+		CommentExpandStack,
+		CommentHandler,
+		MoveTemp(Contains),
+		[&](TArray<UEdGraphNode*>& NodeSet)
+		{
+			NodeSet.StableSort([&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
+			{
+				float TopA = GetNodeBounds(&NodeA).Top;
+				if (auto Comment = Cast<UEdGraphNode_Comment>(&NodeA))
+				{
+					auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
+					Nodes.RemoveAll(FBAUtils::IsCommentNode);
+					TopA = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
+				}
+
+				float TopB = GetNodeBounds(&NodeB).Top;
+				if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(&NodeB))
+				{
+					auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
+					Nodes.RemoveAll(FBAUtils::IsCommentNode);
+					TopB = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
+				}
+				return TopA < TopB;
+			});
+		},
+		[&](UEdGraphNode_Comment* Comment, const TArray<UEdGraphNode*>& NodeSet) { return CommentHandler.GetNodesUnderComments(Comment); },
+		[&](FCommentExpandFrame& Frame) { ExpandCommentNodeSetY(Frame); });
 	// UE_LOG(LogTemp, Error, TEXT("END EXPAND COMMENTS Y"));
 }
 
-void FSimpleFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes)
+void FSimpleFormatter::ExpandCommentNodeSetY(FCommentExpandFrame& Frame)
 {
-	NodeSet.StableSort([&](UEdGraphNode& NodeA, UEdGraphNode& NodeB)
-	{
-		float TopA = GetNodeBounds(&NodeA).Top;
-		if (auto Comment = Cast<UEdGraphNode_Comment>(&NodeA))
-		{
-			auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
-			Nodes.RemoveAll(FBAUtils::IsCommentNode);
-			TopA = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
-		}
-
-		float TopB = GetNodeBounds(&NodeB).Top;
-		if (UEdGraphNode_Comment* Comment = Cast<UEdGraphNode_Comment>(&NodeB))
-		{
-			auto Nodes = FBAUtils::GetNodesUnderComment(Comment);
-			Nodes.RemoveAll(FBAUtils::IsCommentNode);
-			TopB = FBAUtils::GetCachedNodeArrayBounds(GraphHandler, Nodes).Top;
-		}
-		return TopA < TopB;
-	});
-
-	TSet<UEdGraphNode*> HandledNodes;
-	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>> CommentContains;
-
-	TArray<UEdGraphNode_Comment*> Comments = FBAUtils::GetNodesOfClass<UEdGraphNode_Comment>(NodeSet);
-	Comments.StableSort([&](const UEdGraphNode_Comment& CommentA, const UEdGraphNode_Comment& CommentB)
-	{
-		return CommentHandler.GetCommentDepth(&CommentA) < CommentHandler.GetCommentDepth(&CommentB);
-	});
-
-	for (UEdGraphNode_Comment* Comment : Comments)
-	{
-		if (HandledNodes.Contains(Comment))
-		{
-			continue;
-		}
-
-		TSet<UEdGraphNode*> LocalHandled;
-		ExpandCommentsY_Recursive(CommentHandler.GetNodesUnderComments(Comment), LocalHandled);
-		HandledNodes.Append(LocalHandled);
-		CommentContains.Add(Comment, LocalHandled);
-	}
-
-	// for (auto kvp: CommentContains)
-	// {
-	// 	UE_LOG(LogTemp, Warning, TEXT("%s"), *FBAUtils::GetNodeName(kvp.Key));
-	// 	for (UEdGraphNode* Node : kvp.Value)
-	// 	{
-	// 		UE_LOG(LogTemp, Warning, TEXT("Contains %s"), *FBAUtils::GetNodeName(Node));
-	// 	}
-	// }
-
-	OutHandledNodes.Append(NodeSet);
-
-	// Remove all handled nodes from subgraphs
-	NodeSet.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
-	Comments.RemoveAll([&HandledNodes](UEdGraphNode* Node) { return HandledNodes.Contains(Node); });
+	TArray<UEdGraphNode*>& NodeSet = Frame.NodeSet;
+	TMap<UEdGraphNode_Comment*, TSet<UEdGraphNode*>>& CommentContains = Frame.CommentContains;
 
 	// UE_LOG(LogTemp, Warning, TEXT("Format SubGraph"));
 	// for (UEdGraphNode* Node : NodeSet)
@@ -981,13 +1022,14 @@ void FSimpleFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 					for (UEdGraphNode* Node : CommentContains[CommentB])
 					{
 						Node->NodePosY += Delta;
+						CommentHandler.MarkNodeMoved(Node);
 					}
 
 					// for (UEdGraphNode* Node : FBAUtils::GetNodesUnderComment(CommentB))
 					for (UEdGraphNode* Node : CommentContains[CommentB])
 					{
-						FBAFormatterUtils::StraightenRow(GraphHandler, SameRowMapping, Node);
-						// FBAFormatterUtils::StraightenRowWithFilter(GraphHandler, SameRowMapping, Node, [&](const FPinLink& Link) { return NodeSet.Contains(Link.GetNode()); });
+						FBAFormatterUtils::StraightenRow(GraphHandler, LinkIds, SameRowMapping, Node, &CommentHandler);
+						// FBAFormatterUtils::StraightenRowWithFilter(GraphHandler, LinkIds, SameRowMapping, Node, [&](const FPinLink& Link) { return NodeSet.Contains(Link.GetNode()); });
 					}
 
 					// UE_LOG(LogTemp, Warning, TEXT("\t{%s} Colliding with COMMENT {%s}"), *FBAUtils::GetNodeName(NodeA), *FBAUtils::GetNodeName(NodeB));
@@ -997,7 +1039,8 @@ void FSimpleFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 				else
 				{
 					NodeB->NodePosY += Delta;
-					FBAFormatterUtils::StraightenRowWithFilter(GraphHandler, SameRowMapping, NodeB, [&](const FPinLink& Link) { return NodeSet.Contains(Link.GetNode()); });
+					CommentHandler.MarkNodeMoved(NodeB);
+					FBAFormatterUtils::StraightenRowWithFilter(GraphHandler, LinkIds, SameRowMapping, NodeB, [&](const FPinLink& Link) { return NodeSet.Contains(Link.GetNode()); }, &CommentHandler);
 
 					// NodeB->NodePosY += Delta;
 					// if (TSharedPtr<FFormatXInfo> Info = FormatXInfoMap.FindRef(NodeB))
@@ -1014,3 +1057,398 @@ void FSimpleFormatter::ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet,
 		}
 	}
 }
+
+void FSimpleFormatter::FormatFast()
+{
+	BA_TRACE_SCOPE(BA_SimpleFormatFast);
+
+	FastGatherNodes();
+	FastRemoveCycles();
+	FastFormatX();
+	FastFormatY();
+	FastResolveOverlaps();
+
+	FormattedNodes.Reset();
+	FormattedNodes.Reserve(FastNodes.Num());
+	for (const FBASimpleFastNode& FastNode : FastNodes)
+	{
+		FastNode.Node->NodePosX = FMath::RoundToInt(FastNode.Pos.X + FastNode.Inset.X);
+		FastNode.Node->NodePosY = FMath::RoundToInt(FastNode.Pos.Y + FastNode.Inset.Y);
+		FormattedNodes.Add(FastNode.Node);
+	}
+}
+
+void FSimpleFormatter::FastGatherNodes()
+{
+	FastNodes.Reset();
+
+	TMap<UEdGraphNode*, int32> NodeIndices;
+	NodeIndices.Add(RootNode, FastNodes.Num());
+	FastNodes.AddDefaulted_GetRef().Node = RootNode;
+
+	// nodes are indexed in discovery order, which is also the order of the first column
+	for (int32 Index = 0; Index < FastNodes.Num(); ++Index)
+	{
+		UEdGraphNode* Node = FastNodes[Index].Node;
+
+		for (UEdGraphPin* Pin : FBAUtils::GetLinkedPins(Node))
+		{
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+
+				int32 LinkedIndex;
+				if (const int32* FoundIndex = NodeIndices.Find(LinkedNode))
+				{
+					LinkedIndex = *FoundIndex;
+				}
+				else
+				{
+					LinkedIndex = FastNodes.Num();
+					NodeIndices.Add(LinkedNode, LinkedIndex);
+					FastNodes.AddDefaulted_GetRef().Node = LinkedNode;
+				}
+
+				// each link is only added from the node whose pin is in the formatter direction
+				if (Pin->Direction == FormatterSettings.FormatterDirection && LinkedIndex != Index)
+				{
+					FastNodes[Index].Next.AddUnique(LinkedIndex);
+				}
+			}
+		}
+	}
+
+	for (FBASimpleFastNode& FastNode : FastNodes)
+	{
+		const FSlateRect Bounds = GetNodeBounds(FastNode.Node);
+		FastNode.Pos = FVector2D(Bounds.Left, Bounds.Top);
+		FastNode.Size = Bounds.GetSize();
+		FastNode.Inset = FVector2D(FastNode.Node->NodePosX - Bounds.Left, FastNode.Node->NodePosY - Bounds.Top);
+	}
+}
+
+void FSimpleFormatter::FastRemoveCycles()
+{
+	// drop the back edges found by a depth first search from the root, leaving a DAG
+	enum EVisitState : uint8 { Unvisited, OnStack, Finished };
+
+	TArray<uint8> VisitState;
+	VisitState.SetNumZeroed(FastNodes.Num());
+
+	TArray<TPair<int32, int32>> Stack;
+	for (int32 StartIndex = 0; StartIndex < FastNodes.Num(); ++StartIndex)
+	{
+		if (VisitState[StartIndex] != Unvisited)
+		{
+			continue;
+		}
+
+		VisitState[StartIndex] = OnStack;
+		Stack.Emplace(StartIndex, 0);
+
+		while (Stack.Num() > 0)
+		{
+			const int32 Index = Stack.Last().Key;
+			int32& NextIndex = Stack.Last().Value;
+			TArray<int32, TInlineAllocator<4>>& Next = FastNodes[Index].Next;
+
+			if (NextIndex >= Next.Num())
+			{
+				VisitState[Index] = Finished;
+				Stack.Pop(false);
+				continue;
+			}
+
+			const int32 ChildIndex = Next[NextIndex];
+			if (VisitState[ChildIndex] == OnStack)
+			{
+				Next.RemoveAt(NextIndex);
+				continue;
+			}
+
+			NextIndex += 1;
+
+			if (VisitState[ChildIndex] == Unvisited)
+			{
+				VisitState[ChildIndex] = OnStack;
+				Stack.Emplace(ChildIndex, 0);
+			}
+		}
+	}
+
+	for (int32 Index = 0; Index < FastNodes.Num(); ++Index)
+	{
+		for (int32 ChildIndex : FastNodes[Index].Next)
+		{
+			FastNodes[ChildIndex].Prev.Add(Index);
+		}
+	}
+}
+
+void FSimpleFormatter::FastFormatX()
+{
+	// Kahn's algorithm, seeded in discovery order so the root comes first
+	TArray<int32> InDegree;
+	InDegree.SetNumUninitialized(FastNodes.Num());
+
+	FastOrder.Reset(FastNodes.Num());
+	for (int32 Index = 0; Index < FastNodes.Num(); ++Index)
+	{
+		InDegree[Index] = FastNodes[Index].Prev.Num();
+		if (InDegree[Index] == 0)
+		{
+			FastOrder.Add(Index);
+		}
+	}
+
+	for (int32 OrderIndex = 0; OrderIndex < FastOrder.Num(); ++OrderIndex)
+	{
+		for (int32 ChildIndex : FastNodes[FastOrder[OrderIndex]].Next)
+		{
+			InDegree[ChildIndex] -= 1;
+			if (InDegree[ChildIndex] == 0)
+			{
+				FastOrder.Add(ChildIndex);
+			}
+		}
+	}
+
+	const bool bOutput = FormatterSettings.FormatterDirection == EGPD_Output;
+	const float PaddingX = FormatterSettings.Padding.X;
+	const float RootX = FastNodes[0].Pos.X;
+
+	// each node goes just past the furthest of its parents
+	for (int32 Index : FastOrder)
+	{
+		FBASimpleFastNode& FastNode = FastNodes[Index];
+		if (FastNode.Prev.Num() == 0)
+		{
+			FastNode.Layer = 0;
+			FastNode.Pos.X = RootX;
+			continue;
+		}
+
+		float NewX = bOutput ? -FLT_MAX : FLT_MAX;
+		int32 NewLayer = 0;
+		for (int32 ParentIndex : FastNode.Prev)
+		{
+			const FBASimpleFastNode& Parent = FastNodes[ParentIndex];
+			NewLayer = FMath::Max(NewLayer, Parent.Layer + 1);
+			NewX = bOutput
+				? FMath::Max(NewX, Parent.Pos.X + Parent.Size.X + PaddingX)
+				: FMath::Min(NewX, Parent.Pos.X - PaddingX - FastNode.Size.X);
+		}
+
+		FastNode.Layer = NewLayer;
+		FastNode.Pos.X = NewX;
+	}
+
+	// pull the other source nodes up to their children instead of leaving them in the first column
+	for (int32 OrderIndex = FastOrder.Num() - 1; OrderIndex >= 0; --OrderIndex)
+	{
+		FBASimpleFastNode& FastNode = FastNodes[FastOrder[OrderIndex]];
+		if (FastNode.Prev.Num() > 0 || FastNode.Next.Num() == 0 || FastNode.Node == RootNode)
+		{
+			continue;
+		}
+
+		float NewX = bOutput ? FLT_MAX : -FLT_MAX;
+		int32 NewLayer = MAX_int32;
+		for (int32 ChildIndex : FastNode.Next)
+		{
+			const FBASimpleFastNode& Child = FastNodes[ChildIndex];
+			NewLayer = FMath::Min(NewLayer, Child.Layer - 1);
+			NewX = bOutput
+				? FMath::Min(NewX, Child.Pos.X - PaddingX - FastNode.Size.X)
+				: FMath::Max(NewX, Child.Pos.X + Child.Size.X + PaddingX);
+		}
+
+		FastNode.Layer = NewLayer;
+		FastNode.Pos.X = NewX;
+	}
+}
+
+void FSimpleFormatter::FastFormatY()
+{
+	int32 MinLayer = 0;
+	int32 MaxLayer = 0;
+	for (const FBASimpleFastNode& FastNode : FastNodes)
+	{
+		MinLayer = FMath::Min(MinLayer, FastNode.Layer);
+		MaxLayer = FMath::Max(MaxLayer, FastNode.Layer);
+	}
+
+	TArray<TArray<int32>> Columns;
+	Columns.SetNum(MaxLayer - MinLayer + 1);
+	for (int32 Index : FastOrder)
+	{
+		Columns[FastNodes[Index].Layer - MinLayer].Add(Index);
+	}
+
+	const float PaddingY = FormatterSettings.Padding.Y;
+	const float RootY = FastNodes[0].Pos.Y;
+
+	// the columns are placed from the root's column outwards so every node has a placed neighbour to line up with
+	const int32 RootColumn = FastNodes[0].Layer - MinLayer;
+	TArray<int32> ColumnOrder;
+	ColumnOrder.Add(RootColumn);
+	for (int32 Offset = 1; RootColumn + Offset < Columns.Num() || RootColumn - Offset >= 0; ++Offset)
+	{
+		if (RootColumn + Offset < Columns.Num())
+		{
+			ColumnOrder.Add(RootColumn + Offset);
+		}
+
+		if (RootColumn - Offset >= 0)
+		{
+			ColumnOrder.Add(RootColumn - Offset);
+		}
+	}
+
+	TArray<bool> Placed;
+	Placed.SetNumZeroed(FastNodes.Num());
+
+	TArray<float> DesiredY;
+	DesiredY.SetNumUninitialized(FastNodes.Num());
+
+	for (int32 ColumnIndex : ColumnOrder)
+	{
+		TArray<int32>& Column = Columns[ColumnIndex];
+
+		// line up with the average of the placed parents (or children for columns before the root)
+		for (int32 OrderIndex = 0; OrderIndex < Column.Num(); ++OrderIndex)
+		{
+			const FBASimpleFastNode& FastNode = FastNodes[Column[OrderIndex]];
+
+			float SumY = 0;
+			int32 NumPlaced = 0;
+			for (const auto* Neighbours : { &FastNode.Prev, &FastNode.Next })
+			{
+				for (int32 NeighbourIndex : *Neighbours)
+				{
+					if (Placed[NeighbourIndex])
+					{
+						SumY += FastNodes[NeighbourIndex].Pos.Y;
+						NumPlaced += 1;
+					}
+				}
+			}
+
+			// unlinked nodes keep their order below the previous node
+			DesiredY[Column[OrderIndex]] = NumPlaced > 0 ? SumY / NumPlaced : RootY + OrderIndex;
+		}
+
+		Column.StableSort([&DesiredY](int32 A, int32 B) { return DesiredY[A] < DesiredY[B]; });
+
+		float NextTop = -FLT_MAX;
+		for (int32 Index : Column)
+		{
+			FBASimpleFastNode& FastNode = FastNodes[Index];
+			FastNode.Pos.Y = FMath::Max(DesiredY[Index], NextTop);
+			NextTop = FastNode.Pos.Y + FastNode.Size.Y + PaddingY;
+			Placed[Index] = true;
+		}
+	}
+}
+
+void FSimpleFormatter::FastResolveOverlaps()
+{
+	// nodes in a column can't overlap, but nodes of different widths can reach into the next column
+	const FVector2D CollisionPadding(FormatterSettings.Padding.X * 0.75f, FormatterSettings.Padding.Y);
+
+	// size the cells from the median node so a few very large nodes don't make every cell huge
+	TArray<float> Widths;
+	TArray<float> Heights;
+	Widths.Reserve(FastNodes.Num());
+	Heights.Reserve(FastNodes.Num());
+	for (const FBASimpleFastNode& FastNode : FastNodes)
+	{
+		Widths.Add(FastNode.Size.X);
+		Heights.Add(FastNode.Size.Y);
+	}
+
+	Widths.Sort();
+	Heights.Sort();
+
+	const float TypicalWidth = Widths.Num() > 0 ? Widths[Widths.Num() / 2] : 0.0f;
+	const float TypicalHeight = Heights.Num() > 0 ? Heights[Heights.Num() / 2] : 0.0f;
+
+	const FVector2D CellSize(FMath::Max(TypicalWidth, 1.0f) + CollisionPadding.X, FMath::Max(TypicalHeight, 1.0f) + CollisionPadding.Y);
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	const auto GetCell = [&CellSize](const FVector2D& Point)
+	{
+		return FIntPoint(FMath::FloorToInt(Point.X / CellSize.X), FMath::FloorToInt(Point.Y / CellSize.Y));
+	};
+
+	// a node covers every cell its padded bounds touch, so two colliding nodes always share a cell
+	const auto GetCoveredCells = [&](const FBASimpleFastNode& FastNode, FIntPoint& OutMin, FIntPoint& OutMax)
+	{
+		OutMin = GetCell(FastNode.Pos);
+		OutMax = GetCell(FastNode.Pos + FastNode.Size + CollisionPadding);
+	};
+
+	const auto Intersects = [&](const FBASimpleFastNode& A, const FBASimpleFastNode& B)
+	{
+		return A.Pos.X < B.Pos.X + B.Size.X + CollisionPadding.X && B.Pos.X < A.Pos.X + A.Size.X + CollisionPadding.X
+			&& A.Pos.Y < B.Pos.Y + B.Size.Y + CollisionPadding.Y && B.Pos.Y < A.Pos.Y + A.Size.Y + CollisionPadding.Y;
+	};
+
+	// place the nodes column by column from the top, a colliding node is pushed below what it hit
+	TArray<int32> PlaceOrder = FastOrder;
+	PlaceOrder.StableSort([this](int32 A, int32 B)
+	{
+		const FBASimpleFastNode& NodeA = FastNodes[A];
+		const FBASimpleFastNode& NodeB = FastNodes[B];
+		return NodeA.Layer != NodeB.Layer ? NodeA.Layer < NodeB.Layer : NodeA.Pos.Y < NodeB.Pos.Y;
+	});
+
+	for (int32 Index : PlaceOrder)
+	{
+		FBASimpleFastNode& FastNode = FastNodes[Index];
+
+		// each push moves the node below one of the placed nodes it hit, and it only ever moves down,
+		// so it can't hit that node again and this ends after at most one push per placed node
+		while (true)
+		{
+			FIntPoint MinCell, MaxCell;
+			GetCoveredCells(FastNode, MinCell, MaxCell);
+			float PushY = -FLT_MAX;
+
+			for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+			{
+				for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+				{
+					if (const TArray<int32>* CellNodes = Cells.Find(FIntPoint(CellX, CellY)))
+					{
+						for (int32 OtherIndex : *CellNodes)
+						{
+							const FBASimpleFastNode& Other = FastNodes[OtherIndex];
+							if (Intersects(FastNode, Other))
+							{
+								PushY = FMath::Max(PushY, Other.Pos.Y + Other.Size.Y + CollisionPadding.Y);
+							}
+						}
+					}
+				}
+			}
+
+			if (PushY == -FLT_MAX)
+			{
+				break;
+			}
+
+			FastNode.Pos.Y = PushY;
+		}
+
+		FIntPoint MinCell, MaxCell;
+		GetCoveredCells(FastNode, MinCell, MaxCell);
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+		{
+			for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+			{
+				Cells.FindOrAdd(FIntPoint(CellX, CellY)).Add(Index);
+			}
+		}
+	}
+}
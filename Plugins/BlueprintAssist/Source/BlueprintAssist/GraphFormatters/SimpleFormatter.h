@@ -7,6 +7,23 @@
 #include "BlueprintAssistGraphHandler.h"
 #include "FormatterInterface.h"
 
+/* A node in the fast mode of the simple formatter, links are indices into the node array */
+struct FBASimpleFastNode
+{
+	UEdGraphNode* Node = nullptr;
+
+	/* Nodes linked from a pin in the formatter direction, Prev is the reverse */
+	TArray<int32, TInlineAllocator<4>> Next;
+	TArray<int32, TInlineAllocator<4>> Prev;
+
+	int32 Layer = 0;
+
+	/* Top left and size of the bounds, the inset is the offset from the bounds to the node position (comment bubbles) */
+	FVector2D Pos = FVector2D::ZeroVector;
+	FVector2D Size = FVector2D::ZeroVector;
+	FVector2D Inset = FVector2D::ZeroVector;
+};
+
 class BLUEPRINTASSIST_API FSimpleFormatter
 	: public FFormatterInterface
 {
@@ -17,15 +34,26 @@ public:
 	UEdGraphNode* RootNode;
 	virtual UEdGraphNode* GetRootNode() override { return RootNode; }
 	TSet<UEdGraphNode*> FormattedNodes;
-	TMap<UEdGraphNode*, TSharedPtr<FFormatXInfo>> FormatXInfoMap;
-	TMap<FPinLink, bool> SameRowMapping;
+	TFormatterArena<FFormatXInfo> FormatXArena;
+	TMap<UEdGraphNode*, FFormatXInfo*> FormatXInfoMap;
+	FPinLinkIds LinkIds;
+	FPinLinkSet SameRowMapping;
+	FNodeRowSets Rows;
 
-	TSet<TSharedPtr<FFormatXInfo>> NodesToExpand;
+	TSet<FFormatXInfo*> NodesToExpand;
 
 	TArray<FPinLink> Path;
 
 	FCommentHandler CommentHandler;
 
+	/* Scratch stacks reused by every format */
+	TFormatterStack<FFormatYFrame> FormatYStack;
+	TFormatterStack<FCommentExpandFrame> CommentExpandStack;
+
+	/* Fast mode, nodes in topological order once FastFormatX has run */
+	TArray<FBASimpleFastNode> FastNodes;
+	TArray<int32> FastOrder;
+
 	FSimpleFormatter(TSharedPtr<FBAGraphHandler> InGraphHandler);
 
 	virtual ~FSimpleFormatter() override { }
@@ -38,14 +66,14 @@ public:
 
 	void FormatY();
 
-	void FormatY_Recursive(
-		UEdGraphNode* CurrentNode,
-		UEdGraphPin* CurrentPin,
-		UEdGraphPin* ParentPin,
-		TSet<UEdGraphNode*>& NodesToCollisionCheck,
-		TSet<FPinLink>& VisitedLinks,
-		bool bSameRow,
-		TSet<UEdGraphNode*>& Children);
+	void FormatYEnterNode(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck);
+
+	/* Push the next child of the frame onto FormatYStack, returns null once all children are formatted */
+	FFormatYFrame* FormatYNextChild(FFormatYFrame& Frame, TSet<UEdGraphNode*>& NodesToCollisionCheck, FPinLinkSet& VisitedLinks);
+
+	void FormatYChildFinished(FFormatYFrame& Frame, FFormatYFrame& ChildFrame);
+
+	void FormatYExitNode(FFormatYFrame& Frame);
 
 	virtual TSet<UEdGraphNode*> GetFormattedNodes() override;
 
@@ -57,8 +85,15 @@ public:
 	FSlateRect GetNodeArrayBounds(const TArray<UEdGraphNode*>& Nodes);
 
 	void ExpandCommentsX();
-	void ExpandCommentsX_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes);
+	void ExpandCommentNodeSetX(FCommentExpandFrame& Frame);
 
 	void ExpandCommentsY();
-	void ExpandCommentsY_Recursive(TArray<UEdGraphNode*> NodeSet, TSet<UEdGraphNode*>& OutHandledNodes);
+	void ExpandCommentNodeSetY(FCommentExpandFrame& Frame);
+
+	void FormatFast();
+	void FastGatherNodes();
+	void FastRemoveCycles();
+	void FastFormatX();
+	void FastFormatY();
+	void FastResolveOverlaps();
 };
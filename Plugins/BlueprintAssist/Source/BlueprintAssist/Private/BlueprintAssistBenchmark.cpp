@@ -0,0 +1,596 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "BlueprintAssistBenchmark.h"
+
+#include "BlueprintAssistGlobals.h"
+#include "BlueprintAssistGraphHandler.h"
+#include "BlueprintAssistUtils.h"
+#include "EdGraphNode_Comment.h"
+#include "EdGraphSchema_K2.h"
+#include "K2Node_CallFunction.h"
+#include "K2Node_CustomEvent.h"
+#include "K2Node_ExecutionSequence.h"
+#include "K2Node_IfThenElse.h"
+#include "BlueprintAssist/GraphFormatters/BehaviorTreeGraphFormatter.h"
+#include "BlueprintAssist/GraphFormatters/EdGraphFormatter.h"
+#include "BlueprintAssist/GraphFormatters/LayeredFormatter.h"
+#include "BlueprintAssist/GraphFormatters/SimpleFormatter.h"
+#include "EdGraph/EdGraph.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Kismet/KismetMathLibrary.h"
+#include "Kismet/KismetStringLibrary.h"
+#include "Kismet/KismetSystemLibrary.h"
+#include "Kismet2/BlueprintEditorUtils.h"
+#include "Kismet2/KismetEditorUtilities.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	const FVector2D BenchmarkCellSize(400, 200);
+
+	template<typename NodeType>
+	NodeType* SpawnNode(UEdGraph* Graph, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes, TFunctionRef<void(NodeType*)> SetupNode)
+	{
+		FGraphNodeCreator<NodeType> NodeCreator(*Graph);
+		NodeType* Node = NodeCreator.CreateNode(false);
+		SetupNode(Node);
+		NodeCreator.Finalize();
+
+		Node->NodePosX = Cell.X * BenchmarkCellSize.X;
+		Node->NodePosY = Cell.Y * BenchmarkCellSize.Y;
+
+		OutNodes.Add(Node);
+		return Node;
+	}
+
+	UK2Node_CallFunction* SpawnCallFunction(UEdGraph* Graph, UClass* Class, FName FunctionName, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		return SpawnNode<UK2Node_CallFunction>(Graph, Cell, OutNodes, [Class, FunctionName](UK2Node_CallFunction* Node)
+		{
+			Node->SetFromFunction(Class->FindFunctionByName(FunctionName));
+		});
+	}
+
+	UK2Node_CallFunction* SpawnPrintString(UEdGraph* Graph, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		return SpawnCallFunction(Graph, UKismetSystemLibrary::StaticClass(), GET_FUNCTION_NAME_CHECKED(UKismetSystemLibrary, PrintString), Cell, OutNodes);
+	}
+
+	UK2Node_CallFunction* SpawnAddInt(UEdGraph* Graph, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		return SpawnCallFunction(Graph, UKismetMathLibrary::StaticClass(), GET_FUNCTION_NAME_CHECKED(UKismetMathLibrary, Add_IntInt), Cell, OutNodes);
+	}
+
+	UK2Node_CallFunction* SpawnIntToString(UEdGraph* Graph, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		return SpawnCallFunction(Graph, UKismetStringLibrary::StaticClass(), GET_FUNCTION_NAME_CHECKED(UKismetStringLibrary, Conv_IntToString), Cell, OutNodes);
+	}
+
+	void LinkExec(UEdGraphPin* ThenPin, UEdGraphNode* Node)
+	{
+		if (ThenPin)
+		{
+			ThenPin->MakeLinkTo(Node->FindPinChecked(UEdGraphSchema_K2::PN_Execute));
+		}
+	}
+
+	/* Feeds a print string node with an int to string node, whose input is fed by the returned pin */
+	UEdGraphPin* SpawnPrintInput(UEdGraph* Graph, UK2Node_CallFunction* PrintNode, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		UK2Node_CallFunction* ToString = SpawnIntToString(Graph, Cell, OutNodes);
+		ToString->GetReturnValuePin()->MakeLinkTo(PrintNode->FindPinChecked(TEXT("InString")));
+		return ToString->FindPinChecked(TEXT("InInt"));
+	}
+
+	/* Builds a full binary tree of add nodes feeding the given pin */
+	void SpawnParameterTree(UEdGraph* Graph, UEdGraphPin* InputPin, int32 Depth, const FIntPoint& Cell, TArray<UEdGraphNode*>& OutNodes)
+	{
+		if (Depth <= 0)
+		{
+			return;
+		}
+
+		UK2Node_CallFunction* AddNode = SpawnAddInt(Graph, Cell, OutNodes);
+		AddNode->GetReturnValuePin()->MakeLinkTo(InputPin);
+
+		SpawnParameterTree(Graph, AddNode->FindPinChecked(TEXT("A")), Depth - 1, Cell + FIntPoint(-1, 0), OutNodes);
+		SpawnParameterTree(Graph, AddNode->FindPinChecked(TEXT("B")), Depth - 1, Cell + FIntPoint(-1, 1 << (Depth - 1)), OutNodes);
+	}
+
+	UEdGraphNode_Comment* SpawnComment(UEdGraph* Graph, const TArray<UEdGraphNode*>& ContainedNodes, float Padding, TArray<UEdGraphNode*>& OutNodes)
+	{
+		FSlateRect Bounds = FSlateRect::FromPointAndExtent(FVector2D(ContainedNodes[0]->NodePosX, ContainedNodes[0]->NodePosY), BenchmarkCellSize);
+		for (UEdGraphNode* Node : ContainedNodes)
+		{
+			Bounds = Bounds.Expand(FSlateRect::FromPointAndExtent(FVector2D(Node->NodePosX, Node->NodePosY), BenchmarkCellSize));
+		}
+
+		Bounds = Bounds.ExtendBy(Padding);
+
+		UEdGraphNode_Comment* Comment = SpawnNode<UEdGraphNode_Comment>(Graph, FIntPoint::ZeroValue, OutNodes, [](UEdGraphNode_Comment*) { });
+		Comment->SetBounds(Bounds);
+
+		for (UEdGraphNode* Node : ContainedNodes)
+		{
+			Comment->AddNodeUnderComment(Node);
+		}
+
+		return Comment;
+	}
+
+	double Log2(double Value)
+	{
+		return FMath::Loge(Value) / FMath::Loge(2.0);
+	}
+
+	/* Bytes currently allocated, INDEX_NONE if neither the memory tracker nor the allocator keep count */
+	int64 GetAllocatedBytes()
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		if (FLowLevelMemTracker::IsEnabled())
+		{
+			return FLowLevelMemTracker::Get().GetTotalTrackedMemory(ELLMTracker::Default);
+		}
+#endif
+
+		// the binned allocators report their pool usage when their stats are compiled in
+		FGenericMemoryStats AllocatorStats;
+		GMalloc->GetAllocatorStats(AllocatorStats);
+
+		int64 AllocatedBytes = INDEX_NONE;
+		for (const TCHAR* Key : { TEXT("AllocatedSmallPoolMemory"), TEXT("AllocatedLargePoolMemory") })
+		{
+			if (const SIZE_T* Found = AllocatorStats.Data.Find(Key))
+			{
+				AllocatedBytes = FMath::Max<int64>(AllocatedBytes, 0) + *Found;
+			}
+		}
+
+		return AllocatedBytes;
+	}
+
+	void RunBenchmarkCommand(const TArray<FString>& Args)
+	{
+		UEdGraph* Graph = FBABenchmark::CreateTransientGraph();
+		if (!Graph)
+		{
+			UE_LOG(LogBlueprintAssist, Error, TEXT("Benchmark: Failed to create the transient blueprint"));
+			return;
+		}
+
+		const int32 MaxSize = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 256;
+		const int32 NumRuns = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 3;
+
+		TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+		FBABenchmark::LogResults(FBABenchmark::RunAll(GraphHandler, 16, MaxSize, NumRuns));
+	}
+
+	FAutoConsoleCommand BenchmarkCommand(
+		TEXT("BlueprintAssist.Benchmark"),
+		TEXT("Generate graphs of increasing size and time each formatter on them. Args: [MaxSize=256] [NumRuns=3]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunBenchmarkCommand));
+}
+
+UEdGraph* FBABenchmark::CreateTransientGraph()
+{
+	UPackage* Package = GetTransientPackage();
+	const FName BlueprintName = MakeUniqueObjectName(Package, UBlueprint::StaticClass(), TEXT("BABenchmark"));
+
+	UBlueprint* Blueprint = FKismetEditorUtilities::CreateBlueprint(
+		AActor::StaticClass(),
+		Package,
+		BlueprintName,
+		BPTYPE_Normal,
+		UBlueprint::StaticClass(),
+		UBlueprintGeneratedClass::StaticClass());
+
+	if (!Blueprint)
+	{
+		return nullptr;
+	}
+
+	// let the blueprint be garbage collected once nothing references the graph
+	Blueprint->ClearFlags(RF_Standalone);
+	Blueprint->SetFlags(RF_Transient);
+
+	return FBlueprintEditorUtils::FindEventGraph(Blueprint);
+}
+
+UEdGraphNode* FBABenchmark::GenerateGraph(UEdGraph* Graph, EBABenchmarkGraphShape Shape, int32 Size, TArray<UEdGraphNode*>& OutNodes)
+{
+	UBlueprint* Blueprint = FBlueprintEditorUtils::FindBlueprintForGraph(Graph);
+	if (!Graph || !Blueprint)
+	{
+		return nullptr;
+	}
+
+	// place the generated graph far away from any existing nodes
+	const FIntPoint Origin(0, 10000);
+
+	UK2Node_CustomEvent* RootNode = SpawnNode<UK2Node_CustomEvent>(Graph, Origin, OutNodes, [Blueprint](UK2Node_CustomEvent* Node)
+	{
+		Node->CustomFunctionName = FBlueprintEditorUtils::FindUniqueCustomEventName(Blueprint);
+	});
+
+	UEdGraphPin* ThenPin = RootNode->FindPinChecked(UEdGraphSchema_K2::PN_Then);
+
+	switch (Shape)
+	{
+		case EBABenchmarkGraphShape::ExecChain:
+		case EBABenchmarkGraphShape::NestedComments:
+		{
+			TArray<UEdGraphNode*> ChainNodes;
+			for (int i = 0; i < Size; ++i)
+			{
+				UK2Node_CallFunction* PrintNode = SpawnPrintString(Graph, Origin + FIntPoint(i + 1, 0), OutNodes);
+				LinkExec(ThenPin, PrintNode);
+				ThenPin = PrintNode->GetThenPin();
+				ChainNodes.Add(PrintNode);
+			}
+
+			if (Shape == EBABenchmarkGraphShape::NestedComments && ChainNodes.Num() > 0)
+			{
+				// each level splits the chain in half, the outer comments get more padding
+				const int32 NumLevels = FMath::Min(4, FMath::FloorLog2(ChainNodes.Num()) + 1);
+				for (int Level = 0; Level < NumLevels; ++Level)
+				{
+					const int32 NumChunks = 1 << Level;
+					const int32 ChunkSize = FMath::DivideAndRoundUp(ChainNodes.Num(), NumChunks);
+					for (int Start = 0; Start < ChainNodes.Num(); Start += ChunkSize)
+					{
+						TArray<UEdGraphNode*> ContainedNodes(&ChainNodes[Start], FMath::Min(ChunkSize, ChainNodes.Num() - Start));
+						SpawnComment(Graph, ContainedNodes, 20.f * (NumLevels - Level), OutNodes);
+					}
+				}
+			}
+			break;
+		}
+		case EBABenchmarkGraphShape::FanOut:
+		{
+			// alternate between sequence and branch nodes until we reach the size
+			TArray<TPair<UEdGraphPin*, FIntPoint>> PendingPins = { TPair<UEdGraphPin*, FIntPoint>(ThenPin, Origin) };
+			int32 NumSpawned = 0;
+			for (int i = 0; i < PendingPins.Num() && NumSpawned < Size; ++i)
+			{
+				const FIntPoint Cell = PendingPins[i].Value + FIntPoint(1, i);
+				UEdGraphNode* Spawned;
+				if (NumSpawned % 2 == 0)
+				{
+					UK2Node_ExecutionSequence* Sequence = SpawnNode<UK2Node_ExecutionSequence>(Graph, Cell, OutNodes, [](UK2Node_ExecutionSequence*) { });
+					Sequence->AddInputPin();
+					Spawned = Sequence;
+				}
+				else
+				{
+					Spawned = SpawnNode<UK2Node_IfThenElse>(Graph, Cell, OutNodes, [](UK2Node_IfThenElse*) { });
+				}
+
+				LinkExec(PendingPins[i].Key, Spawned);
+				NumSpawned += 1;
+
+				for (UEdGraphPin* Pin : Spawned->Pins)
+				{
+					if (Pin->Direction == EGPD_Output && FBAUtils::IsExecPin(Pin))
+					{
+						PendingPins.Add(TPair<UEdGraphPin*, FIntPoint>(Pin, Cell));
+					}
+				}
+			}
+			break;
+		}
+		case EBABenchmarkGraphShape::ParameterTree:
+		{
+			// each print string is fed by a tree of 7 add nodes
+			constexpr int32 TreeDepth = 3;
+			const int32 NumPrintNodes = FMath::Max(1, Size / ((1 << TreeDepth) + 1));
+			for (int i = 0; i < NumPrintNodes; ++i)
+			{
+				const FIntPoint Cell = Origin + FIntPoint(i * (TreeDepth + 2) + TreeDepth + 1, 0);
+				UK2Node_CallFunction* PrintNode = SpawnPrintString(Graph, Cell, OutNodes);
+				LinkExec(ThenPin, PrintNode);
+				ThenPin = PrintNode->GetThenPin();
+
+				UEdGraphPin* InputPin = SpawnPrintInput(Graph, PrintNode, Cell + FIntPoint(-1, 1), OutNodes);
+				SpawnParameterTree(Graph, InputPin, TreeDepth, Cell + FIntPoint(-2, 1), OutNodes);
+			}
+			break;
+		}
+		case EBABenchmarkGraphShape::Helixing:
+		{
+			// each print string is fed by a single chain of add nodes
+			constexpr int32 ChainLength = 3;
+			const int32 NumPrintNodes = FMath::Max(1, Size / (ChainLength + 2));
+			for (int i = 0; i < NumPrintNodes; ++i)
+			{
+				const FIntPoint Cell = Origin + FIntPoint(i * (ChainLength + 2) + ChainLength + 1, 0);
+				UK2Node_CallFunction* PrintNode = SpawnPrintString(Graph, Cell, OutNodes);
+				LinkExec(ThenPin, PrintNode);
+				ThenPin = PrintNode->GetThenPin();
+
+				UEdGraphPin* InputPin = SpawnPrintInput(Graph, PrintNode, Cell + FIntPoint(-1, 1), OutNodes);
+				for (int Link = 0; Link < ChainLength; ++Link)
+				{
+					UK2Node_CallFunction* AddNode = SpawnAddInt(Graph, Cell + FIntPoint(-2 - Link, 1), OutNodes);
+					AddNode->GetReturnValuePin()->MakeLinkTo(InputPin);
+					InputPin = AddNode->FindPinChecked(TEXT("A"));
+				}
+			}
+			break;
+		}
+		case EBABenchmarkGraphShape::Loop:
+		{
+			// every 8th node is a sequence which loops back to the start of its block
+			constexpr int32 BlockSize = 8;
+			UEdGraphNode* BlockStart = nullptr;
+			for (int i = 0; i < Size; ++i)
+			{
+				const FIntPoint Cell = Origin + FIntPoint(i + 1, 0);
+				if (i % BlockSize == BlockSize - 1)
+				{
+					UK2Node_ExecutionSequence* Sequence = SpawnNode<UK2Node_ExecutionSequence>(Graph, Cell, OutNodes, [](UK2Node_ExecutionSequence*) { });
+					LinkExec(ThenPin, Sequence);
+					LinkExec(Sequence->GetThenPinGivenIndex(1), BlockStart);
+					ThenPin = Sequence->GetThenPinGivenIndex(0);
+					BlockStart = nullptr;
+				}
+				else
+				{
+					UK2Node_CallFunction* PrintNode = SpawnPrintString(Graph, Cell, OutNodes);
+					LinkExec(ThenPin, PrintNode);
+					ThenPin = PrintNode->GetThenPin();
+					BlockStart = BlockStart ? BlockStart : PrintNode;
+				}
+			}
+			break;
+		}
+		default: ;
+	}
+
+	return RootNode;
+}
+
+double FBABenchmark::FormatGeneratedGraph(
+	TSharedPtr<FBAGraphHandler> GraphHandler,
+	EBABenchmarkFormatter Formatter,
+	EBABenchmarkGraphShape Shape,
+	int32 Size,
+	TFunctionRef<void(const TArray<UEdGraphNode*>& GeneratedNodes, const TArray<UEdGraphNode*>& CreatedNodes)> OnFormatted,
+	int64* OutAllocatedBytes)
+{
+	UEdGraph* Graph = GraphHandler.IsValid() ? GraphHandler->GetFocusedEdGraph() : nullptr;
+	if (!Graph || !FBAUtils::IsBlueprintGraph(Graph))
+	{
+		UE_LOG(LogBlueprintAssist, Error, TEXT("Benchmark: The focused graph must be a blueprint graph"));
+		return -1;
+	}
+
+	const TSet<UEdGraphNode*> ExistingNodes(Graph->Nodes);
+
+	TArray<UEdGraphNode*> GeneratedNodes;
+	UEdGraphNode* RootNode = GenerateGraph(Graph, Shape, Size, GeneratedNodes);
+	if (!RootNode)
+	{
+		return -1;
+	}
+
+	TSharedPtr<FFormatterInterface> FormatterInstance;
+	switch (Formatter)
+	{
+		case EBABenchmarkFormatter::Blueprint:
+			FormatterInstance = MakeShared<FEdGraphFormatter>(GraphHandler, FEdGraphFormatterParameters());
+			break;
+		case EBABenchmarkFormatter::Simple:
+			FormatterInstance = MakeShared<FSimpleFormatter>(GraphHandler);
+			break;
+		case EBABenchmarkFormatter::BehaviorTree:
+			FormatterInstance = MakeShared<FBehaviorTreeGraphFormatter>(GraphHandler);
+			break;
+		case EBABenchmarkFormatter::Layered:
+			FormatterInstance = MakeShared<FLayeredFormatter>(GraphHandler);
+			break;
+		default: ;
+	}
+
+	double Seconds = -1;
+	if (FormatterInstance.IsValid())
+	{
+		const FBAScopedFormatterSettings ScopedSettings(*GraphHandler);
+
+		// sampled after generating so only the formatter's allocations are counted, the formatter is still alive for the second sample
+		const int64 AllocatedBefore = GetAllocatedBytes();
+
+		const double StartTime = FPlatformTime::Seconds();
+		FormatterInstance->FormatNode(RootNode);
+		Seconds = FPlatformTime::Seconds() - StartTime;
+
+		const int64 AllocatedAfter = GetAllocatedBytes();
+		if (OutAllocatedBytes)
+		{
+			*OutAllocatedBytes = AllocatedBefore != INDEX_NONE && AllocatedAfter != INDEX_NONE ? AllocatedAfter - AllocatedBefore : INDEX_NONE;
+		}
+	}
+
+	const TSet<UEdGraphNode*> GeneratedNodesSet(GeneratedNodes);
+	const TArray<UEdGraphNode*> CreatedNodes = Graph->Nodes.FilterByPredicate([&ExistingNodes, &GeneratedNodesSet](UEdGraphNode* Node)
+	{
+		return !ExistingNodes.Contains(Node) && !GeneratedNodesSet.Contains(Node);
+	});
+
+	OnFormatted(GeneratedNodes, CreatedNodes);
+
+	// delete the generated nodes along with any knot nodes the formatter created
+	for (UEdGraphNode* Node : GeneratedNodes)
+	{
+		FBAUtils::DeleteNode(Node);
+	}
+
+	for (UEdGraphNode* Node : CreatedNodes)
+	{
+		FBAUtils::DeleteNode(Node);
+	}
+
+	return Seconds;
+}
+
+FBABenchmarkResult FBABenchmark::RunFormatter(TSharedPtr<FBAGraphHandler> GraphHandler, EBABenchmarkFormatter Formatter, EBABenchmarkGraphShape Shape, int32 Size, int32 NumRuns)
+{
+	FBABenchmarkResult Result;
+	Result.Formatter = Formatter;
+	Result.Shape = Shape;
+	Result.Size = Size;
+
+	NumRuns = FMath::Max(1, NumRuns);
+
+	int64 TotalAllocatedBytes = 0;
+	for (int Run = 0; Run < NumRuns; ++Run)
+	{
+		int64 AllocatedBytes = INDEX_NONE;
+		const double Seconds = FormatGeneratedGraph(GraphHandler, Formatter, Shape, Size, [&](const TArray<UEdGraphNode*>& GeneratedNodes, const TArray<UEdGraphNode*>&)
+		{
+			Result.NumNodes = GeneratedNodes.Num();
+		}, &AllocatedBytes);
+
+		if (Seconds < 0)
+		{
+			Result.Seconds = -1;
+			return Result;
+		}
+
+		Result.Seconds += Seconds;
+
+		// a single untracked run makes the average meaningless
+		TotalAllocatedBytes = TotalAllocatedBytes != INDEX_NONE && AllocatedBytes != INDEX_NONE ? TotalAllocatedBytes + AllocatedBytes : INDEX_NONE;
+	}
+
+	Result.Seconds /= NumRuns;
+	Result.AllocatedBytes = TotalAllocatedBytes != INDEX_NONE ? TotalAllocatedBytes / NumRuns : INDEX_NONE;
+	return Result;
+}
+
+TArray<FBABenchmarkResult> FBABenchmark::RunAll(TSharedPtr<FBAGraphHandler> GraphHandler, int32 MinSize, int32 MaxSize, int32 NumRuns)
+{
+	TArray<FBABenchmarkResult> Results;
+
+	MinSize = FMath::Max(1, MinSize);
+	for (int FormatterIndex = 0; FormatterIndex < static_cast<int>(EBABenchmarkFormatter::Num); ++FormatterIndex)
+	{
+		for (int ShapeIndex = 0; ShapeIndex < static_cast<int>(EBABenchmarkGraphShape::Num); ++ShapeIndex)
+		{
+			for (int32 Size = MinSize; Size <= MaxSize; Size *= 2)
+			{
+				Results.Add(RunFormatter(GraphHandler, static_cast<EBABenchmarkFormatter>(FormatterIndex), static_cast<EBABenchmarkGraphShape>(ShapeIndex), Size, NumRuns));
+			}
+		}
+	}
+
+	return Results;
+}
+
+void FBABenchmark::LogResults(const TArray<FBABenchmarkResult>& Results)
+{
+	UE_LOG(LogBlueprintAssist, Log, TEXT("Benchmark: Formatter, Shape, Size, Nodes, Milliseconds, AllocatedKB, ScalingExponent"));
+
+	for (int i = 0; i < Results.Num(); ++i)
+	{
+		const FBABenchmarkResult& Result = Results[i];
+
+		// the exponent k in time ~ nodes^k compared to the previous size of the same formatter and shape
+		FString ScalingExponent = TEXT("-");
+		if (i > 0)
+		{
+			const FBABenchmarkResult& Previous = Results[i - 1];
+			const bool bSameSeries = Previous.Formatter == Result.Formatter && Previous.Shape == Result.Shape;
+			if (bSameSeries && Previous.Seconds > 0 && Result.Seconds > 0 && Previous.NumNodes > 0 && Result.NumNodes > Previous.NumNodes)
+			{
+				const double Exponent = Log2(Result.Seconds / Previous.Seconds) / Log2(static_cast<double>(Result.NumNodes) / Previous.NumNodes);
+				ScalingExponent = FString::Printf(TEXT("%.2f"), Exponent);
+			}
+		}
+
+		const FString AllocatedKB = Result.AllocatedBytes != INDEX_NONE ? FString::Printf(TEXT("%lld"), Result.AllocatedBytes / 1024) : TEXT("-");
+
+		UE_LOG(LogBlueprintAssist, Log, TEXT("Benchmark: %s, %s, %d, %d, %.3f, %s, %s"),
+			*GetFormatterName(Result.Formatter),
+			*GetShapeName(Result.Shape),
+			Result.Size,
+			Result.NumNodes,
+			Result.Seconds * 1000.0,
+			*AllocatedKB,
+			*ScalingExponent);
+	}
+}
+
+FString FBABenchmark::GetShapeName(EBABenchmarkGraphShape Shape)
+{
+	switch (Shape)
+	{
+		case EBABenchmarkGraphShape::ExecChain:
+			return TEXT("ExecChain");
+		case EBABenchmarkGraphShape::FanOut:
+			return TEXT("FanOut");
+		case EBABenchmarkGraphShape::ParameterTree:
+			return TEXT("ParameterTree");
+		case EBABenchmarkGraphShape::Helixing:
+			return TEXT("Helixing");
+		case EBABenchmarkGraphShape::NestedComments:
+			return TEXT("NestedComments");
+		case EBABenchmarkGraphShape::Loop:
+			return TEXT("Loop");
+		default:
+			return TEXT("Unknown");
+	}
+}
+
+FString FBABenchmark::GetFormatterName(EBABenchmarkFormatter Formatter)
+{
+	switch (Formatter)
+	{
+		case EBABenchmarkFormatter::Blueprint:
+			return TEXT("Blueprint");
+		case EBABenchmarkFormatter::Simple:
+			return TEXT("Simple");
+		case EBABenchmarkFormatter::BehaviorTree:
+			return TEXT("BehaviorTree");
+		case EBABenchmarkFormatter::Layered:
+			return TEXT("Layered");
+		default:
+			return TEXT("Unknown");
+	}
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBABenchmarkTest, "BlueprintAssist.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FBABenchmarkTest::RunTest(const FString& Parameters)
+{
+	UEdGraph* Graph = FBABenchmark::CreateTransientGraph();
+	if (!TestNotNull(TEXT("Transient blueprint graph"), Graph))
+	{
+		return false;
+	}
+
+	TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+
+	const TArray<FBABenchmarkResult> Results = FBABenchmark::RunAll(GraphHandler, 16, 256, 3);
+	FBABenchmark::LogResults(Results);
+
+	for (const FBABenchmarkResult& Result : Results)
+	{
+		const FString Name = FString::Printf(TEXT("%s_%s_%d"), *FBABenchmark::GetFormatterName(Result.Formatter), *FBABenchmark::GetShapeName(Result.Shape), Result.Size);
+		if (Result.Seconds < 0)
+		{
+			AddError(FString::Printf(TEXT("%s failed to format"), *Name));
+			continue;
+		}
+
+		AddInfo(FString::Printf(TEXT("%s | %d nodes | %.3fms"), *Name, Result.NumNodes, Result.Seconds * 1000.0));
+	}
+
+	return true;
+}
+
+#endif
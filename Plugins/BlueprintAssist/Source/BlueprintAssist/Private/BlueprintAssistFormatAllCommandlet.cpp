@@ -0,0 +1,281 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "BlueprintAssistFormatAllCommandlet.h"
+
+#include "BlueprintAssistGlobals.h"
+#include "BlueprintAssistGraphHandler.h"
+#include "BlueprintAssistSizeCache.h"
+#include "BlueprintAssistUtils.h"
+#include "Editor.h"
+#include "AssetRegistry/Public/AssetRegistryModule.h"
+#include "Core/Public/HAL/FileManager.h"
+#include "Core/Public/Misc/FileHelper.h"
+#include "Core/Public/Misc/PackageName.h"
+#include "Core/Public/Misc/Paths.h"
+#include "EdGraph/EdGraph.h"
+#include "Engine/Blueprint.h"
+#include "Kismet2/BlueprintEditorUtils.h"
+#include "UObject/UObjectGlobals.h"
+
+UBAFormatAllCommandlet::UBAFormatAllCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Runs Blueprint Assist's Format All on every blueprint graph and saves the modified packages");
+	HelpUsage = TEXT("-run=BAFormatAll [-Paths=/Game/A+/Game/B] [-Max=N] [-LoadAhead=8] [-GCInterval=50] [-AllowMissingSizes] [-DryRun] [-Report=Path.csv]");
+}
+
+int32 UBAFormatAllCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamsMap;
+	ParseCommandLine(*Params, Tokens, Switches, ParamsMap);
+
+	bAllowMissingSizes = Switches.Contains(TEXT("AllowMissingSizes"));
+	bDryRun = Switches.Contains(TEXT("DryRun"));
+
+	TArray<FString> Paths;
+	if (const FString* PathsParam = ParamsMap.Find(TEXT("Paths")))
+	{
+		PathsParam->ParseIntoArray(Paths, TEXT("+"));
+	}
+
+	if (Paths.Num() == 0)
+	{
+		Paths.Add(TEXT("/Game"));
+	}
+
+	const int32 MaxAssets = ParamsMap.Contains(TEXT("Max")) ? FCString::Atoi(*ParamsMap[TEXT("Max")]) : 0;
+	const int32 LoadAhead = ParamsMap.Contains(TEXT("LoadAhead")) ? FMath::Max(0, FCString::Atoi(*ParamsMap[TEXT("LoadAhead")])) : 8;
+	const int32 GCInterval = ParamsMap.Contains(TEXT("GCInterval")) ? FMath::Max(1, FCString::Atoi(*ParamsMap[TEXT("GCInterval")])) : 50;
+	const FString ReportPath = ParamsMap.Contains(TEXT("Report"))
+		? ParamsMap[TEXT("Report")]
+		: FPaths::ProjectSavedDir() / TEXT("BlueprintAssist") / TEXT("FormatAllReport.csv");
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	// the module doesn't initialize without slate, so load the size cache ourselves
+	FBASizeCache::Get().LoadCache();
+
+	FARFilter Filter;
+	Filter.ClassNames.Add(UBlueprint::StaticClass()->GetFName());
+	Filter.bRecursiveClasses = true;
+	Filter.bRecursivePaths = true;
+	for (const FString& Path : Paths)
+	{
+		Filter.PackagePaths.Add(FName(*Path));
+	}
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+	Assets.Sort([](const FAssetData& A, const FAssetData& B) { return A.PackageName.LexicalLess(B.PackageName); });
+
+	if (MaxAssets > 0 && Assets.Num() > MaxAssets)
+	{
+		Assets.SetNum(MaxAssets);
+	}
+
+	UE_LOG(LogBlueprintAssist, Display, TEXT("FormatAll: Formatting %d blueprints in %s"), Assets.Num(), *FString::Join(Paths, TEXT(", ")));
+
+	// keep the next few packages loading asynchronously while the current one is formatted
+	TArray<int32> LoadRequests;
+	LoadRequests.Init(INDEX_NONE, Assets.Num());
+	int32 NextToRequest = 0;
+
+	TArray<FBAFormatAllAssetResult> Results;
+	Results.Reserve(Assets.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (int i = 0; i < Assets.Num(); ++i)
+	{
+		for (; NextToRequest < Assets.Num() && NextToRequest <= i + LoadAhead; ++NextToRequest)
+		{
+			LoadRequests[NextToRequest] = LoadPackageAsync(Assets[NextToRequest].PackageName.ToString());
+		}
+
+		const FAssetData& AssetData = Assets[i];
+		FBAFormatAllAssetResult& Result = Results.AddDefaulted_GetRef();
+		Result.AssetPath = AssetData.ObjectPath.ToString();
+
+		const double LoadStart = FPlatformTime::Seconds();
+		if (LoadRequests[i] != INDEX_NONE)
+		{
+			FlushAsyncLoading(LoadRequests[i]);
+		}
+
+		// falls back to a synchronous load if the async request failed or the package was garbage collected
+		UBlueprint* Blueprint = Cast<UBlueprint>(AssetData.GetAsset());
+		Result.LoadSeconds = FPlatformTime::Seconds() - LoadStart;
+
+		if (Blueprint == nullptr)
+		{
+			Result.Errors.Add(TEXT("Failed to load blueprint"));
+		}
+		else
+		{
+			const double FormatStart = FPlatformTime::Seconds();
+			FormatBlueprint(Blueprint, Result);
+			Result.FormatSeconds = FPlatformTime::Seconds() - FormatStart;
+
+			if (Result.bModified && !bDryRun)
+			{
+				const double SaveStart = FPlatformTime::Seconds();
+				SavePackage(Blueprint->GetOutermost(), Result);
+				Result.SaveSeconds = FPlatformTime::Seconds() - SaveStart;
+			}
+		}
+
+		UE_LOG(LogBlueprintAssist, Display, TEXT("FormatAll: [%d/%d] %s | %d/%d graphs | load %.1fms format %.1fms save %.1fms%s%s"),
+			i + 1, Assets.Num(),
+			*Result.AssetPath,
+			Result.NumFormattedGraphs, Result.NumGraphs,
+			Result.LoadSeconds * 1000.0, Result.FormatSeconds * 1000.0, Result.SaveSeconds * 1000.0,
+			Result.bModified ? TEXT(" | modified") : TEXT(""),
+			Result.Errors.Num() > 0 ? *(TEXT(" | ") + FString::Join(Result.Errors, TEXT("; "))) : TEXT(""));
+
+		// the transaction buffer holds onto every formatted graph
+		if (GEditor)
+		{
+			GEditor->ResetTransaction(NSLOCTEXT("BlueprintAssist", "FormatAllCommandlet", "Format All Commandlet"));
+		}
+
+		if ((i + 1) % GCInterval == 0)
+		{
+			CollectGarbage(RF_NoFlags);
+		}
+	}
+
+	int32 NumModified = 0;
+	int32 NumFailed = 0;
+	for (const FBAFormatAllAssetResult& Result : Results)
+	{
+		NumModified += Result.bModified ? 1 : 0;
+		NumFailed += Result.Errors.Num() > 0 ? 1 : 0;
+	}
+
+	WriteReport(ReportPath, Results);
+
+	UE_LOG(LogBlueprintAssist, Display, TEXT("FormatAll: Finished %d blueprints in %.1fs | %d modified%s | %d failed | Report: %s"),
+		Results.Num(),
+		FPlatformTime::Seconds() - StartTime,
+		NumModified,
+		bDryRun ? TEXT(" (dry run, not saved)") : TEXT(""),
+		NumFailed,
+		*ReportPath);
+
+	return NumFailed > 0 ? 1 : 0;
+}
+
+void UBAFormatAllCommandlet::FormatBlueprint(UBlueprint* Blueprint, FBAFormatAllAssetResult& OutResult) const
+{
+	TArray<UEdGraph*> Graphs;
+	Blueprint->GetAllGraphs(Graphs);
+
+	for (UEdGraph* Graph : Graphs)
+	{
+		if (Graph == nullptr || Graph->Nodes.Num() == 0 || FBlueprintEditorUtils::IsGraphReadOnly(Graph))
+		{
+			continue;
+		}
+
+		OutResult.NumGraphs += 1;
+
+		TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+
+		if (!bAllowMissingSizes)
+		{
+			const FBACacheData& CacheData = FBASizeCache::Get().GetGraphData(Graph);
+
+			int32 NumMissingSizes = 0;
+			for (UEdGraphNode* Node : Graph->Nodes)
+			{
+				if (FBAUtils::IsGraphNode(Node) && !FBAUtils::IsKnotNode(Node) && !CacheData.CachedNodes.Contains(Node->NodeGuid))
+				{
+					NumMissingSizes += 1;
+				}
+			}
+
+			if (NumMissingSizes > 0)
+			{
+				OutResult.Errors.Add(FString::Printf(TEXT("%s: %d nodes have no cached size"), *Graph->GetName(), NumMissingSizes));
+				continue;
+			}
+		}
+
+		// only save graphs whose layout actually changed, already formatted graphs are left untouched
+		TMap<UEdGraphNode*, FNodeLayoutState> OldLayout;
+		OldLayout.Reserve(Graph->Nodes.Num());
+		for (UEdGraphNode* Node : Graph->Nodes)
+		{
+			OldLayout.Add(Node, FNodeLayoutState(Node));
+		}
+
+		GraphHandler->FormatAllEvents();
+		GraphHandler->UpdateNodesRequiringFormatting();
+		GraphHandler->ClearCachedFormatters();
+		OutResult.NumFormattedGraphs += 1;
+
+		if (!OutResult.bModified)
+		{
+			OutResult.bModified = Graph->Nodes.Num() != OldLayout.Num() || Graph->Nodes.ContainsByPredicate([&OldLayout](UEdGraphNode* Node)
+			{
+				const FNodeLayoutState* OldState = OldLayout.Find(Node);
+				return OldState == nullptr || *OldState != FNodeLayoutState(Node);
+			});
+		}
+	}
+}
+
+void UBAFormatAllCommandlet::SavePackage(UPackage* Package, FBAFormatAllAssetResult& OutResult) const
+{
+	FString Filename;
+	if (!FPackageName::DoesPackageExist(Package->GetName(), nullptr, &Filename))
+	{
+		OutResult.Errors.Add(TEXT("Failed to find package file"));
+		return;
+	}
+
+	if (IFileManager::Get().IsReadOnly(*Filename))
+	{
+		OutResult.Errors.Add(FString::Printf(TEXT("Package file is read-only: %s"), *Filename));
+		return;
+	}
+
+	OutResult.bSaved = UPackage::SavePackage(Package, nullptr, RF_Standalone, *Filename, GError, nullptr, false, true, SAVE_NoError);
+	if (!OutResult.bSaved)
+	{
+		OutResult.Errors.Add(FString::Printf(TEXT("Failed to save package: %s"), *Filename));
+	}
+}
+
+void UBAFormatAllCommandlet::WriteReport(const FString& ReportPath, const TArray<FBAFormatAllAssetResult>& Results)
+{
+	TArray<FString> Lines;
+	Lines.Reserve(Results.Num() + 1);
+	Lines.Add(TEXT("Asset,Graphs,FormattedGraphs,LoadMs,FormatMs,SaveMs,Modified,Saved,Errors"));
+
+	for (const FBAFormatAllAssetResult& Result : Results)
+	{
+		Lines.Add(FString::Printf(TEXT("%s,%d,%d,%.3f,%.3f,%.3f,%d,%d,\"%s\""),
+			*Result.AssetPath,
+			Result.NumGraphs,
+			Result.NumFormattedGraphs,
+			Result.LoadSeconds * 1000.0,
+			Result.FormatSeconds * 1000.0,
+			Result.SaveSeconds * 1000.0,
+			Result.bModified ? 1 : 0,
+			Result.bSaved ? 1 : 0,
+			*FString::Join(Result.Errors, TEXT("; ")).Replace(TEXT("\""), TEXT("'"))));
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(Lines, *ReportPath))
+	{
+		UE_LOG(LogBlueprintAssist, Error, TEXT("FormatAll: Failed to write report to %s"), *ReportPath);
+	}
+}
@@ -0,0 +1,96 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "BlueprintAssistBenchmark.h"
+#include "BlueprintAssistGraphHandler.h"
+#include "BlueprintAssistUtils.h"
+#include "Editor.h"
+#include "K2Node_Knot.h"
+#include "ScopedTransaction.h"
+#include "BlueprintAssist/GraphFormatters/GraphFormatterTypes.h"
+#include "EdGraph/EdGraph.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/* Formats the benchmark graphs inside a transaction and checks that undoing it restores every node and removes the created knots */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBAFormatUndoTest, "BlueprintAssist.FormatUndo", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FBAFormatUndoTest::RunTest(const FString& Parameters)
+{
+	if (!TestNotNull(TEXT("Editor"), GEditor))
+	{
+		return false;
+	}
+
+	UEdGraph* Graph = FBABenchmark::CreateTransientGraph();
+	if (!TestNotNull(TEXT("Transient blueprint graph"), Graph))
+	{
+		return false;
+	}
+
+	TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+
+	int32 NumCreatedKnots = 0;
+	for (int ShapeIndex = 0; ShapeIndex < static_cast<int>(EBABenchmarkGraphShape::Num); ++ShapeIndex)
+	{
+		const EBABenchmarkGraphShape Shape = static_cast<EBABenchmarkGraphShape>(ShapeIndex);
+		const FString ShapeName = FBABenchmark::GetShapeName(Shape);
+
+		TArray<UEdGraphNode*> GeneratedNodes;
+		UEdGraphNode* RootNode = FBABenchmark::GenerateGraph(Graph, Shape, 16, GeneratedNodes);
+		if (!TestNotNull(*FString::Printf(TEXT("%s root node"), *ShapeName), RootNode))
+		{
+			continue;
+		}
+
+		TArray<FNodeLayoutState> LayoutBefore;
+		for (UEdGraphNode* Node : GeneratedNodes)
+		{
+			LayoutBefore.Add(FNodeLayoutState(Node));
+		}
+
+		const TSet<UEdGraphNode*> NodesBefore(Graph->Nodes);
+
+		{
+			FScopedTransaction Transaction(INVTEXT("Format Undo Test"));
+			GraphHandler->FormatNodes(RootNode);
+		}
+
+		const int32 NumKnots = Graph->Nodes.FilterByPredicate([&NodesBefore](UEdGraphNode* Node)
+		{
+			return !NodesBefore.Contains(Node) && Cast<UK2Node_Knot>(Node);
+		}).Num();
+		NumCreatedKnots += NumKnots;
+
+		GEditor->UndoTransaction();
+
+		for (int i = 0; i < GeneratedNodes.Num(); ++i)
+		{
+			if (FNodeLayoutState(GeneratedNodes[i]) != LayoutBefore[i])
+			{
+				AddError(FString::Printf(TEXT("%s | Node %d was not restored by undo (%d knots created)"), *ShapeName, i, NumKnots));
+				break;
+			}
+		}
+
+		for (UEdGraphNode* Node : Graph->Nodes)
+		{
+			if (!NodesBefore.Contains(Node))
+			{
+				AddError(FString::Printf(TEXT("%s | Created node %s was not removed by undo"), *ShapeName, *FBAUtils::GetNodeName(Node)));
+			}
+		}
+
+		for (UEdGraphNode* Node : GeneratedNodes)
+		{
+			FBAUtils::DeleteNode(Node);
+		}
+	}
+
+	// the positions are only interesting if the format relinked nodes through knots
+	TestTrue(TEXT("Formatting created knot nodes"), NumCreatedKnots > 0);
+
+	return true;
+}
+
+#endif
@@ -6,6 +6,8 @@
 
 DEFINE_LOG_CATEGORY(LogBlueprintAssist);
 
+UE_TRACE_CHANNEL_DEFINE(BlueprintAssistChannel);
+
 FBAGlobals& FBAGlobals::Get()
 {
 	return TLazySingleton<FBAGlobals>::Get();
@@ -0,0 +1,358 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "BlueprintAssistGoldenLayout.h"
+
+#include "BlueprintAssistGlobals.h"
+#include "BlueprintAssistGraphHandler.h"
+#include "BlueprintAssistSettings.h"
+#include "BlueprintAssistUtils.h"
+#include "K2Node_Knot.h"
+#include "Core/Public/HAL/PlatformFilemanager.h"
+#include "Core/Public/Misc/FileHelper.h"
+#include "HAL/IConsoleManager.h"
+#include "JsonUtilities/Public/JsonObjectConverter.h"
+#include "Misc/AutomationTest.h"
+#include "Projects/Public/Interfaces/IPluginManager.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	/* Timings are machine dependent, so the budget is generous and relative to the recorded time */
+	const float BudgetScale = 4.0f;
+	const float BudgetSlackMilliseconds = 10.0f;
+
+	const int32 NumTimingRuns = 3;
+
+	void RunGoldenLayoutCommand(const TArray<FString>& Args)
+	{
+		UEdGraph* Graph = FBABenchmark::CreateTransientGraph();
+		if (!Graph)
+		{
+			UE_LOG(LogBlueprintAssist, Error, TEXT("GoldenLayout: Failed to create the transient blueprint"));
+			return;
+		}
+
+		TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+
+		if (Args.Num() > 0 && Args[0].Equals(TEXT("Record"), ESearchCase::IgnoreCase))
+		{
+			FBAGoldenLayout::Record(GraphHandler);
+		}
+		else
+		{
+			FBAGoldenLayout::Verify(GraphHandler);
+		}
+	}
+
+	FAutoConsoleCommand GoldenLayoutCommand(
+		TEXT("BlueprintAssist.GoldenLayout"),
+		TEXT("Compare formatted benchmark graphs against the golden snapshots. Args: [Record|Verify]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&RunGoldenLayoutCommand));
+}
+
+FString FBAGoldenLayoutCase::GetName() const
+{
+	return FString::Printf(TEXT("%s_%s_%d"), *FBABenchmark::GetFormatterName(Formatter), *FBABenchmark::GetShapeName(Shape), Size);
+}
+
+const TArray<FBAGoldenLayoutCase>& FBAGoldenLayout::GetCases()
+{
+	static const TArray<FBAGoldenLayoutCase> Cases = {
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::ExecChain, 64 },
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::FanOut, 64 },
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::ParameterTree, 64 },
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::Helixing, 64 },
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::NestedComments, 64 },
+		{ EBABenchmarkFormatter::Blueprint, EBABenchmarkGraphShape::Loop, 64 },
+		{ EBABenchmarkFormatter::Simple, EBABenchmarkGraphShape::ExecChain, 64 },
+		{ EBABenchmarkFormatter::Simple, EBABenchmarkGraphShape::FanOut, 64 },
+		{ EBABenchmarkFormatter::BehaviorTree, EBABenchmarkGraphShape::FanOut, 64 },
+	};
+
+	return Cases;
+}
+
+int32 FBAGoldenLayout::Verify(TSharedPtr<FBAGraphHandler> GraphHandler, TArray<FString>* OutErrors, TArray<FString>* OutWarnings)
+{
+	const FString GoldenDir = GetGoldenDir();
+
+	int32 NumFailed = 0;
+	const auto AddFailure = [&NumFailed, OutErrors](const FString& Error)
+	{
+		if (OutErrors)
+		{
+			OutErrors->Add(Error);
+		}
+		else
+		{
+			UE_LOG(LogBlueprintAssist, Error, TEXT("GoldenLayout: FAILED %s"), *Error);
+		}
+
+		NumFailed += 1;
+	};
+
+	const auto AddWarning = [OutWarnings](const FString& Warning)
+	{
+		if (OutWarnings)
+		{
+			OutWarnings->Add(Warning);
+		}
+		else
+		{
+			UE_LOG(LogBlueprintAssist, Warning, TEXT("GoldenLayout: %s"), *Warning);
+		}
+	};
+
+	// missing golden data is recorded from the current formatter so a fresh checkout doesn't fail, the new files should be committed
+	const FString UserSettings = SaveSettings();
+	FString GoldenSettings;
+	if (FFileHelper::LoadFileToString(GoldenSettings, *(GoldenDir + "Settings.json")))
+	{
+		ApplySettings(GoldenSettings);
+	}
+	else
+	{
+		FFileHelper::SaveStringToFile(UserSettings, *(GoldenDir + "Settings.json"));
+		AddWarning(FString::Printf(TEXT("Recorded the golden settings to %s, commit them with the snapshots"), *GoldenDir));
+	}
+
+	for (const FBAGoldenLayoutCase& Case : GetCases())
+	{
+		FBAGoldenLayoutSnapshot Current;
+		if (!FormatCase(GraphHandler, Case, Current))
+		{
+			AddFailure(FString::Printf(TEXT("%s | Failed to format"), *Case.GetName()));
+			continue;
+		}
+
+		FString GoldenString;
+		FBAGoldenLayoutSnapshot Golden;
+		if (!FFileHelper::LoadFileToString(GoldenString, *(GoldenDir + Case.GetName() + ".json")) ||
+			!FJsonObjectConverter::JsonObjectStringToUStruct(GoldenString, &Golden, 0, 0))
+		{
+			SaveSnapshot(Case, Current);
+			AddWarning(FString::Printf(TEXT("%s | Recorded a missing golden snapshot, commit it"), *Case.GetName()));
+			continue;
+		}
+
+		const float BudgetMilliseconds = Golden.RecordedMilliseconds * BudgetScale + BudgetSlackMilliseconds;
+
+		FString Error;
+		if (!CompareSnapshots(Golden, Current, Error))
+		{
+			AddFailure(FString::Printf(TEXT("%s | %s"), *Case.GetName(), *Error));
+		}
+		else if (Current.RecordedMilliseconds > BudgetMilliseconds)
+		{
+			AddFailure(FString::Printf(TEXT("%s | Took %.3fms, budget is %.3fms"), *Case.GetName(), Current.RecordedMilliseconds, BudgetMilliseconds));
+		}
+		else
+		{
+			UE_LOG(LogBlueprintAssist, Log, TEXT("GoldenLayout: Passed %s | %.3fms (golden %.3fms)"), *Case.GetName(), Current.RecordedMilliseconds, Golden.RecordedMilliseconds);
+		}
+	}
+
+	ApplySettings(UserSettings);
+
+	UE_LOG(LogBlueprintAssist, Log, TEXT("GoldenLayout: %d / %d cases passed"), GetCases().Num() - NumFailed, GetCases().Num());
+	return NumFailed;
+}
+
+void FBAGoldenLayout::Record(TSharedPtr<FBAGraphHandler> GraphHandler)
+{
+	const FString GoldenDir = GetGoldenDir();
+
+	// reuse the stored settings so recording new cases keeps the old ones valid
+	const FString UserSettings = SaveSettings();
+	FString GoldenSettings;
+	if (FFileHelper::LoadFileToString(GoldenSettings, *(GoldenDir + "Settings.json")))
+	{
+		ApplySettings(GoldenSettings);
+	}
+	else
+	{
+		FFileHelper::SaveStringToFile(UserSettings, *(GoldenDir + "Settings.json"));
+	}
+
+	for (const FBAGoldenLayoutCase& Case : GetCases())
+	{
+		FBAGoldenLayoutSnapshot Snapshot;
+		if (!FormatCase(GraphHandler, Case, Snapshot))
+		{
+			UE_LOG(LogBlueprintAssist, Error, TEXT("GoldenLayout: Failed to record %s"), *Case.GetName());
+			continue;
+		}
+
+		SaveSnapshot(Case, Snapshot);
+		UE_LOG(LogBlueprintAssist, Log, TEXT("GoldenLayout: Recorded %s"), *Case.GetName());
+	}
+
+	ApplySettings(UserSettings);
+}
+
+FString FBAGoldenLayout::GetGoldenDir()
+{
+	const FString PluginDir = IPluginManager::Get().FindPlugin("BlueprintAssist")->GetBaseDir();
+	return PluginDir + "/GoldenLayouts/";
+}
+
+bool FBAGoldenLayout::FormatCase(TSharedPtr<FBAGraphHandler> GraphHandler, const FBAGoldenLayoutCase& Case, FBAGoldenLayoutSnapshot& OutSnapshot)
+{
+	const auto TakeSnapshot = [&OutSnapshot](const TArray<UEdGraphNode*>& GeneratedNodes, const TArray<UEdGraphNode*>& CreatedNodes)
+	{
+		if (GeneratedNodes.Num() == 0)
+		{
+			return;
+		}
+
+		const FIntPoint RootPos(GeneratedNodes[0]->NodePosX, GeneratedNodes[0]->NodePosY);
+
+		TMap<UEdGraphNode*, int32> NodeIndices;
+		for (int i = 0; i < GeneratedNodes.Num(); ++i)
+		{
+			UEdGraphNode* Node = GeneratedNodes[i];
+			OutSnapshot.NodePositions.Add(FIntPoint(Node->NodePosX, Node->NodePosY) - RootPos);
+			NodeIndices.Add(Node, i);
+		}
+
+		for (UEdGraphNode* Node : CreatedNodes)
+		{
+			if (!Cast<UK2Node_Knot>(Node))
+			{
+				continue;
+			}
+
+			// knots are described by their position and the generated nodes they link to, other knots are marked with K
+			TArray<FString> LinkedNodes;
+			for (UEdGraphNode* LinkedNode : FBAUtils::GetLinkedNodes(Node))
+			{
+				const int32* LinkedIndex = NodeIndices.Find(LinkedNode);
+				LinkedNodes.Add(LinkedIndex ? FString::FromInt(*LinkedIndex) : TEXT("K"));
+			}
+			LinkedNodes.Sort();
+
+			OutSnapshot.KnotNodes.Add(FString::Printf(TEXT("%d,%d>%s"), Node->NodePosX - RootPos.X, Node->NodePosY - RootPos.Y, *FString::Join(LinkedNodes, TEXT(","))));
+		}
+
+		OutSnapshot.KnotNodes.Sort();
+	};
+
+	// the layout is taken from the first run, the others only reduce the noise in the timing
+	double BestSeconds = -1;
+	for (int32 Run = 0; Run < NumTimingRuns; ++Run)
+	{
+		const double Seconds = Run == 0
+			? FBABenchmark::FormatGeneratedGraph(GraphHandler, Case.Formatter, Case.Shape, Case.Size, TakeSnapshot)
+			: FBABenchmark::FormatGeneratedGraph(GraphHandler, Case.Formatter, Case.Shape, Case.Size, [](const TArray<UEdGraphNode*>&, const TArray<UEdGraphNode*>&) { });
+
+		if (Seconds < 0)
+		{
+			return false;
+		}
+
+		BestSeconds = BestSeconds < 0 ? Seconds : FMath::Min(BestSeconds, Seconds);
+	}
+
+	OutSnapshot.RecordedMilliseconds = BestSeconds * 1000.0;
+	return true;
+}
+
+void FBAGoldenLayout::SaveSnapshot(const FBAGoldenLayoutCase& Case, const FBAGoldenLayoutSnapshot& Snapshot)
+{
+	FString JsonAsString;
+	FJsonObjectConverter::UStructToJsonObjectString(Snapshot, JsonAsString);
+	FFileHelper::SaveStringToFile(JsonAsString, *(GetGoldenDir() + Case.GetName() + ".json"));
+}
+
+bool FBAGoldenLayout::CompareSnapshots(const FBAGoldenLayoutSnapshot& Golden, const FBAGoldenLayoutSnapshot& Current, FString& OutError)
+{
+	if (Golden.NodePositions.Num() != Current.NodePositions.Num())
+	{
+		OutError = FString::Printf(TEXT("Expected %d nodes, got %d"), Golden.NodePositions.Num(), Current.NodePositions.Num());
+		return false;
+	}
+
+	for (int i = 0; i < Golden.NodePositions.Num(); ++i)
+	{
+		if (Golden.NodePositions[i] != Current.NodePositions[i])
+		{
+			OutError = FString::Printf(TEXT("Node %d expected at %s, got %s"), i, *Golden.NodePositions[i].ToString(), *Current.NodePositions[i].ToString());
+			return false;
+		}
+	}
+
+	if (Golden.KnotNodes.Num() != Current.KnotNodes.Num())
+	{
+		OutError = FString::Printf(TEXT("Expected %d knot nodes, got %d"), Golden.KnotNodes.Num(), Current.KnotNodes.Num());
+		return false;
+	}
+
+	for (int i = 0; i < Golden.KnotNodes.Num(); ++i)
+	{
+		if (Golden.KnotNodes[i] != Current.KnotNodes[i])
+		{
+			OutError = FString::Printf(TEXT("Knot expected %s, got %s"), *Golden.KnotNodes[i], *Current.KnotNodes[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FBAGoldenLayout::ApplySettings(const FString& SettingsJson)
+{
+	TSharedPtr<FJsonObject> JsonObject;
+	const TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(SettingsJson);
+	if (!FJsonSerializer::Deserialize(JsonReader, JsonObject) || !JsonObject.IsValid())
+	{
+		UE_LOG(LogBlueprintAssist, Error, TEXT("GoldenLayout: Failed to read settings"));
+		return false;
+	}
+
+	UBASettings* BASettings = GetMutableDefault<UBASettings>();
+	const bool bApplied = FJsonObjectConverter::JsonObjectToUStruct(JsonObject.ToSharedRef(), UBASettings::StaticClass(), BASettings, 0, 0);
+
+	// the whole settings object was overwritten (both when applying the golden settings and when restoring the user's), invalidate anything resolved from the old values
+	BASettings->MarkSettingsChanged();
+	return bApplied;
+}
+
+FString FBAGoldenLayout::SaveSettings()
+{
+	FString JsonAsString;
+	FJsonObjectConverter::UStructToJsonObjectString(UBASettings::StaticClass(), GetDefault<UBASettings>(), JsonAsString, 0, 0);
+	return JsonAsString;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBAGoldenLayoutTest, "BlueprintAssist.GoldenLayout", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FBAGoldenLayoutTest::RunTest(const FString& Parameters)
+{
+	UEdGraph* Graph = FBABenchmark::CreateTransientGraph();
+	if (!TestNotNull(TEXT("Transient blueprint graph"), Graph))
+	{
+		return false;
+	}
+
+	TSharedPtr<FBAGraphHandler> GraphHandler = MakeShared<FBAGraphHandler>(Graph);
+
+	TArray<FString> Errors;
+	TArray<FString> Warnings;
+	FBAGoldenLayout::Verify(GraphHandler, &Errors, &Warnings);
+
+	for (const FString& Warning : Warnings)
+	{
+		AddWarning(Warning);
+	}
+
+	for (const FString& Error : Errors)
+	{
+		AddError(Error);
+	}
+
+	return Errors.Num() == 0;
+}
+
+#endif
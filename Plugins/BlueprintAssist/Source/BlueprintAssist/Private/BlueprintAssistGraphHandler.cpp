@@ -15,8 +15,10 @@
 #include "SCommentBubble.h"
 #include "ScopedTransaction.h"
 #include "SGraphPanel.h"
+#include "Algo/BinarySearch.h"
 #include "BlueprintAssist/GraphFormatters/BehaviorTreeGraphFormatter.h"
 #include "BlueprintAssist/GraphFormatters/EdGraphFormatter.h"
+#include "BlueprintAssist/GraphFormatters/LayeredFormatter.h"
 #include "BlueprintAssist/GraphFormatters/SimpleFormatter.h"
 #include "Editor/BlueprintGraph/Classes/K2Node_Knot.h"
 #include "Framework/Application/SlateApplication.h"
@@ -26,6 +28,96 @@
 #include "Widgets/Docking/SDockTab.h"
 #include "Widgets/Notifications/SNotificationList.h"
 
+TRACE_DECLARE_INT_COUNTER(BA_GraphNodes, TEXT("BlueprintAssist/GraphNodes"));
+TRACE_DECLARE_INT_COUNTER(BA_PendingSizeNodes, TEXT("BlueprintAssist/PendingSizeNodes"));
+
+namespace
+{
+	/* Highest bottom edge raised over each horizontal span, a segment tree over the sorted unique x coordinates of every bounds used */
+	struct FBASkyline
+	{
+		explicit FBASkyline(const TArray<float>& InXs)
+			: Xs(InXs)
+			, NumSegments(FMath::Max(1, InXs.Num() - 1))
+		{
+			MaxBottom.Init(-FLT_MAX, 4 * NumSegments);
+			SpanBottom.Init(-FLT_MAX, 4 * NumSegments);
+		}
+
+		void Raise(const FSlateRect& Bounds, float Bottom)
+		{
+			int32 First, Last;
+			if (GetSegments(Bounds, First, Last))
+			{
+				Raise(1, 0, NumSegments - 1, First, Last, Bottom);
+			}
+		}
+
+		float GetMaxBottom(const FSlateRect& Bounds) const
+		{
+			int32 First, Last;
+			return GetSegments(Bounds, First, Last) ? GetMaxBottom(1, 0, NumSegments - 1, First, Last) : -FLT_MAX;
+		}
+
+	private:
+		TArray<float> Xs;
+		int32 NumSegments;
+
+		/* Max over everything raised inside the segment's range */
+		TArray<float> MaxBottom;
+
+		/* Max over everything raised across the segment's whole range */
+		TArray<float> SpanBottom;
+
+		bool GetSegments(const FSlateRect& Bounds, int32& OutFirst, int32& OutLast) const
+		{
+			// segment i spans [Xs[i], Xs[i + 1]), so bounds which only touch don't overlap
+			OutFirst = Algo::LowerBound(Xs, Bounds.Left);
+			OutLast = Algo::LowerBound(Xs, Bounds.Right) - 1;
+			return OutFirst <= OutLast;
+		}
+
+		void Raise(int32 Segment, int32 Low, int32 High, int32 First, int32 Last, float Bottom)
+		{
+			if (Last < Low || High < First)
+			{
+				return;
+			}
+
+			MaxBottom[Segment] = FMath::Max(MaxBottom[Segment], Bottom);
+
+			if (First <= Low && High <= Last)
+			{
+				SpanBottom[Segment] = FMath::Max(SpanBottom[Segment], Bottom);
+				return;
+			}
+
+			const int32 Mid = (Low + High) / 2;
+			Raise(2 * Segment, Low, Mid, First, Last, Bottom);
+			Raise(2 * Segment + 1, Mid + 1, High, First, Last, Bottom);
+		}
+
+		float GetMaxBottom(int32 Segment, int32 Low, int32 High, int32 First, int32 Last) const
+		{
+			if (Last < Low || High < First)
+			{
+				return -FLT_MAX;
+			}
+
+			if (First <= Low && High <= Last)
+			{
+				return MaxBottom[Segment];
+			}
+
+			const int32 Mid = (Low + High) / 2;
+			return FMath::Max3(
+				SpanBottom[Segment],
+				GetMaxBottom(2 * Segment, Low, Mid, First, Last),
+				GetMaxBottom(2 * Segment + 1, Mid + 1, High, First, Last));
+		}
+	};
+}
+
 FBAGraphHandler::FBAGraphHandler(
 	TWeakPtr<SDockTab> InTab,
 	TWeakPtr<SGraphEditor> InGraphEditor)
@@ -43,6 +135,15 @@ FBAGraphHandler::FBAGraphHandler(
 	FCoreUObjectDelegates::OnObjectTransacted.AddRaw(this, &FBAGraphHandler::OnObjectTransacted);
 }
 
+FBAGraphHandler::FBAGraphHandler(UEdGraph* InGraph)
+	: CachedEdGraph(InGraph)
+	, bHeadless(true)
+{
+	check(GetFocusedEdGraph() != nullptr);
+
+	InitGraphHandler();
+}
+
 FBAGraphHandler::~FBAGraphHandler()
 {
 	if (OnGraphChangedHandle.IsValid())
@@ -53,7 +154,7 @@ FBAGraphHandler::~FBAGraphHandler()
 		}
 	}
 
-	FormatterMap.Empty();
+	ClearCachedFormatters();
 	SelectedPinHandle = nullptr;
 	FocusedNode = nullptr;
 	LastSelectedNode = nullptr;
@@ -90,18 +191,32 @@ void FBAGraphHandler::InitGraphHandler()
 	PendingSize.Reset();
 	CommentBubbleSizeCache.Reset();
 	FormatAllColumns.Reset();
-	FormatterMap.Reset();
+	ClearCachedFormatters();
+	ParameterLayoutCache.Reset();
+	CommentForest.Reset();
+	NodeTreeIndex.Reset();
+	CachedRootNodes.Reset();
+	KnotNodePool.Reset();
+	RecordedLayout.Reset();
+	RecordedLinks.Reset();
+	RecordLayoutDepth = 0;
 
 	PendingTransaction.Reset();
 	ReplaceNewNodeTransaction.Reset();
 	FormatAllTransaction.Reset();
 
-	CachedEdGraph.Reset();
-	CachedEdGraph = GetFocusedEdGraph();
+	if (!bHeadless)
+	{
+		CachedEdGraph.Reset();
+		CachedEdGraph = GetFocusedEdGraph();
+	}
 
 	GetGraphCache().CleanupGraph(GetFocusedEdGraph());
 
-	GetGraphEditor()->GetViewLocation(LastGraphView, LastZoom);
+	if (!bHeadless)
+	{
+		GetGraphEditor()->GetViewLocation(LastGraphView, LastZoom);
+	}
 
 	if (OnGraphChangedHandle.IsValid())
 	{
@@ -176,7 +291,15 @@ void FBAGraphHandler::Cleanup()
 
 	FormatterParameters.Reset();
 	ResetTransactions();
-	FormatterMap.Reset();
+	ClearCachedFormatters();
+	ParameterLayoutCache.Reset();
+	CommentForest.Reset();
+	NodeTreeIndex.Reset();
+	CachedRootNodes.Reset();
+	KnotNodePool.Reset();
+	RecordedLayout.Reset();
+	RecordedLinks.Reset();
+	RecordLayoutDepth = 0;
 	NodeToReplace = nullptr;
 	NodeSizeChangeDataMap.Reset();
 
@@ -292,11 +415,11 @@ void FBAGraphHandler::LinkExecWhenCreatedFromParameter(UEdGraphNode* NodeCreated
 							TArray<UEdGraphPin*> MyPinsInDirection = FBAUtils::GetExecPins(NodeCreated, OtherExecPin->Direction);
 							if (MyPinsInDirection.Num() > 0)
 							{
-								FBAUtils::TryCreateConnection(OtherExecPin->LinkedTo[0], MyPinsInDirection[0]);
+								TryCreateConnection(OtherExecPin->LinkedTo[0], MyPinsInDirection[0]);
 							}
 						}
 
-						FBAUtils::TryCreateConnection(ExecPins[0], OtherExecPin);
+						TryCreateConnection(ExecPins[0], OtherExecPin);
 						return;
 					}
 				}
@@ -340,7 +463,7 @@ void FBAGraphHandler::AutoInsertExecNode(UEdGraphNode* NodeCreated)
 
 				if (ExecPinOnA != nullptr)
 				{
-					FBAUtils::TryCreateConnection(ExecPinOnA, NodeCreatedOutputExecPins[0]);
+					TryCreateConnection(ExecPinOnA, NodeCreatedOutputExecPins[0]);
 				}
 			}
 		}
@@ -380,7 +503,7 @@ void FBAGraphHandler::AutoInsertParameterNode(UEdGraphNode* NodeCreated)
 			{
 				if (Pin->PinType == PinToLinkTo->PinType)
 				{
-					bool bConnected = FBAUtils::TryCreateConnection(Pin, PinToLinkTo);
+					bool bConnected = TryCreateConnection(Pin, PinToLinkTo);
 					if (bConnected)
 					{
 						return;
@@ -480,6 +603,9 @@ void FBAGraphHandler::Tick(float DeltaTime)
 
 	UpdateNodesRequiringFormatting();
 
+	// deferred so no formatter is released while a format command still holds it
+	EvictCachedFormatters();
+
 	UpdateLerpViewport(DeltaTime);
 }
 
@@ -647,7 +773,7 @@ void FBAGraphHandler::ReplaceSavedSelectedNode(UEdGraphNode* NewNode)
 			{
 				if (Pin->PinId == PinToLink.To->PinId)
 				{
-					FBAUtils::TryCreateConnection(PinToLink.From, Pin);
+					TryCreateConnection(PinToLink.From, Pin);
 					break;
 					//UE_LOG(LogBlueprintAssist, Warning, TEXT("\tConnected"));
 				}
@@ -696,80 +822,198 @@ void FBAGraphHandler::MoveUnrelatedNodes(TSharedPtr<FFormatterInterface> Formatt
 		return;
 	}
 
-	float CHECK_INFINITE_LOOP = 0;
+	BA_TRACE_SCOPE(BA_MoveUnrelatedNodes);
+
+	// vertical gap between a moved tree and the bounds it was moved below
+	const float Padding = 20.f;
 
-	// check all nodes on the graph
-	TArray<UEdGraphNode*> Nodes = Graph->Nodes;
+	FBANodeTreeIndex& TreeIndex = GetNodeTreeIndex();
+
+	TSet<int32> FormattedTreeIds;
+	for (UEdGraphNode* Node : FormattedNodes)
+	{
+		FormattedTreeIds.Add(TreeIndex.GetTreeId(Node));
+	}
+
+	struct FTreeToPlace
+	{
+		int32 TreeId;
+		FSlateRect Bounds;
+		float OriginalTop;
+		bool bMoved;
+	};
 
-	while (Nodes.Num())
+	TArray<FTreeToPlace> Trees;
+	TArray<float> Xs = { FormatterBounds.Left, FormatterBounds.Right };
+	for (int32 TreeId : TreeIndex.GetTreeIds())
 	{
-		const auto NextNode = Nodes.Pop();
+		const TArray<UEdGraphNode*>& NodeTree = TreeIndex.GetTreeNodes(TreeId);
 
-		if (FBAUtils::IsCommentNode(NextNode))
+		// comments have no links so they are always a tree of their own
+		if (FormattedTreeIds.Contains(TreeId) || (NodeTree.Num() == 1 && FBAUtils::IsCommentNode(NodeTree[0])))
 		{
 			continue;
 		}
 
-		const auto NodeTree = FBAUtils::GetNodeTree(NextNode);
+		const FSlateRect Bounds = TreeIndex.GetTreeBounds(TreeId);
+		Trees.Add({ TreeId, Bounds, Bounds.Top, false });
+		Xs.Add(Bounds.Left);
+		Xs.Add(Bounds.Right);
+	}
 
-		const bool bSkipNodeTree = NodeTree.Array().ContainsByPredicate([&FormattedNodes](UEdGraphNode* Node)
+	Xs.Sort();
+	int32 NumUniqueXs = 0;
+	for (float X : Xs)
+	{
+		if (NumUniqueXs == 0 || Xs[NumUniqueXs - 1] != X)
 		{
-			return FormattedNodes.Contains(Node);
-		});
+			Xs[NumUniqueXs++] = X;
+		}
+	}
+	Xs.SetNum(NumUniqueXs);
+
+	// bottoms of the formatted nodes and the moved trees, and of every placed bounds
+	FBASkyline MovedSkyline(Xs);
+	FBASkyline PlacedSkyline(Xs);
+
+	// sweep every bounds from top to bottom by its current top. Trees only move down, so every placed bounds
+	// starts above the current one and overlaps it exactly when it shares its span and ends below its top.
+	struct FSweepItem
+	{
+		float Top;
+		int32 TreeIndex; // INDEX_NONE for the formatted nodes
+	};
+
+	const auto SweepOrder = [](const FSweepItem& A, const FSweepItem& B) { return A.Top < B.Top; };
+
+	// set the top directly so the next check sees exactly the bottom it was moved below
+	const auto MoveBelow = [Padding](FTreeToPlace& Tree, float BlockingBottom)
+	{
+		const float Height = Tree.Bounds.Bottom - Tree.Bounds.Top;
+		const float NewTop = BlockingBottom + Padding;
+		Tree.Bounds = FSlateRect(Tree.Bounds.Left, NewTop, Tree.Bounds.Right, NewTop + Height);
+	};
+
+	TArray<FSweepItem> Sweep;
+	Sweep.Reserve(Trees.Num() + 1);
+	Sweep.Add({ FormatterBounds.Top, INDEX_NONE });
+	for (int32 i = 0; i < Trees.Num(); ++i)
+	{
+		Sweep.Add({ Trees[i].Bounds.Top, i });
+	}
+
+	Sweep.Heapify(SweepOrder);
+
+	bool bPlacedFormatterBounds = false;
+	while (Sweep.Num() > 0)
+	{
+		FSweepItem Item;
+		Sweep.HeapPop(Item, SweepOrder, false);
 
-		if (bSkipNodeTree)
+		if (Item.TreeIndex == INDEX_NONE)
 		{
+			MovedSkyline.Raise(FormatterBounds, FormatterBounds.Bottom);
+			PlacedSkyline.Raise(FormatterBounds, FormatterBounds.Bottom);
+			bPlacedFormatterBounds = true;
 			continue;
 		}
 
-		const FSlateRect NodeTreeBounds = FBAUtils::GetNodeArrayBounds(NodeTree.Array());
-		float OffsetX = 0;
-		if (FSlateRect::DoRectanglesIntersect(FormatterBounds, NodeTreeBounds))
-		{
-			OffsetX = FormatterBounds.Bottom - NodeTreeBounds.Top + 20;
-		}
+		FTreeToPlace& Tree = Trees[Item.TreeIndex];
 
-		for (auto Node : NodeTree)
+		// a tree only moves when it overlaps the formatted nodes or a moved tree, overlaps which already existed are left alone
+		if (!Tree.bMoved)
 		{
-			if (OffsetX != 0)
+			// trees starting above the formatted nodes are swept before them, moved trees always start below them
+			const bool bOverlapsMoved = bPlacedFormatterBounds
+				? MovedSkyline.GetMaxBottom(Tree.Bounds) > Tree.Bounds.Top
+				: FSlateRect::DoRectanglesIntersect(Tree.Bounds, FormatterBounds);
+
+			if (!bOverlapsMoved)
 			{
-				Node->Modify();
-				Node->NodePosY += OffsetX;
+				PlacedSkyline.Raise(Tree.Bounds, Tree.Bounds.Bottom);
+				continue;
 			}
 
-			Nodes.Remove(Node);
+			const float BlockingBottom = bPlacedFormatterBounds
+				? PlacedSkyline.GetMaxBottom(Tree.Bounds)
+				: FMath::Max(PlacedSkyline.GetMaxBottom(Tree.Bounds), FormatterBounds.Bottom);
+
+			Tree.bMoved = true;
+			MoveBelow(Tree, BlockingBottom);
+			Sweep.HeapPush({ Tree.Bounds.Top, Item.TreeIndex }, SweepOrder);
+			continue;
 		}
 
-		if (CHECK_INFINITE_LOOP++ > 10000)
+		// bounds placed since the tree was moved may end below its new top, move it again before placing it
+		const float BlockingBottom = PlacedSkyline.GetMaxBottom(Tree.Bounds);
+		if (BlockingBottom + Padding > Tree.Bounds.Top)
 		{
-			UE_LOG(LogBlueprintAssist, Error, TEXT("Infinite loop detected in MoveUnrelatedNodes"));
-			break;
+			MoveBelow(Tree, BlockingBottom);
+			Sweep.HeapPush({ Tree.Bounds.Top, Item.TreeIndex }, SweepOrder);
+			continue;
+		}
+
+		MovedSkyline.Raise(Tree.Bounds, Tree.Bounds.Bottom);
+		PlacedSkyline.Raise(Tree.Bounds, Tree.Bounds.Bottom);
+	}
+
+	// nodes are modified when the layout recording ends
+	for (const FTreeToPlace& Tree : Trees)
+	{
+		if (!Tree.bMoved)
+		{
+			continue;
+		}
+
+		const int32 OffsetY = FMath::CeilToInt(Tree.Bounds.Top - Tree.OriginalTop);
+		for (UEdGraphNode* Node : TreeIndex.GetTreeNodes(Tree.TreeId))
+		{
+			Node->NodePosY += OffsetY;
+			TreeIndex.MarkNodeMoved(Node);
 		}
 	}
 }
 
 void FBAGraphHandler::OnGraphChanged(const FEdGraphEditAction& Action)
 {
+	for (const UEdGraphNode* Node : Action.Nodes)
+	{
+		if (Action.Action & GRAPHACTION_RemoveNode)
+		{
+			NodeTreeIndex.MarkNodeRemoved(const_cast<UEdGraphNode*>(Node));
+		}
+		else
+		{
+			NodeTreeIndex.MarkNodeDirty(const_cast<UEdGraphNode*>(Node));
+		}
+	}
+
 	DelayedDetectGraphChanges.StartDelay(1);
 }
 
 void FBAGraphHandler::DetectGraphChanges()
 {
+	BA_TRACE_SCOPE(BA_DetectGraphChanges);
+
 	TArray<UEdGraphNode*> NewNodes;
 	for (UEdGraphNode* NewNode : GetFocusedEdGraph()->Nodes)
 	{
-		if (FBAUtils::IsCommentNode(NewNode) || FBAUtils::IsKnotNode(NewNode))
+		if (LastNodes.Contains(NewNode))
 		{
 			continue;
 		}
 
-		if (!LastNodes.Contains(NewNode))
+		// not every way of adding a node broadcasts it
+		NodeTreeIndex.MarkNodeDirty(NewNode);
+
+		if (!FBAUtils::IsCommentNode(NewNode) && !FBAUtils::IsKnotNode(NewNode))
 		{
 			NewNodes.Add(NewNode);
 		}
 	}
 
 	LastNodes = GetFocusedEdGraph()->Nodes;
+	TRACE_COUNTER_SET(BA_GraphNodes, LastNodes.Num());
 
 	if (NewNodes.Num() > 0)
 	{
@@ -848,33 +1092,31 @@ void FBAGraphHandler::FormatNewNodes(const TArray<UEdGraphNode*>& NewNodes)
 	bool bHandledAlwaysFormatAll = false;
 	if (GetDefault<UBASettings>()->bAlwaysFormatAll)
 	{
-		TArray<UEdGraphNode*> PendingNodes = NewNodes;
-		int32 ErrorCount = 0;
-		while (PendingNodes.Num() > 0)
+		FBANodeTreeIndex& TreeIndex = GetNodeTreeIndex();
+
+		auto FilterEvents = [](UEdGraphNode* Node)
 		{
-			ErrorCount += 1;
-			if (ErrorCount > 1000)
+			return FBAUtils::IsEventNode(Node, EGPD_Output);
+		};
+
+		// new nodes in the same tree share the check
+		TSet<int32> CheckedTrees;
+		for (UEdGraphNode* NewNode : NewNodes)
+		{
+			const int32 TreeId = TreeIndex.GetTreeId(NewNode);
+			if (TreeId != INDEX_NONE && CheckedTrees.Contains(TreeId))
 			{
-				UE_LOG(LogBlueprintAssist, Error, TEXT("BlueprintAssist: Error infinite loop detected in FBAGraphHandler::FormatNewNodes"));
-				break;
+				continue;
 			}
 
-			UEdGraphNode* CurrentNode = PendingNodes.Pop();
-			TArray<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTree(CurrentNode).Array();
+			CheckedTrees.Add(TreeId);
 
-			auto FilterEvents = [](UEdGraphNode* Node)
-			{
-				return FBAUtils::IsEventNode(Node, EGPD_Output);
-			};
-
-			if (NodeTree.FilterByPredicate(FilterEvents).Num() > 0)
+			if (TreeIndex.GetNodeTree(NewNode).ContainsByPredicate(FilterEvents))
 			{
 				FormatAllEvents();
 				bHandledAlwaysFormatAll = true;
 				break;
 			}
-
-			PendingNodes.RemoveAllSwap([&NodeTree](UEdGraphNode* Node) { return NodeTree.Contains(Node); });
 		}
 	}
 
@@ -895,7 +1137,7 @@ void FBAGraphHandler::FormatNewNodes(const TArray<UEdGraphNode*>& NewNodes)
 	{
 		NewNodeToFormat = NewNodes[0];
 
-		const bool bIsParameterFormatter = !FBAUtils::GetNodeTree(NewNodeToFormat).Array().ContainsByPredicate(FBAUtils::IsNodeImpure);
+		const bool bIsParameterFormatter = !GetNodeTreeIndex().GetNodeTree(NewNodeToFormat).ContainsByPredicate(FBAUtils::IsNodeImpure);
 		const EEdGraphPinDirection FormatterDirection = bIsParameterFormatter ? EGPD_Output : EGPD_Input;
 
 		if (FBAUtils::GetLinkedPins(NewNodeToFormat, FormatterDirection).Num() == 0)
@@ -975,7 +1217,7 @@ void FBAGraphHandler::AutoAddParentNode(UEdGraphNode* NewNode)
 			{
 				for (auto Pin : NodeLinkedToPins)
 				{
-					if (FBAUtils::TryCreateConnection(OutputPin, Pin))
+					if (TryCreateConnection(OutputPin, Pin))
 					{
 						break;
 					}
@@ -987,7 +1229,7 @@ void FBAGraphHandler::AutoAddParentNode(UEdGraphNode* NewNode)
 			{
 				for (auto InputPin : FBAUtils::GetPinsByDirection(ParentFunctionNode, EGPD_Input))
 				{
-					if (FBAUtils::TryCreateConnection(OutputPin, InputPin))
+					if (TryCreateConnection(OutputPin, InputPin))
 					{
 						break;
 					}
@@ -1137,6 +1379,20 @@ void FBAGraphHandler::OnObjectTransacted(UObject* Object, const FTransactionObje
 {
 	static const FName NodesChangedName(TEXT("Nodes"));
 
+	// links made by the editor (dragging a wire, undo) don't always broadcast a graph change but are always transacted
+	if (UEdGraphNode* Node = Cast<UEdGraphNode>(Object))
+	{
+		if (Node->GetGraph() == GetFocusedEdGraph())
+		{
+			NodeTreeIndex.MarkNodeDirty(Node);
+		}
+	}
+	else if (Object == GetFocusedEdGraph() && Event.GetEventType() == ETransactionObjectEventType::UndoRedo)
+	{
+		// undo doesn't say which nodes were added or removed
+		NodeTreeIndex.MarkAllDirty();
+	}
+
 	if (Event.GetEventType() == ETransactionObjectEventType::UndoRedo)
 	{
 		if (Event.GetChangedProperties().Num() == 1 && Event.GetChangedProperties()[0].IsEqual(NodesChangedName))
@@ -1152,8 +1408,26 @@ void FBAGraphHandler::OnObjectTransacted(UObject* Object, const FTransactionObje
 	}
 }
 
+bool FBAGraphHandler::TryCreateConnection(UEdGraphPin* PinA, UEdGraphPin* PinB)
+{
+	const bool bConnected = FBAUtils::TryCreateConnection(PinA, PinB);
+	if (bConnected)
+	{
+		NodeTreeIndex.MarkNodeDirty(PinA->GetOwningNode());
+		NodeTreeIndex.MarkNodeDirty(PinB->GetOwningNode());
+	}
+
+	return bConnected;
+}
+
 bool FBAGraphHandler::UpdateNodeSizesChanges(const TArray<UEdGraphNode*>& Nodes)
 {
+	// nodes can't be measured without a graph panel, format with whatever is in the size cache
+	if (bHeadless)
+	{
+		return false;
+	}
+
 	bool bAddedSize = false;
 
 	TSet<UEdGraphNode*> NodesToCheck;
@@ -1275,20 +1549,75 @@ bool FBAGraphHandler::DoesNodeWantAutoFormatting(UEdGraphNode* Node)
 
 UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat, bool bCheckSelectedNode)
 {
-	TSharedPtr<FFormatterInterface> Formatter = MakeFormatter();
-	if (!Formatter.IsValid())
+	UEdGraph* EdGraph = GetFocusedEdGraph();
+	if (!EdGraph)
 	{
 		return nullptr;
 	}
 
-	EEdGraphPinDirection FormatterDirection = Formatter->GetFormatterSettings().FormatterDirection;
+	const FBAScopedFormatterSettings ScopedSettings(*this);
+
+	// the cached roots were found from the links, so they stay valid until the links or the settings change
+	const uint32 LinkVersion = GetNodeTreeIndex().GetLinkVersion();
+	const uint32 SettingsVersion = GetDefault<UBASettings>()->GetSettingsVersion();
+	if (CachedRootNodesLinkVersion != LinkVersion || CachedRootNodesSettingsVersion != SettingsVersion || !NodeTreeIndex.IsIndexing(EdGraph))
+	{
+		CachedRootNodes.Reset();
+		CachedRootNodesLinkVersion = LinkVersion;
+		CachedRootNodesSettingsVersion = SettingsVersion;
+	}
+
+	// selective formatting filters the tree, so those roots are never cached
+	const bool bCanUseCache = NodesToFormat.Num() == 0 && FormatterParameters.NodesToFormat.Num() == 0;
+	if (bCanUseCache)
+	{
+		if (UEdGraphNode** CachedRootNode = CachedRootNodes.Find(InitialNode))
+		{
+			return *CachedRootNode;
+		}
+	}
+
+	bool bCanCache = false;
+	UEdGraphNode* RootNode = FindRootNode(InitialNode, NodesToFormat, bCheckSelectedNode, bCanCache);
+	if (bCanUseCache && bCanCache)
+	{
+		CachedRootNodes.Add(InitialNode, RootNode);
+	}
+
+	return RootNode;
+}
+
+UEdGraphNode* FBAGraphHandler::FindRootNode(UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat, bool bCheckSelectedNode, bool& bOutCanCache)
+{
+	bOutCanCache = false;
+
+	// MakeFormatter only makes a formatter for graphs with formatter settings, so read the direction from them
+	const FBAFormatterSettings* FormatterSettings = GetFormatterSettings();
+	if (!FormatterSettings)
+	{
+		return nullptr;
+	}
+
+	const EEdGraphPinDirection FormatterDirection = FormatterSettings->FormatterDirection;
 
 	const auto OppositeDirection = UEdGraphPin::GetComplementaryDirection(FormatterDirection);
 
-	const auto NodeTreeFilter = [this, &NodesToFormat](const FPinLink& Link) { return FilterDelegatePin(Link, NodesToFormat); };
-	TSet<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTreeWithFilter(InitialNode, NodeTreeFilter);
+	FBANodeTreeIndex& TreeIndex = GetNodeTreeIndex();
+	const int32 TreeId = TreeIndex.GetTreeId(InitialNode);
+
+	// the filter only removes links when selectively formatting or ignoring delegates, otherwise use the indexed tree
+	TArray<UEdGraphNode*> NodeTree;
+	if (TreeId != INDEX_NONE && NodesToFormat.Num() == 0 && (GetDefault<UBASettings>()->bTreatDelegatesAsExecutionPins || !TreeIndex.HasDelegateLinks(TreeId)))
+	{
+		NodeTree = TreeIndex.GetTreeNodes(TreeId);
+	}
+	else
+	{
+		const auto NodeTreeFilter = [this, &NodesToFormat](const FPinLink& Link) { return FilterDelegatePin(Link, NodesToFormat); };
+		NodeTree = FBAUtils::GetNodeTreeWithFilter(InitialNode, NodeTreeFilter).Array();
+	}
 
-	const bool bIsParameterTree = !NodeTree.Array().ContainsByPredicate(FBAUtils::IsNodeImpure);
+	const bool bIsParameterTree = !NodeTree.ContainsByPredicate(FBAUtils::IsNodeImpure);
 	if (bIsParameterTree)
 	{
 		const auto Filter = [&](UEdGraphNode* Node)
@@ -1300,6 +1629,19 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 		return FBAUtils::GetTopMostWithFilter(InitialNode, EGPD_Output, Filter);
 	}
 
+	// traverse the execution from the initial node once, instead of once per candidate
+	TOptional<TSet<UEdGraphNode*>> ExecutionFromInitialNode;
+	const auto HasExecutionTo = [&ExecutionFromInitialNode, InitialNode](UEdGraphNode* Node)
+	{
+		if (!ExecutionFromInitialNode.IsSet())
+		{
+			ExecutionFromInitialNode = FBAUtils::GetNodesWithExecutionFrom(InitialNode);
+		}
+
+		UEdGraphNode* ExecNode = FBAUtils::IsNodePure(Node) ? FBAUtils::GetExecutingNode(Node) : nullptr;
+		return ExecutionFromInitialNode->Contains(ExecNode ? ExecNode : Node);
+	};
+
 	TArray<UEdGraphNode*> EventNodes;
 	TArray<UEdGraphNode*> UnlinkedNodes;
 	TArray<UEdGraphNode*> RootNodes;
@@ -1312,7 +1654,7 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 			continue;
 		}
 
-		if (FBAUtils::IsExtraRootNode(Node) && FBAUtils::DoesNodeHaveExecutionTo(InitialNode, Node))
+		if (FBAUtils::IsExtraRootNode(Node) && HasExecutionTo(Node))
 		{
 			// UE_LOG(LogTemp, Warning, TEXT("\tRoot node EXTRA %s"), *FBAUtils::GetNodeName(Node));
 			RootNodes.Add(Node);
@@ -1321,7 +1663,7 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 
 		if (FBAUtils::IsNodeImpure(Node))
 		{
-			if (FBAUtils::IsEventNode(Node, FormatterDirection) && FBAUtils::DoesNodeHaveExecutionTo(InitialNode, Node))
+			if (FBAUtils::IsEventNode(Node, FormatterDirection) && HasExecutionTo(Node))
 			{
 				// UE_LOG(LogTemp, Warning, TEXT("\tRoot node EVENT %s"), *FBAUtils::GetNodeName(Node));
 				EventNodes.Add(Node);
@@ -1330,7 +1672,7 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 
 			TArray<UEdGraphPin*> LinkedInputPins = FBAUtils::GetLinkedPins(Node, OppositeDirection).FilterByPredicate(FBAUtils::IsExecPin);
 
-			if (LinkedInputPins.Num() == 0 && FBAUtils::DoesNodeHaveExecutionTo(InitialNode, Node))
+			if (LinkedInputPins.Num() == 0 && HasExecutionTo(Node))
 			{
 				// UE_LOG(LogTemp, Warning, TEXT("\tRoot node UNLINKED %s"), *FBAUtils::GetNodeName(Node));
 				UnlinkedNodes.Emplace(Node);
@@ -1391,6 +1733,9 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 
 	if (RootNodes.Num() > 0)
 	{
+		// a single candidate is picked whatever is selected and wherever the nodes are
+		bOutCanCache = RootNodes.Num() == 1;
+
 		if (bCheckSelectedNode && RootNodes.Contains(SelectedNode))
 		{
 			return SelectedNode;
@@ -1412,6 +1757,8 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 
 	if (EventNodes.Num() > 0) // use the top left most event node
 	{
+		bOutCanCache = EventNodes.Num() == 1;
+
 		if (bCheckSelectedNode && EventNodes.Contains(SelectedNode))
 		{
 			return SelectedNode;
@@ -1431,6 +1778,8 @@ UEdGraphNode* FBAGraphHandler::GetRootNode(UEdGraphNode* InitialNode, const TArr
 		UnlinkedNodes.RemoveAll(FBAUtils::IsNodePure);
 	}
 
+	bOutCanCache = UnlinkedNodes.Num() == 1;
+
 	// use the top left most unlinked node
 	if (bCheckSelectedNode && UnlinkedNodes.Contains(SelectedNode))
 	{
@@ -1455,7 +1804,7 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::MakeFormatter()
 		return nullptr;
 	}
 
-	if (FBAFormatterSettings* FormatterSettings = FBAUtils::FindFormatterSettings(EdGraph))
+	if (const FBAFormatterSettings* FormatterSettings = GetFormatterSettings())
 	{
 		switch (FormatterSettings->FormatterType)
 		{
@@ -1465,6 +1814,8 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::MakeFormatter()
 				return MakeShared<FBehaviorTreeGraphFormatter>(AsShared());
 			case EBAFormatterType::Simple:
 				return MakeShared<FSimpleFormatter>(AsShared());
+			case EBAFormatterType::Layered:
+				return MakeShared<FLayeredFormatter>(AsShared());
 			default: ;
 		}
 	}
@@ -1693,8 +2044,7 @@ void FBAGraphHandler::AddPendingFormatNodes(UEdGraphNode* Node, TSharedPtr<FScop
 
 	if (GetDefault<UBASettings>()->bRefreshNodeSizeBeforeFormatting)
 	{
-		TSet<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTree(Node);
-		UpdateNodeSizesChanges(NodeTree.Array());
+		UpdateNodeSizesChanges(GetNodeTreeIndex().GetNodeTree(Node));
 	}
 }
 
@@ -1754,6 +2104,8 @@ float FBAGraphHandler::GetPinY(UEdGraphPin* Pin)
 
 void FBAGraphHandler::UpdateCachedNodeSize(float DeltaTime)
 {
+	BA_TRACE_SCOPE(BA_UpdateCachedNodeSize);
+
 	if (!bInitialZoomFinished)
 	{
 		return;
@@ -1774,6 +2126,7 @@ void FBAGraphHandler::UpdateCachedNodeSize(float DeltaTime)
 	TSharedPtr<SGraphPanel> GraphPanel = GetGraphPanel();
 
 	PendingSize.RemoveAll(FBAUtils::IsNodeDeleted);
+	TRACE_COUNTER_SET(BA_PendingSizeNodes, PendingSize.Num());
 
 	// Save the currently viewport to restore once we are done
 	if (PendingSize.Num() > 0 && !bFullyZoomed)
@@ -1953,11 +2306,12 @@ void FBAGraphHandler::UpdateNodesRequiringFormatting()
 
 	if (NodesWithoutSize.Num() > 0)
 	{
+		FBANodeTreeIndex& TreeIndex = GetNodeTreeIndex();
+
 		bool bPendingSize = false;
 		for (UEdGraphNode* Pending : PendingFormatting)
 		{
-			TSet<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTree(Pending);
-			bPendingSize |= UpdateNodeSizesChanges(NodeTree.Array());
+			bPendingSize |= UpdateNodeSizesChanges(TreeIndex.GetNodeTree(Pending));
 		}
 
 		if (bPendingSize)
@@ -2029,6 +2383,18 @@ void FBAGraphHandler::UpdateNodesRequiringFormatting()
 
 void FBAGraphHandler::SimpleFormatAll()
 {
+	BeginRecordingLayoutChanges();
+
+	const UBASettings* BASettings = GetDefault<UBASettings>();
+	const FBASettingsSnapshot Settings(BASettings, BASettings->BlueprintFormatterSettings);
+
+	const auto GetFormatterBounds = [this, &Settings](TSharedPtr<FFormatterInterface> Formatter)
+	{
+		return Settings.bApplyCommentPadding
+			? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
+			: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+	};
+
 	TSet<UEdGraphNode*> FormattedNodes;
 	FSlateRect FormattedBounds;
 
@@ -2045,8 +2411,6 @@ void FBAGraphHandler::SimpleFormatAll()
 				continue;
 			}
 
-			Node->Modify();
-
 			TSharedPtr<FFormatterInterface> Formatter = FormatNodes(Node, true);
 
 			if (!Formatter.IsValid())
@@ -2054,9 +2418,7 @@ void FBAGraphHandler::SimpleFormatAll()
 				continue;
 			}
 
-			FSlateRect CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+			FSlateRect CurrentBounds = GetFormatterBounds(Formatter);
 
 			// align the position of the formatted nodes to the column
 			const int32 DeltaX = ColumnX - CurrentBounds.Left;
@@ -2073,9 +2435,7 @@ void FBAGraphHandler::SimpleFormatAll()
 			FormattedNodes.Append(Formatter->GetFormattedNodes());
 
 			// update the bounds again after moving nodes
-			CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+			CurrentBounds = GetFormatterBounds(Formatter);
 
 			if (bFirst)
 			{
@@ -2084,16 +2444,14 @@ void FBAGraphHandler::SimpleFormatAll()
 			}
 			else
 			{
-				const float Delta = (FormattedBounds.Bottom + GetDefault<UBASettings>()->FormatAllPadding.Y) - CurrentBounds.Top;
+				const float Delta = (FormattedBounds.Bottom + Settings.FormatAllPadding.Y) - CurrentBounds.Top;
 				for (UEdGraphNode* FormattedNode : Formatter->GetFormattedNodes())
 				{
 					FormattedNode->NodePosY += Delta;
 				}
 
 				// update the bounds again after moving nodes (again)
-				CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-					? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-					: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+				CurrentBounds = GetFormatterBounds(Formatter);
 
 				FormattedBounds = FormattedBounds.Expand(CurrentBounds);
 			}
@@ -2101,17 +2459,32 @@ void FBAGraphHandler::SimpleFormatAll()
 
 		if (!bFirst) // if bFirst is false that also means we formatted at least 1 node
 		{
-			ColumnX = FormattedBounds.Right + GetMutableDefault<UBASettings>()->FormatAllPadding.X;
+			ColumnX = FormattedBounds.Right + Settings.FormatAllPadding.X;
 		}
 	}
 
+	EndRecordingLayoutChanges();
+
 	FormatAllColumns.Empty();
 	FormatAllTransaction.Reset();
 }
 
 void FBAGraphHandler::SmartFormatAll()
 {
-	TArray<TSharedPtr<FFormatterInterface>> AllFormatters;
+	BeginRecordingLayoutChanges();
+
+	const UBASettings* BASettings = GetDefault<UBASettings>();
+	const FBASettingsSnapshot Settings(BASettings, BASettings->BlueprintFormatterSettings);
+
+	struct FFormattedTree
+	{
+		TSharedPtr<FFormatterInterface> Formatter;
+		TArray<UEdGraphNode*> Nodes;
+		FSlateRect Bounds;
+		bool bPlaced = false;
+	};
+
+	TArray<FFormattedTree> Trees;
 
 	// format all the nodes
 	TSet<UEdGraphNode*> PreviouslyFormattedNodes;
@@ -2123,69 +2496,116 @@ void FBAGraphHandler::SmartFormatAll()
 			continue;
 		}
 
-		Node->Modify();
-
 		TSharedPtr<FFormatterInterface> Formatter = FormatNodes(Node, true);
-		AllFormatters.Add(Formatter);
+		if (!Formatter.IsValid())
+		{
+			continue;
+		}
 
-		PreviouslyFormattedNodes.Append(Formatter->GetFormattedNodes());
+		FFormattedTree& Tree = Trees.AddDefaulted_GetRef();
+		Tree.Formatter = Formatter;
+		Tree.Nodes = Formatter->GetFormattedNodes().Array();
+
+		PreviouslyFormattedNodes.Append(Tree.Nodes);
 	}
 
-	float ColumnX = 0;
-	while (AllFormatters.Num() > 0)
+	const auto MoveTree = [](FFormattedTree& Tree, const int32 DeltaX, const int32 DeltaY)
+	{
+		for (UEdGraphNode* FormattedNode : Tree.Nodes)
+		{
+			FormattedNode->NodePosX += DeltaX;
+			FormattedNode->NodePosY += DeltaY;
+		}
+
+		Tree.Bounds = Tree.Bounds.OffsetBy(FVector2D(DeltaX, DeltaY));
+	};
+
+	// unplaced trees never move, so a single sort of the left most roots and of the left edges holds for every column
+	TArray<int32> ByRoot;
+	TArray<int32> ByLeft;
+	for (int32 i = 0; i < Trees.Num(); ++i)
 	{
-		TArray<TSharedPtr<FFormatterInterface>> AllFormattersCopy = AllFormatters;
+		// the bounds are only calculated once after formatting, moving a tree translates its bounds
+		FFormattedTree& Tree = Trees[i];
+		Tree.Bounds = Settings.bApplyCommentPadding
+			? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Tree.Formatter->GetCommentHandler(), Tree.Nodes)
+			: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Tree.Nodes);
 
-		// sort formatted nodes by left most
-		AllFormattersCopy.Sort([](TSharedPtr<FFormatterInterface> FormatterA, TSharedPtr<FFormatterInterface> FormatterB)
+		ByRoot.Add(i);
+		ByLeft.Add(i);
+	}
+
+	ByRoot.Sort([&Trees](const int32 A, const int32 B)
+	{
+		UEdGraphNode* RootA = Trees[A].Formatter->GetRootNode();
+		UEdGraphNode* RootB = Trees[B].Formatter->GetRootNode();
+		if (RootA->NodePosX != RootB->NodePosX)
 		{
-			UEdGraphNode* RootA = FormatterA->GetRootNode();
-			UEdGraphNode* RootB = FormatterB->GetRootNode();
-			if (RootA->NodePosX != RootB->NodePosX)
-			{
-				return RootA->NodePosX < RootB->NodePosX;
-			}
+			return RootA->NodePosX < RootB->NodePosX;
+		}
 
-			return RootA->NodePosY < RootB->NodePosY;
-		});
+		return RootA->NodePosY < RootB->NodePosY;
+	});
 
-		// get the bounds of the left most node
-		TSharedPtr<FFormatterInterface> LeftMostNodeTree = AllFormattersCopy[0];
-		const FSlateRect LeftMostNodeBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), LeftMostNodeTree->GetCommentHandler(), LeftMostNodeTree->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), LeftMostNodeTree->GetFormattedNodes().Array());
-		float ColumnRight = ColumnX + LeftMostNodeBounds.GetSize().X;
+	ByLeft.Sort([&Trees](const int32 A, const int32 B)
+	{
+		return Trees[A].Bounds.Left < Trees[B].Bounds.Left;
+	});
 
-		TArray<TSharedPtr<FFormatterInterface>> CurrentColumn;
-		CurrentColumn.Add(LeftMostNodeTree);
+	int32 NextRoot = 0;
+	int32 NextLeft = 0;
+	float ColumnX = 0;
+	TArray<int32> CurrentColumn;
 
-		// create columns by checking for overlapping formatted node-trees
-		for (TSharedPtr<FFormatterInterface> Formatter : AllFormattersCopy)
+	while (true)
+	{
+		while (NextRoot < ByRoot.Num() && Trees[ByRoot[NextRoot]].bPlaced)
 		{
-			if (Formatter == LeftMostNodeTree)
+			++NextRoot;
+		}
+
+		if (NextRoot >= ByRoot.Num())
+		{
+			break;
+		}
+
+		// start the column from the left most node
+		const int32 LeftMostTree = ByRoot[NextRoot];
+		float ColumnRight = ColumnX + Trees[LeftMostTree].Bounds.GetSize().X;
+
+		CurrentColumn.Reset();
+		CurrentColumn.Add(LeftMostTree);
+		Trees[LeftMostTree].bPlaced = true;
+
+		// sweep the left edges to collect the node-trees overlapping the column
+		for (int32 i = NextLeft; i < ByLeft.Num(); ++i)
+		{
+			FFormattedTree& Tree = Trees[ByLeft[i]];
+			if (Tree.bPlaced)
 			{
 				continue;
 			}
 
-			TSet<UEdGraphNode*> FormatterNodes = Formatter->GetFormattedNodes();
-			FSlateRect Bounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
-			
-			if (Bounds.Left < ColumnRight)
+			if (Tree.Bounds.Left >= ColumnRight)
 			{
-				ColumnRight = FMath::Max(ColumnRight, ColumnX + Bounds.GetSize().X);
-				CurrentColumn.Add(Formatter);
+				break;
 			}
+
+			ColumnRight = FMath::Max(ColumnRight, ColumnX + Tree.Bounds.GetSize().X);
+			CurrentColumn.Add(ByLeft[i]);
+			Tree.bPlaced = true;
 		}
 
-		FSlateRect FormattedBounds;
+		while (NextLeft < ByLeft.Num() && Trees[ByLeft[NextLeft]].bPlaced)
+		{
+			++NextLeft;
+		}
 
 		// Sort the column by height
-		CurrentColumn.Sort([](TSharedPtr<FFormatterInterface> FormatterA, TSharedPtr<FFormatterInterface> FormatterB)
+		CurrentColumn.Sort([&Trees](const int32 A, const int32 B)
 		{
-			UEdGraphNode* RootA = FormatterA->GetRootNode();
-			UEdGraphNode* RootB = FormatterB->GetRootNode();
+			UEdGraphNode* RootA = Trees[A].Formatter->GetRootNode();
+			UEdGraphNode* RootB = Trees[B].Formatter->GetRootNode();
 			if (RootA->NodePosY != RootB->NodePosY)
 			{
 				return RootA->NodePosY < RootB->NodePosY;
@@ -2194,58 +2614,38 @@ void FBAGraphHandler::SmartFormatAll()
 			return RootA->NodePosX < RootB->NodePosX;
 		});
 
+		FSlateRect FormattedBounds;
 		bool bFirst = true;
 
 		// position the node-trees into columns
-		for (TSharedPtr<FFormatterInterface> Formatter : CurrentColumn)
+		for (const int32 TreeIndex : CurrentColumn)
 		{
-			FSlateRect CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+			FFormattedTree& Tree = Trees[TreeIndex];
 
-			// align the position of the formatted nodes to the column
-			const int32 DeltaX = ColumnX - CurrentBounds.Left;
-
-			// offset the first formatted node's Y position to zero
-			const int32 DeltaY = bFirst ? 0 - CurrentBounds.Top : 0;
+			// align the position of the formatted nodes to the column and offset the first node-tree's Y position to zero
+			const int32 DeltaX = ColumnX - Tree.Bounds.Left;
+			const int32 DeltaY = bFirst ? 0 - Tree.Bounds.Top : 0;
+			MoveTree(Tree, DeltaX, DeltaY);
 
-			for (auto FormattedNode : Formatter->GetFormattedNodes())
-			{
-				FormattedNode->NodePosX += DeltaX;
-				FormattedNode->NodePosY += DeltaY;
-			}
-
-			CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-				? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-				: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
-			
 			if (bFirst)
 			{
 				bFirst = false;
-				FormattedBounds = CurrentBounds;
+				FormattedBounds = Tree.Bounds;
 			}
 			else
 			{
-				const float Delta = (FormattedBounds.Bottom + GetDefault<UBASettings>()->FormatAllPadding.Y) - CurrentBounds.Top;
-				for (UEdGraphNode* FormattedNode : Formatter->GetFormattedNodes())
-				{
-					FormattedNode->NodePosY += Delta;
-				}
-
-				CurrentBounds = GetDefault<UBASettings>()->bApplyCommentPadding
-					? FBAUtils::GetCachedNodeArrayBoundsWithComments(AsShared(), Formatter->GetCommentHandler(), Formatter->GetFormattedNodes().Array())
-					: FBAUtils::GetCachedNodeArrayBounds(AsShared(), Formatter->GetFormattedNodes().Array());
+				const int32 Delta = FMath::CeilToInt((FormattedBounds.Bottom + Settings.FormatAllPadding.Y) - Tree.Bounds.Top);
+				MoveTree(Tree, 0, Delta);
 
-				FormattedBounds = FormattedBounds.Expand(CurrentBounds);
+				FormattedBounds = FormattedBounds.Expand(Tree.Bounds);
 			}
-
-			// UE_LOG(LogBlueprintAssist, Warning, TEXT("\t%s"), *FBAUtils::GetNodeName(Formatter->GetRootNode()));
-			AllFormatters.Remove(Formatter);
 		}
 
-		ColumnX = ColumnRight + GetDefault<UBASettings>()->FormatAllPadding.X;
+		ColumnX = ColumnRight + Settings.FormatAllPadding.X;
 	}
 
+	EndRecordingLayoutChanges();
+
 	FormatAllColumns.Empty();
 	FormatAllTransaction.Reset();
 }
@@ -2356,11 +2756,7 @@ void FBAGraphHandler::RefreshNodeSize(UEdGraphNode* Node)
 
 		UEdGraphNode* NodeToFormat = GetRootNode(Node, TArray<UEdGraphNode*>());
 
-		if (FormatterMap.Contains(NodeToFormat))
-		{
-			FormatterMap[NodeToFormat].Reset();
-			FormatterMap.Remove(NodeToFormat);
-		}
+		RemoveCachedFormatter(NodeToFormat);
 	}
 	else if (FBAUtils::IsCommentNode(Node))
 	{
@@ -2471,12 +2867,12 @@ void FBAGraphHandler::FormatAllEvents()
 	{
 		TArray<UEdGraphNode*>& Column = FormatAllColumns[i];
 
-		for (UEdGraphNode* Node : Column)
+		if (GetDefault<UBASettings>()->bRefreshNodeSizeBeforeFormatting)
 		{
-			if (GetDefault<UBASettings>()->bRefreshNodeSizeBeforeFormatting)
+			FBANodeTreeIndex& TreeIndex = GetNodeTreeIndex();
+			for (UEdGraphNode* Node : Column)
 			{
-				TSet<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTree(Node);
-				UpdateNodeSizesChanges(NodeTree.Array());
+				UpdateNodeSizesChanges(TreeIndex.GetNodeTree(Node));
 			}
 		}
 
@@ -2531,12 +2927,165 @@ void FBAGraphHandler::ClearCache()
 
 void FBAGraphHandler::ClearFormatters()
 {
+	ClearCachedFormatters();
+	ParameterLayoutCache.Empty();
+	CommentForest.Reset();
+}
+
+void FBAGraphHandler::ClearCachedFormatters()
+{
+	// the formatters own pointers back to themselves, so they must be released to be freed
+	for (auto& Elem : FormatterMap)
+	{
+		Elem.Value.Formatter->ReleaseFormattingData();
+	}
+
 	FormatterMap.Empty();
+	FormatterResumeStates.Empty();
+	FormatterUseCounter = 0;
+}
+
+void FBAGraphHandler::RemoveCachedFormatter(UEdGraphNode* RootNode)
+{
+	if (FBACachedFormatter* CachedFormatter = FormatterMap.Find(RootNode))
+	{
+		CachedFormatter->Formatter->ReleaseFormattingData();
+		FormatterMap.Remove(RootNode);
+	}
+
+	FormatterResumeStates.Remove(RootNode);
+}
+
+void FBAGraphHandler::EvictCachedFormatters()
+{
+	const UBASettings* BASettings = GetDefault<UBASettings>();
+	const int32 MaxFormatters = FMath::Max(1, BASettings->MaxCachedFormatters);
+	const SIZE_T MemoryBudget = static_cast<SIZE_T>(FMath::Max(1, BASettings->CachedFormattersMemoryBudget)) * 1024 * 1024;
+
+	// before the budget check so deleted roots don't linger while under budget
+	PruneFormatterResumeStates();
+
+	SIZE_T TotalSize = 0;
+	for (const auto& Elem : FormatterMap)
+	{
+		TotalSize += Elem.Value.AllocatedSize;
+	}
+
+	for (const auto& Elem : FormatterResumeStates)
+	{
+		TotalSize += Elem.Value.GetAllocatedSize();
+	}
+
+	if (FormatterMap.Num() <= MaxFormatters && TotalSize <= MemoryBudget)
+	{
+		return;
+	}
+
+	BA_TRACE_SCOPE(BA_EvictCachedFormatters);
+
+	TArray<UEdGraphNode*> RootNodes;
+	FormatterMap.GenerateKeyArray(RootNodes);
+	RootNodes.Sort([this](UEdGraphNode& A, UEdGraphNode& B)
+	{
+		return FormatterMap[&A].LastUsed < FormatterMap[&B].LastUsed;
+	});
+
+	for (UEdGraphNode* RootNode : RootNodes)
+	{
+		if (FormatterMap.Num() <= MaxFormatters && TotalSize <= MemoryBudget)
+		{
+			break;
+		}
+
+		FBACachedFormatter& CachedFormatter = FormatterMap[RootNode];
+		TotalSize -= CachedFormatter.AllocatedSize;
+
+		FEdGraphFormatterResumeState ResumeState = CachedFormatter.Formatter->MakeResumeState();
+		if (ResumeState.IsValid())
+		{
+			TotalSize += ResumeState.GetAllocatedSize();
+			FormatterResumeStates.Add(RootNode, MoveTemp(ResumeState));
+		}
+
+		CachedFormatter.Formatter->ReleaseFormattingData();
+		FormatterMap.Remove(RootNode);
+	}
+}
+
+void FBAGraphHandler::PruneFormatterResumeStates()
+{
+	// this runs every tick, so use the index as it was last updated instead of applying the pending changes
+	if (FormatterResumeStates.Num() == 0 || NodeTreeIndex.GetLinkVersion() == ResumeStatesLinkVersion)
+	{
+		return;
+	}
+
+	ResumeStatesLinkVersion = NodeTreeIndex.GetLinkVersion();
+
+	for (auto It = FormatterResumeStates.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid() || !NodeTreeIndex.Contains(It.Key().Get()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TSharedPtr<FFormatterInterface> FBAGraphHandler::FindCachedFormatter(UEdGraphNode* RootNode)
+{
+	if (FBACachedFormatter* CachedFormatter = FormatterMap.Find(RootNode))
+	{
+		CachedFormatter->LastUsed = ++FormatterUseCounter;
+		return CachedFormatter->Formatter;
+	}
+
+	if (const FEdGraphFormatterResumeState* ResumeState = FormatterResumeStates.Find(RootNode))
+	{
+		TSharedPtr<FEdGraphResumedFormatter> ResumedFormatter = MakeShared<FEdGraphResumedFormatter>(AsShared(), *ResumeState);
+		if (ResumedFormatter->CanResume())
+		{
+			return ResumedFormatter;
+		}
+
+		FormatterResumeStates.Remove(RootNode);
+	}
+
+	return nullptr;
+}
+
+const FBAFormatterSettings* FBAGraphHandler::GetFormatterSettings()
+{
+	UEdGraph* EdGraph = GetFocusedEdGraph();
+	if (!EdGraph)
+	{
+		return nullptr;
+	}
+
+	const uint32 SettingsVersion = GetDefault<UBASettings>()->GetSettingsVersion();
+	if (CachedFormatterSettingsGraph.Get() != EdGraph || CachedFormatterSettingsVersion != SettingsVersion)
+	{
+		CachedFormatterSettingsGraph = EdGraph;
+		CachedFormatterSettingsVersion = SettingsVersion;
+
+		// copy the settings so the cache never points into the settings object
+		const FBAFormatterSettings* FoundSettings = FBAUtils::FindFormatterSettings(EdGraph);
+		bHasCachedFormatterSettings = FoundSettings != nullptr;
+		CachedFormatterSettings = FoundSettings ? *FoundSettings : FBAFormatterSettings();
+	}
+
+	return bHasCachedFormatterSettings ? &CachedFormatterSettings : nullptr;
+}
+
+FBANodeTreeIndex& FBAGraphHandler::GetNodeTreeIndex()
+{
+	// only rescans the marked nodes, or the whole graph when the focused graph changed
+	NodeTreeIndex.Update(GetFocusedEdGraph());
+	return NodeTreeIndex;
 }
 
 TSharedPtr<FFormatterInterface> FBAGraphHandler::FormatNodes(UEdGraphNode* Node, bool bUsingFormatAll)
 {
-	if (!GetGraphPanel().IsValid())
+	if (!bHeadless && !GetGraphPanel().IsValid())
 	{
 		return nullptr;
 	}
@@ -2557,6 +3106,8 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::FormatNodes(UEdGraphNode* Node,
 		return nullptr;
 	}
 
+	const FBAScopedFormatterSettings ScopedSettings(*this);
+
 	TSharedPtr<FFormatterInterface> Formatter;
 
 	const bool bCheckSelectedNode = !bUsingFormatAll; // don't check selected node if we are running format all command
@@ -2566,14 +3117,26 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::FormatNodes(UEdGraphNode* Node,
 
 	if (FBAUtils::IsBlueprintGraph(EdGraph))
 	{
-		if (FormatterMap.Contains(NodeToFormat) && GetDefault<UBASettings>()->bEnableFasterFormatting)
+		if (GetDefault<UBASettings>()->bEnableFasterFormatting)
 		{
-			Formatter = FormatterMap[NodeToFormat];
+			// GetRootNode updated the node tree index
+			PruneFormatterResumeStates();
+			Formatter = FindCachedFormatter(NodeToFormat);
 		}
-		else
+
+		if (!Formatter.IsValid())
 		{
-			Formatter = MakeShared<FEdGraphFormatter>(AsShared(), FormatterParameters);
-			FormatterMap.Add(NodeToFormat, Formatter);
+			TSharedPtr<FEdGraphFormatter> EdGraphFormatter = MakeShared<FEdGraphFormatter>(AsShared(), FormatterParameters);
+			if (GetDefault<UBASettings>()->bEnableFasterFormatting)
+			{
+				RemoveCachedFormatter(NodeToFormat);
+
+				FBACachedFormatter& CachedFormatter = FormatterMap.Add(NodeToFormat);
+				CachedFormatter.Formatter = EdGraphFormatter;
+				CachedFormatter.LastUsed = ++FormatterUseCounter;
+			}
+
+			Formatter = EdGraphFormatter;
 		}
 	}
 	else
@@ -2584,7 +3147,22 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::FormatNodes(UEdGraphNode* Node,
 	if (Formatter.IsValid())
 	{
 		// const double StartTime = FPlatformTime::Seconds();
+		BeginRecordingLayoutChanges();
 		Formatter->FormatNode(NodeToFormat);
+
+		// format all places every tree itself
+		if (!bUsingFormatAll && GetDefault<UBASettings>()->bMoveUnrelatedNodes)
+		{
+			MoveUnrelatedNodes(Formatter);
+		}
+
+		EndRecordingLayoutChanges();
+
+		if (FBACachedFormatter* CachedFormatter = FormatterMap.Find(NodeToFormat))
+		{
+			CachedFormatter->AllocatedSize = CachedFormatter->Formatter->GetAllocatedSize();
+		}
+
 		OnNodeFormatted.Broadcast(Node, *(Formatter.Get()));
 		// const double EndTime = FPlatformTime::Seconds();
 
@@ -2598,6 +3176,152 @@ TSharedPtr<FFormatterInterface> FBAGraphHandler::FormatNodes(UEdGraphNode* Node,
 	return Formatter;
 }
 
+void FBAGraphHandler::BeginRecordingLayoutChanges()
+{
+	RecordLayoutDepth += 1;
+	if (RecordLayoutDepth > 1)
+	{
+		return;
+	}
+
+	RecordedLayout.Reset();
+	RecordedLinks.Reset();
+
+	if (UEdGraph* EdGraph = GetFocusedEdGraph())
+	{
+		RecordedLayout.Reserve(EdGraph->Nodes.Num());
+		for (UEdGraphNode* Node : EdGraph->Nodes)
+		{
+			if (Node)
+			{
+				RecordedLayout.Add(Node, FNodeLayoutState(Node));
+			}
+		}
+	}
+}
+
+void FBAGraphHandler::EndRecordingLayoutChanges()
+{
+	if (RecordLayoutDepth <= 0)
+	{
+		return;
+	}
+
+	RecordLayoutDepth -= 1;
+	if (RecordLayoutDepth > 0)
+	{
+		return;
+	}
+
+	// Modify records the state of the node, so temporarily restore the old layout and links before calling it.
+	// Nodes created while recording were made inside the transaction and don't need this.
+	for (const auto& Elem : RecordedLayout)
+	{
+		UEdGraphNode* Node = Elem.Key.Get();
+		if (!Node)
+		{
+			continue;
+		}
+
+		const FNodeLayoutState NewLayout(Node);
+		const bool bLayoutChanged = NewLayout != Elem.Value;
+
+		const FNodeLinkState* OldLinks = RecordedLinks.Find(Node);
+		const bool bLinksChanged = OldLinks && !OldLinks->HasSameLinks(Node);
+
+		// the node was relinked to the same pins, put back the old order so nothing changed at all
+		if (OldLinks && !bLinksChanged)
+		{
+			OldLinks->ApplyTo(Node);
+		}
+
+		if (!bLayoutChanged && !bLinksChanged)
+		{
+			continue;
+		}
+
+		const FNodeLinkState NewLinks = bLinksChanged ? FNodeLinkState(Node) : FNodeLinkState();
+
+		Elem.Value.ApplyTo(Node);
+		if (bLinksChanged)
+		{
+			OldLinks->ApplyTo(Node);
+		}
+
+		Node->Modify();
+
+		NewLayout.ApplyTo(Node);
+		if (bLinksChanged)
+		{
+			NewLinks.ApplyTo(Node);
+		}
+
+		NodeTreeIndex.MarkNodeMoved(Node);
+	}
+
+	RecordedLayout.Reset();
+	RecordedLinks.Reset();
+}
+
+void FBAGraphHandler::ModifyRecordedNode(UEdGraphNode* Node)
+{
+	if (!Node)
+	{
+		return;
+	}
+
+	NodeTreeIndex.MarkNodeDirty(Node);
+
+	// modify only saves the node the first time inside a transaction, so it must see the recorded layout and links
+	const FNodeLayoutState* RecordedState = RecordLayoutDepth > 0 ? RecordedLayout.Find(Node) : nullptr;
+	if (!RecordedState)
+	{
+		Node->Modify();
+		return;
+	}
+
+	const FNodeLayoutState NewLayout(Node);
+	RecordedState->ApplyTo(Node);
+
+	FNodeLinkState OldLinks;
+	const bool bRestoreLinks = RecordedLinks.RemoveAndCopyValue(Node, OldLinks);
+	const FNodeLinkState NewLinks = bRestoreLinks ? FNodeLinkState(Node) : FNodeLinkState();
+	if (bRestoreLinks)
+	{
+		OldLinks.ApplyTo(Node);
+	}
+
+	Node->Modify();
+
+	NewLayout.ApplyTo(Node);
+	if (bRestoreLinks)
+	{
+		NewLinks.ApplyTo(Node);
+	}
+}
+
+void FBAGraphHandler::RecordNodeLinks(UEdGraphNode* Node)
+{
+	if (!Node)
+	{
+		return;
+	}
+
+	// nodes created while recording (or changed outside of it) are modified straight away
+	if (RecordLayoutDepth <= 0 || !RecordedLayout.Contains(Node))
+	{
+		ModifyRecordedNode(Node);
+		return;
+	}
+
+	NodeTreeIndex.MarkNodeDirty(Node);
+
+	if (!RecordedLinks.Contains(Node))
+	{
+		RecordedLinks.Add(Node, FNodeLinkState(Node));
+	}
+}
+
 void FBAGraphHandler::CancelProcessingNodeSizes()
 {
 	PendingSize.Reset();
@@ -2379,10 +2379,11 @@ void FBAInputProcessor::ZoomToNodeTree() const
 		return;
 	}
 
-	TSet<UEdGraphNode*> NodeTree = FBAUtils::GetNodeTree(SelectedNode);
+	const TArray<UEdGraphNode*>& NodeTree = GraphHandler->GetNodeTreeIndex().GetNodeTree(SelectedNode);
 
 	// selecting a set of nodes requires the ptrs to be const
 	TSet<const UEdGraphNode*> ConstNodeTree;
+	ConstNodeTree.Reserve(NodeTree.Num());
 	for (UEdGraphNode* Node : NodeTree)
 	{
 		ConstNodeTree.Add(Node);
@@ -0,0 +1,441 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#include "BlueprintAssistNodeTreeIndex.h"
+
+#include "BlueprintAssistGlobals.h"
+#include "BlueprintAssistUtils.h"
+#include "EdGraph/EdGraph.h"
+
+void FBANodeTreeIndex::Update(UEdGraph* Graph)
+{
+	if (!Graph)
+	{
+		Reset();
+		return;
+	}
+
+	if (IndexedGraph.Get() != Graph)
+	{
+		Reset();
+		IndexedGraph = Graph;
+	}
+
+	if (!bFullRescanPending && DirtyNodes.Num() == 0)
+	{
+		return;
+	}
+
+	BA_TRACE_SCOPE(BA_NodeTreeIndexUpdate);
+
+	TSet<int32> DirtyRoots;
+	TArray<TPair<int32, UEdGraphNode*>> NewLinks;
+	TArray<int32> RemovedIds;
+	bool bChanged = false;
+
+	if (bFullRescanPending)
+	{
+		++UpdateStamp;
+
+		for (UEdGraphNode* Node : Graph->Nodes)
+		{
+			if (Node)
+			{
+				bChanged |= UpdateEntry(Node, DirtyRoots, NewLinks);
+			}
+		}
+
+		for (int32 Id = 0; Id < Entries.Num(); ++Id)
+		{
+			if (Entries[Id].Node && Entries[Id].UpdateStamp != UpdateStamp)
+			{
+				RemoveEntry(Id, DirtyRoots, RemovedIds);
+				bChanged = true;
+			}
+		}
+	}
+	else
+	{
+		// links are symmetric, so a marked node can only have changed the links of the nodes it was or is now linked to
+		TSet<UEdGraphNode*> NeighbourNodes;
+		for (const auto& Elem : DirtyNodes)
+		{
+			UEdGraphNode* Node = Elem.Key;
+			const bool bRemoved = Elem.Value || !IsValid(Node);
+			if (const int32* FoundId = NodeIds.Find(Node))
+			{
+				NeighbourNodes.Append(Entries[*FoundId].LinkedNodes);
+
+				if (bRemoved)
+				{
+					RemoveEntry(*FoundId, DirtyRoots, RemovedIds);
+					bChanged = true;
+					continue;
+				}
+			}
+			else if (bRemoved)
+			{
+				continue;
+			}
+
+			bChanged |= UpdateEntry(Node, DirtyRoots, NewLinks);
+			NeighbourNodes.Append(Entries[NodeIds.FindChecked(Node)].LinkedNodes);
+		}
+
+		for (UEdGraphNode* Node : NeighbourNodes)
+		{
+			if (IsValid(Node) && !DirtyNodes.Contains(Node))
+			{
+				bChanged |= UpdateEntry(Node, DirtyRoots, NewLinks);
+			}
+		}
+	}
+
+	DirtyNodes.Reset();
+	bFullRescanPending = false;
+
+	if (!bChanged)
+	{
+		return;
+	}
+
+	++LinkVersion;
+
+	// relabel the dirty trees from the current links, every other tree keeps its labels
+	RelabelTrees(DirtyRoots);
+
+	for (int32 Id : RemovedIds)
+	{
+		Entries[Id].LinkedNodes.Reset();
+		FreeIds.Add(Id);
+	}
+
+	for (const auto& NewLink : NewLinks)
+	{
+		if (const int32* LinkedId = NodeIds.Find(NewLink.Value))
+		{
+			Join(NewLink.Key, *LinkedId);
+		}
+	}
+}
+
+void FBANodeTreeIndex::Reset()
+{
+	IndexedGraph.Reset();
+	NodeIds.Reset();
+	Entries.Reset();
+	Parents.Reset();
+	Sizes.Reset();
+	FreeIds.Reset();
+	Trees.Reset();
+	DirtyNodes.Reset();
+	bFullRescanPending = true;
+}
+
+void FBANodeTreeIndex::MarkNodeDirty(UEdGraphNode* Node)
+{
+	if (Node)
+	{
+		DirtyNodes.Add(Node, false);
+		MarkNodeMoved(Node);
+	}
+}
+
+void FBANodeTreeIndex::MarkNodeRemoved(UEdGraphNode* Node)
+{
+	if (Node)
+	{
+		DirtyNodes.Add(Node, true);
+	}
+}
+
+void FBANodeTreeIndex::MarkNodeMoved(UEdGraphNode* Node)
+{
+	if (const int32* NodeId = NodeIds.Find(Node))
+	{
+		if (FTree* Tree = Trees.Find(FindRoot(*NodeId)))
+		{
+			Tree->bBoundsValid = false;
+		}
+	}
+}
+
+int32 FBANodeTreeIndex::GetTreeId(UEdGraphNode* Node)
+{
+	const int32* NodeId = NodeIds.Find(Node);
+	return NodeId ? FindRoot(*NodeId) : INDEX_NONE;
+}
+
+bool FBANodeTreeIndex::IsSameTree(UEdGraphNode* NodeA, UEdGraphNode* NodeB)
+{
+	if (NodeA == NodeB)
+	{
+		return true;
+	}
+
+	const int32 TreeA = GetTreeId(NodeA);
+	return TreeA != INDEX_NONE && TreeA == GetTreeId(NodeB);
+}
+
+const TArray<UEdGraphNode*>& FBANodeTreeIndex::GetNodeTree(UEdGraphNode* Node)
+{
+	const int32 TreeId = GetTreeId(Node);
+	if (TreeId == INDEX_NONE)
+	{
+		SingleNodeTree.Reset();
+		SingleNodeTree.Add(Node);
+		return SingleNodeTree;
+	}
+
+	return GetTreeNodes(TreeId);
+}
+
+const TArray<UEdGraphNode*>& FBANodeTreeIndex::GetTreeNodes(int32 TreeId)
+{
+	return Trees.FindChecked(TreeId).Nodes;
+}
+
+bool FBANodeTreeIndex::HasDelegateLinks(int32 TreeId)
+{
+	return Trees.FindChecked(TreeId).bHasDelegateLinks;
+}
+
+TArray<int32> FBANodeTreeIndex::GetTreeIds() const
+{
+	TArray<int32> TreeIds;
+	Trees.GenerateKeyArray(TreeIds);
+	return TreeIds;
+}
+
+FSlateRect FBANodeTreeIndex::GetTreeBounds(int32 TreeId)
+{
+	FTree& Tree = Trees.FindChecked(TreeId);
+	if (!Tree.bBoundsValid)
+	{
+		Tree.Bounds = FBAUtils::GetNodeArrayBounds(Tree.Nodes);
+		Tree.bBoundsValid = true;
+	}
+
+	return Tree.Bounds;
+}
+
+TArray<int32> FBANodeTreeIndex::GetTreesIntersecting(const FSlateRect& Bounds)
+{
+	TArray<int32> TreeIds;
+	for (const auto& Elem : Trees)
+	{
+		if (FSlateRect::DoRectanglesIntersect(Bounds, GetTreeBounds(Elem.Key)))
+		{
+			TreeIds.Add(Elem.Key);
+		}
+	}
+
+	return TreeIds;
+}
+
+int32 FBANodeTreeIndex::AddEntry(UEdGraphNode* Node)
+{
+	int32 NewId;
+	if (FreeIds.Num() > 0)
+	{
+		NewId = FreeIds.Pop(false);
+		Parents[NewId] = NewId;
+		Sizes[NewId] = 1;
+	}
+	else
+	{
+		NewId = Entries.AddDefaulted();
+		Parents.Add(NewId);
+		Sizes.Add(1);
+	}
+
+	Entries[NewId] = FNodeEntry();
+	Entries[NewId].Node = Node;
+
+	FTree& Tree = Trees.Add(NewId);
+	Tree.Nodes.Add(Node);
+
+	return NodeIds.Add(Node, NewId);
+}
+
+bool FBANodeTreeIndex::UpdateEntry(UEdGraphNode* Node, TSet<int32>& DirtyRoots, TArray<TPair<int32, UEdGraphNode*>>& NewLinks)
+{
+	TArray<UEdGraphNode*, TInlineAllocator<4>> LinkedNodes;
+	bool bHasDelegateLink = false;
+	uint32 PinLinkHash = 0;
+	GetLinkedNodes(Node, LinkedNodes, bHasDelegateLink, PinLinkHash);
+
+	const int32* FoundId = NodeIds.Find(Node);
+	const bool bIsNewNode = FoundId == nullptr;
+	const int32 NodeId = FoundId ? *FoundId : AddEntry(Node);
+
+	FNodeEntry& Entry = Entries[NodeId];
+	Entry.UpdateStamp = UpdateStamp;
+
+	if (!bIsNewNode && Entry.LinkedNodes == LinkedNodes && Entry.bHasDelegateLink == bHasDelegateLink)
+	{
+		// relinking different pins between the same nodes keeps the trees but still changes the links
+		if (Entry.PinLinkHash != PinLinkHash)
+		{
+			Entry.PinLinkHash = PinLinkHash;
+			return true;
+		}
+
+		return false;
+	}
+
+	Entry.PinLinkHash = PinLinkHash;
+
+	if (!bIsNewNode)
+	{
+		// a lost link may split the tree, a lost delegate link may clear the tree's flag
+		bool bLostLink = Entry.bHasDelegateLink && !bHasDelegateLink;
+		for (UEdGraphNode* OldLinkedNode : Entry.LinkedNodes)
+		{
+			bLostLink |= !LinkedNodes.Contains(OldLinkedNode);
+		}
+
+		if (bLostLink)
+		{
+			DirtyRoots.Add(FindRoot(NodeId));
+		}
+	}
+
+	for (UEdGraphNode* LinkedNode : LinkedNodes)
+	{
+		if (bIsNewNode || !Entry.LinkedNodes.Contains(LinkedNode))
+		{
+			NewLinks.Emplace(NodeId, LinkedNode);
+		}
+	}
+
+	Entry.LinkedNodes = LinkedNodes;
+	Entry.bHasDelegateLink = bHasDelegateLink;
+
+	if (bHasDelegateLink)
+	{
+		Trees.FindChecked(FindRoot(NodeId)).bHasDelegateLinks = true;
+	}
+
+	return true;
+}
+
+void FBANodeTreeIndex::RemoveEntry(int32 Id, TSet<int32>& DirtyRoots, TArray<int32>& RemovedIds)
+{
+	FNodeEntry& Entry = Entries[Id];
+	DirtyRoots.Add(FindRoot(Id));
+	NodeIds.Remove(Entry.Node);
+	Entry.Node = nullptr;
+	RemovedIds.Add(Id);
+}
+
+int32 FBANodeTreeIndex::FindRoot(int32 Id)
+{
+	// path halving
+	while (Parents[Id] != Id)
+	{
+		Parents[Id] = Parents[Parents[Id]];
+		Id = Parents[Id];
+	}
+
+	return Id;
+}
+
+void FBANodeTreeIndex::Join(int32 IdA, int32 IdB)
+{
+	int32 RootA = FindRoot(IdA);
+	int32 RootB = FindRoot(IdB);
+	if (RootA == RootB)
+	{
+		return;
+	}
+
+	if (Sizes[RootA] < Sizes[RootB])
+	{
+		Swap(RootA, RootB);
+	}
+
+	Parents[RootB] = RootA;
+	Sizes[RootA] += Sizes[RootB];
+
+	// the smaller tree is merged into the larger one
+	FTree TreeB;
+	if (Trees.RemoveAndCopyValue(RootB, TreeB))
+	{
+		FTree& TreeA = Trees.FindOrAdd(RootA);
+		TreeA.Nodes.Append(TreeB.Nodes);
+		TreeA.bHasDelegateLinks |= TreeB.bHasDelegateLinks;
+
+		if (TreeA.bBoundsValid && TreeB.bBoundsValid)
+		{
+			TreeA.Bounds = TreeA.Bounds.Expand(TreeB.Bounds);
+		}
+		else
+		{
+			TreeA.bBoundsValid = false;
+		}
+	}
+}
+
+void FBANodeTreeIndex::RelabelTrees(const TSet<int32>& DirtyRoots)
+{
+	if (DirtyRoots.Num() == 0)
+	{
+		return;
+	}
+
+	// only the members of the dirty trees are visited, removed nodes are no longer in NodeIds
+	TArray<int32> DirtyIds;
+	for (int32 Root : DirtyRoots)
+	{
+		FTree Tree;
+		if (Trees.RemoveAndCopyValue(Root, Tree))
+		{
+			for (UEdGraphNode* Node : Tree.Nodes)
+			{
+				if (const int32* NodeId = NodeIds.Find(Node))
+				{
+					DirtyIds.Add(*NodeId);
+				}
+			}
+		}
+	}
+
+	for (int32 Id : DirtyIds)
+	{
+		Parents[Id] = Id;
+		Sizes[Id] = 1;
+
+		FTree& Tree = Trees.Add(Id);
+		Tree.Nodes.Add(Entries[Id].Node);
+		Tree.bHasDelegateLinks = Entries[Id].bHasDelegateLink;
+	}
+
+	for (int32 Id : DirtyIds)
+	{
+		for (UEdGraphNode* LinkedNode : Entries[Id].LinkedNodes)
+		{
+			if (const int32* LinkedId = NodeIds.Find(LinkedNode))
+			{
+				Join(Id, *LinkedId);
+			}
+		}
+	}
+}
+
+void FBANodeTreeIndex::GetLinkedNodes(UEdGraphNode* Node, TArray<UEdGraphNode*, TInlineAllocator<4>>& OutLinkedNodes, bool& bOutHasDelegateLink, uint32& OutPinLinkHash)
+{
+	OutLinkedNodes.Reset();
+	bOutHasDelegateLink = false;
+	OutPinLinkHash = 0;
+
+	for (UEdGraphPin* Pin : FBAUtils::GetLinkedPins(Node))
+	{
+		bOutHasDelegateLink |= FBAUtils::IsDelegatePin(Pin);
+
+		for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+		{
+			OutLinkedNodes.AddUnique(LinkedPin->GetOwningNode());
+			OutPinLinkHash += HashCombine(PointerHash(Pin), PointerHash(LinkedPin));
+		}
+	}
+}
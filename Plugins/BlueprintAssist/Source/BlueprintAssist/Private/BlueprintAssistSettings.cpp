@@ -136,6 +136,8 @@ UBASettings::UBASettings(const FObjectInitializer& ObjectInitializer)
 	EnvironmentQuerySettings.RootNodes = { "EnvironmentQueryGraphNode_Root" };
 	NonBlueprintFormatterSettings.Add("EnvironmentQueryGraph", EnvironmentQuerySettings);
 
+	LayeredFormatterMaxSweeps = 8;
+
 	bCreateKnotNodes = true;
 
 	bBetterWiringForNewNodes = true;
@@ -162,8 +164,14 @@ UBASettings::UBASettings(const FObjectInitializer& ObjectInitializer)
 	CommentNodePadding = FVector2D(30, 30);
 
 	bEnableFasterFormatting = false;
+	MaxCachedFormatters = 16;
+	CachedFormattersMemoryBudget = 64;
+
+	bUseKnotNodePool = true;
 
-	bUseKnotNodePool = false;
+	bMoveUnrelatedNodes = false;
+
+	bCacheParameterLayouts = true;
 
 	bSlowButAccurateSizeCaching = false;
 
@@ -224,12 +232,21 @@ UBASettings::UBASettings(const FObjectInitializer& ObjectInitializer)
 	bCustomDebug = -1;
 }
 
+void UBASettings::PostReloadConfig(BA_PROPERTY* PropertyThatWasLoaded)
+{
+	Super::PostReloadConfig(PropertyThatWasLoaded);
+
+	MarkSettingsChanged();
+}
+
 void UBASettings::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
 {
 	check(IBlueprintAssistModule::IsAvailable())
 
 	const FName PropertyName = (PropertyChangedEvent.Property != nullptr) ? PropertyChangedEvent.Property->GetFName() : NAME_None;
 
+	MarkSettingsChanged();
+
 	TSharedPtr<FBAGraphHandler> GraphHandler = FBATabHandler::Get().GetActiveGraphHandler();
 	if (GraphHandler.IsValid())
 	{
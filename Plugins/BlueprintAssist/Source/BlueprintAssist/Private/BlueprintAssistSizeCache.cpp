@@ -19,6 +19,8 @@
 
 #define CACHE_VERSION 1
 
+TRACE_DECLARE_INT_COUNTER(BA_CachedPackages, TEXT("BlueprintAssist/CachedPackages"));
+
 FBASizeCache& FBASizeCache::Get()
 {
 	return TLazySingleton<FBASizeCache>::Get();
@@ -37,6 +39,8 @@ void FBASizeCache::Init()
 
 void FBASizeCache::LoadCache()
 {
+	BA_TRACE_SCOPE(BA_LoadSizeCache);
+
 	if (!GetDefault<UBASettings>()->bSaveBlueprintAssistCacheToFile)
 	{
 		return;
@@ -68,10 +72,14 @@ void FBASizeCache::LoadCache()
 	}
 
 	CleanupFiles();
+
+	TRACE_COUNTER_SET(BA_CachedPackages, PackageData.PackageCache.Num());
 }
 
 void FBASizeCache::SaveCache()
 {
+	BA_TRACE_SCOPE(BA_SaveSizeCache);
+
 	if (!GetDefault<UBASettings>()->bSaveBlueprintAssistCacheToFile)
 	{
 		return;
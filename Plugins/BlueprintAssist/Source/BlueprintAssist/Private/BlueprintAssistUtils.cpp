@@ -400,6 +400,7 @@ UK2Node_Knot* FBAUtils::CreateKnotNode(
 		NewKnot->SetFlags(RF_Transactional);
 	}
 
+	Graph->Modify();
 	Graph->AddNode(NewKnot, false, false);
 	NewKnot->CreateNewGuid();
 	NewKnot->PostPlacedNewNode();
@@ -552,15 +553,14 @@ bool FBAUtils::IsExecPin(const UEdGraphPin* Pin)
 {
 	UEdGraph* Graph = Pin->GetOwningNodeUnchecked()->GetGraph();
 
-	if (FBAFormatterSettings* FormatterSettings = FindFormatterSettings(Graph))
+	const FBAFormatterSettings* FormatterSettings = FindCachedFormatterSettings(Graph);
+	if (FormatterSettings && !FormatterSettings->ExecPinName.IsNone())
 	{
-		if (!FormatterSettings->ExecPinName.IsNone())
-		{
-			return DoesPinTypeCategoryObjectMatchName(Pin, FormatterSettings->ExecPinName);
-		}
+		return DoesPinTypeCategoryObjectMatchName(Pin, FormatterSettings->ExecPinName);
 	}
 
-	if (IsBlueprintGraph(Graph))
+	// same as IsBlueprintGraph, checking the settings we already have first
+	if ((FormatterSettings && FormatterSettings->FormatterType == EBAFormatterType::Blueprint) || IsBlueprintGraph(Graph, false))
 	{
 		return Pin->PinType.PinCategory == UEdGraphSchema_K2::PC_Exec;
 	}
@@ -669,6 +669,52 @@ bool FBAUtils::DoesNodeHaveExecutionTo(UEdGraphNode* InNodeA, UEdGraphNode* InNo
 	return false;
 }
 
+TSet<UEdGraphNode*> FBAUtils::GetNodesWithExecutionFrom(UEdGraphNode* InNode)
+{
+	// same traversal as DoesNodeHaveExecutionTo, for checking many nodes against the same node
+	UEdGraphNode* Node = InNode;
+	if (FBAUtils::IsNodePure(Node))
+	{
+		if (UEdGraphNode* ExecNode = GetExecutingNode(Node))
+		{
+			Node = ExecNode;
+		}
+	}
+
+	TSet<UEdGraphNode*> NodeTree;
+	TQueue<UEdGraphNode*> NodeQueue;
+
+	NodeTree.Add(Node);
+	NodeQueue.Enqueue(Node);
+
+	while (!NodeQueue.IsEmpty())
+	{
+		UEdGraphNode* NextNode;
+		NodeQueue.Dequeue(NextNode);
+
+		TArray<UEdGraphPin*> MyLinkedPins = FBAUtils::GetLinkedPins(NextNode);
+		if (IsNodeImpure(NextNode))
+		{
+			MyLinkedPins = MyLinkedPins.FilterByPredicate(FBAUtils::IsExecPin);
+		}
+
+		for (UEdGraphPin* Pin : MyLinkedPins)
+		{
+			for (UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+				if (!NodeTree.Contains(LinkedNode))
+				{
+					NodeTree.Add(LinkedNode);
+					NodeQueue.Enqueue(LinkedNode);
+				}
+			}
+		}
+	}
+
+	return NodeTree;
+}
+
 UEdGraphNode* FBAUtils::GetExecutingNode(UEdGraphNode* Node)
 {
 	if (FBAUtils::IsNodeImpure(Node))
@@ -2236,7 +2282,7 @@ bool FBAUtils::IsExtraRootNode(UEdGraphNode* Node)
 		}
 	}
 	
-	if (FBAFormatterSettings* FormatterSettings = FindFormatterSettings(Node->GetGraph()))
+	if (const FBAFormatterSettings* FormatterSettings = FindCachedFormatterSettings(Node->GetGraph()))
 	{
 		return FormatterSettings->RootNodes.Contains(Node->GetClass()->GetFName());
 	}
@@ -2503,6 +2549,37 @@ FBAFormatterSettings* FBAUtils::FindFormatterSettings(UEdGraph* Graph)
 	return nullptr; 
 }
 
+namespace
+{
+	/* Set by FBAScopedFormatterSettings */
+	UEdGraph* ScopedSettingsGraph = nullptr;
+	const FBAFormatterSettings* ScopedSettings = nullptr;
+}
+
+const FBAFormatterSettings* FBAUtils::FindCachedFormatterSettings(UEdGraph* Graph)
+{
+	if (Graph && Graph == ScopedSettingsGraph)
+	{
+		return ScopedSettings;
+	}
+
+	return FindFormatterSettings(Graph);
+}
+
+FBAScopedFormatterSettings::FBAScopedFormatterSettings(FBAGraphHandler& GraphHandler)
+	: PreviousGraph(ScopedSettingsGraph)
+	, PreviousSettings(ScopedSettings)
+{
+	ScopedSettings = GraphHandler.GetFormatterSettings();
+	ScopedSettingsGraph = GraphHandler.GetFocusedEdGraph();
+}
+
+FBAScopedFormatterSettings::~FBAScopedFormatterSettings()
+{
+	ScopedSettingsGraph = PreviousGraph;
+	ScopedSettings = PreviousSettings;
+}
+
 TSharedPtr<FBAGraphHandler> FBAUtils::GetCurrentGraphHandler()
 {
 	return FBATabHandler::Get().GetActiveGraphHandler();
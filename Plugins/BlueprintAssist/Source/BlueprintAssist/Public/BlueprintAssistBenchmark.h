@@ -0,0 +1,79 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBAGraphHandler;
+class UEdGraph;
+class UEdGraphNode;
+
+enum class EBABenchmarkGraphShape : uint8
+{
+	ExecChain,
+	FanOut,
+	ParameterTree,
+	Helixing,
+	NestedComments,
+	Loop,
+	Num
+};
+
+enum class EBABenchmarkFormatter : uint8
+{
+	Blueprint,
+	Simple,
+	BehaviorTree,
+	Layered,
+	Num
+};
+
+struct BLUEPRINTASSIST_API FBABenchmarkResult
+{
+	EBABenchmarkFormatter Formatter;
+	EBABenchmarkGraphShape Shape;
+	int32 Size = 0;
+	int32 NumNodes = 0;
+	double Seconds = 0;
+
+	/* Bytes allocated while formatting and still held afterwards, INDEX_NONE if the allocator doesn't track them */
+	int64 AllocatedBytes = INDEX_NONE;
+};
+
+/**
+ * Procedurally generates blueprint graphs of a given shape and times the formatters on them.
+ * The graphs are generated into a transient blueprint and formatted with a headless graph handler, so nothing needs to be open.
+ * Runs as the "BlueprintAssist.Benchmark" automation test, or from the console with "BlueprintAssist.Benchmark [MaxSize] [NumRuns]".
+ */
+class BLUEPRINTASSIST_API FBABenchmark
+{
+public:
+	/* Event graph of a new blueprint in the transient package */
+	static UEdGraph* CreateTransientGraph();
+
+	/* Generates nodes into the graph, returns the root node to format from */
+	static UEdGraphNode* GenerateGraph(UEdGraph* Graph, EBABenchmarkGraphShape Shape, int32 Size, TArray<UEdGraphNode*>& OutNodes);
+
+	/*
+	 * Generates a graph, formats it and returns the time taken in seconds (negative on failure).
+	 * OnFormatted is called with the generated nodes and the nodes the formatter created before they are all deleted.
+	 */
+	static double FormatGeneratedGraph(
+		TSharedPtr<FBAGraphHandler> GraphHandler,
+		EBABenchmarkFormatter Formatter,
+		EBABenchmarkGraphShape Shape,
+		int32 Size,
+		TFunctionRef<void(const TArray<UEdGraphNode*>& GeneratedNodes, const TArray<UEdGraphNode*>& CreatedNodes)> OnFormatted,
+		int64* OutAllocatedBytes = nullptr);
+
+	static FBABenchmarkResult RunFormatter(TSharedPtr<FBAGraphHandler> GraphHandler, EBABenchmarkFormatter Formatter, EBABenchmarkGraphShape Shape, int32 Size, int32 NumRuns = 1);
+
+	/* Runs every formatter on every shape, doubling the size from MinSize up to MaxSize */
+	static TArray<FBABenchmarkResult> RunAll(TSharedPtr<FBAGraphHandler> GraphHandler, int32 MinSize, int32 MaxSize, int32 NumRuns = 1);
+
+	static void LogResults(const TArray<FBABenchmarkResult>& Results);
+
+	static FString GetShapeName(EBABenchmarkGraphShape Shape);
+
+	static FString GetFormatterName(EBABenchmarkFormatter Formatter);
+};
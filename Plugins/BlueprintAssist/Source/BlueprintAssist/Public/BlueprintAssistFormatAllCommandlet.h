@@ -0,0 +1,53 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Commandlets/Commandlet.h"
+
+#include "BlueprintAssistFormatAllCommandlet.generated.h"
+
+class UBlueprint;
+
+struct BLUEPRINTASSIST_API FBAFormatAllAssetResult
+{
+	FString AssetPath;
+	int32 NumGraphs = 0;
+	int32 NumFormattedGraphs = 0;
+	double LoadSeconds = 0;
+	double FormatSeconds = 0;
+	double SaveSeconds = 0;
+	bool bModified = false;
+	bool bSaved = false;
+	TArray<FString> Errors;
+};
+
+/**
+ * Runs Format All on every graph of every blueprint and saves the packages which changed.
+ * Only cached node sizes are used, graphs with nodes missing from the size cache are skipped unless -AllowMissingSizes is passed.
+ *
+ * UE4Editor-Cmd.exe Project.uproject -run=BAFormatAll [-Paths=/Game/A+/Game/B] [-Max=N] [-LoadAhead=8] [-GCInterval=50]
+ *		[-AllowMissingSizes] [-DryRun] [-Report=Path.csv]
+ */
+UCLASS()
+class BLUEPRINTASSIST_API UBAFormatAllCommandlet final : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBAFormatAllCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	bool bAllowMissingSizes = false;
+
+	bool bDryRun = false;
+
+	void FormatBlueprint(UBlueprint* Blueprint, FBAFormatAllAssetResult& OutResult) const;
+
+	void SavePackage(UPackage* Package, FBAFormatAllAssetResult& OutResult) const;
+
+	static void WriteReport(const FString& ReportPath, const TArray<FBAFormatAllAssetResult>& Results);
+};
@@ -2,8 +2,17 @@
 
 #pragma once
 
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
 BLUEPRINTASSIST_API DECLARE_LOG_CATEGORY_EXTERN(LogBlueprintAssist, Log, All);
 
+/* Trace channel for formatter and cache phases, enable with -trace=cpu,counters,BlueprintAssist */
+UE_TRACE_CHANNEL_EXTERN(BlueprintAssistChannel, BLUEPRINTASSIST_API);
+
+#define BA_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Name, BlueprintAssistChannel)
+
 class BLUEPRINTASSIST_API FBAGlobals
 {
 public:
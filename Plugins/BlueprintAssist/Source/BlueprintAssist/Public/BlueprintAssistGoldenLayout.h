@@ -0,0 +1,65 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "BlueprintAssistBenchmark.h"
+
+#include "BlueprintAssistGoldenLayout.generated.h"
+
+USTRUCT()
+struct BLUEPRINTASSIST_API FBAGoldenLayoutSnapshot
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Generated node positions relative to the root node, in generation order */
+	UPROPERTY()
+	TArray<FIntPoint> NodePositions;
+
+	/* Knot nodes created by the formatter as "X,Y>LinkedNodes", sorted */
+	UPROPERTY()
+	TArray<FString> KnotNodes;
+
+	/* Fastest of a few formats, the timing budget of a case is relative to the recorded time */
+	UPROPERTY()
+	float RecordedMilliseconds = 0;
+};
+
+struct BLUEPRINTASSIST_API FBAGoldenLayoutCase
+{
+	EBABenchmarkFormatter Formatter;
+	EBABenchmarkGraphShape Shape;
+	int32 Size;
+
+	FString GetName() const;
+};
+
+/**
+ * Formats the benchmark graphs with the settings stored next to the golden snapshots and compares the resulting layout against them.
+ * Verified by the "BlueprintAssist.GoldenLayout" automation test, record or verify from the console with "BlueprintAssist.GoldenLayout [Record|Verify]".
+ * Both run headless on a transient blueprint. Verifying records any missing snapshot instead of failing, the new files should then be committed.
+ */
+class BLUEPRINTASSIST_API FBAGoldenLayout
+{
+public:
+	static const TArray<FBAGoldenLayoutCase>& GetCases();
+
+	/* Returns the number of failed cases. Failures and recorded snapshots are added to OutErrors and OutWarnings, or logged when they are null. */
+	static int32 Verify(TSharedPtr<FBAGraphHandler> GraphHandler, TArray<FString>* OutErrors = nullptr, TArray<FString>* OutWarnings = nullptr);
+
+	static void Record(TSharedPtr<FBAGraphHandler> GraphHandler);
+
+	static FString GetGoldenDir();
+
+private:
+	static bool FormatCase(TSharedPtr<FBAGraphHandler> GraphHandler, const FBAGoldenLayoutCase& Case, FBAGoldenLayoutSnapshot& OutSnapshot);
+
+	static void SaveSnapshot(const FBAGoldenLayoutCase& Case, const FBAGoldenLayoutSnapshot& Snapshot);
+
+	static bool CompareSnapshots(const FBAGoldenLayoutSnapshot& Golden, const FBAGoldenLayoutSnapshot& Current, FString& OutError);
+
+	static bool ApplySettings(const FString& SettingsJson);
+
+	static FString SaveSettings();
+};
@@ -6,7 +6,11 @@
 
 #include "BlueprintAssistDelayedDelegate.h"
 #include "BlueprintAssistNodeSizeChangeData.h"
+#include "BlueprintAssistNodeTreeIndex.h"
+#include "BlueprintAssist/GraphFormatters/BlueprintAssistCommentHandler.h"
+#include "BlueprintAssist/GraphFormatters/EdGraphFormatter.h"
 #include "BlueprintAssist/GraphFormatters/GraphFormatterTypes.h"
+#include "BlueprintAssist/GraphFormatters/KnotTrack/KnotTrack.h"
 
 class SMyBlueprint;
 class FBANodeSizeChangeData;
@@ -15,6 +19,14 @@ struct FBACacheData;
 
 DECLARE_MULTICAST_DELEGATE_TwoParams(FOnNodeFormatted, UEdGraphNode*, const FFormatterInterface&);
 
+/* A formatter kept for the faster formatting path, keyed by its root node */
+struct FBACachedFormatter
+{
+	TSharedPtr<FEdGraphFormatter> Formatter;
+	SIZE_T AllocatedSize = 0;
+	uint64 LastUsed = 0;
+};
+
 class BLUEPRINTASSIST_API FBAGraphHandler
 	: public TSharedFromThis<FBAGraphHandler>
 {
@@ -25,6 +37,9 @@ public:
 
 	FBAGraphHandler(TWeakPtr<SDockTab> InTab, TWeakPtr<SGraphEditor> InGraphEditor);
 
+	/* Handler without a graph editor (used by the format all commandlet), node sizes only come from the size cache */
+	explicit FBAGraphHandler(UEdGraph* InGraph);
+
 	~FBAGraphHandler();
 
 	void InitGraphHandler();
@@ -81,6 +96,17 @@ public:
 
 	TSharedPtr<FFormatterInterface> FormatNodes(UEdGraphNode* Node, bool bUsingFormatAll = false);
 
+	/* Formatters write node positions directly, when the outermost recording ends only the nodes which actually moved are modified */
+	void BeginRecordingLayoutChanges();
+
+	void EndRecordingLayoutChanges();
+
+	/* Modify a node whose links or comment membership are about to change, also marks it in the node tree index. While recording, the node is modified with the layout it had when recording began so undo restores it. */
+	void ModifyRecordedNode(UEdGraphNode* Node);
+
+	/* Save the links of a node which is about to be relinked. It is only modified when the recording ends if its links or layout changed, so relinking it to the same pins leaves no change behind. */
+	void RecordNodeLinks(UEdGraphNode* Node);
+
 	void CancelProcessingNodeSizes();
 
 	void CancelCachingNotification();
@@ -129,16 +155,45 @@ public:
 
 	void ClearFormatters();
 
+	/* Releases every cached formatter and resume state */
+	void ClearCachedFormatters();
+
+	void RemoveCachedFormatter(UEdGraphNode* RootNode);
+
+	/* Evicts the least recently used formatters (keeping their resume state) while over the count or memory budget */
+	void EvictCachedFormatters();
+
+	/* Drops the resume states whose root node was deleted, only checked when the node tree index saw a link change since the last prune */
+	void PruneFormatterResumeStates();
+
+	/* The cached formatter for the root node, or a formatter resumed from an evicted one if its node tree is unchanged */
+	TSharedPtr<FFormatterInterface> FindCachedFormatter(UEdGraphNode* RootNode);
+
 	bool FilterSelectiveFormatting(UEdGraphNode* Node, const TArray<UEdGraphNode*>& NodesToFormat);
 
 	bool FilterDelegatePin(const FPinLink& PinLink, const TArray<UEdGraphNode*>& NodesToFormat);
 
+	/* Roots which didn't depend on the selection or node positions are reused until the links or settings change */
 	UEdGraphNode* GetRootNode(UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat, bool bCheckSelectedNode = true);
 
 	TSharedPtr<FFormatterInterface> MakeFormatter();
 
+	/* Formatter settings of the focused graph, copied from the settings and refreshed when they change. Null if the graph has none. */
+	const FBAFormatterSettings* GetFormatterSettings();
+
+	TMap<uint32, FParameterLayout>& GetParameterLayoutCache() { return ParameterLayoutCache; }
+
+	FBACommentForest& GetCommentForest() { return CommentForest; }
+
+	/* Node trees of the focused graph, the nodes marked by graph and transaction notifications are rescanned on access */
+	FBANodeTreeIndex& GetNodeTreeIndex();
+
+	FBAKnotNodePool& GetKnotNodePool() { return KnotNodePool; }
+
 	bool HasActiveTransaction() const;
 
+	bool IsHeadless() const { return bHeadless; }
+
 private:
 	TWeakPtr<SGraphPanel> CachedGraphPanel;
 	TWeakPtr<SGraphEditor> CachedGraphEditor;
@@ -146,6 +201,8 @@ private:
 
 	TWeakObjectPtr<UEdGraph> CachedEdGraph;
 
+	bool bHeadless = false;
+
 	FEdGraphFormatterParameters FormatterParameters;
 
 	TOptional<FGraphPinHandle> SelectedPinHandle;
@@ -185,7 +242,27 @@ private:
 	TArray<UEdGraphNode*> PendingSize;
 
 	TArray<TArray<UEdGraphNode*>> FormatAllColumns;
-	TMap<UEdGraphNode*, TSharedPtr<FFormatterInterface>> FormatterMap;
+	TMap<UEdGraphNode*, FBACachedFormatter> FormatterMap;
+	TMap<TWeakObjectPtr<UEdGraphNode>, FEdGraphFormatterResumeState> FormatterResumeStates;
+	uint64 FormatterUseCounter = 0;
+	uint32 ResumeStatesLinkVersion = 0;
+	TMap<uint32, FParameterLayout> ParameterLayoutCache;
+	FBACommentForest CommentForest;
+	FBANodeTreeIndex NodeTreeIndex;
+	FBAKnotNodePool KnotNodePool;
+
+	FBAFormatterSettings CachedFormatterSettings;
+	TWeakObjectPtr<UEdGraph> CachedFormatterSettingsGraph;
+	uint32 CachedFormatterSettingsVersion = 0;
+	bool bHasCachedFormatterSettings = false;
+
+	TMap<UEdGraphNode*, UEdGraphNode*> CachedRootNodes;
+	uint32 CachedRootNodesLinkVersion = 0;
+	uint32 CachedRootNodesSettingsVersion = 0;
+
+	TMap<TWeakObjectPtr<UEdGraphNode>, FNodeLayoutState> RecordedLayout;
+	TMap<TWeakObjectPtr<UEdGraphNode>, FNodeLinkState> RecordedLinks;
+	int32 RecordLayoutDepth = 0;
 
 	TSharedPtr<FScopedTransaction> PendingTransaction;
 	TSharedPtr<FScopedTransaction> ReplaceNewNodeTransaction;
@@ -218,6 +295,7 @@ private:
 
 	void ReplaceSavedSelectedNode(UEdGraphNode* NewNode);
 
+	/* Moves the trees overlapping the formatted nodes, and the trees those moved trees land on, down until nothing overlaps. Call while recording layout changes. */
 	void MoveUnrelatedNodes(TSharedPtr<FFormatterInterface> Formatter);
 
 	void OnGraphChanged(const FEdGraphEditAction& Action);
@@ -242,6 +320,9 @@ private:
 
 	void OnObjectTransacted(UObject* Object, const FTransactionObjectEvent& Event);
 
+	/* FBAUtils::TryCreateConnection which also marks both nodes in the node tree index */
+	bool TryCreateConnection(UEdGraphPin* PinA, UEdGraphPin* PinB);
+
 	bool CacheNodeSize(UEdGraphNode* Node);
 
 	bool UpdateNodeSizesChanges(const TArray<UEdGraphNode*>& Nodes);
@@ -251,4 +332,7 @@ private:
 	void AutoZoomToNode(UEdGraphNode* Node);
 
 	bool DoesNodeWantAutoFormatting(UEdGraphNode* Node);
+
+	/* bOutCanCache is false when the root depended on the selected node or the node positions */
+	UEdGraphNode* FindRootNode(UEdGraphNode* InitialNode, const TArray<UEdGraphNode*>& NodesToFormat, bool bCheckSelectedNode, bool& bOutCanCache);
 };
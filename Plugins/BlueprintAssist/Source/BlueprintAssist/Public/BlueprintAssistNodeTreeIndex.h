@@ -0,0 +1,112 @@
+// Copyright 2021 fpwong. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UEdGraph;
+class UEdGraphNode;
+
+/**
+ * The connected node trees of a graph (what FBAUtils::GetNodeTree would return for each node).
+ * Nodes are marked from graph and transaction notifications, Update only rescans the marked nodes and the nodes they were linked to.
+ * New links join two trees while trees which lost a link or a node are relabeled from their current links.
+ */
+struct BLUEPRINTASSIST_API FBANodeTreeIndex
+{
+	/* Applies the marked changes, the whole graph is only rescanned when indexing a new graph or after MarkAllDirty */
+	void Update(UEdGraph* Graph);
+
+	void Reset();
+
+	/* The node was added or its links changed */
+	void MarkNodeDirty(UEdGraphNode* Node);
+
+	/* The node was removed from the graph, it is not accessed again */
+	void MarkNodeRemoved(UEdGraphNode* Node);
+
+	/* Invalidates the cached bounds of the node's tree */
+	void MarkNodeMoved(UEdGraphNode* Node);
+
+	/* For changes which don't say which nodes they touched */
+	void MarkAllDirty() { bFullRescanPending = true; }
+
+	bool Contains(UEdGraphNode* Node) const { return NodeIds.Contains(Node); }
+
+	bool IsIndexing(UEdGraph* Graph) const { return Graph != nullptr && IndexedGraph.Get() == Graph; }
+
+	/* Incremented whenever an update finds a changed pin link or node */
+	uint32 GetLinkVersion() const { return LinkVersion; }
+
+	/* Id of the tree containing the node, INDEX_NONE if the node is not in the graph. Ids are only valid until the next update. */
+	int32 GetTreeId(UEdGraphNode* Node);
+
+	bool IsSameTree(UEdGraphNode* NodeA, UEdGraphNode* NodeB);
+
+	/* Every node linked to the node directly or through other nodes, including the node */
+	const TArray<UEdGraphNode*>& GetNodeTree(UEdGraphNode* Node);
+
+	const TArray<UEdGraphNode*>& GetTreeNodes(int32 TreeId);
+
+	/* If any node in the tree has a linked delegate pin */
+	bool HasDelegateLinks(int32 TreeId);
+
+	TArray<int32> GetTreeIds() const;
+
+	/* Cached until a node of the tree is marked as moved or the tree changes */
+	FSlateRect GetTreeBounds(int32 TreeId);
+
+	/* Trees whose bounds intersect the given bounds */
+	TArray<int32> GetTreesIntersecting(const FSlateRect& Bounds);
+
+private:
+	struct FNodeEntry
+	{
+		UEdGraphNode* Node = nullptr;
+		TArray<UEdGraphNode*, TInlineAllocator<4>> LinkedNodes;
+		bool bHasDelegateLink = false;
+		uint32 PinLinkHash = 0;
+		uint32 UpdateStamp = 0;
+	};
+
+	struct FTree
+	{
+		TArray<UEdGraphNode*> Nodes;
+		bool bHasDelegateLinks = false;
+		FSlateRect Bounds;
+		bool bBoundsValid = false;
+	};
+
+	TWeakObjectPtr<UEdGraph> IndexedGraph;
+
+	TMap<UEdGraphNode*, int32> NodeIds;
+	TArray<FNodeEntry> Entries;
+	TArray<int32> Parents;
+	TArray<int32> Sizes;
+	TArray<int32> FreeIds;
+	uint32 UpdateStamp = 0;
+	uint32 LinkVersion = 0;
+
+	/* Kept for every tree, keyed by the root id */
+	TMap<int32, FTree> Trees;
+
+	/* Nodes to rescan on the next update, true if the node was removed */
+	TMap<UEdGraphNode*, bool> DirtyNodes;
+	bool bFullRescanPending = true;
+
+	/* Returned for nodes which are not in the graph */
+	TArray<UEdGraphNode*> SingleNodeTree;
+
+	int32 AddEntry(UEdGraphNode* Node);
+
+	/* Rescans the links of the node, returns true if they changed */
+	bool UpdateEntry(UEdGraphNode* Node, TSet<int32>& DirtyRoots, TArray<TPair<int32, UEdGraphNode*>>& NewLinks);
+
+	void RemoveEntry(int32 Id, TSet<int32>& DirtyRoots, TArray<int32>& RemovedIds);
+
+	int32 FindRoot(int32 Id);
+	void Join(int32 IdA, int32 IdB);
+	void RelabelTrees(const TSet<int32>& DirtyRoots);
+
+	static void GetLinkedNodes(UEdGraphNode* Node, TArray<UEdGraphNode*, TInlineAllocator<4>>& OutLinkedNodes, bool& bOutHasDelegateLink, uint32& OutPinLinkHash);
+};
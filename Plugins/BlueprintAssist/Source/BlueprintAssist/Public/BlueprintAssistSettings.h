@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 
 #include "IDetailCustomization.h"
+#include "BlueprintAssistTypes.h"
 
 #include "BlueprintAssistSettings.generated.h"
 
@@ -60,6 +61,7 @@ enum class EBAFormatterType : uint8
 	Blueprint UMETA(DisplayName = "Blueprint"),
 	BehaviorTree UMETA(DisplayName = "BehaviorTree"),
 	Simple UMETA(DisplayName = "Simple formatter"),
+	Layered UMETA(DisplayName = "Layered formatter (large graphs)"),
 };
 
 UENUM()
@@ -114,9 +116,13 @@ struct FBAFormatterSettings
 	UPROPERTY(EditAnywhere, config, Category=FormatterSettings)
 	FName ExecPinName;
 
+	/* Simple formatter only: lay out large graphs with a single pass over dense arrays (columns from a topological order, packed rows and a spatial hash for overlaps). Faster but less compact, comment padding is not applied */
+	UPROPERTY(EditAnywhere, config, Category=FormatterSettings, meta = (EditCondition = "FormatterType == EBAFormatterType::Simple"))
+	bool bFastMode = false;
+
 	FString ToString() const
 	{
-		return FString::Printf(TEXT("FormatterType %d | ExecPinName %s"), FormatterType, *ExecPinName.ToString());
+		return FString::Printf(TEXT("FormatterType %d | ExecPinName %s | FastMode %d"), FormatterType, *ExecPinName.ToString(), bFastMode);
 	}
 };
 
@@ -204,10 +210,26 @@ public:
 	UPROPERTY(EditAnywhere, config, Category = FormattingOptions)
 	bool bEnableFasterFormatting;
 
-	/* Reuse knot nodes instead of creating new ones every time */
+	/* Number of formatters kept per graph for faster formatting, the least recently used ones are evicted and only keep a small resume state */
+	UPROPERTY(EditAnywhere, config, Category = FormattingOptions, meta = (EditCondition = "bEnableFasterFormatting", ClampMin = 1))
+	int32 MaxCachedFormatters;
+
+	/* Memory (in MB) the formatters kept for faster formatting may use per graph before the least recently used ones are evicted */
+	UPROPERTY(EditAnywhere, config, Category = FormattingOptions, meta = (EditCondition = "bEnableFasterFormatting", ClampMin = 1))
+	int32 CachedFormattersMemoryBudget;
+
+	/* Reuse knot nodes instead of creating new ones every time. Knots are kept between formats and relinked in place, only the difference is created or deleted */
 	UPROPERTY(EditAnywhere, config, Category = FormattingOptions)
 	bool bUseKnotNodePool;
 
+	/* After formatting an event, move the node trees which overlap it (and the trees those land on) below it */
+	UPROPERTY(EditAnywhere, config, Category = FormattingOptions)
+	bool bMoveUnrelatedNodes;
+
+	/* Reuse the previous layout of parameter nodes if their structure and node sizes have not changed */
+	UPROPERTY(EditAnywhere, config, Category = FormattingOptions)
+	bool bCacheParameterLayouts;
+
 	/* Whether to use HelixingHeightMax and SingleNodeMaxHeight */
 	UPROPERTY(EditAnywhere, config, Category = FormattingOptions)
 	bool bLimitHelixingHeight;
@@ -326,6 +348,10 @@ public:
 	UPROPERTY(EditAnywhere, config, Category = OtherGraphs)
 	TMap<FName, FBAFormatterSettings> NonBlueprintFormatterSettings;
 
+	/* Number of ordering sweeps the layered formatter runs to reduce crossing wires */
+	UPROPERTY(EditAnywhere, config, Category = OtherGraphs, meta = (ClampMin = 0))
+	int32 LayeredFormatterMaxSweeps;
+
 	////////////////////////////////////////////////////////////
 	// Comment Settings
 	////////////////////////////////////////////////////////////
@@ -463,6 +489,17 @@ public:
 	int bCustomDebug;
 
 	virtual void PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChangedEvent) override;
+
+	virtual void PostReloadConfig(BA_PROPERTY* PropertyThatWasLoaded) override;
+
+	/* Incremented whenever a setting changes, caches of resolved settings compare against this */
+	uint32 GetSettingsVersion() const { return SettingsVersion; }
+
+	/* Call after writing to the settings directly (without PostEditChange) so the caches are invalidated */
+	void MarkSettingsChanged() { ++SettingsVersion; }
+
+private:
+	uint32 SettingsVersion = 1;
 };
 
 class FBASettingsDetails final : public IDetailCustomization
@@ -169,6 +169,9 @@ struct BLUEPRINTASSIST_API FBAUtils
 
 	static bool DoesNodeHaveExecutionTo(UEdGraphNode* NodeA, UEdGraphNode* NodeB);
 
+	/* Every node DoesNodeHaveExecutionTo reaches from the node, check pure nodes by their executing node */
+	static TSet<UEdGraphNode*> GetNodesWithExecutionFrom(UEdGraphNode* Node);
+
 	static UEdGraphNode* GetExecutingNode(UEdGraphNode* Node);
 
 	static TSet<UEdGraphNode*> GetNodeTreeWithFilter(
@@ -421,6 +424,9 @@ struct BLUEPRINTASSIST_API FBAUtils
 	static FBAFormatterSettings GetFormatterSettings(UEdGraph* Graph);
 	static FBAFormatterSettings* FindFormatterSettings(UEdGraph* Graph);
 
+	/* The graph handler's cached settings while a FBAScopedFormatterSettings is alive for the graph, otherwise FindFormatterSettings */
+	static const FBAFormatterSettings* FindCachedFormatterSettings(UEdGraph* Graph);
+
 	static TSharedPtr<FBAGraphHandler> GetCurrentGraphHandler();
 
 	static float GetCenterYOfPins(TSharedPtr<FBAGraphHandler> GraphHandler, TArray<UEdGraphPin*>& Pins);
@@ -480,3 +486,14 @@ struct BLUEPRINTASSIST_API FBAUtils
 	static UMetaData* GetNodeMetaData(UEdGraphNode* Node);
 	static FString GetVariableName(const FString& Name, const FName& PinCategory, EPinContainerType ContainerType);
 };
+
+/* Per pin and per node lookups (IsExecPin, IsExtraRootNode) on the handler's graph read the handler's cached formatter settings while this is alive */
+struct BLUEPRINTASSIST_API FBAScopedFormatterSettings
+{
+	explicit FBAScopedFormatterSettings(FBAGraphHandler& GraphHandler);
+	~FBAScopedFormatterSettings();
+
+private:
+	UEdGraph* PreviousGraph;
+	const FBAFormatterSettings* PreviousSettings;
+};